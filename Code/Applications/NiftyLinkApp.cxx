@@ -197,8 +197,12 @@ void NiftyLinkApp::OnMessageReceived(NiftyLinkMessageContainer::Pointer message)
   // For stats.
   m_MessagesReceived.OnMessageReceived(message);
 
-  // Extract Data, at each loop iteration.
-  ExtractImageMessage(message, m_MostRecentImage);
+  // Extract Data, at each loop iteration. Images are only converted when the screen is updated,
+  // so here we just keep a reference to the most recent one.
+  if (dynamic_cast<igtl::ImageMessage*>(message->GetMessage().GetPointer()) != NULL)
+  {
+    m_MostRecentImageMessage = message;
+  }
   ExtractTextBasedMessage(message, m_MostRecentString);
 
   QString filterText = this->m_OutgoingFilter->text();
@@ -243,7 +247,18 @@ void NiftyLinkApp::OnUpdateStatus()
 void NiftyLinkApp::OnUpdateScreen()
 {
   this->m_TextEdit->setPlainText(m_MostRecentString);
-  this->m_ImageLabel->setPixmap(QPixmap::fromImage(m_MostRecentImage));
+
+  if (m_MostRecentImageMessage.data() != NULL)
+  {
+    // Where the scalars are suitably aligned, the view refers to them, so the only copy is the unavoidable one into the QPixmap.
+    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(m_MostRecentImageMessage->GetMessage().GetPointer());
+    QImage image;
+    GetQImageView(imageMessage, image);
+    this->m_ImageLabel->setPixmap(QPixmap::fromImage(image));
+
+    // Nothing new to draw until the next image arrives.
+    m_MostRecentImageMessage.reset();
+  }
 }
 
 
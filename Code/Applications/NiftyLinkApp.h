@@ -97,7 +97,7 @@ private:
 
   NiftyLinkTcpClient      *m_InboundClient;
   NiftyLinkTcpClient      *m_OutboundClient;
-  QImage                   m_MostRecentImage;
+  NiftyLinkMessageContainer::Pointer m_MostRecentImageMessage;
   QString                  m_MostRecentString;
   NiftyLinkMessageCounter  m_MessagesReceived;
   NiftyLinkMessageCounter  m_MessagesSent;
@@ -122,6 +122,13 @@ void NiftyLinkMessageCounter::OnMessageReceived(NiftyLinkMessageContainer::Point
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageCounter::OnMessageCodec(quint64 uncompressedBytes, quint64 compressedBytes, quint64 codecTimeInNanoseconds)
+{
+  m_StatsContainer.IncrementCodec(uncompressedBytes, compressedBytes, codecTimeInNanoseconds);
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkMessageCounter::OnOutputStats()
 {
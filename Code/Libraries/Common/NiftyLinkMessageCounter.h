@@ -99,6 +99,9 @@ public slots:
   /// \brief Increment internal counters, i.e. accumulate statistics.
   void OnMessageReceived(NiftyLinkMessageContainer::Pointer& message);
 
+  /// \brief Accumulates compression statistics, for each image compressed or decompressed.
+  void OnMessageCodec(quint64 uncompressedBytes, quint64 compressedBytes, quint64 codecTimeInNanoseconds);
+
   /// \brief Clear the stats containers down.
   void OnClear();
 
@@ -56,7 +56,10 @@ void NiftyLinkMessageStatsContainer::DeepCopy(const NiftyLinkMessageStatsContain
   m_TotalNumberMessagesReceived = another.m_TotalNumberMessagesReceived;
   m_BytesReceivedBetweenCheckPoints = another.m_BytesReceivedBetweenCheckPoints;
   m_NumberMessagesReceivedBetweenCheckPoints = another.m_NumberMessagesReceivedBetweenCheckPoints;
-  m_ListOfLatency = another.m_ListOfLatency;
+  m_LatencyStats = another.m_LatencyStats;
+  m_UncompressedBytesBetweenCheckPoints = another.m_UncompressedBytesBetweenCheckPoints;
+  m_CompressedBytesBetweenCheckPoints = another.m_CompressedBytesBetweenCheckPoints;
+  m_CodecTimeStats = another.m_CodecTimeStats;
   m_MapOfMessageCounts = another.m_MapOfMessageCounts;
 }
 
@@ -75,7 +78,10 @@ bool NiftyLinkMessageStatsContainer::operator==(const NiftyLinkMessageStatsConta
       && m_EndTimeStampInNanoseconds == another.m_EndTimeStampInNanoseconds
       && m_BytesReceivedBetweenCheckPoints == another.m_BytesReceivedBetweenCheckPoints
       && m_NumberMessagesReceivedBetweenCheckPoints == another.m_NumberMessagesReceivedBetweenCheckPoints
-      && m_ListOfLatency == another.m_ListOfLatency
+      && m_LatencyStats == another.m_LatencyStats
+      && m_UncompressedBytesBetweenCheckPoints == another.m_UncompressedBytesBetweenCheckPoints
+      && m_CompressedBytesBetweenCheckPoints == another.m_CompressedBytesBetweenCheckPoints
+      && m_CodecTimeStats == another.m_CodecTimeStats
       && m_MapOfMessageCounts == another.m_MapOfMessageCounts
       )
   {
@@ -100,7 +106,10 @@ void NiftyLinkMessageStatsContainer::Checkpoint()
 {
   m_BytesReceivedBetweenCheckPoints = 0;
   m_NumberMessagesReceivedBetweenCheckPoints = 0;
-  m_ListOfLatency.clear();
+  m_LatencyStats.Reset();
+  m_UncompressedBytesBetweenCheckPoints = 0;
+  m_CompressedBytesBetweenCheckPoints = 0;
+  m_CodecTimeStats.Reset();
   m_MapOfMessageCounts.clear();
   m_StartTimeStampInNanoseconds = 0;
   m_EndTimeStampInNanoseconds = 0;
@@ -126,7 +135,7 @@ void NiftyLinkMessageStatsContainer::Increment(const QString& deviceType,
   m_TotalNumberMessagesReceived += 1;
   m_NumberMessagesReceivedBetweenCheckPoints += 1;
 
-  m_ListOfLatency.push_back(latency);
+  m_LatencyStats.Add(latency);
 
   if (m_MapOfMessageCounts.contains(deviceType))
   {
@@ -141,10 +150,53 @@ void NiftyLinkMessageStatsContainer::Increment(const QString& deviceType,
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageStatsContainer::IncrementCodec(const quint64& uncompressedBytes,
+    const quint64& compressedBytes,
+    const quint64& codecTimeInNanoseconds)
+{
+  m_UncompressedBytesBetweenCheckPoints += uncompressedBytes;
+  m_CompressedBytesBetweenCheckPoints += compressedBytes;
+  m_CodecTimeStats.Add(codecTimeInNanoseconds);
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageStatsContainer::GetNumberOfCodecMessagesSinceCheckpoint() const
+{
+  return m_CodecTimeStats.GetCount();
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageStatsContainer::GetCompressionRatioSinceCheckpoint() const
+{
+  if (m_CompressedBytesBetweenCheckPoints == 0)
+  {
+    return 0;
+  }
+  return static_cast<double>(m_UncompressedBytesBetweenCheckPoints) / static_cast<double>(m_CompressedBytesBetweenCheckPoints);
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageStatsContainer::GetMeanCodecTimeSinceCheckpointInMilliseconds() const
+{
+  return m_CodecTimeStats.GetMean()/m_NANO_TO_MILLI_DIVISOR;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageStatsContainer::GetMaxCodecTimeSinceCheckpointInMilliseconds() const
+{
+  return static_cast<double>(m_CodecTimeStats.GetMax())/m_NANO_TO_MILLI_DIVISOR;
+}
+
+
 //-----------------------------------------------------------------------------
 double NiftyLinkMessageStatsContainer::GetMeanLatencySinceCheckpoint() const
 {
-  return CalculateMean(m_ListOfLatency);
+  return m_LatencyStats.GetMean();
 }
 
 
@@ -158,7 +210,7 @@ double NiftyLinkMessageStatsContainer::GetMeanLatencySinceCheckpointInMillisecon
 //-----------------------------------------------------------------------------
 double NiftyLinkMessageStatsContainer::GetStdDevLatencySinceCheckpoint() const
 {
-  return CalculateStdDev(m_ListOfLatency);
+  return m_LatencyStats.GetStdDev();
 }
 
 
@@ -172,7 +224,7 @@ double NiftyLinkMessageStatsContainer::GetStdDevLatencySinceCheckpointInMillisec
 //-----------------------------------------------------------------------------
 double NiftyLinkMessageStatsContainer::GetMaxLatencySinceCheckpoint() const
 {
-  return static_cast<double>(CalculateMax(m_ListOfLatency));
+  return static_cast<double>(m_LatencyStats.GetMax());
 }
 
 
@@ -183,6 +235,20 @@ double NiftyLinkMessageStatsContainer::GetMaxLatencySinceCheckpointInMillisecond
 }
 
 
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageStatsContainer::GetMinLatencySinceCheckpoint() const
+{
+  return static_cast<double>(m_LatencyStats.GetMin());
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageStatsContainer::GetMinLatencySinceCheckpointInMilliseconds() const
+{
+  return this->GetMinLatencySinceCheckpoint()/m_NANO_TO_MILLI_DIVISOR;
+}
+
+
 //-----------------------------------------------------------------------------
 double NiftyLinkMessageStatsContainer::GetDurationSinceLastCheckpoint() const
 {
@@ -274,6 +340,15 @@ QString NiftyLinkMessageStatsContainer::GetStatsMessage() const
     ++i;
   }
 
+  if (this->GetNumberOfCodecMessagesSinceCheckpoint() > 0)
+  {
+    outputString.append(QObject::tr("compressed %1 images, ratio %2, codec mean %3, max %4, ")
+                        .arg(this->GetNumberOfCodecMessagesSinceCheckpoint())
+                        .arg(this->GetCompressionRatioSinceCheckpoint())
+                        .arg(this->GetMeanCodecTimeSinceCheckpointInMilliseconds())
+                        .arg(this->GetMaxCodecTimeSinceCheckpointInMilliseconds()));
+  }
+
   return outputString;
 }
 
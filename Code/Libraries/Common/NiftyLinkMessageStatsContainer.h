@@ -13,6 +13,7 @@
 #define NiftyLinkMessageStatsContainer_h
 
 #include "NiftyLinkCommonWin32ExportHeader.h"
+#include "NiftyLinkRunningStats.h"
 
 #include <QMap>
 #include <QtGlobal>
@@ -35,6 +36,9 @@ namespace niftk
 * For this reason, note that we do not use igtl::TimeStamp in this class. igtl::TimeStamp is expensive to create/destroy.
 * So, we don't want to create/destroy them each time we use signals and slots and copy constructors etc.
 * So, this class works in conjunction with the NiftyLinkMessageCounter class to measure stats.
+*
+* Latency statistics are accumulated incrementally by NiftyLinkRunningStats, so Increment(),
+* Checkpoint() and copying are all O(1) regardless of how many messages arrive between checkpoints.
 * The reason this class is separate is to make it easier to test.
 */
 class NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessageStatsContainer {
@@ -71,6 +75,14 @@ public:
                  const quint64& numberOfBytes,
                  const quint64& latency);
 
+  /// \brief Increments the codec data, for each image compressed or decompressed, (see NiftyLinkImageCompression.h).
+  /// \param uncompressedBytes size of the message before compression, or after decompression.
+  /// \param compressedBytes size of the compressed message.
+  /// \param codecTimeInNanoseconds time taken to compress or decompress.
+  void IncrementCodec(const quint64& uncompressedBytes,
+                      const quint64& compressedBytes,
+                      const quint64& codecTimeInNanoseconds);
+
   /// \brief Resets everything to zero.
   void ResetAll();
 
@@ -95,6 +107,24 @@ public:
   /// \brief Returns the maximum of the latency in milliseconds since the last checkpoint.
   double GetMaxLatencySinceCheckpointInMilliseconds() const;
 
+  /// \brief Returns the minimum of the latency in nanoseconds since the last checkpoint.
+  double GetMinLatencySinceCheckpoint() const;
+
+  /// \brief Returns the minimum of the latency in milliseconds since the last checkpoint.
+  double GetMinLatencySinceCheckpointInMilliseconds() const;
+
+  /// \brief Returns the number of images compressed or decompressed since the last checkpoint.
+  quint64 GetNumberOfCodecMessagesSinceCheckpoint() const;
+
+  /// \brief Returns uncompressed bytes / compressed bytes since the last checkpoint, or zero if nothing was compressed.
+  double GetCompressionRatioSinceCheckpoint() const;
+
+  /// \brief Returns the mean time to compress or decompress an image in milliseconds since the last checkpoint.
+  double GetMeanCodecTimeSinceCheckpointInMilliseconds() const;
+
+  /// \brief Returns the maximum time to compress or decompress an image in milliseconds since the last checkpoint.
+  double GetMaxCodecTimeSinceCheckpointInMilliseconds() const;
+
   /// \brief Returns the duration over which the stats are currently calculated, ie. since the last checkpoint.
   /// No attempt is made to detect or recover from underflow, so if time drifts backwards, this can be negative.
   double GetDurationSinceLastCheckpoint() const;
@@ -129,7 +159,10 @@ private:
   quint64                  m_TotalNumberMessagesReceived;
   quint64                  m_BytesReceivedBetweenCheckPoints;
   quint64                  m_NumberMessagesReceivedBetweenCheckPoints;
-  QList<quint64>           m_ListOfLatency;
+  NiftyLinkRunningStats    m_LatencyStats;
+  quint64                  m_UncompressedBytesBetweenCheckPoints;
+  quint64                  m_CompressedBytesBetweenCheckPoints;
+  NiftyLinkRunningStats    m_CodecTimeStats;
   QMap< QString, quint64 > m_MapOfMessageCounts;
 
 }; // end class
@@ -0,0 +1,515 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkPixelConversions.h"
+#include <NiftyLinkMacro.h>
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NIFTYLINK_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace niftk
+{
+
+// Frames with at least this many pixels are split into bands of rows and converted in parallel.
+static const int NIFTYLINK_PIXEL_CONVERSION_PARALLEL_THRESHOLD = 256 * 256;
+
+// Each band is at least this many rows, so tasks are not too small to be worth scheduling.
+static const int NIFTYLINK_PIXEL_CONVERSION_MINIMUM_ROWS_PER_BAND = 32;
+
+// SwapByteOrder() treats its buffer as rows of this many elements, so it can reuse ConvertAllRows().
+static const int NIFTYLINK_BYTE_SWAP_ELEMENTS_PER_ROW = 4096;
+
+// Bands run on this pool, rather than QThreadPool::globalInstance(). Its threads only ever convert a band, and never
+// wait, so a band always gets a thread, even if ConvertAllRows() is called from a task on a saturated global pool.
+Q_GLOBAL_STATIC(QThreadPool, s_PixelConversionPool)
+
+// Byte offsets within a QImage::Format_ARGB32 pixel, which is a native endian quint32 0xAARRGGBB.
+// The destination is written a byte at a time, as igtl::ImageMessage scalars are not 4 byte aligned.
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+static const int ARGB32_B = 0;
+static const int ARGB32_G = 1;
+static const int ARGB32_R = 2;
+static const int ARGB32_A = 3;
+#else
+static const int ARGB32_A = 0;
+static const int ARGB32_R = 1;
+static const int ARGB32_G = 2;
+static const int ARGB32_B = 3;
+#endif
+
+/**
+* \brief Everything a row conversion function needs, so that all of them have the same signature.
+*/
+struct NiftyLinkPixelConversionArguments
+{
+  const uchar *m_Source;
+  int          m_SourceBytesPerLine;
+  const uchar *m_SecondSource;
+  int          m_SecondSourceBytesPerLine;
+  uchar       *m_Destination;
+  int          m_DestinationBytesPerLine;
+  int          m_Width;
+  int          m_Height;
+  const uchar *m_LookupTable;
+};
+
+typedef void (*NiftyLinkConvertRowsFunction)(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow);
+
+/**
+* \class NiftyLinkPixelConversionTask
+* \brief Private task to convert one band of rows on a QThreadPool.
+*/
+class NiftyLinkPixelConversionTask : public QRunnable
+{
+public:
+  NiftyLinkPixelConversionTask(NiftyLinkConvertRowsFunction function,
+                               const NiftyLinkPixelConversionArguments *args,
+                               const int& firstRow, const int& lastRow,
+                               QSemaphore *done)
+  : m_Function(function)
+  , m_Arguments(args)
+  , m_FirstRow(firstRow)
+  , m_LastRow(lastRow)
+  , m_Done(done)
+  {
+    this->setAutoDelete(true);
+  }
+
+  virtual void run()
+  {
+    m_Function(*m_Arguments, m_FirstRow, m_LastRow);
+    m_Done->release();
+  }
+
+private:
+  NiftyLinkConvertRowsFunction             m_Function;
+  const NiftyLinkPixelConversionArguments *m_Arguments;
+  int                                      m_FirstRow;
+  int                                      m_LastRow;
+  QSemaphore                              *m_Done;
+};
+
+
+//-----------------------------------------------------------------------------
+static void ConvertAllRows(NiftyLinkConvertRowsFunction function, const NiftyLinkPixelConversionArguments& args)
+{
+  if (args.m_Width <= 0 || args.m_Height <= 0)
+  {
+    return;
+  }
+
+  int numberOfBands = 1;
+  if (args.m_Width * args.m_Height >= NIFTYLINK_PIXEL_CONVERSION_PARALLEL_THRESHOLD)
+  {
+    numberOfBands = qMin(QThread::idealThreadCount(), args.m_Height / NIFTYLINK_PIXEL_CONVERSION_MINIMUM_ROWS_PER_BAND);
+  }
+
+  if (numberOfBands <= 1)
+  {
+    function(args, 0, args.m_Height);
+    return;
+  }
+
+  const int rowsPerBand = (args.m_Height + numberOfBands - 1) / numberOfBands;
+
+  QSemaphore done;
+  int numberOfTasks = 0;
+  for (int firstRow = rowsPerBand; firstRow < args.m_Height; firstRow += rowsPerBand)
+  {
+    s_PixelConversionPool()->start(
+          new NiftyLinkPixelConversionTask(function, &args, firstRow, qMin(firstRow + rowsPerBand, args.m_Height), &done));
+    numberOfTasks++;
+  }
+
+  // The calling thread does the first band, rather than sitting idle.
+  function(args, 0, rowsPerBand);
+
+  done.acquire(numberOfTasks);
+}
+
+
+//-----------------------------------------------------------------------------
+static inline uchar ClampToByte(const int& value)
+{
+  return static_cast<uchar>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+
+//-----------------------------------------------------------------------------
+static inline void YUVToARGB32(const int& y, const int& u, const int& v, uchar *pixel)
+{
+  // ITU-R BT.601, video range, in 8 bit fixed point.
+  const int c = 298 * (y - 16) + 128;
+  const int d = u - 128;
+  const int e = v - 128;
+
+  pixel[ARGB32_R] = ClampToByte((c + 409 * e) >> 8);
+  pixel[ARGB32_G] = ClampToByte((c - 100 * d - 208 * e) >> 8);
+  pixel[ARGB32_B] = ClampToByte((c + 516 * d) >> 8);
+  pixel[ARGB32_A] = 255;
+}
+
+
+//-----------------------------------------------------------------------------
+static void ConvertRGB888ToARGB32Rows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int width = args.m_Width;
+  for (int row = firstRow; row < lastRow; row++)
+  {
+    const uchar *source = args.m_Source + row * args.m_SourceBytesPerLine;
+    uchar *destination = args.m_Destination + row * args.m_DestinationBytesPerLine;
+
+    for (int x = 0; x < width; x++)
+    {
+      destination[4 * x + ARGB32_R] = source[3 * x];
+      destination[4 * x + ARGB32_G] = source[3 * x + 1];
+      destination[4 * x + ARGB32_B] = source[3 * x + 2];
+      destination[4 * x + ARGB32_A] = 255;
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void ConvertBGRAToRGBARows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int width = args.m_Width;
+  for (int row = firstRow; row < lastRow; row++)
+  {
+    const uchar *source = args.m_Source + row * args.m_SourceBytesPerLine;
+    uchar *destination = args.m_Destination + row * args.m_DestinationBytesPerLine;
+
+    for (int x = 0; x < width; x++)
+    {
+      destination[4 * x]     = source[4 * x + 2];
+      destination[4 * x + 1] = source[4 * x + 1];
+      destination[4 * x + 2] = source[4 * x];
+      destination[4 * x + 3] = source[4 * x + 3];
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void ConvertYUV422ToARGB32Rows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int pairs = args.m_Width / 2;
+  for (int row = firstRow; row < lastRow; row++)
+  {
+    const uchar *source = args.m_Source + row * args.m_SourceBytesPerLine;
+    uchar *destination = args.m_Destination + row * args.m_DestinationBytesPerLine;
+
+    for (int x = 0; x < pairs; x++)
+    {
+      const int u = source[4 * x + 1];
+      const int v = source[4 * x + 3];
+      YUVToARGB32(source[4 * x],     u, v, destination + 8 * x);
+      YUVToARGB32(source[4 * x + 2], u, v, destination + 8 * x + 4);
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void ConvertNV12ToARGB32Rows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int pairs = args.m_Width / 2;
+  for (int row = firstRow; row < lastRow; row++)
+  {
+    const uchar *yRow = args.m_Source + row * args.m_SourceBytesPerLine;
+    const uchar *uvRow = args.m_SecondSource + (row / 2) * args.m_SecondSourceBytesPerLine;
+    uchar *destination = args.m_Destination + row * args.m_DestinationBytesPerLine;
+
+    for (int x = 0; x < pairs; x++)
+    {
+      const int u = uvRow[2 * x];
+      const int v = uvRow[2 * x + 1];
+      YUVToARGB32(yRow[2 * x],     u, v, destination + 8 * x);
+      YUVToARGB32(yRow[2 * x + 1], u, v, destination + 8 * x + 4);
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void ConvertGrey16ToGrey8Rows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int width = args.m_Width;
+  const uchar *lookupTable = args.m_LookupTable;
+  for (int row = firstRow; row < lastRow; row++)
+  {
+    const uchar *source = args.m_Source + row * args.m_SourceBytesPerLine;
+    uchar *destination = args.m_Destination + row * args.m_DestinationBytesPerLine;
+
+    for (int x = 0; x < width; x++)
+    {
+      // Source need not be 2 byte aligned.
+      quint16 value;
+      memcpy(&value, source + 2 * x, 2);
+      destination[x] = lookupTable[value];
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void SwapByteOrder16(const uchar *source, uchar *destination, const int& numberOfElements)
+{
+  int i = 0;
+#if defined(NIFTYLINK_USE_SSE2)
+  for (; i + 8 <= numberOfElements; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 2 * i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 2 * i), v);
+  }
+#endif
+  for (; i < numberOfElements; i++)
+  {
+    const uchar b0 = source[2 * i];
+    const uchar b1 = source[2 * i + 1];
+    destination[2 * i]     = b1;
+    destination[2 * i + 1] = b0;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void SwapByteOrder32(const uchar *source, uchar *destination, const int& numberOfElements)
+{
+  int i = 0;
+#if defined(NIFTYLINK_USE_SSE2)
+  for (; i + 4 <= numberOfElements; i += 4)
+  {
+    // Swap the 16 bit halves of each element, then the bytes of each half.
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * i));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * i), v);
+  }
+#endif
+  for (; i < numberOfElements; i++)
+  {
+    const uchar b0 = source[4 * i];
+    const uchar b1 = source[4 * i + 1];
+    const uchar b2 = source[4 * i + 2];
+    const uchar b3 = source[4 * i + 3];
+    destination[4 * i]     = b3;
+    destination[4 * i + 1] = b2;
+    destination[4 * i + 2] = b1;
+    destination[4 * i + 3] = b0;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void SwapByteOrder64(const uchar *source, uchar *destination, const int& numberOfElements)
+{
+  int i = 0;
+#if defined(NIFTYLINK_USE_SSE2)
+  for (; i + 2 <= numberOfElements; i += 2)
+  {
+    // Reverse the 16 bit quarters of each element, then the bytes of each quarter.
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 8 * i));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 8 * i), v);
+  }
+#endif
+  for (; i < numberOfElements; i++)
+  {
+    uchar bytes[8];
+    memcpy(bytes, source + 8 * i, 8);
+    for (int j = 0; j < 8; j++)
+    {
+      destination[8 * i + j] = bytes[7 - j];
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void SwapByteOrderRows(const NiftyLinkPixelConversionArguments& args, const int& firstRow, const int& lastRow)
+{
+  const int bytesPerElement = args.m_SourceBytesPerLine / args.m_Width;
+  const uchar *source = args.m_Source + firstRow * args.m_SourceBytesPerLine;
+  uchar *destination = args.m_Destination + firstRow * args.m_DestinationBytesPerLine;
+  const int numberOfElements = (lastRow - firstRow) * args.m_Width;
+
+  switch (bytesPerElement)
+  {
+    case 2:
+      SwapByteOrder16(source, destination, numberOfElements);
+      break;
+    case 4:
+      SwapByteOrder32(source, destination, numberOfElements);
+      break;
+    case 8:
+      SwapByteOrder64(source, destination, numberOfElements);
+      break;
+    default:
+      if (source != destination)
+      {
+        memcpy(destination, source, static_cast<size_t>(numberOfElements) * bytesPerElement);
+      }
+      break;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkPixelConversionArguments CreateArguments(const uchar *source, const int& sourceBytesPerLine,
+                                                         uchar *destination, const int& destinationBytesPerLine,
+                                                         const int& width, const int& height)
+{
+  if (source == NULL || destination == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Source or destination is NULL.");
+  }
+
+  NiftyLinkPixelConversionArguments args;
+  args.m_Source = source;
+  args.m_SourceBytesPerLine = sourceBytesPerLine;
+  args.m_SecondSource = NULL;
+  args.m_SecondSourceBytesPerLine = 0;
+  args.m_Destination = destination;
+  args.m_DestinationBytesPerLine = destinationBytesPerLine;
+  args.m_Width = width;
+  args.m_Height = height;
+  args.m_LookupTable = NULL;
+  return args;
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertRGB888ToARGB32(const uchar *source, const int& sourceBytesPerLine,
+                           uchar *destination, const int& destinationBytesPerLine,
+                           const int& width, const int& height)
+{
+  NiftyLinkPixelConversionArguments args = CreateArguments(source, sourceBytesPerLine, destination, destinationBytesPerLine, width, height);
+  ConvertAllRows(ConvertRGB888ToARGB32Rows, args);
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertBGRAToRGBA(const uchar *source, const int& sourceBytesPerLine,
+                       uchar *destination, const int& destinationBytesPerLine,
+                       const int& width, const int& height)
+{
+  NiftyLinkPixelConversionArguments args = CreateArguments(source, sourceBytesPerLine, destination, destinationBytesPerLine, width, height);
+  ConvertAllRows(ConvertBGRAToRGBARows, args);
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertYUV422ToARGB32(const uchar *source, const int& sourceBytesPerLine,
+                           uchar *destination, const int& destinationBytesPerLine,
+                           const int& width, const int& height)
+{
+  if (width % 2 != 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "YUV 4:2:2 width must be even, not " << width << ".");
+  }
+
+  NiftyLinkPixelConversionArguments args = CreateArguments(source, sourceBytesPerLine, destination, destinationBytesPerLine, width, height);
+  ConvertAllRows(ConvertYUV422ToARGB32Rows, args);
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertNV12ToARGB32(const uchar *yPlane, const int& yBytesPerLine,
+                         const uchar *uvPlane, const int& uvBytesPerLine,
+                         uchar *destination, const int& destinationBytesPerLine,
+                         const int& width, const int& height)
+{
+  if (width % 2 != 0 || height % 2 != 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "NV12 width and height must be even, not " << width << "x" << height << ".");
+  }
+
+  if (uvPlane == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "NV12 UV plane is NULL.");
+  }
+
+  NiftyLinkPixelConversionArguments args = CreateArguments(yPlane, yBytesPerLine, destination, destinationBytesPerLine, width, height);
+  args.m_SecondSource = uvPlane;
+  args.m_SecondSourceBytesPerLine = uvBytesPerLine;
+  ConvertAllRows(ConvertNV12ToARGB32Rows, args);
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertGrey16ToGrey8(const uchar *source, const int& sourceBytesPerLine,
+                          uchar *destination, const int& destinationBytesPerLine,
+                          const int& width, const int& height,
+                          const int& window, const int& level)
+{
+  if (window < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Window must be at least 1, not " << window << ".");
+  }
+
+  // 64K entries is cheap next to a frame of 16 bit pixels, and turns each pixel into one load.
+  QVector<uchar> lookupTable(65536);
+  const qint64 low = static_cast<qint64>(level) - window / 2;
+  for (int i = 0; i < 65536; i++)
+  {
+    qint64 value = ((i - low) * 255 + window / 2) / window;
+    lookupTable[i] = static_cast<uchar>(value < 0 ? 0 : (value > 255 ? 255 : value));
+  }
+
+  NiftyLinkPixelConversionArguments args = CreateArguments(source, sourceBytesPerLine, destination, destinationBytesPerLine, width, height);
+  args.m_LookupTable = lookupTable.constData();
+  ConvertAllRows(ConvertGrey16ToGrey8Rows, args);
+}
+
+//-----------------------------------------------------------------------------
+void SwapByteOrder(const uchar *source, uchar *destination, const int& bytesPerElement, const qint64& numberOfElements)
+{
+  if (bytesPerElement != 1 && bytesPerElement != 2 && bytesPerElement != 4 && bytesPerElement != 8)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Can only swap the byte order of 1, 2, 4 or 8 byte elements, not " << bytesPerElement << ".");
+  }
+
+  const qint64 numberOfRows = numberOfElements / NIFTYLINK_BYTE_SWAP_ELEMENTS_PER_ROW;
+  const int bytesPerRow = NIFTYLINK_BYTE_SWAP_ELEMENTS_PER_ROW * bytesPerElement;
+
+  NiftyLinkPixelConversionArguments args = CreateArguments(source, bytesPerRow, destination, bytesPerRow,
+                                                           NIFTYLINK_BYTE_SWAP_ELEMENTS_PER_ROW, static_cast<int>(numberOfRows));
+  ConvertAllRows(SwapByteOrderRows, args);
+
+  // The elements left over after the whole rows.
+  const qint64 numberOfElementsDone = numberOfRows * NIFTYLINK_BYTE_SWAP_ELEMENTS_PER_ROW;
+  const int numberOfElementsLeft = static_cast<int>(numberOfElements - numberOfElementsDone);
+  if (numberOfElementsLeft > 0)
+  {
+    args.m_Source = source + numberOfElementsDone * bytesPerElement;
+    args.m_Destination = destination + numberOfElementsDone * bytesPerElement;
+    args.m_Width = numberOfElementsLeft;
+    args.m_SourceBytesPerLine = numberOfElementsLeft * bytesPerElement;
+    args.m_DestinationBytesPerLine = args.m_SourceBytesPerLine;
+    args.m_Height = 1;
+    SwapByteOrderRows(args, 0, 1);
+  }
+}
+
+} // end namespace niftk
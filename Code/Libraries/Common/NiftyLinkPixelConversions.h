@@ -0,0 +1,81 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkPixelConversions_h
+#define NiftyLinkPixelConversions_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <QtGlobal>
+
+/**
+* \file NiftyLinkPixelConversions.h
+* \brief Conversions between the pixel formats commonly streamed, (eg. from frame grabbers and ultrasound machines),
+* and the formats used by QImage and igtl::ImageMessage.
+*
+* Each function converts width x height pixels, from source to destination, which must not overlap.
+* Each row starts bytesPerLine after the previous one, so both tightly packed (igtl::ImageMessage) and
+* padded (QImage) buffers can be used directly, without an intermediate copy.
+*
+* The inner loops are simple, branch free, integer loops over one row, written so that the compiler
+* can vectorise them. Frames of at least 256x256 pixels are split into bands of rows,
+* and converted on a private QThreadPool, with the calling thread converting the first band, and then waiting
+* until all are done. The pool is private so that a caller that is itself running on QThreadPool::globalInstance()
+* can't deadlock waiting for bands queued behind it.
+*
+* ARGB32 means QImage::Format_ARGB32, ie. each pixel is a native endian quint32 0xAARRGGBB,
+* which is what SetQImage() puts into a TYPE_UINT32 igtl::ImageMessage.
+*
+* SwapByteOrder() works on whole buffers, rather than rows, and uses SSE2 where available.
+*/
+namespace niftk
+{
+
+/// \brief Converts packed 24 bit R, G, B (QImage::Format_RGB888) to opaque ARGB32.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertRGB888ToARGB32(const uchar *source, const int& sourceBytesPerLine,
+                                                                  uchar *destination, const int& destinationBytesPerLine,
+                                                                  const int& width, const int& height);
+
+/// \brief Swaps the first and third byte of each 4 byte pixel, ie. converts B, G, R, A to R, G, B, A, and vice-versa.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertBGRAToRGBA(const uchar *source, const int& sourceBytesPerLine,
+                                                              uchar *destination, const int& destinationBytesPerLine,
+                                                              const int& width, const int& height);
+
+/// \brief Converts YUV 4:2:2, packed as Y0, U, Y1, V, (also known as YUY2 or YUYV), to opaque ARGB32,
+/// using ITU-R BT.601 video range coefficients. Width must be even.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertYUV422ToARGB32(const uchar *source, const int& sourceBytesPerLine,
+                                                                  uchar *destination, const int& destinationBytesPerLine,
+                                                                  const int& width, const int& height);
+
+/// \brief Converts NV12, ie. a full resolution Y plane followed by a half resolution plane of interleaved U, V,
+/// to opaque ARGB32, using ITU-R BT.601 video range coefficients. Width and height must be even.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertNV12ToARGB32(const uchar *yPlane, const int& yBytesPerLine,
+                                                                const uchar *uvPlane, const int& uvBytesPerLine,
+                                                                uchar *destination, const int& destinationBytesPerLine,
+                                                                const int& width, const int& height);
+
+/// \brief Converts native endian unsigned 16 bit grey to 8 bit grey, mapping [level - window/2, level + window/2] to [0, 255], and clamping.
+/// \param window must be at least 1.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertGrey16ToGrey8(const uchar *source, const int& sourceBytesPerLine,
+                                                                 uchar *destination, const int& destinationBytesPerLine,
+                                                                 const int& width, const int& height,
+                                                                 const int& window, const int& level);
+
+/// \brief Reverses the byte order of each of numberOfElements elements of bytesPerElement bytes, (1, 2, 4 or 8),
+/// eg. to convert big endian scalars to little endian, and vice-versa. Unlike the functions above,
+/// source and destination may be the same buffer, but must not otherwise overlap.
+/// \throws std::invalid_argument if source or destination is NULL, or bytesPerElement is not 1, 2, 4 or 8.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void SwapByteOrder(const uchar *source, uchar *destination,
+                                                          const int& bytesPerElement, const qint64& numberOfElements);
+
+} // end namespace niftk
+
+#endif // NiftyLinkPixelConversions_h
@@ -0,0 +1,270 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkRunningStats.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace niftk
+{
+
+// Number of values summarised before folding into the running totals.
+// Small enough that the shifted sums stay accurate, large enough to amortise the fold.
+static const int NIFTYLINK_STATS_BLOCK_SIZE = 1024;
+
+// Number of independent accumulators within a block.
+static const int NIFTYLINK_STATS_LANES = 4;
+
+//-----------------------------------------------------------------------------
+NiftyLinkRunningStats::NiftyLinkRunningStats()
+{
+  this->Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRunningStats::~NiftyLinkRunningStats()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkRunningStats::operator==(const NiftyLinkRunningStats& another) const
+{
+  return m_Count == another.m_Count
+      && m_Mean == another.m_Mean
+      && m_SumOfSquaredDifferences == another.m_SumOfSquaredDifferences
+      && m_Min == another.m_Min
+      && m_Max == another.m_Max;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRunningStats::Reset()
+{
+  m_Count = 0;
+  m_Mean = 0;
+  m_SumOfSquaredDifferences = 0;
+  m_Min = 0;
+  m_Max = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRunningStats::Add(const quint64& value)
+{
+  if (m_Count == 0)
+  {
+    m_Min = value;
+    m_Max = value;
+  }
+  else
+  {
+    if (value < m_Min)
+    {
+      m_Min = value;
+    }
+    if (value > m_Max)
+    {
+      m_Max = value;
+    }
+  }
+
+  m_Count += 1;
+
+  double delta = static_cast<double>(value) - m_Mean;
+  m_Mean += delta / static_cast<double>(m_Count);
+  m_SumOfSquaredDifferences += delta * (static_cast<double>(value) - m_Mean);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRunningStats::Add(const quint64* values, const int& numberOfValues)
+{
+  if (numberOfValues <= 0)
+  {
+    return;
+  }
+  assert(values);
+
+  for (int blockStart = 0; blockStart < numberOfValues; blockStart += NIFTYLINK_STATS_BLOCK_SIZE)
+  {
+    const quint64 *block = values + blockStart;
+    int blockSize = numberOfValues - blockStart;
+    if (blockSize > NIFTYLINK_STATS_BLOCK_SIZE)
+    {
+      blockSize = NIFTYLINK_STATS_BLOCK_SIZE;
+    }
+
+    // Sums are taken relative to the first value in the block. Latencies are
+    // large numbers with a small spread, so this avoids cancellation in sum(x^2) - sum(x)^2/n.
+    const double shift = static_cast<double>(block[0]);
+
+    double  sum[NIFTYLINK_STATS_LANES];
+    double  sumOfSquares[NIFTYLINK_STATS_LANES];
+    quint64 min[NIFTYLINK_STATS_LANES];
+    quint64 max[NIFTYLINK_STATS_LANES];
+
+    for (int lane = 0; lane < NIFTYLINK_STATS_LANES; lane++)
+    {
+      sum[lane] = 0;
+      sumOfSquares[lane] = 0;
+      min[lane] = block[0];
+      max[lane] = block[0];
+    }
+
+    const int vectorisedSize = blockSize - (blockSize % NIFTYLINK_STATS_LANES);
+    for (int i = 0; i < vectorisedSize; i += NIFTYLINK_STATS_LANES)
+    {
+      for (int lane = 0; lane < NIFTYLINK_STATS_LANES; lane++)
+      {
+        const quint64 value = block[i + lane];
+        const double difference = static_cast<double>(value) - shift;
+        sum[lane] += difference;
+        sumOfSquares[lane] += difference * difference;
+        min[lane] = value < min[lane] ? value : min[lane];
+        max[lane] = value > max[lane] ? value : max[lane];
+      }
+    }
+    for (int i = vectorisedSize; i < blockSize; i++)
+    {
+      const quint64 value = block[i];
+      const double difference = static_cast<double>(value) - shift;
+      sum[0] += difference;
+      sumOfSquares[0] += difference * difference;
+      min[0] = value < min[0] ? value : min[0];
+      max[0] = value > max[0] ? value : max[0];
+    }
+
+    double  blockSum = 0;
+    double  blockSumOfSquares = 0;
+    quint64 blockMin = min[0];
+    quint64 blockMax = max[0];
+
+    for (int lane = 0; lane < NIFTYLINK_STATS_LANES; lane++)
+    {
+      blockSum += sum[lane];
+      blockSumOfSquares += sumOfSquares[lane];
+      blockMin = min[lane] < blockMin ? min[lane] : blockMin;
+      blockMax = max[lane] > blockMax ? max[lane] : blockMax;
+    }
+
+    const double n = static_cast<double>(blockSize);
+    double blockSumOfSquaredDifferences = blockSumOfSquares - (blockSum * blockSum) / n;
+    if (blockSumOfSquaredDifferences < 0)
+    {
+      blockSumOfSquaredDifferences = 0;
+    }
+
+    this->MergeBlock(static_cast<quint64>(blockSize), shift + blockSum / n, blockSumOfSquaredDifferences, blockMin, blockMax);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRunningStats::Merge(const NiftyLinkRunningStats& another)
+{
+  if (this == &another)
+  {
+    NiftyLinkRunningStats copy(another);
+    this->Merge(copy);
+    return;
+  }
+  this->MergeBlock(another.m_Count, another.m_Mean, another.m_SumOfSquaredDifferences, another.m_Min, another.m_Max);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRunningStats::MergeBlock(const quint64& count, const double& mean, const double& sumOfSquaredDifferences,
+                                       const quint64& min, const quint64& max)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  if (m_Count == 0)
+  {
+    m_Count = count;
+    m_Mean = mean;
+    m_SumOfSquaredDifferences = sumOfSquaredDifferences;
+    m_Min = min;
+    m_Max = max;
+    return;
+  }
+
+  const double countA = static_cast<double>(m_Count);
+  const double countB = static_cast<double>(count);
+  const double total = countA + countB;
+  const double delta = mean - m_Mean;
+
+  m_Mean += delta * countB / total;
+  m_SumOfSquaredDifferences += sumOfSquaredDifferences + delta * delta * countA * countB / total;
+  m_Count += count;
+
+  if (min < m_Min)
+  {
+    m_Min = min;
+  }
+  if (max > m_Max)
+  {
+    m_Max = max;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkRunningStats::GetCount() const
+{
+  return m_Count;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkRunningStats::GetMean() const
+{
+  return m_Mean;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkRunningStats::GetVariance() const
+{
+  if (m_Count < 2)
+  {
+    return 0;
+  }
+  return m_SumOfSquaredDifferences / static_cast<double>(m_Count - 1);
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkRunningStats::GetStdDev() const
+{
+  return sqrt(this->GetVariance());
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkRunningStats::GetMin() const
+{
+  return m_Min;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkRunningStats::GetMax() const
+{
+  return m_Max;
+}
+
+} // end namespace niftk
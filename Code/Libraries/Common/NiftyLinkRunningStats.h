@@ -0,0 +1,97 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkRunningStats_h
+#define NiftyLinkRunningStats_h
+
+#include "NiftyLinkCommonWin32ExportHeader.h"
+
+#include <QtGlobal>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkRunningStats
+* \brief Accumulates count, mean, sample variance, min and max of a stream of unsigned 64 bit values
+* (typically latencies in nanoseconds), without storing the values.
+*
+* Adding a single value is O(1) and uses Welford's update, so the accumulator can be queried
+* at any time, and reset at a checkpoint, without iterating over history.
+*
+* Adding a contiguous array of values is done in a single pass, in fixed size blocks,
+* each processed by 4 independent lanes with no data-dependent branches, so that the compiler
+* can auto-vectorise the inner loop. Each block is then folded into the running totals
+* using the pairwise update of Chan et al. Two accumulators can be combined in the same way with Merge().
+*
+* This class relies on Value Type semantics, and the compiler generated copy constructor and assignment operator are sufficient.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkRunningStats {
+
+public:
+
+  /// \brief Constructor, see Reset().
+  NiftyLinkRunningStats();
+
+  /// \brief Destructor.
+  ~NiftyLinkRunningStats();
+
+  /// \brief Check for equality.
+  bool operator==(const NiftyLinkRunningStats& another) const;
+
+  /// \brief Sets everything back to zero.
+  void Reset();
+
+  /// \brief Adds a single value, O(1).
+  void Add(const quint64& value);
+
+  /// \brief Adds numberOfValues values from a contiguous array in a single pass.
+  /// \param values must be non-NULL if numberOfValues > 0, only checked with assert().
+  void Add(const quint64* values, const int& numberOfValues);
+
+  /// \brief Combines the statistics of another accumulator into this one.
+  void Merge(const NiftyLinkRunningStats& another);
+
+  /// \brief Returns the number of values added since the last Reset().
+  quint64 GetCount() const;
+
+  /// \brief Returns the mean, or zero if no values have been added.
+  double GetMean() const;
+
+  /// \brief Returns the sample corrected variance, or zero if less than 2 values have been added.
+  double GetVariance() const;
+
+  /// \brief Returns the sample corrected standard deviation, or zero if less than 2 values have been added.
+  double GetStdDev() const;
+
+  /// \brief Returns the minimum, or zero if no values have been added.
+  quint64 GetMin() const;
+
+  /// \brief Returns the maximum, or zero if no values have been added.
+  quint64 GetMax() const;
+
+private:
+
+  /// \brief Folds in a block summarised by count, mean, sum of squared differences from the mean, min and max.
+  void MergeBlock(const quint64& count, const double& mean, const double& sumOfSquaredDifferences,
+                  const quint64& min, const quint64& max);
+
+  quint64 m_Count;
+  double  m_Mean;
+  double  m_SumOfSquaredDifferences;
+  quint64 m_Min;
+  quint64 m_Max;
+
+}; // end class
+
+} // end namespace
+
+#endif // NiftyLinkRunningStats_h
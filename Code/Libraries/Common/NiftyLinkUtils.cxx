@@ -224,51 +224,49 @@ igtlUint64 GetDifferenceInNanoSeconds(igtl::TimeStamp* timeA, igtl::TimeStamp* t
 
 
 //-----------------------------------------------------------------------------
-double CalculateMean(const QList<igtlUint64>& list)
+NiftyLinkRunningStats CalculateStats(const QList<igtlUint64>& list)
 {
-  double mean = 0;
-  foreach(igtlUint64 item, list)
-  {
-    mean += static_cast<double>(item);
-  }
-  if (list.size() > 1)
+  // QList does not guarantee contiguous storage of its values,
+  // so copy into a small buffer, and pass that to the block-wise kernel.
+  const int bufferSize = 256;
+  quint64 buffer[bufferSize];
+
+  NiftyLinkRunningStats stats;
+  int numberInBuffer = 0;
+
+  QList<igtlUint64>::const_iterator iter;
+  for (iter = list.constBegin(); iter != list.constEnd(); ++iter)
   {
-    mean /= static_cast<double>(list.size());
+    buffer[numberInBuffer++] = *iter;
+    if (numberInBuffer == bufferSize)
+    {
+      stats.Add(buffer, numberInBuffer);
+      numberInBuffer = 0;
+    }
   }
-  return mean;
+  stats.Add(buffer, numberInBuffer);
+  return stats;
+}
+
+
+//-----------------------------------------------------------------------------
+double CalculateMean(const QList<igtlUint64>& list)
+{
+  return CalculateStats(list).GetMean();
 }
 
 
 //-----------------------------------------------------------------------------
 double CalculateStdDev(const QList<igtlUint64>& list)
 {
-  double stdDev = 0;
-  double mean = CalculateMean(list);
-  foreach(igtlUint64 item, list)
-  {
-    stdDev += ((static_cast<double>(item)-mean)*(static_cast<double>(item)-mean));
-  }
-  if (list.size() > 1)
-  {
-    stdDev /= static_cast<double>(list.size() - 1);
-  }
-  stdDev = sqrt(stdDev);
-  return stdDev;
+  return CalculateStats(list).GetStdDev();
 }
 
 
 //-----------------------------------------------------------------------------
 igtlUint64 CalculateMax(const QList<igtlUint64>& list)
 {
-  igtlUint64 max = 0;
-  foreach(igtlUint64 item, list)
-  {
-    if (item > max)
-    {
-      max = item;
-    }
-  }
-  return max;
+  return CalculateStats(list).GetMax();
 }
 
 
@@ -494,6 +492,134 @@ bool IsStatsRequest(const igtl::MessageBase::Pointer& message)
 }
 
 
+//-----------------------------------------------------------------------------
+bool IsCompressionRequest(const igtl::MessageBase::Pointer& message, bool& isOn)
+{
+  bool isCompression = false;
+  igtl::StringMessage::Pointer msg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+  if (msg.IsNotNull())
+  {
+    if (msg->GetString() == std::string("COMPRESS:zlib"))
+    {
+      isCompression = true;
+      isOn = true;
+    }
+    else if (msg->GetString() == std::string("COMPRESS:none"))
+    {
+      isCompression = true;
+      isOn = false;
+    }
+  }
+  return isCompression;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsDownsamplingRequest(const igtl::MessageBase::Pointer& message, int& factor)
+{
+  bool isDownsampling = false;
+  igtl::StringMessage::Pointer msg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+  if (msg.IsNotNull())
+  {
+    QString string = QString::fromStdString(msg->GetString());
+    if (string.startsWith("DOWNSAMPLE:"))
+    {
+      bool isInteger = false;
+      int value = string.mid(11).toInt(&isInteger);
+      if (isInteger && value >= 1)
+      {
+        isDownsampling = true;
+        factor = value;
+      }
+    }
+  }
+  return isDownsampling;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsRegionOfInterestRequest(const igtl::MessageBase::Pointer& message, QRect& regionOfInterest)
+{
+  bool isRegionOfInterest = false;
+  igtl::StringMessage::Pointer msg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+  if (msg.IsNotNull())
+  {
+    QString string = QString::fromStdString(msg->GetString());
+    if (string == "ROI:none")
+    {
+      isRegionOfInterest = true;
+      regionOfInterest = QRect();
+    }
+    else if (string.startsWith("ROI:"))
+    {
+      QStringList values = string.mid(4).split(",");
+      if (values.size() == 4)
+      {
+        bool isInteger[4];
+        int value[4];
+        for (int i = 0; i < 4; i++)
+        {
+          value[i] = values[i].toInt(&isInteger[i]);
+        }
+        if (isInteger[0] && isInteger[1] && isInteger[2] && isInteger[3] && value[2] > 0 && value[3] > 0)
+        {
+          isRegionOfInterest = true;
+          regionOfInterest = QRect(value[0], value[1], value[2], value[3]);
+        }
+      }
+    }
+  }
+  return isRegionOfInterest;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsSharedMemoryRequest(const igtl::MessageBase::Pointer& message, bool& isOn)
+{
+  bool isSharedMemory = false;
+  igtl::StringMessage::Pointer msg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+  if (msg.IsNotNull())
+  {
+    if (msg->GetString() == std::string("SHM:on"))
+    {
+      isSharedMemory = true;
+      isOn = true;
+    }
+    else if (msg->GetString() == std::string("SHM:none"))
+    {
+      isSharedMemory = true;
+      isOn = false;
+    }
+  }
+  return isSharedMemory;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsSharedMemoryImage(const igtl::MessageBase::Pointer& message, QString& key, int& slot)
+{
+  bool isSharedMemoryImage = false;
+  igtl::StringMessage::Pointer msg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+  if (msg.IsNotNull())
+  {
+    QString string = QString::fromStdString(msg->GetString());
+    if (string.startsWith("SHMIMAGE:"))
+    {
+      int comma = string.lastIndexOf(",");
+      bool isInteger = false;
+      int value = string.mid(comma + 1).toInt(&isInteger);
+      if (comma > 9 && isInteger && value >= 0)
+      {
+        isSharedMemoryImage = true;
+        key = string.mid(9, comma - 9);
+        slot = value;
+      }
+    }
+  }
+  return isSharedMemoryImage;
+}
+
+
 //-----------------------------------------------------------------------------
 bool IsCloseEnoughTo(const igtl::Matrix4x4& a, const igtl::Matrix4x4& b, double tolerance)
 {
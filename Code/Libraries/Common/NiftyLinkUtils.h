@@ -14,11 +14,13 @@
 
 #include "NiftyLinkCommonWin32ExportHeader.h"
 #include <NiftyLinkMessageContainer.h>
+#include <NiftyLinkRunningStats.h>
 
 #include <igtlMath.h>
 #include <igtlTimeStamp.h>
 
 #include <QString>
+#include <QRect>
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 #include <windows.h>
@@ -101,6 +103,13 @@ extern "C++" NIFTYLINKCOMMON_WINEXPORT void CreateRandomTransformMatrix(igtl::Ma
 */
 ///@{
 
+/**
+* \brief Computes count, mean, sample corrected variance, min and max of a list of igtlUint64 in a single pass.
+*
+* Prefer this to calling CalculateMean(), CalculateStdDev() and CalculateMax() in turn, as each of those is a separate pass.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT NiftyLinkRunningStats CalculateStats(const QList<igtlUint64>& list);
+
 /**
 * \brief Computes the mean of a list of igtlUint64, used when calculating latency stats.
 */
@@ -202,6 +211,42 @@ extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsKeepAlive(const igtl::MessageBase:
 */
 extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsStatsRequest(const igtl::MessageBase::Pointer&);
 
+/**
+* \brief Returns true if the message is an igtl::StringMessage containing just the text "COMPRESS:zlib" or "COMPRESS:none",
+* which a peer sends to ask to receive IMAGE messages compressed, or not, (see NiftyLinkImageCompression.h).
+* \param isOn output, true for "COMPRESS:zlib", and false for "COMPRESS:none", only set if this returns true.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsCompressionRequest(const igtl::MessageBase::Pointer&, bool& isOn);
+
+/**
+* \brief Returns true if the message is an igtl::StringMessage containing "DOWNSAMPLE:n", where n is an integer of at least 1,
+* which a peer sends to ask for IMAGE messages downsampled by a factor n, (see NiftyLinkImageDecimator).
+* \param factor output, n, only set if this returns true.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsDownsamplingRequest(const igtl::MessageBase::Pointer&, int& factor);
+
+/**
+* \brief Returns true if the message is an igtl::StringMessage containing "ROI:x,y,width,height" or "ROI:none",
+* which a peer sends to ask for only that region of IMAGE messages, in pixels, (see NiftyLinkImageDecimator).
+* \param regionOfInterest output, or a null QRect for "ROI:none", only set if this returns true.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsRegionOfInterestRequest(const igtl::MessageBase::Pointer&, QRect& regionOfInterest);
+
+/**
+* \brief Returns true if the message is an igtl::StringMessage containing just the text "SHM:on" or "SHM:none",
+* which a peer on the same host sends to ask to receive IMAGE messages through shared memory, or not, (see NiftyLinkSharedMemoryRing).
+* \param isOn output, true for "SHM:on", and false for "SHM:none", only set if this returns true.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsSharedMemoryRequest(const igtl::MessageBase::Pointer&, bool& isOn);
+
+/**
+* \brief Returns true if the message is an igtl::StringMessage containing "SHMIMAGE:key,slot", which says
+* the next IMAGE message is in that slot of the NiftyLinkSharedMemoryRing called key.
+* \param key output, only set if this returns true.
+* \param slot output, only set if this returns true.
+*/
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsSharedMemoryImage(const igtl::MessageBase::Pointer&, QString& key, int& slot);
+
 } // end namespace niftk
 
 #endif // NiftyLinkUtils_h
@@ -0,0 +1,339 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkImageCompression.h"
+#include <NiftyLinkMacro.h>
+
+#include <igtlMessageHeader.h>
+#include <igtl_header.h>
+#include <igtl_util.h>
+
+#include <QByteArray>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace niftk
+{
+
+// The OpenIGTLink message type name of a compressed image.
+static const char* const NIFTYLINK_COMPRESSED_IMAGE_TYPE = "ZIMAGE";
+
+// The only codec so far, zlib, via qCompress() and qUncompress().
+static const quint16 NIFTYLINK_COMPRESSION_CODEC_ZLIB = 1;
+
+// Size of the fixed part of the body, before the list of compressed block sizes.
+static const int NIFTYLINK_COMPRESSION_HEADER_SIZE = 20;
+
+// Images are split into blocks of this many bytes, which are compressed in parallel.
+static const int NIFTYLINK_COMPRESSION_BLOCK_SIZE = 1024 * 1024;
+
+// Blocks run on this pool, rather than QThreadPool::globalInstance(). Its threads only ever do a block, and never
+// wait, so a block always gets a thread, even if RunAllBlocks() is called from a task on a saturated global pool,
+// (eg. a decode task of NiftyLinkTcpNetworkWorker).
+Q_GLOBAL_STATIC(QThreadPool, s_ImageCompressionPool)
+
+/**
+* \brief Everything a block compression or decompression function needs, so that both have the same signature.
+*/
+struct NiftyLinkImageCompressionArguments
+{
+  const uchar         *m_Source;
+  QVector<int>         m_SourceOffsets;
+  QVector<int>         m_SourceSizes;
+  uchar               *m_Destination;
+  int                  m_DestinationSize;
+  int                  m_BlockSize;
+  int                  m_CompressionLevel;
+  QVector<QByteArray>  m_CompressedBlocks;
+  QVector<bool>        m_Failed;
+};
+
+typedef void (*NiftyLinkCodecBlockFunction)(NiftyLinkImageCompressionArguments& args, const int& blockNumber);
+
+/**
+* \class NiftyLinkImageCompressionTask
+* \brief Private task to compress or decompress one block on a QThreadPool.
+*/
+class NiftyLinkImageCompressionTask : public QRunnable
+{
+public:
+  NiftyLinkImageCompressionTask(NiftyLinkCodecBlockFunction function,
+                                NiftyLinkImageCompressionArguments *args,
+                                const int& blockNumber,
+                                QSemaphore *done)
+  : m_Function(function)
+  , m_Arguments(args)
+  , m_BlockNumber(blockNumber)
+  , m_Done(done)
+  {
+    this->setAutoDelete(true);
+  }
+
+  virtual void run()
+  {
+    m_Function(*m_Arguments, m_BlockNumber);
+    m_Done->release();
+  }
+
+private:
+  NiftyLinkCodecBlockFunction         m_Function;
+  NiftyLinkImageCompressionArguments *m_Arguments;
+  int                                 m_BlockNumber;
+  QSemaphore                         *m_Done;
+};
+
+
+//-----------------------------------------------------------------------------
+static void RunAllBlocks(NiftyLinkCodecBlockFunction function, NiftyLinkImageCompressionArguments& args, const int& numberOfBlocks)
+{
+  QSemaphore done;
+  for (int i = 1; i < numberOfBlocks; i++)
+  {
+    s_ImageCompressionPool()->start(new NiftyLinkImageCompressionTask(function, &args, i, &done));
+  }
+
+  // The calling thread does the first block, rather than sitting idle.
+  function(args, 0);
+
+  done.acquire(numberOfBlocks - 1);
+}
+
+
+//-----------------------------------------------------------------------------
+static void CompressBlock(NiftyLinkImageCompressionArguments& args, const int& blockNumber)
+{
+  args.m_CompressedBlocks[blockNumber] = qCompress(args.m_Source + args.m_SourceOffsets[blockNumber],
+                                                   args.m_SourceSizes[blockNumber],
+                                                   args.m_CompressionLevel);
+}
+
+
+//-----------------------------------------------------------------------------
+static void DecompressBlock(NiftyLinkImageCompressionArguments& args, const int& blockNumber)
+{
+  QByteArray block = qUncompress(args.m_Source + args.m_SourceOffsets[blockNumber], args.m_SourceSizes[blockNumber]);
+
+  const int expectedSize = qMin(args.m_BlockSize, args.m_DestinationSize - blockNumber * args.m_BlockSize);
+
+  if (block.size() != expectedSize)
+  {
+    args.m_Failed[blockNumber] = true;
+    return;
+  }
+  memcpy(args.m_Destination + blockNumber * args.m_BlockSize, block.constData(), expectedSize);
+}
+
+
+//-----------------------------------------------------------------------------
+static igtl::MessageHeader::Pointer CreateHeader(const igtl_header& hostOrderHeader)
+{
+  igtl_header networkOrderHeader = hostOrderHeader;
+  igtl_header_convert_byte_order(&networkOrderHeader);
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), &networkOrderHeader, IGTL_HEADER_SIZE);
+  header->Unpack();
+
+  return header;
+}
+
+
+//-----------------------------------------------------------------------------
+static void WriteHeader(const igtl_header& hostOrderHeader, igtl::MessageBase::Pointer& message)
+{
+  igtl_header networkOrderHeader = hostOrderHeader;
+  igtl_header_convert_byte_order(&networkOrderHeader);
+  memcpy(message->GetPackPointer(), &networkOrderHeader, IGTL_HEADER_SIZE);
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsUncompressedImage(const igtl::MessageBase::Pointer& message)
+{
+  return dynamic_cast<igtl::ImageMessage*>(message.GetPointer()) != NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+bool IsCompressedImage(const igtl::MessageBase::Pointer& message)
+{
+  return message.IsNotNull()
+      && !IsUncompressedImage(message)
+      && strncmp(message->GetDeviceType(), NIFTYLINK_COMPRESSED_IMAGE_TYPE, IGTL_HEADER_TYPE_SIZE) == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::MessageBase::Pointer CompressImageMessage(const igtl::MessageBase::Pointer& image, const int& compressionLevel)
+{
+  if (!IsUncompressedImage(image) || image->GetPackPointer() == NULL || image->GetPackSize() <= IGTL_HEADER_SIZE)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Message is NULL, not an IMAGE message, or not Packed.");
+  }
+
+  const int bodySize = image->GetPackBodySize();
+  const int numberOfBlocks = (bodySize + NIFTYLINK_COMPRESSION_BLOCK_SIZE - 1) / NIFTYLINK_COMPRESSION_BLOCK_SIZE;
+
+  NiftyLinkImageCompressionArguments args;
+  args.m_Source = static_cast<const uchar*>(image->GetPackBodyPointer());
+  args.m_Destination = NULL;
+  args.m_DestinationSize = 0;
+  args.m_BlockSize = NIFTYLINK_COMPRESSION_BLOCK_SIZE;
+  args.m_CompressionLevel = compressionLevel;
+  args.m_CompressedBlocks.resize(numberOfBlocks);
+  for (int i = 0; i < numberOfBlocks; i++)
+  {
+    args.m_SourceOffsets.append(i * NIFTYLINK_COMPRESSION_BLOCK_SIZE);
+    args.m_SourceSizes.append(qMin(NIFTYLINK_COMPRESSION_BLOCK_SIZE, bodySize - i * NIFTYLINK_COMPRESSION_BLOCK_SIZE));
+  }
+
+  RunAllBlocks(CompressBlock, args, numberOfBlocks);
+
+  int compressedBodySize = NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * numberOfBlocks;
+  for (int i = 0; i < numberOfBlocks; i++)
+  {
+    compressedBodySize += args.m_CompressedBlocks[i].size();
+  }
+
+  // Same version, device name and time stamp as the image.
+  igtl_header header;
+  memcpy(&header, image->GetPackPointer(), IGTL_HEADER_SIZE);
+  igtl_header_convert_byte_order(&header);
+
+  const quint64 imageCRC = header.crc;
+
+  memset(header.name, 0, IGTL_HEADER_TYPE_SIZE);
+  strncpy(header.name, NIFTYLINK_COMPRESSED_IMAGE_TYPE, IGTL_HEADER_TYPE_SIZE);
+  header.body_size = compressedBodySize;
+  header.crc = 0;
+
+  igtl::MessageBase::Pointer compressed = igtl::MessageBase::New();
+  compressed->SetMessageHeader(CreateHeader(header));
+  compressed->AllocatePack();
+
+  uchar *body = static_cast<uchar*>(compressed->GetPackBodyPointer());
+  qToBigEndian<quint16>(NIFTYLINK_COMPRESSION_CODEC_ZLIB, body);
+  qToBigEndian<quint16>(static_cast<quint16>(numberOfBlocks), body + 2);
+  qToBigEndian<quint32>(static_cast<quint32>(bodySize), body + 4);
+  qToBigEndian<quint32>(static_cast<quint32>(NIFTYLINK_COMPRESSION_BLOCK_SIZE), body + 8);
+  qToBigEndian<quint64>(imageCRC, body + 12);
+
+  uchar *blockData = body + NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * numberOfBlocks;
+  for (int i = 0; i < numberOfBlocks; i++)
+  {
+    const QByteArray& block = args.m_CompressedBlocks[i];
+    qToBigEndian<quint32>(static_cast<quint32>(block.size()), body + NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * i);
+    memcpy(blockData, block.constData(), block.size());
+    blockData += block.size();
+  }
+
+  header.crc = igtl_crc64(body, compressedBodySize, 0);
+  WriteHeader(header, compressed);
+
+  return compressed;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::ImageMessage::Pointer DecompressImageMessage(const igtl::MessageBase::Pointer& compressed)
+{
+  if (!IsCompressedImage(compressed) || compressed->GetPackPointer() == NULL
+      || compressed->GetPackBodySize() < NIFTYLINK_COMPRESSION_HEADER_SIZE)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Message is NULL, not a ZIMAGE message, or too small.");
+  }
+
+  const uchar *body = static_cast<const uchar*>(compressed->GetPackBodyPointer());
+  const quint64 compressedBodySize = compressed->GetPackBodySize();
+
+  const quint16 codec = qFromBigEndian<quint16>(body);
+  const int numberOfBlocks = qFromBigEndian<quint16>(body + 2);
+  const quint32 bodySize = qFromBigEndian<quint32>(body + 4);
+  const quint32 blockSize = qFromBigEndian<quint32>(body + 8);
+  const quint64 imageCRC = qFromBigEndian<quint64>(body + 12);
+
+  if (codec != NIFTYLINK_COMPRESSION_CODEC_ZLIB)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Unknown compression codec " << codec << ".");
+  }
+
+  if (bodySize == 0
+      || bodySize > 0x7fffffff
+      || blockSize == 0
+      || blockSize > static_cast<quint32>(NIFTYLINK_COMPRESSION_BLOCK_SIZE) * 64
+      || numberOfBlocks != static_cast<int>((static_cast<quint64>(bodySize) + blockSize - 1) / blockSize)
+      || compressedBodySize < static_cast<quint64>(NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * numberOfBlocks))
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Corrupt ZIMAGE header, " << numberOfBlocks << " blocks of "
+                               << blockSize << " bytes, for " << bodySize << " bytes.");
+  }
+
+  NiftyLinkImageCompressionArguments args;
+  args.m_Source = body;
+  args.m_DestinationSize = static_cast<int>(bodySize);
+  args.m_BlockSize = static_cast<int>(blockSize);
+  args.m_CompressionLevel = 0;
+  args.m_Failed.fill(false, numberOfBlocks);
+
+  quint64 offset = NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * numberOfBlocks;
+  for (int i = 0; i < numberOfBlocks; i++)
+  {
+    const quint32 size = qFromBigEndian<quint32>(body + NIFTYLINK_COMPRESSION_HEADER_SIZE + 4 * i);
+    args.m_SourceOffsets.append(static_cast<int>(offset));
+    args.m_SourceSizes.append(static_cast<int>(size));
+    offset += size;
+  }
+
+  if (offset != compressedBodySize)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Corrupt ZIMAGE, blocks total " << offset
+                               << " bytes, but body is " << compressedBodySize << " bytes.");
+  }
+
+  // Same version, device name and time stamp as the ZIMAGE, and the CRC of the original image.
+  igtl_header header;
+  memcpy(&header, compressed->GetPackPointer(), IGTL_HEADER_SIZE);
+  igtl_header_convert_byte_order(&header);
+
+  memset(header.name, 0, IGTL_HEADER_TYPE_SIZE);
+  strncpy(header.name, "IMAGE", IGTL_HEADER_TYPE_SIZE);
+  header.body_size = bodySize;
+  header.crc = imageCRC;
+
+  igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+  image->SetMessageHeader(CreateHeader(header));
+  image->AllocatePack();
+
+  igtl::MessageBase::Pointer imageBase = image.GetPointer();
+  WriteHeader(header, imageBase);
+
+  args.m_Destination = static_cast<uchar*>(image->GetPackBodyPointer());
+
+  RunAllBlocks(DecompressBlock, args, numberOfBlocks);
+
+  for (int i = 0; i < numberOfBlocks; i++)
+  {
+    if (args.m_Failed[i])
+    {
+      NiftyLinkStdExceptionMacro(std::invalid_argument, << "Corrupt ZIMAGE, failed to decompress block " << i << ".");
+    }
+  }
+
+  return image;
+}
+
+} // end namespace niftk
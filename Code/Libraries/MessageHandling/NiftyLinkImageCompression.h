@@ -0,0 +1,64 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkImageCompression_h
+#define NiftyLinkImageCompression_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <igtlMessageBase.h>
+#include <igtlImageMessage.h>
+
+/**
+* \file NiftyLinkImageCompression.h
+* \brief Lossless compression of whole IMAGE messages, into a NiftyLink specific "ZIMAGE" message, and back.
+*
+* A ZIMAGE message has a standard OpenIGTLink header, with the same version, device name and time stamp
+* as the IMAGE message it was made from. The body, in network byte order, is
+* <pre>
+*   quint16 codec, (1 = zlib, via qCompress())
+*   quint16 number of blocks, N
+*   quint32 size of the uncompressed IMAGE body
+*   quint32 uncompressed size of each block, (the last block may be smaller)
+*   quint64 CRC of the uncompressed IMAGE body, as in the original IMAGE header
+*   N x quint32 compressed size of each block
+*   N compressed blocks
+* </pre>
+* The blocks are compressed, and decompressed, independently on a private QThreadPool, (not the global
+* one, so callers may themselves be global pool tasks), with the calling thread doing the first block,
+* and waiting until all are done.
+*
+* Third party OpenIGTLink peers don't understand ZIMAGE, so it must only be sent to a peer that
+* asked for it, (see NiftyLinkTcpNetworkWorker::RequestCompression()). Uncompressed IMAGE remains the default.
+*/
+namespace niftk
+{
+
+/// \brief Returns true if message is an IMAGE message, which can be passed to CompressImageMessage().
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsUncompressedImage(const igtl::MessageBase::Pointer& message);
+
+/// \brief Returns true if message is a ZIMAGE message, which can be passed to DecompressImageMessage().
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool IsCompressedImage(const igtl::MessageBase::Pointer& message);
+
+/// \brief Compresses a Packed IMAGE message, which is not modified, into a new, Packed, ZIMAGE message.
+/// \param compressionLevel passed to qCompress(), 1 (fastest) to 9 (smallest), or -1 for the zlib default.
+/// \throws std::invalid_argument if image is NULL, not an IMAGE message, or not Packed.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT igtl::MessageBase::Pointer CompressImageMessage(const igtl::MessageBase::Pointer& image,
+                                                                                      const int& compressionLevel = 1);
+
+/// \brief Decompresses a ZIMAGE message, whose pack must contain the header and body as they came off the wire,
+/// into a new IMAGE message, whose pack is exactly what the original IMAGE message was on the wire, ie. not yet Unpacked.
+/// \throws std::invalid_argument if compressed is NULL, not a ZIMAGE message, or is corrupt.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT igtl::ImageMessage::Pointer DecompressImageMessage(const igtl::MessageBase::Pointer& compressed);
+
+} // end namespace niftk
+
+#endif // NiftyLinkImageCompression_h
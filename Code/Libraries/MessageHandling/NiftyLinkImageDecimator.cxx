@@ -0,0 +1,214 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkImageDecimator.h"
+#include <NiftyLinkMacro.h>
+
+namespace niftk
+{
+
+// The frame interval and downsampling factor of each level.
+static const int NIFTYLINK_DECIMATION_NUMBER_OF_LEVELS = 6;
+static const int NIFTYLINK_DECIMATION_FRAME_INTERVAL[NIFTYLINK_DECIMATION_NUMBER_OF_LEVELS] = {1, 2, 2, 4, 4, 8};
+static const int NIFTYLINK_DECIMATION_DOWNSAMPLE_FACTOR[NIFTYLINK_DECIMATION_NUMBER_OF_LEVELS] = {1, 1, 2, 2, 4, 4};
+
+// The level goes up at most once in this many images.
+static const int NIFTYLINK_DECIMATION_IMAGES_BEFORE_INCREASE = 10;
+
+// The level goes down after this many images in a row below the low thresholds.
+static const int NIFTYLINK_DECIMATION_IMAGES_BEFORE_DECREASE = 30;
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDecimator::NiftyLinkImageDecimator()
+: m_Adaptive(false)
+, m_LowQueuedBytes(1024 * 1024)
+, m_HighQueuedBytes(4 * 1024 * 1024)
+, m_LowRoundTripTime(20000000)
+, m_HighRoundTripTime(100000000)
+, m_RequestedDownsampleFactor(1)
+, m_Level(0)
+, m_ImagesSinceLevelChanged(0)
+, m_ImagesBelowLowThresholds(0)
+, m_NumberOfImagesOffered(0)
+, m_NumberOfImagesDropped(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDecimator::~NiftyLinkImageDecimator()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDecimator::SetAdaptive(const bool& isOn)
+{
+  m_Adaptive = isOn;
+  if (!m_Adaptive)
+  {
+    m_Level = 0;
+    m_ImagesSinceLevelChanged = 0;
+    m_ImagesBelowLowThresholds = 0;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkImageDecimator::GetAdaptive() const
+{
+  return m_Adaptive;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDecimator::SetQueueThresholds(const qint64& lowBytes, const qint64& highBytes)
+{
+  m_LowQueuedBytes = lowBytes;
+  m_HighQueuedBytes = highBytes;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDecimator::SetRoundTripTimeThresholds(const quint64& lowNanoseconds, const quint64& highNanoseconds)
+{
+  m_LowRoundTripTime = lowNanoseconds;
+  m_HighRoundTripTime = highNanoseconds;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDecimator::SetDownsampleFactor(const int& factor)
+{
+  if (factor < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Downsampling factor must be at least 1.");
+  }
+  m_RequestedDownsampleFactor = factor;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDecimator::GetRequestedDownsampleFactor() const
+{
+  return m_RequestedDownsampleFactor;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDecimator::SetRegionOfInterest(const QRect& regionOfInterest)
+{
+  m_RegionOfInterest = regionOfInterest;
+}
+
+
+//-----------------------------------------------------------------------------
+QRect NiftyLinkImageDecimator::GetRegionOfInterest() const
+{
+  return m_RegionOfInterest;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkImageDecimator::IsDecimating() const
+{
+  return m_Adaptive || m_RequestedDownsampleFactor > 1 || !m_RegionOfInterest.isNull();
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkImageDecimator::Update(const qint64& queuedBytes, const quint64& roundTripTimeInNanoseconds)
+{
+  if (m_Adaptive)
+  {
+    const bool isRoundTripTimeKnown = roundTripTimeInNanoseconds > 0;
+
+    const bool isAboveHighThreshold = queuedBytes > m_HighQueuedBytes
+        || (isRoundTripTimeKnown && roundTripTimeInNanoseconds > m_HighRoundTripTime);
+
+    const bool isBelowLowThresholds = queuedBytes < m_LowQueuedBytes
+        && (!isRoundTripTimeKnown || roundTripTimeInNanoseconds < m_LowRoundTripTime);
+
+    m_ImagesSinceLevelChanged++;
+
+    if (isAboveHighThreshold)
+    {
+      m_ImagesBelowLowThresholds = 0;
+      if (m_Level < NIFTYLINK_DECIMATION_NUMBER_OF_LEVELS - 1
+          && m_ImagesSinceLevelChanged >= NIFTYLINK_DECIMATION_IMAGES_BEFORE_INCREASE)
+      {
+        m_Level++;
+        m_ImagesSinceLevelChanged = 0;
+      }
+    }
+    else if (isBelowLowThresholds)
+    {
+      m_ImagesBelowLowThresholds++;
+      if (m_Level > 0 && m_ImagesBelowLowThresholds >= NIFTYLINK_DECIMATION_IMAGES_BEFORE_DECREASE)
+      {
+        m_Level--;
+        m_ImagesSinceLevelChanged = 0;
+        m_ImagesBelowLowThresholds = 0;
+      }
+    }
+    else
+    {
+      m_ImagesBelowLowThresholds = 0;
+    }
+  }
+
+  const bool isSent = (m_NumberOfImagesOffered % this->GetFrameInterval()) == 0;
+
+  m_NumberOfImagesOffered++;
+  if (!isSent)
+  {
+    m_NumberOfImagesDropped++;
+  }
+
+  return isSent;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDecimator::GetLevel() const
+{
+  return m_Level;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDecimator::GetFrameInterval() const
+{
+  return NIFTYLINK_DECIMATION_FRAME_INTERVAL[m_Level];
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDecimator::GetDownsampleFactor() const
+{
+  return qMax(m_RequestedDownsampleFactor, NIFTYLINK_DECIMATION_DOWNSAMPLE_FACTOR[m_Level]);
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDecimator::GetNumberOfImagesOffered() const
+{
+  return m_NumberOfImagesOffered;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDecimator::GetNumberOfImagesDropped() const
+{
+  return m_NumberOfImagesDropped;
+}
+
+} // end namespace niftk
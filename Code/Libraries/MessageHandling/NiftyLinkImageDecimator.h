@@ -0,0 +1,124 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkImageDecimator_h
+#define NiftyLinkImageDecimator_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <QRect>
+#include <QtGlobal>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkImageDecimator
+* \brief Decides, for one client, which images to send, and how much to downsample them,
+* so that a slow client gets fewer, smaller, images, without slowing down other clients.
+*
+* The client can ask for a fixed downsampling factor, and a region of interest, see
+* SetDownsampleFactor() and SetRegionOfInterest(). In addition, if SetAdaptive() is on, each call to
+* Update() is given the number of bytes still queued to that client, and the round trip time,
+* and moves between the following levels:
+* <pre>
+*   level           0  1  2  3  4  5
+*   frame interval  1  2  2  4  4  8   (ie. send 1 image in every N)
+*   downsampling    1  1  2  2  4  4
+* </pre>
+* The level goes up one step if the queue or round trip time is above its high threshold, but at
+* most once every 10 images, so each change has time to take effect. The level goes down one step
+* after 30 images in a row with both below their low thresholds.
+*
+* This class is not thread safe, and does no image processing itself, see DecimateImage().
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkImageDecimator
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkImageDecimator();
+
+  /// \brief Destructor.
+  ~NiftyLinkImageDecimator();
+
+  /// \brief Turns adaptive decimation on or off, default off. Turning it off returns to level 0.
+  void SetAdaptive(const bool& isOn);
+
+  /// \brief Returns whether adaptive decimation is on.
+  bool GetAdaptive() const;
+
+  /// \brief Sets the queued bytes thresholds, default 1MB and 4MB.
+  void SetQueueThresholds(const qint64& lowBytes, const qint64& highBytes);
+
+  /// \brief Sets the round trip time thresholds, default 20ms and 100ms. A round trip time of zero means unknown, and is ignored.
+  void SetRoundTripTimeThresholds(const quint64& lowNanoseconds, const quint64& highNanoseconds);
+
+  /// \brief Sets the downsampling factor requested by the client, default 1.
+  /// \throws std::invalid_argument if factor is less than 1.
+  void SetDownsampleFactor(const int& factor);
+
+  /// \brief Returns the downsampling factor requested by the client.
+  int GetRequestedDownsampleFactor() const;
+
+  /// \brief Sets the region of interest, in pixels, requested by the client, or a null QRect for the whole image, (the default).
+  void SetRegionOfInterest(const QRect& regionOfInterest);
+
+  /// \brief Returns the region of interest.
+  QRect GetRegionOfInterest() const;
+
+  /// \brief Returns true if this decimator might drop or change an image,
+  /// ie. adaptive decimation is on, or the client asked for downsampling, or a region of interest.
+  bool IsDecimating() const;
+
+  /// \brief Called once for each image offered to the client, to update the level.
+  /// \param queuedBytes number of bytes not yet written to the client.
+  /// \param roundTripTimeInNanoseconds the current round trip time, or zero if unknown.
+  /// \return true if this image should be sent, downsampled by GetDownsampleFactor(), and false if it should be dropped.
+  bool Update(const qint64& queuedBytes, const quint64& roundTripTimeInNanoseconds);
+
+  /// \brief Returns the current adaptive level, 0 (no decimation) to 5.
+  int GetLevel() const;
+
+  /// \brief Returns the frame interval of the current level, ie. 1 image in every N is sent.
+  int GetFrameInterval() const;
+
+  /// \brief Returns the downsampling factor to use, which is the larger of the requested one and that of the current level.
+  int GetDownsampleFactor() const;
+
+  /// \brief Returns the number of images passed to Update().
+  quint64 GetNumberOfImagesOffered() const;
+
+  /// \brief Returns the number of images for which Update() returned false.
+  quint64 GetNumberOfImagesDropped() const;
+
+private:
+
+  bool     m_Adaptive;
+  qint64   m_LowQueuedBytes;
+  qint64   m_HighQueuedBytes;
+  quint64  m_LowRoundTripTime;
+  quint64  m_HighRoundTripTime;
+  int      m_RequestedDownsampleFactor;
+  QRect    m_RegionOfInterest;
+
+  int      m_Level;
+  int      m_ImagesSinceLevelChanged;
+  int      m_ImagesBelowLowThresholds;
+  quint64  m_NumberOfImagesOffered;
+  quint64  m_NumberOfImagesDropped;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkImageDecimator_h
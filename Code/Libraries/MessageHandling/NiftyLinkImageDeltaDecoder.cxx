@@ -0,0 +1,136 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkImageDeltaDecoder.h"
+#include <NiftyLinkImageMessageHelpers.h>
+#include <NiftyLinkMacro.h>
+
+#include <QsLog.h>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDeltaDecoder::NiftyLinkImageDeltaDecoder()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDeltaDecoder::~NiftyLinkImageDeltaDecoder()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDeltaDecoder::Reset()
+{
+  m_Frame = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::ImageMessage::Pointer NiftyLinkImageDeltaDecoder::Decode(const igtl::ImageMessage::Pointer& received)
+{
+  if (received.IsNull() || received->GetScalarPointer() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL, or has no scalars.");
+  }
+
+  int width = 0;
+  int height = 0;
+  int depth = 0;
+  received->GetDimensions(width, height, depth);
+
+  int subWidth = 0;
+  int subHeight = 0;
+  int subDepth = 0;
+  int subOffsetX = 0;
+  int subOffsetY = 0;
+  int subOffsetZ = 0;
+  received->GetSubVolume(subWidth, subHeight, subDepth, subOffsetX, subOffsetY, subOffsetZ);
+
+  const bool isKeyFrame = (subWidth == width && subHeight == height && subDepth == depth);
+  const int bytesPerPixel = received->GetScalarSize() * received->GetNumComponents();
+  const int bytesPerLine = width * bytesPerPixel;
+
+  if (isKeyFrame)
+  {
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int frameDepth = 0;
+    if (m_Frame.IsNotNull())
+    {
+      m_Frame->GetDimensions(frameWidth, frameHeight, frameDepth);
+    }
+
+    bool needsAllocating = m_Frame.IsNull()
+                           || frameWidth != width || frameHeight != height || frameDepth != depth
+                           || m_Frame->GetScalarType() != received->GetScalarType()
+                           || m_Frame->GetNumComponents() != received->GetNumComponents();
+
+    if (needsAllocating)
+    {
+      m_Frame = igtl::ImageMessage::New();
+    }
+    CopyImageMetaData(received, m_Frame);
+    if (needsAllocating)
+    {
+      m_Frame->AllocateScalars();
+    }
+
+    memcpy(m_Frame->GetScalarPointer(), received->GetScalarPointer(), bytesPerLine * height * depth);
+    return m_Frame;
+  }
+
+  if (m_Frame.IsNull())
+  {
+    QLOG_DEBUG() << QObject::tr("NiftyLinkImageDeltaDecoder::Decode() - %1: waiting for key frame.").arg(received->GetDeviceName());
+    return igtl::ImageMessage::Pointer();
+  }
+
+  int frameWidth = 0;
+  int frameHeight = 0;
+  int frameDepth = 0;
+  m_Frame->GetDimensions(frameWidth, frameHeight, frameDepth);
+
+  if (frameWidth != width || frameHeight != height || frameDepth != depth
+      || m_Frame->GetScalarType() != received->GetScalarType()
+      || m_Frame->GetNumComponents() != received->GetNumComponents()
+      || subOffsetX + subWidth > width || subOffsetY + subHeight > height || subOffsetZ + subDepth > depth)
+  {
+    QLOG_WARN() << QObject::tr("NiftyLinkImageDeltaDecoder::Decode() - %1: sub-volume does not match key frame, waiting for next key frame.").arg(received->GetDeviceName());
+    m_Frame = NULL;
+    return igtl::ImageMessage::Pointer();
+  }
+
+  // Same shape, so this only updates the timestamp, matrix etc, and keeps the scalars.
+  CopyImageMetaData(received, m_Frame);
+
+  const uchar *source = static_cast<const uchar*>(received->GetScalarPointer());
+  uchar *destination = static_cast<uchar*>(m_Frame->GetScalarPointer());
+  const int subBytesPerLine = subWidth * bytesPerPixel;
+
+  for (int slice = 0; slice < subDepth; slice++)
+  {
+    for (int row = 0; row < subHeight; row++)
+    {
+      const int destinationOffset = ((subOffsetZ + slice) * height + subOffsetY + row) * bytesPerLine + subOffsetX * bytesPerPixel;
+      memcpy(destination + destinationOffset, source + (slice * subHeight + row) * subBytesPerLine, subBytesPerLine);
+    }
+  }
+
+  return m_Frame;
+}
+
+} // end namespace niftk
@@ -0,0 +1,61 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkImageDeltaDecoder_h
+#define NiftyLinkImageDeltaDecoder_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <igtlImageMessage.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkImageDeltaDecoder
+* \brief Receiver side of NiftyLinkImageDeltaEncoder, that reassembles full frames from
+* IMAGE messages containing a sub-volume.
+*
+* Images that are not sub-volumes, ie. key frames, or any ordinary IMAGE message, are copied
+* whole, so the decoder can be used on any stream. Sub-volumes received before the first key frame,
+* or that don't match its size and type, can't be decoded, and are ignored.
+*
+* One decoder should be used per stream, (eg. per device name), and it is not thread safe.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkImageDeltaDecoder
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkImageDeltaDecoder();
+
+  /// \brief Destructor.
+  ~NiftyLinkImageDeltaDecoder();
+
+  /// \brief Applies a received, Unpacked, image message to the current frame.
+  /// \return the current full frame, which is owned by this decoder, and updated in place by the next call,
+  /// so copy it if you need to keep it, or NULL if there is no key frame yet.
+  /// \throws std::invalid_argument if received is NULL or has no scalars.
+  igtl::ImageMessage::Pointer Decode(const igtl::ImageMessage::Pointer& received);
+
+  /// \brief Forgets the current frame, so that the next frame decoded must be a key frame.
+  void Reset();
+
+private:
+
+  igtl::ImageMessage::Pointer m_Frame;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkImageDeltaDecoder_h
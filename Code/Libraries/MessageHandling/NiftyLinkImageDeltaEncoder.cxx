@@ -0,0 +1,290 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkImageDeltaEncoder.h"
+#include <NiftyLinkImageMessageHelpers.h>
+#include <NiftyLinkMacro.h>
+
+#include <QsLog.h>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDeltaEncoder::NiftyLinkImageDeltaEncoder()
+: m_TileSize(64)
+, m_KeyFrameInterval(30)
+, m_FramesSinceKeyFrame(0)
+, m_KeyFrameRequested(true)
+, m_Width(0)
+, m_Height(0)
+, m_Depth(0)
+, m_ScalarType(0)
+, m_NumberOfComponents(0)
+, m_NumberOfFrames(0)
+, m_NumberOfKeyFrames(0)
+, m_NumberOfFullFrameBytes(0)
+, m_NumberOfEncodedBytes(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkImageDeltaEncoder::~NiftyLinkImageDeltaEncoder()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDeltaEncoder::SetTileSize(const int& tileSize)
+{
+  if (tileSize < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Tile size must be positive.");
+  }
+  m_TileSize = tileSize;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDeltaEncoder::GetTileSize() const
+{
+  return m_TileSize;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDeltaEncoder::SetKeyFrameInterval(const int& numberOfFrames)
+{
+  if (numberOfFrames < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Key frame interval must be at least 1.");
+  }
+  m_KeyFrameInterval = numberOfFrames;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkImageDeltaEncoder::GetKeyFrameInterval() const
+{
+  return m_KeyFrameInterval;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDeltaEncoder::RequestKeyFrame()
+{
+  m_KeyFrameRequested = true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkImageDeltaEncoder::IsSameShapeAsPrevious(const int& width, const int& height, const int& depth,
+                                                       const int& scalarType, const int& numberOfComponents) const
+{
+  return width == m_Width
+      && height == m_Height
+      && depth == m_Depth
+      && scalarType == m_ScalarType
+      && numberOfComponents == m_NumberOfComponents;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::ImageMessage::Pointer NiftyLinkImageDeltaEncoder::Encode(const igtl::ImageMessage::Pointer& frame)
+{
+  if (frame.IsNull() || frame->GetScalarPointer() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL, or has no scalars.");
+  }
+
+  int width = 0;
+  int height = 0;
+  int depth = 0;
+  frame->GetDimensions(width, height, depth);
+
+  const int bytesPerPixel = frame->GetScalarSize() * frame->GetNumComponents();
+  const int bytesPerLine = width * bytesPerPixel;
+  const int frameSize = bytesPerLine * height * depth;
+  const uchar *scalars = static_cast<const uchar*>(frame->GetScalarPointer());
+
+  m_NumberOfFrames++;
+  m_NumberOfFullFrameBytes += frameSize;
+
+  // Work out the tile aligned bounding box of the changed tiles, (only for 2D).
+  bool isKeyFrame = m_KeyFrameRequested
+                    || m_FramesSinceKeyFrame + 1 >= m_KeyFrameInterval
+                    || depth != 1
+                    || m_DeviceName != QString(frame->GetDeviceName())
+                    || !this->IsSameShapeAsPrevious(width, height, depth, frame->GetScalarType(), frame->GetNumComponents());
+
+  int minTileX = 0;
+  int minTileY = 0;
+  int maxTileX = -1;
+  int maxTileY = -1;
+
+  if (!isKeyFrame)
+  {
+    const uchar *previous = reinterpret_cast<const uchar*>(m_PreviousFrame.constData());
+    const int numberOfTilesX = (width + m_TileSize - 1) / m_TileSize;
+    const int numberOfTilesY = (height + m_TileSize - 1) / m_TileSize;
+
+    minTileX = numberOfTilesX;
+    minTileY = numberOfTilesY;
+
+    for (int tileY = 0; tileY < numberOfTilesY; tileY++)
+    {
+      const int firstRow = tileY * m_TileSize;
+      const int lastRow = qMin(firstRow + m_TileSize, height);
+
+      for (int tileX = 0; tileX < numberOfTilesX; tileX++)
+      {
+        // Tiles already inside the bounding box needn't be compared.
+        if (tileX >= minTileX && tileX <= maxTileX && tileY >= minTileY && tileY <= maxTileY)
+        {
+          continue;
+        }
+
+        const int offset = tileX * m_TileSize * bytesPerPixel;
+        const int length = (qMin((tileX + 1) * m_TileSize, width) - tileX * m_TileSize) * bytesPerPixel;
+
+        for (int row = firstRow; row < lastRow; row++)
+        {
+          if (memcmp(scalars + row * bytesPerLine + offset, previous + row * bytesPerLine + offset, length) != 0)
+          {
+            minTileX = qMin(minTileX, tileX);
+            maxTileX = qMax(maxTileX, tileX);
+            minTileY = qMin(minTileY, tileY);
+            maxTileY = qMax(maxTileY, tileY);
+            break;
+          }
+        }
+      }
+    }
+
+    if (maxTileX < 0)
+    {
+      // Nothing changed.
+      m_FramesSinceKeyFrame++;
+      return igtl::ImageMessage::Pointer();
+    }
+  }
+
+  int subOffsetX = 0;
+  int subOffsetY = 0;
+  int subWidth = width;
+  int subHeight = height;
+  int subDepth = depth;
+
+  if (isKeyFrame)
+  {
+    m_PreviousFrame.resize(frameSize);
+    memcpy(m_PreviousFrame.data(), scalars, frameSize);
+
+    m_DeviceName = QString(frame->GetDeviceName());
+    m_Width = width;
+    m_Height = height;
+    m_Depth = depth;
+    m_ScalarType = frame->GetScalarType();
+    m_NumberOfComponents = frame->GetNumComponents();
+    m_FramesSinceKeyFrame = 0;
+    m_KeyFrameRequested = false;
+    m_NumberOfKeyFrames++;
+  }
+  else
+  {
+    subOffsetX = minTileX * m_TileSize;
+    subOffsetY = minTileY * m_TileSize;
+    subWidth = qMin((maxTileX + 1) * m_TileSize, width) - subOffsetX;
+    subHeight = qMin((maxTileY + 1) * m_TileSize, height) - subOffsetY;
+    m_FramesSinceKeyFrame++;
+  }
+
+  igtl::ImageMessage::Pointer encoded = igtl::ImageMessage::New();
+  CopyImageMetaData(frame, encoded);
+  encoded->SetSubVolume(subWidth, subHeight, subDepth, subOffsetX, subOffsetY, 0);
+  encoded->AllocateScalars();
+
+  uchar *destination = static_cast<uchar*>(encoded->GetScalarPointer());
+  const int subBytesPerLine = subWidth * bytesPerPixel;
+
+  for (int row = 0; row < subHeight * subDepth; row++)
+  {
+    const int sourceOffset = (subOffsetY + row) * bytesPerLine + subOffsetX * bytesPerPixel;
+    memcpy(destination + row * subBytesPerLine, scalars + sourceOffset, subBytesPerLine);
+
+    // Outside the box, the previous frame already matches this one.
+    if (!isKeyFrame)
+    {
+      memcpy(m_PreviousFrame.data() + sourceOffset, scalars + sourceOffset, subBytesPerLine);
+    }
+  }
+
+  m_NumberOfEncodedBytes += static_cast<quint64>(subBytesPerLine) * subHeight * subDepth;
+
+  return encoded;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDeltaEncoder::GetNumberOfFrames() const
+{
+  return m_NumberOfFrames;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDeltaEncoder::GetNumberOfKeyFrames() const
+{
+  return m_NumberOfKeyFrames;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDeltaEncoder::GetNumberOfFullFrameBytes() const
+{
+  return m_NumberOfFullFrameBytes;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkImageDeltaEncoder::GetNumberOfEncodedBytes() const
+{
+  return m_NumberOfEncodedBytes;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkImageDeltaEncoder::GetBandwidthSaving() const
+{
+  if (m_NumberOfFullFrameBytes == 0)
+  {
+    return 0;
+  }
+  return 1.0 - static_cast<double>(m_NumberOfEncodedBytes) / static_cast<double>(m_NumberOfFullFrameBytes);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageDeltaEncoder::OutputStats() const
+{
+  QLOG_INFO() << QObject::tr("NiftyLinkImageDeltaEncoder::OutputStats() - %1: frames=%2, key frames=%3, full bytes=%4, encoded bytes=%5, saving=%6%.")
+                 .arg(m_DeviceName)
+                 .arg(m_NumberOfFrames)
+                 .arg(m_NumberOfKeyFrames)
+                 .arg(m_NumberOfFullFrameBytes)
+                 .arg(m_NumberOfEncodedBytes)
+                 .arg(this->GetBandwidthSaving() * 100, 0, 'f', 1);
+}
+
+} // end namespace niftk
@@ -0,0 +1,119 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkImageDeltaEncoder_h
+#define NiftyLinkImageDeltaEncoder_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <igtlImageMessage.h>
+
+#include <QByteArray>
+#include <QString>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkImageDeltaEncoder
+* \brief Opt-in, sender side, delta encoding of a stream of 2D IMAGE messages, for sources
+* such as ultrasound and endoscopes, where often only part of each frame changes.
+*
+* Each frame is divided into tiles of GetTileSize() x GetTileSize() pixels, and compared
+* with the previous frame. The tiles that changed are coalesced into their tile aligned
+* bounding box, which is sent as an OpenIGTLink sub-volume, (see igtl::ImageMessage::SetSubVolume()).
+* So, each frame is still exactly one standard IMAGE message, the frame boundaries are
+* unambiguous, and the receiver (see NiftyLinkImageDeltaDecoder) just copies the sub-volume
+* into its copy of the frame. Every GetKeyFrameInterval() frames, and whenever the image size
+* or type changes, the whole frame is sent, so that late joining clients can start decoding.
+*
+* One encoder should be used per stream, (eg. per device name), and it is not thread safe.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkImageDeltaEncoder
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkImageDeltaEncoder();
+
+  /// \brief Destructor.
+  ~NiftyLinkImageDeltaEncoder();
+
+  /// \brief Sets the tile size in pixels, default 64. Smaller tiles find smaller changed areas, but cost more to compare.
+  void SetTileSize(const int& tileSize);
+
+  /// \brief Returns the tile size.
+  int GetTileSize() const;
+
+  /// \brief Sets the number of frames between key frames, default 30, or 1 to send every frame whole.
+  void SetKeyFrameInterval(const int& numberOfFrames);
+
+  /// \brief Returns the key frame interval.
+  int GetKeyFrameInterval() const;
+
+  /// \brief Forces the next frame to be a key frame, eg. when a new client connects.
+  void RequestKeyFrame();
+
+  /// \brief Encodes the next frame.
+  /// \param frame a 2D image, with its scalars, (ie. not yet Packed, or already Unpacked), which is not modified.
+  /// \return a new, not yet Packed, image message containing only the changed sub-volume, and the same
+  /// meta-data as frame, or NULL if nothing changed, in which case there is nothing to send.
+  /// \throws std::invalid_argument if frame is NULL or has no scalars.
+  igtl::ImageMessage::Pointer Encode(const igtl::ImageMessage::Pointer& frame);
+
+  /// \brief Returns the number of frames passed to Encode().
+  quint64 GetNumberOfFrames() const;
+
+  /// \brief Returns the number of frames sent whole.
+  quint64 GetNumberOfKeyFrames() const;
+
+  /// \brief Returns the number of scalar bytes that would have been sent, had every frame been sent whole.
+  quint64 GetNumberOfFullFrameBytes() const;
+
+  /// \brief Returns the number of scalar bytes actually returned by Encode().
+  quint64 GetNumberOfEncodedBytes() const;
+
+  /// \brief Returns the fraction of scalar bytes saved, eg. 0.75 means 75% fewer bytes than sending whole frames.
+  double GetBandwidthSaving() const;
+
+  /// \brief Logs the above stats, for this stream.
+  void OutputStats() const;
+
+private:
+
+  /// \brief Returns true if frame can be delta encoded against m_PreviousFrame.
+  bool IsSameShapeAsPrevious(const int& width, const int& height, const int& depth,
+                             const int& scalarType, const int& numberOfComponents) const;
+
+  int         m_TileSize;
+  int         m_KeyFrameInterval;
+  int         m_FramesSinceKeyFrame;
+  bool        m_KeyFrameRequested;
+
+  QByteArray  m_PreviousFrame;
+  QString     m_DeviceName;
+  int         m_Width;
+  int         m_Height;
+  int         m_Depth;
+  int         m_ScalarType;
+  int         m_NumberOfComponents;
+
+  quint64     m_NumberOfFrames;
+  quint64     m_NumberOfKeyFrames;
+  quint64     m_NumberOfFullFrameBytes;
+  quint64     m_NumberOfEncodedBytes;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkImageDeltaEncoder_h
@@ -13,6 +13,7 @@
 
 #include <NiftyLinkUtils.h>
 #include <NiftyLinkMacro.h>
+#include <NiftyLinkPixelConversions.h>
 
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
@@ -20,7 +21,7 @@
 #include <QsLog.h>
 
 #include <math.h>
-#include <cassert>
+#include <cstring>
 
 namespace niftk
 {
@@ -86,6 +87,89 @@ void InitialiseImageWithRandomData(igtl::ImageMessage::Pointer& imageMessage)
 }
 
 
+//-----------------------------------------------------------------------------
+static void CopyRows(const uchar *source, const int& sourceBytesPerLine,
+                     uchar *destination, const int& destinationBytesPerLine,
+                     const int& bytesPerRow, const int& numberOfRows)
+{
+  if (sourceBytesPerLine == bytesPerRow && destinationBytesPerLine == bytesPerRow)
+  {
+    memcpy(destination, source, static_cast<size_t>(bytesPerRow) * numberOfRows);
+  }
+  else
+  {
+    // QImage pads each line to 32 bits, but igtl::ImageMessage is tightly packed.
+    for (int row = 0; row < numberOfRows; row++)
+    {
+      memcpy(destination + row * destinationBytesPerLine, source + row * sourceBytesPerLine, bytesPerRow);
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static bool GetQImageFormat(const igtl::ImageMessage::Pointer& imageToRead, QImage::Format& format)
+{
+  if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT32 )
+  {
+    format = QImage::Format_ARGB32;
+  }
+  else if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8
+            && imageToRead->GetNumComponents() == 3
+          )
+  {
+    format = QImage::Format_RGB888;
+  }
+  else if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8
+            && imageToRead->GetNumComponents() == 4
+          )
+  {
+    format = QImage::Format_ARGB32;
+  }
+  else if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8 )
+  {
+#if (QT_VERSION < QT_VERSION_CHECK(5,5,0))
+    format = QImage::Format_Indexed8;
+#else
+    format = QImage::Format_Grayscale8;
+#endif
+  }
+  else
+  {
+    QLOG_ERROR() << "NiftyLinkImageMessage::GetQImage(void)" << ": Attempt to get QImage from image message of type "
+                 << imageToRead->GetScalarType() << " not implemented. \n";
+    return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+static void SetGreyScaleColorTable(QImage& image)
+{
+  if (image.format() == QImage::Format_Indexed8)
+  {
+    QVector<QRgb> colors = QVector<QRgb>(256);
+
+    for (int i = 0; i < 256; i ++)
+    {
+      colors[i] = qRgb(i, i, i);
+    }
+
+    image.setColorTable(colors);
+  }
+}
+
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5,0,0))
+//-----------------------------------------------------------------------------
+static void ReleaseImageMessage(void *imageMessage)
+{
+  static_cast<igtl::ImageMessage*>(imageMessage)->UnRegister();
+}
+#endif
+
+
 //-----------------------------------------------------------------------------
 void SetQImage(const QImage& imageToRead, igtl::ImageMessage::Pointer& imageToWrite)
 {
@@ -99,11 +183,11 @@ void SetQImage(const QImage& imageToRead, igtl::ImageMessage::Pointer& imageToWr
     NiftyLinkStdExceptionMacro(std::invalid_argument, << "QImage is NULL.");
   }
 
-  // better check that the assumption below that images are tightly packed is actually true.
-  // note that the qt docs are conflicting on this matter!
-  assert(imageToRead.bytesPerLine() == (imageToRead.width() * (imageToRead.depth() / 8)));
+  // All formats other than grey scale get converted to Format_ARGB32, which is a shallow copy if it already is.
+  QImage image(imageToRead);
 
-  unsigned long int byteSizeOfImage = 0;
+  // ARGB32 pixels are native endian quint32, so say so, then a receiver with the same byte order needn't swap them.
+  imageToWrite->SetEndian(GetNativeEndian());
 
   if (
 #if (QT_VERSION < QT_VERSION_CHECK(5,5,0))
@@ -117,18 +201,30 @@ void SetQImage(const QImage& imageToRead, igtl::ImageMessage::Pointer& imageToWr
     imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
     imageToWrite->SetNumComponents(1);
     imageToWrite->AllocateScalars();
-    byteSizeOfImage = imageToRead.byteCount();
+  }
+  else if (imageToRead.format() == QImage::Format_RGB888)
+  {
+    // Frame grabbers commonly produce this, so convert straight into the message, rather than via a temporary QImage.
+    imageToWrite->SetDimensions(imageToRead.width(), imageToRead.height(), 1);
+    imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT32);
+    imageToWrite->SetNumComponents(1);
+    imageToWrite->AllocateScalars();
+
+    if (imageToWrite->GetScalarPointer() != 0)
+    {
+      ConvertRGB888ToARGB32(imageToRead.constBits(), imageToRead.bytesPerLine(),
+                            static_cast<uchar*>(imageToWrite->GetScalarPointer()), imageToRead.width() * 4,
+                            imageToRead.width(), imageToRead.height());
+    }
+    return;
   }
   else
   {
-    // All other formats get converted to Format_ARGB32.
-    QImage image(imageToRead);
     image = image.convertToFormat(QImage::Format_ARGB32);
     imageToWrite->SetDimensions(image.width(), image.height(), 1);
     imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT32);
     imageToWrite->SetNumComponents(1);
     imageToWrite->AllocateScalars();
-    byteSizeOfImage = image.byteCount();
   }
 
   // Copy image data to igtl::ImageMessage
@@ -137,9 +233,11 @@ void SetQImage(const QImage& imageToRead, igtl::ImageMessage::Pointer& imageToWr
   // image at the other end
 
   // in some cases we'll end up with a null-pointer if we are short of mem.
-  if ((imageToWrite->GetScalarPointer() != 0) && (imageToRead.bits() != 0))
+  if ((imageToWrite->GetScalarPointer() != 0) && (image.constBits() != 0))
   {
-    memcpy(imageToWrite->GetScalarPointer(), imageToRead.bits(), byteSizeOfImage);
+    CopyRows(image.constBits(), image.bytesPerLine(),
+             static_cast<uchar*>(imageToWrite->GetScalarPointer()), image.width() * (image.depth() / 8),
+             image.width() * (image.depth() / 8), image.height());
   }
 }
 
@@ -157,50 +255,307 @@ void GetQImage(const igtl::ImageMessage::Pointer& imageToRead, QImage& imageToWr
   int k;
   imageToRead->GetDimensions(i, j, k);
 
-  if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT32 )
+  QImage::Format format;
+  if (!GetQImageFormat(imageToRead, format))
   {
-    imageToWrite = QImage(i, j, QImage::Format_ARGB32);
+    return;
   }
-  else if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8
-            && imageToRead->GetNumComponents() == 3
-          )
+
+  imageToWrite = QImage(i, j, format);
+  SetGreyScaleColorTable(imageToWrite);
+
+  const int bytesPerRow = i * (imageToWrite.depth() / 8);
+  CopyRows(static_cast<const uchar*>(imageToRead->GetScalarPointer()), bytesPerRow,
+           imageToWrite.bits(), imageToWrite.bytesPerLine(),
+           bytesPerRow, j);
+}
+
+
+//-----------------------------------------------------------------------------
+void GetQImage(const igtl::ImageMessage::Pointer& imageToRead, const int& window, const int& level, QImage& imageToWrite)
+{
+  if (imageToRead.IsNull())
   {
-    imageToWrite = QImage(i, j, QImage::Format_RGB888);
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL.");
   }
-  else if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8
-            && imageToRead->GetNumComponents() == 4
-          )
+
+  if (imageToRead->GetScalarType() != igtl::ImageMessage::TYPE_UINT16 || imageToRead->GetNumComponents() != 1)
   {
-    imageToWrite = QImage(i, j, QImage::Format_ARGB32);
+    GetQImage(imageToRead, imageToWrite);
+    return;
   }
-  else
-  {
-    if ( imageToRead->GetScalarType() == igtl::ImageMessage::TYPE_UINT8 )
-    {
+
+  int i;
+  int j;
+  int k;
+  imageToRead->GetDimensions(i, j, k);
+
 #if (QT_VERSION < QT_VERSION_CHECK(5,5,0))
-      imageToWrite = QImage(i, j, QImage::Format_Indexed8);
-      QVector<QRgb> colors = QVector<QRgb>(256);
+  imageToWrite = QImage(i, j, QImage::Format_Indexed8);
+  SetGreyScaleColorTable(imageToWrite);
+#else
+  imageToWrite = QImage(i, j, QImage::Format_Grayscale8);
+#endif
 
-      for (int i = 0; i < 256; i ++)
-      {
-        colors[i] = qRgb(i, i, i);
-      }
+  ConvertGrey16ToGrey8(static_cast<const uchar*>(imageToRead->GetScalarPointer()), i * 2,
+                       imageToWrite.bits(), imageToWrite.bytesPerLine(),
+                       i, j, window, level);
+}
+
+
+//-----------------------------------------------------------------------------
+bool GetQImageView(const igtl::ImageMessage::Pointer& imageToRead, QImage& view)
+{
+  if (imageToRead.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL.");
+  }
+
+  if (imageToRead->GetScalarPointer() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message has no scalars.");
+  }
+
+  int i;
+  int j;
+  int k;
+  imageToRead->GetDimensions(i, j, k);
+
+  QImage::Format format;
+  if (!GetQImageFormat(imageToRead, format))
+  {
+    view = QImage();
+    return false;
+  }
 
-      imageToWrite.setColorTable(colors);
+  // igtl::ImageMessage is tightly packed, so pass bytesPerLine, as QImage otherwise assumes 32 bit aligned lines.
+  const int bytesPerLine = i * imageToRead->GetScalarSize() * imageToRead->GetNumComponents();
+  uchar *scalars = static_cast<uchar*>(imageToRead->GetScalarPointer());
+
+  // QImage requires its data and each of its lines to be 32 bit aligned. The scalars follow the
+  // 58 byte message header and 72 byte image header, so often are not, and then we must copy.
+  if (reinterpret_cast<quintptr>(scalars) % 4 != 0 || bytesPerLine % 4 != 0)
+  {
+    GetQImage(imageToRead, view);
+    return false;
+  }
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5,0,0))
+  // The view holds a reference to the message, released by QImage when the last copy of the view goes.
+  imageToRead->Register();
+  view = QImage(scalars, i, j, bytesPerLine, format, ReleaseImageMessage, imageToRead.GetPointer());
 #else
-      imageToWrite = QImage(i, j, QImage::Format_Grayscale8);
+  view = QImage(scalars, i, j, bytesPerLine, format);
 #endif
+
+  SetGreyScaleColorTable(view);
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool AllocateQImage(const int& width, const int& height, const QImage::Format& format,
+                    igtl::ImageMessage::Pointer& imageToWrite, QImage& view)
+{
+  if (imageToWrite.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL.");
+  }
+
+  if (width <= 0 || height <= 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Invalid image size " << width << "x" << height << ".");
+  }
+
+  if (format == QImage::Format_ARGB32)
+  {
+    imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT32);
+    imageToWrite->SetNumComponents(1);
+  }
+  else if (format == QImage::Format_RGB888)
+  {
+    imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+    imageToWrite->SetNumComponents(3);
+  }
+  else if (
+#if (QT_VERSION < QT_VERSION_CHECK(5,5,0))
+           format == QImage::Format_Indexed8
+#else
+           format == QImage::Format_Indexed8 || format == QImage::Format_Grayscale8
+#endif
+          )
+  {
+    imageToWrite->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+    imageToWrite->SetNumComponents(1);
+  }
+  else
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "QImage format " << format << " is not supported.");
+  }
+
+  imageToWrite->SetDimensions(width, height, 1);
+  imageToWrite->AllocateScalars();
+
+  return GetQImageView(imageToWrite, view);
+}
+
+
+//-----------------------------------------------------------------------------
+void CopyImageMetaData(const igtl::ImageMessage::Pointer& imageToRead, igtl::ImageMessage::Pointer& imageToWrite)
+{
+  if (imageToRead.IsNull() || imageToWrite.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL.");
+  }
+
+  int dimensions[3];
+  imageToRead->GetDimensions(dimensions);
+
+  float spacing[3];
+  imageToRead->GetSpacing(spacing);
+
+  igtl::Matrix4x4 matrix;
+  imageToRead->GetMatrix(matrix);
+
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  imageToRead->GetTimeStamp(timeStamp);
+
+  imageToWrite->SetDeviceName(imageToRead->GetDeviceName());
+  imageToWrite->SetTimeStamp(timeStamp);
+  imageToWrite->SetDimensions(dimensions);
+  imageToWrite->SetSpacing(spacing);
+  imageToWrite->SetMatrix(matrix);
+  imageToWrite->SetScalarType(imageToRead->GetScalarType());
+  imageToWrite->SetNumComponents(imageToRead->GetNumComponents());
+  imageToWrite->SetEndian(imageToRead->GetEndian());
+  imageToWrite->SetCoordinateSystem(imageToRead->GetCoordinateSystem());
+}
+
+
+//-----------------------------------------------------------------------------
+void DecimateImage(const igtl::ImageMessage::Pointer& imageToRead, const int& factor,
+                   const QRect& regionOfInterest, igtl::ImageMessage::Pointer& imageToWrite)
+{
+  if (imageToRead.IsNull() || imageToWrite.IsNull() || imageToRead->GetScalarPointer() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL, or has no scalars.");
+  }
+  if (factor < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Downsampling factor must be at least 1.");
+  }
+
+  int dimensions[3];
+  imageToRead->GetDimensions(dimensions);
+
+  int subVolumeDimensions[3];
+  int subVolumeOffset[3];
+  imageToRead->GetSubVolume(subVolumeDimensions, subVolumeOffset);
+
+  if (dimensions[2] != 1
+      || subVolumeDimensions[0] != dimensions[0]
+      || subVolumeDimensions[1] != dimensions[1]
+      || subVolumeDimensions[2] != dimensions[2])
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Can only decimate whole 2D images.");
+  }
+
+  QRect region(0, 0, dimensions[0], dimensions[1]);
+  if (!regionOfInterest.isNull())
+  {
+    region = region.intersected(regionOfInterest);
+  }
+  if (region.isEmpty())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Region of interest doesn't overlap the image.");
+  }
+
+  const int width = (region.width() + factor - 1) / factor;
+  const int height = (region.height() + factor - 1) / factor;
+
+  CopyImageMetaData(imageToRead, imageToWrite);
+
+  float spacing[3];
+  imageToRead->GetSpacing(spacing);
+
+  // The matrix origin is the image centre, so move it by the offset of the new centre, in mm.
+  const double centreOffsetX = (region.x() + width * factor / 2.0 - dimensions[0] / 2.0) * spacing[0];
+  const double centreOffsetY = (region.y() + height * factor / 2.0 - dimensions[1] / 2.0) * spacing[1];
+
+  igtl::Matrix4x4 matrix;
+  imageToRead->GetMatrix(matrix);
+  for (int i = 0; i < 3; i++)
+  {
+    matrix[i][3] += static_cast<float>(matrix[i][0] * centreOffsetX + matrix[i][1] * centreOffsetY);
+  }
+
+  imageToWrite->SetDimensions(width, height, 1);
+  imageToWrite->SetSpacing(spacing[0] * factor, spacing[1] * factor, spacing[2]);
+  imageToWrite->SetMatrix(matrix);
+  imageToWrite->AllocateScalars();
+
+  const int bytesPerPixel = imageToRead->GetScalarSize() * imageToRead->GetNumComponents();
+  const int sourceBytesPerLine = dimensions[0] * bytesPerPixel;
+  const int destinationBytesPerLine = width * bytesPerPixel;
+  const uchar *source = static_cast<const uchar*>(imageToRead->GetScalarPointer())
+                        + region.y() * sourceBytesPerLine + region.x() * bytesPerPixel;
+  uchar *destination = static_cast<uchar*>(imageToWrite->GetScalarPointer());
+
+  for (int y = 0; y < height; y++)
+  {
+    const uchar *sourceRow = source + y * factor * sourceBytesPerLine;
+    uchar *destinationRow = destination + y * destinationBytesPerLine;
+
+    if (factor == 1)
+    {
+      memcpy(destinationRow, sourceRow, destinationBytesPerLine);
     }
     else
     {
-      QLOG_ERROR() << "NiftyLinkImageMessage::GetQImage(void)" << ": Attempt to get QImage from image message of type "
-                   << imageToRead->GetScalarType() << " not implemented. \n";
-      return;
+      for (int x = 0; x < width; x++)
+      {
+        memcpy(destinationRow + x * bytesPerPixel, sourceRow + x * factor * bytesPerPixel, bytesPerPixel);
+      }
     }
   }
+}
+
 
-  int byteSizeOfImg = imageToWrite.byteCount();
-  memcpy(imageToWrite.bits(), imageToRead->GetScalarPointer(), byteSizeOfImg);
+//-----------------------------------------------------------------------------
+int GetNativeEndian()
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+  return igtl::ImageMessage::ENDIAN_LITTLE;
+#else
+  return igtl::ImageMessage::ENDIAN_BIG;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+void ConvertImageEndian(igtl::ImageMessage::Pointer& image, const int& endian)
+{
+  if (image.IsNull() || image->GetScalarPointer() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Image message is NULL, or has no scalars.");
+  }
+  if (endian != igtl::ImageMessage::ENDIAN_LITTLE && endian != igtl::ImageMessage::ENDIAN_BIG)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Invalid endian " << endian << ".");
+  }
+
+  if (image->GetEndian() == endian)
+  {
+    return;
+  }
+
+  const int scalarSize = image->GetScalarSize();
+  if (scalarSize > 1)
+  {
+    uchar *scalars = static_cast<uchar*>(image->GetScalarPointer());
+    SwapByteOrder(scalars, scalars, scalarSize, static_cast<qint64>(image->GetSubVolumeImageSize()) / scalarSize);
+  }
+  image->SetEndian(endian);
 }
 
 
@@ -218,21 +573,7 @@ void SaveImage(const igtl::ImageMessage::Pointer& imageToRead, const QString& ou
   }
 
   QImage image;
-  GetQImage(imageToRead, image);
-
-  // GetQImage currently does not set the color table.
-  // Lets do it here. Insert a default index table for indexed image type
-  if ( image.format() == QImage::Format_Indexed8)
-  {
-    QVector<QRgb> colors = QVector<QRgb> (256);
-
-    for (int i = 0; i < 256; i++)
-    {
-      colors[i] = qRgb(i, i, i);
-    }
-
-    image.setColorTable(colors);
-  }
+  GetQImageView(imageToRead, image);
 
   if (!image.isNull())
   {
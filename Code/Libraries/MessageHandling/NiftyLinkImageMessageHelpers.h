@@ -18,6 +18,7 @@
 #include <igtlImageMessage.h>
 
 #include <QImage>
+#include <QRect>
 
 /**
 * \file NiftyLinkImageMessageHelpers.h
@@ -49,9 +50,61 @@ extern "C++" NIFTYLINKCOMMON_WINEXPORT void InitialiseImageWithRandomData(igtl::
 /// \brief Sets the QImage onto the igtl::ImageMessage.
 extern "C++" NIFTYLINKCOMMON_WINEXPORT void SetQImage(const QImage& imageToRead, igtl::ImageMessage::Pointer& imageToWrite);
 
-/// \brief Gets/Creates a new QImage using the provided igtl::ImageMessage.
+/// \brief Gets/Creates a new QImage using the provided igtl::ImageMessage, by copying. See also GetQImageView().
 extern "C++" NIFTYLINKCOMMON_WINEXPORT void GetQImage(const igtl::ImageMessage::Pointer& imageToRead, QImage& imageToWrite);
 
+/// \brief As GetQImage(), but for unsigned 16 bit grey scale (eg. ultrasound or fluoroscopy), maps [level - window/2, level + window/2]
+/// onto 8 bit grey. Other types are passed to GetQImage(), ignoring window and level.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void GetQImage(const igtl::ImageMessage::Pointer& imageToRead, const int& window, const int& level, QImage& imageToWrite);
+
+/// \brief Sets view to a QImage that refers directly to the scalars of the provided igtl::ImageMessage, without copying.
+///
+/// The format is chosen as for GetQImage(). Painting into the view, (or calling bits()), modifies the message.
+/// With Qt5, the view holds a reference to the message, so the message stays valid for as long as any copy
+/// of the view exists, even after the last NiftyLinkMessageContainer referring to it has gone. With Qt4,
+/// QImage cannot hold a reference, so the caller must keep the message (or its container) alive for as long as the view is used.
+/// Either way, the message must not be re-allocated, (eg. SetDimensions() and AllocateScalars(), or Unpack() of new data), while the view is used.
+///
+/// QImage requires 32 bit aligned data and lines, so if the scalars or the line length are not a multiple of 4 bytes,
+/// (which is common, as the scalars start 130 bytes into a packed message), view is instead a copy, as GetQImage().
+/// \return true if view refers to the message's scalars, false if it is a copy, (or null, if the format is not supported).
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool GetQImageView(const igtl::ImageMessage::Pointer& imageToRead, QImage& view);
+
+/// \brief Allocates the scalars of imageToWrite for a width x height image of the given format, and sets view as GetQImageView(),
+/// so that a producer can render (eg. with QPainter) directly into the message, and then Pack() it, rather than
+/// rendering into a separate QImage, and calling SetQImage().
+///
+/// Supported formats are QImage::Format_ARGB32, QImage::Format_RGB888, QImage::Format_Indexed8, (and Qt 5.5+ QImage::Format_Grayscale8).
+/// Note that QPainter cannot paint onto QImage::Format_Indexed8.
+/// \return as GetQImageView(). If false, view is a copy, so the producer must call SetQImage() after rendering.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT bool AllocateQImage(const int& width, const int& height, const QImage::Format& format,
+                                                           igtl::ImageMessage::Pointer& imageToWrite, QImage& view);
+
+/// \brief Copies device name, timestamp, dimensions, spacing, matrix, scalar type, number of components,
+/// endian and coordinate system from one image message to another, but not the sub-volume or scalars.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void CopyImageMetaData(const igtl::ImageMessage::Pointer& imageToRead, igtl::ImageMessage::Pointer& imageToWrite);
+
+/// \brief Copies a region of interest of a 2D image, keeping every factor'th pixel in each direction, (ie. nearest neighbour downsampling),
+/// so that a slow client can be sent a smaller image. Spacing and origin, (ie. the image centre), are adjusted so that the result
+/// still lies in the same physical place. imageToWrite is not Packed.
+/// \param regionOfInterest in pixels, which is clipped to the image, or a null QRect for the whole image.
+/// \throws std::invalid_argument if either image is NULL, imageToRead has no scalars, or is a sub-volume, or is 3D,
+/// or factor is less than 1, or regionOfInterest doesn't overlap the image.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void DecimateImage(const igtl::ImageMessage::Pointer& imageToRead, const int& factor,
+                                                          const QRect& regionOfInterest, igtl::ImageMessage::Pointer& imageToWrite);
+
+/// \brief Returns igtl::ImageMessage::ENDIAN_LITTLE or igtl::ImageMessage::ENDIAN_BIG, whichever this machine is.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT int GetNativeEndian();
+
+/// \brief Converts the scalars of image, in place, to endian, (igtl::ImageMessage::ENDIAN_LITTLE or ENDIAN_BIG), and sets its endian flag.
+///
+/// OpenIGTLink does not convert IMAGE scalars in Pack() or Unpack(), it just sends the endian flag, so a receiver
+/// whose native byte order matches the flag, (see GetNativeEndian()), need do nothing. Otherwise, this reverses the bytes
+/// of each scalar, using SwapByteOrder(). Nothing is done if the image is already endian, or has 1 byte scalars.
+/// The image must have its scalars, ie. not yet Packed, or already Unpacked, and should be Packed again before sending.
+/// \throws std::invalid_argument if image is NULL, has no scalars, or endian is not valid.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void ConvertImageEndian(igtl::ImageMessage::Pointer& image, const int& endian);
+
 /// \brief Saves the image data to a file.
 extern "C++" NIFTYLINKCOMMON_WINEXPORT void SaveImage(const igtl::ImageMessage::Pointer& imageToRead, const QString& outputFileName);
 
@@ -18,20 +18,213 @@
 #include "QsLog.h"
 #include "QsLogDest.h"
 
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QList>
+#include <QMutex>
+#include <QThreadStorage>
+
 #include <cassert>
 
 namespace niftk
 {
 
+// Freed containers are handed between threads in chains of this many.
+static const int NIFTYLINK_CONTAINER_BATCH_SIZE = 64;
+
+// Beyond this many chains waiting to be taken by a thread, freed containers go back to the heap.
+static const int NIFTYLINK_CONTAINER_MAX_BATCHES = 16;
+
+// See GetNumberOfHeapAllocations().
+static QAtomicInt s_NumberOfHeapAllocations(0);
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5,3,0))
+static QAtomicInteger<quint64> s_NextId(1);
+#else
+static QAtomicInt s_NextId(1);
+#endif
+
+//-----------------------------------------------------------------------------
+static igtlUint64 GetNextMessageId()
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5,3,0))
+  return s_NextId.fetchAndAddRelaxed(1);
+#else
+  return static_cast<quint32>(s_NextId.fetchAndAddRelaxed(1));
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+static void DeleteChain(void *p)
+{
+  while (p != NULL)
+  {
+    void *next = *static_cast<void**>(p);
+    ::operator delete(p);
+    p = next;
+  }
+}
+
+
+/**
+* \class NiftyLinkMessageContainerDepot
+* \brief Chains of freed containers, that any thread can take, see NiftyLinkMessageContainerPool.
+*/
+class NiftyLinkMessageContainerDepot
+{
+public:
+  ~NiftyLinkMessageContainerDepot()
+  {
+    for (int i = 0; i < m_Batches.size(); i++)
+    {
+      DeleteChain(m_Batches[i]);
+    }
+  }
+
+  QMutex       m_Mutex;
+  QList<void*> m_Batches;
+};
+
+// Q_GLOBAL_STATIC returns NULL once destroyed, so containers freed later still go back to the heap.
+Q_GLOBAL_STATIC(NiftyLinkMessageContainerDepot, s_Depot)
+
+
+/**
+* \class NiftyLinkMessageContainerPool
+* \brief Private list of freed containers for one thread, see NiftyLinkMessageContainer::operator new().
+*
+* Each freed container's memory holds the pointer to the next. Once a thread holds two chains,
+* it gives one to s_Depot, and when it runs out, it takes one from there, before using the heap.
+*/
+class NiftyLinkMessageContainerPool
+{
+public:
+  NiftyLinkMessageContainerPool()
+  : m_Free(NULL)
+  , m_NumberFree(0)
+  {
+  }
+
+  ~NiftyLinkMessageContainerPool()
+  {
+    // The thread is finishing, so other threads can have what is left.
+    while (m_NumberFree >= NIFTYLINK_CONTAINER_BATCH_SIZE)
+    {
+      this->GiveBatch();
+    }
+    DeleteChain(m_Free);
+  }
+
+  void* Allocate()
+  {
+    if (m_Free == NULL)
+    {
+      this->TakeBatch();
+    }
+    if (m_Free == NULL)
+    {
+      s_NumberOfHeapAllocations.ref();
+      return ::operator new(sizeof(NiftyLinkMessageContainer));
+    }
+    void *p = m_Free;
+    m_Free = *static_cast<void**>(p);
+    m_NumberFree--;
+    return p;
+  }
+
+  void Free(void *p)
+  {
+    *static_cast<void**>(p) = m_Free;
+    m_Free = p;
+    m_NumberFree++;
+
+    if (m_NumberFree >= 2 * NIFTYLINK_CONTAINER_BATCH_SIZE)
+    {
+      this->GiveBatch();
+    }
+  }
+
+private:
+
+  void TakeBatch()
+  {
+    NiftyLinkMessageContainerDepot *depot = s_Depot();
+    if (depot == NULL)
+    {
+      return;
+    }
+
+    QMutexLocker locker(&depot->m_Mutex);
+    if (!depot->m_Batches.isEmpty())
+    {
+      m_Free = depot->m_Batches.takeLast();
+      m_NumberFree = NIFTYLINK_CONTAINER_BATCH_SIZE;
+    }
+  }
+
+  void GiveBatch()
+  {
+    void *batch = m_Free;
+    void *last = batch;
+    for (int i = 1; i < NIFTYLINK_CONTAINER_BATCH_SIZE; i++)
+    {
+      last = *static_cast<void**>(last);
+    }
+    m_Free = *static_cast<void**>(last);
+    *static_cast<void**>(last) = NULL;
+    m_NumberFree -= NIFTYLINK_CONTAINER_BATCH_SIZE;
+
+    NiftyLinkMessageContainerDepot *depot = s_Depot();
+    if (depot != NULL)
+    {
+      QMutexLocker locker(&depot->m_Mutex);
+      if (depot->m_Batches.size() < NIFTYLINK_CONTAINER_MAX_BATCHES)
+      {
+        depot->m_Batches.append(batch);
+        return;
+      }
+    }
+    DeleteChain(batch);
+  }
+
+  void *m_Free;
+  int   m_NumberFree;
+};
+
+// Each thread's pool is deleted by Qt when the thread finishes, or for the main thread, when QCoreApplication is destroyed.
+typedef QThreadStorage<NiftyLinkMessageContainerPool*> NiftyLinkMessageContainerPools;
+Q_GLOBAL_STATIC(NiftyLinkMessageContainerPools, s_Pools)
+
+//-----------------------------------------------------------------------------
+static NiftyLinkMessageContainerPool* GetPool()
+{
+  NiftyLinkMessageContainerPools *pools = s_Pools();
+  if (pools == NULL)
+  {
+    return NULL;
+  }
+  if (!pools->hasLocalData())
+  {
+    // Only while QCoreApplication exists, as a pool created before or after it, (eg. by a container
+    // freed during static destruction), would never be deleted.
+    if (QCoreApplication::instance() == NULL)
+    {
+      return NULL;
+    }
+    pools->setLocalData(new NiftyLinkMessageContainerPool());
+  }
+  return pools->localData();
+}
+
+
 //-----------------------------------------------------------------------------
 NiftyLinkMessageContainer::NiftyLinkMessageContainer()
-: m_Message(NULL)
-, m_Id(0)
+: m_SenderPortNumber(-1)
+, m_Message(NULL)
+, m_Id(GetNextMessageId())
 , m_TimeArrived(0)
 , m_TimeReceived(0)
-, m_SenderHostName("")
-, m_SenderPortNumber(-1)
-, m_OwnerName("")
 {
 }
 
@@ -70,6 +263,52 @@ NiftyLinkMessageContainer::~NiftyLinkMessageContainer(void)
 }
 
 
+//-----------------------------------------------------------------------------
+void* NiftyLinkMessageContainer::operator new(std::size_t size)
+{
+  // Sub-classes are bigger, so can't use the pool.
+  NiftyLinkMessageContainerPool *pool = NULL;
+  if (size == sizeof(NiftyLinkMessageContainer))
+  {
+    pool = GetPool();
+  }
+  if (pool == NULL)
+  {
+    s_NumberOfHeapAllocations.ref();
+    return ::operator new(size);
+  }
+  return pool->Allocate();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageContainer::operator delete(void* p, std::size_t size)
+{
+  if (p == NULL)
+  {
+    return;
+  }
+  NiftyLinkMessageContainerPool *pool = NULL;
+  if (size == sizeof(NiftyLinkMessageContainer))
+  {
+    pool = GetPool();
+  }
+  if (pool == NULL)
+  {
+    ::operator delete(p);
+    return;
+  }
+  pool->Free(p);
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageContainer::GetNumberOfHeapAllocations()
+{
+  return s_NumberOfHeapAllocations.fetchAndAddRelaxed(0);
+}
+
+
 //-----------------------------------------------------------------------------
 igtlUint64 NiftyLinkMessageContainer::GetNiftyLinkMessageId() const
 {
@@ -130,7 +369,7 @@ void NiftyLinkMessageContainer::SetSenderHostName(const QString &host)
 //-----------------------------------------------------------------------------
 QString NiftyLinkMessageContainer::GetSenderHostName() const
 {
-  return m_SenderHostName;
+  return this->m_SenderHostName;
 }
 
 
@@ -26,6 +26,7 @@
 #include <QSharedData>
 #include <QExplicitlySharedDataPointer>
 
+#include <cstddef>
 #include <map>
 
 namespace niftk
@@ -47,6 +48,12 @@ namespace niftk
 *
 * We currently store a smart pointer to the OpenIGTLink image, so
 * copy operators are shallow, copying the value of this pointer.
+*
+* Containers are created and destroyed at the message rate, so are kept small, (the host and owner
+* names are implicitly shared QStrings, so setting them from an existing string doesn't copy it).
+* Freed containers are kept in a pool for each thread, and handed between threads in batches, so the
+* thread reading a socket can reuse containers freed by the GUI thread. Outside the lifetime of
+* QCoreApplication, (which deletes the main thread's pool), containers come from, and go back to, the heap.
 */
 class NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessageContainer : public QSharedData
 {
@@ -58,7 +65,7 @@ public:
   typedef QExplicitlySharedDataPointer<Self>       Pointer;
   typedef QExplicitlySharedDataPointer<const Self> ConstPointer;
 
-  /// \brief Basic constructor which generates a timestamp and derives the message ID from it.
+  /// \brief Basic constructor, which takes the next message ID from a counter shared by all threads.
   NiftyLinkMessageContainer();
 
   /// \brief We need a copy constructor to register a Qt metatype.
@@ -71,7 +78,8 @@ public:
   /// \brief Basic destructor.
   virtual ~NiftyLinkMessageContainer(void);
 
-  /// \brief Returns the message ID.
+  /// \brief Returns the message ID, which is unique, and increases with each container constructed.
+  /// Copies keep the ID of the original.
   igtlUint64 GetNiftyLinkMessageId(void) const;
 
   /// \brief This function sets the OpenIGTLink message, which copies the smart pointer.
@@ -116,11 +124,25 @@ public:
   /// \brief Method to check who owns the message at the moment
   QString GetOwnerName(void);
 
+  /// \brief Takes memory from the calling thread's pool of freed containers, or the heap if there are none, or no pool.
+  static void* operator new(std::size_t size);
+
+  /// \brief Gives memory back to the calling thread's pool, or the heap if it has no pool.
+  static void operator delete(void* p, std::size_t size);
+
+  /// \brief Returns the number of containers allocated from the heap, rather than a pool, for measuring churn.
+  static int GetNumberOfHeapAllocations();
+
 private:
 
   // Shallow copy, meaning that it copies pointer values.
   void ShallowCopy(const NiftyLinkMessageContainer& another);
 
+  // Ordered so there is no padding on 64 bit platforms, as the port number fits after the reference count.
+
+  // To indicate which port number the message came from.
+  int                                m_SenderPortNumber;
+
   // Holds the actual message. All operations on the message should be done directly here.
   igtl::MessageBase::Pointer         m_Message;
 
@@ -136,9 +158,6 @@ private:
   // To indicate which host/ip address the message came from.
   QString                            m_SenderHostName;
 
-  // To indicate which port number the message came from.
-  int                                m_SenderPortNumber;
-
   // We store an indicator of who 'owns' this message.
   QString                            m_OwnerName;
 };
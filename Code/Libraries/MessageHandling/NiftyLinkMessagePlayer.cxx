@@ -0,0 +1,372 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkMessagePlayer.h"
+#include <NiftyLinkTcpServer.h>
+#include <NiftyLinkMacro.h>
+#include <NiftyLinkUtils.h>
+
+#include <igtlTimeStamp.h>
+
+#include <QsLog.h>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace niftk
+{
+
+const qint64 NiftyLinkMessagePlayer::m_SPIN_INTERVAL_IN_NANOSECONDS(1000000);
+
+/**
+* \class NiftyLinkMessagePlayerThread
+* \brief Private thread that runs NiftyLinkMessagePlayer::PlaybackLoop().
+*/
+class NiftyLinkMessagePlayerThread : public QThread
+{
+public:
+  NiftyLinkMessagePlayerThread(NiftyLinkMessagePlayer *player)
+  : m_Player(player)
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    m_Player->PlaybackLoop();
+  }
+
+private:
+  NiftyLinkMessagePlayer *m_Player;
+};
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessagePlayer::NiftyLinkMessagePlayer(QObject *parent)
+: QObject(parent)
+, m_Thread(NULL)
+, m_Server(NULL)
+, m_PlaybackMode(ORIGINAL_TIMING)
+, m_Speed(1)
+, m_RestampMessages(false)
+, m_SpinWait(false)
+, m_StartTime(0)
+, m_IsPlaying(false)
+, m_StopRequested(false)
+, m_NumberOfMessagesPlayed(0)
+{
+  this->setObjectName("NiftyLinkMessagePlayer");
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  // This is to make sure we have the best possible system timer.
+  niftk::InitializeWinTimers();
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessagePlayer::~NiftyLinkMessagePlayer()
+{
+  this->Stop();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetPlaybackMode(const PlaybackMode& mode)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PlaybackMode = mode;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessagePlayer::PlaybackMode NiftyLinkMessagePlayer::GetPlaybackMode() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_PlaybackMode;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetSpeed(const double& speed)
+{
+  if (speed <= 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Playback speed must be positive.");
+  }
+  QMutexLocker locker(&m_Mutex);
+  m_Speed = speed;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessagePlayer::GetSpeed() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_Speed;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetRestampMessages(bool restamp)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_RestampMessages = restamp;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetSpinWait(bool spin)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_SpinWait = spin;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetStartTime(const quint64& timeArrived)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_StartTime = timeArrived;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::SetServer(NiftyLinkTcpServer *server)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_Server = server;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::Start(const QString& fileName)
+{
+  QMutexLocker locker(&m_Mutex);
+
+  if (m_IsPlaying)
+  {
+    NiftyLinkStdExceptionMacro(std::logic_error, << "Player is already playing.");
+  }
+
+  // The previous playback reached the end of its file, so the thread has already finished.
+  if (m_Thread != NULL)
+  {
+    m_Thread->wait();
+    delete m_Thread;
+    m_Thread = NULL;
+  }
+
+  m_Reader.Open(fileName);
+  m_Reader.SeekToTime(m_StartTime);
+
+  m_IsPlaying = true;
+  m_StopRequested = false;
+  m_NumberOfMessagesPlayed = 0;
+  m_LatenessStats.Reset();
+
+  m_Thread = new NiftyLinkMessagePlayerThread(this);
+  m_Thread->start(QThread::HighestPriority);
+
+  QLOG_INFO() << QObject::tr("%1::Start() - playing %2.").arg(objectName()).arg(fileName);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::Stop()
+{
+  NiftyLinkMessagePlayerThread *thread = NULL;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_StopRequested = true;
+    thread = m_Thread;
+    m_Thread = NULL;
+    m_StopCondition.wakeAll();
+  }
+
+  if (thread == NULL)
+  {
+    return;
+  }
+
+  thread->wait();
+  delete thread;
+
+  m_Reader.Close();
+
+  QLOG_INFO() << QObject::tr("%1::Stop() - played %2 messages, mean lateness %3 ns, max %4 ns.")
+                 .arg(objectName())
+                 .arg(this->GetNumberOfMessagesPlayed())
+                 .arg(this->GetLatenessStats().GetMean())
+                 .arg(this->GetLatenessStats().GetMax());
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessagePlayer::IsPlaying() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_IsPlaying;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessagePlayer::GetNumberOfMessagesPlayed() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_NumberOfMessagesPlayed;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRunningStats NiftyLinkMessagePlayer::GetLatenessStats() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_LatenessStats;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessagePlayer::WaitUntil(const QElapsedTimer& clock, const qint64& deadlineInNanoseconds, const bool& spin)
+{
+  QMutexLocker locker(&m_Mutex);
+
+  qint64 remaining = deadlineInNanoseconds - clock.nsecsElapsed();
+  while (!m_StopRequested && remaining > 0)
+  {
+    if (!spin)
+    {
+      // Sleep right up to the deadline, rounding up, so we are never early, and at most about 1 ms late.
+      unsigned long msec = static_cast<unsigned long>((remaining + 999999) / 1000000);
+      m_StopCondition.wait(&m_Mutex, msec);
+    }
+    else if (remaining > m_SPIN_INTERVAL_IN_NANOSECONDS)
+    {
+      // Sleep for the bulk of the time, but wake up early if Stop() is called.
+      unsigned long msec = static_cast<unsigned long>((remaining - m_SPIN_INTERVAL_IN_NANOSECONDS) / 1000000);
+      m_StopCondition.wait(&m_Mutex, msec > 0 ? msec : 1);
+    }
+    else
+    {
+      // The last millisecond is too short for the scheduler, so just give up our time slice.
+      locker.unlock();
+      QThread::yieldCurrentThread();
+      locker.relock();
+    }
+    remaining = deadlineInNanoseconds - clock.nsecsElapsed();
+  }
+  return !m_StopRequested;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessagePlayer::PlaybackLoop()
+{
+  PlaybackMode mode;
+  double speed;
+  bool restamp;
+  bool spin;
+  NiftyLinkTcpServer *server;
+  {
+    QMutexLocker locker(&m_Mutex);
+    mode = m_PlaybackMode;
+    speed = (m_PlaybackMode == SCALED_TIMING ? m_Speed : 1);
+    restamp = m_RestampMessages;
+    spin = m_SpinWait;
+    server = m_Server;
+  }
+
+  // These are expensive to create/destroy, so do it once.
+  igtl::TimeStamp::Pointer timeNow = igtl::TimeStamp::New();
+
+  quint64 timeArrived = 0;
+  quint64 timeReceived = 0;
+  quint64 firstTimeArrived = 0;
+  int portNumber = 0;
+  bool isFirst = true;
+  QByteArray rawMessage;
+
+  QElapsedTimer clock;
+  clock.start();
+
+  while (m_Reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage))
+  {
+    if (isFirst)
+    {
+      firstTimeArrived = timeArrived;
+      isFirst = false;
+    }
+
+    qint64 due = 0;
+    if (mode != AS_FAST_AS_POSSIBLE && timeArrived > firstTimeArrived)
+    {
+      due = static_cast<qint64>(static_cast<double>(timeArrived - firstTimeArrived) / speed);
+    }
+
+    if (!this->WaitUntil(clock, due, spin))
+    {
+      break;
+    }
+    qint64 lateness = clock.nsecsElapsed() - due;
+
+    igtl::MessageBase::Pointer message;
+    try
+    {
+      message = NiftyLinkRecordingReader::CreateMessage(rawMessage.constData(), rawMessage.size());
+    }
+    catch (const std::exception& e)
+    {
+      QLOG_WARN() << QObject::tr("%1::PlaybackLoop() - skipping message, error=%2").arg(objectName()).arg(QString::fromStdString(e.what()));
+      continue;
+    }
+
+    timeNow->GetTime();
+
+    if (restamp)
+    {
+      message->Unpack();
+      message->SetTimeStamp(timeNow);
+      message->Pack();
+    }
+
+    NiftyLinkMessageContainer::Pointer container = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+    container->SetMessage(message);
+    container->SetTimeArrived(timeNow);
+    container->SetTimeReceived(timeNow);
+    container->SetSenderPortNumber(portNumber);
+    container->SetOwnerName(objectName());
+
+    // Server sends the pack, which must still be in network byte order, so send before Unpack().
+    if (server != NULL)
+    {
+      server->Send(container);
+    }
+
+    if (!restamp)
+    {
+      message->Unpack();
+    }
+
+    emit MessagePlayed(container);
+
+    QMutexLocker locker(&m_Mutex);
+    m_NumberOfMessagesPlayed++;
+    m_LatenessStats.Add(static_cast<quint64>(lateness > 0 ? lateness : 0));
+  }
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_IsPlaying = false;
+  }
+
+  emit PlaybackFinished();
+}
+
+} // end namespace niftk
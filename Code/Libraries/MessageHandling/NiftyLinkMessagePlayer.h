@@ -0,0 +1,153 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkMessagePlayer_h
+#define NiftyLinkMessagePlayer_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+#include <NiftyLinkRecordingReader.h>
+#include <NiftyLinkRunningStats.h>
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+namespace niftk
+{
+
+class NiftyLinkTcpServer;
+class NiftyLinkMessagePlayerThread;
+
+/**
+* \class NiftyLinkMessagePlayer
+* \brief Plays back a file written by NiftyLinkMessageRecorder, either to all clients
+* of a NiftyLinkTcpServer, or to anything connected to the MessagePlayed signal, or both.
+*
+* Playback runs in a private thread. Each message is due at its original arrival time,
+* relative to the first message, divided by the speed. So, ORIGINAL_TIMING reproduces
+* the recorded timing, SCALED_TIMING with speed 4 plays 4 times faster, and AS_FAST_AS_POSSIBLE
+* does not wait at all. To hit each deadline, the thread sleeps (interruptibly, so Stop() is prompt)
+* until it is due, so a message may be up to about a millisecond late, depending on the scheduler.
+* SetSpinWait(true) sleeps until just before it is due, and yields the CPU for the last
+* m_SPIN_INTERVAL_IN_NANOSECONDS, which is more punctual, but keeps a core busy at high message rates.
+* The difference between when a message was due and when it was delivered is available from GetLatenessStats().
+*
+* Messages are sent to the server exactly as recorded, unless SetRestampMessages(true), in which
+* case the OpenIGTLink timestamp is set to the time of sending, and the message re-Packed, so that
+* latency measured downstream is meaningful.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessagePlayer : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  enum PlaybackMode
+  {
+    ORIGINAL_TIMING,
+    SCALED_TIMING,
+    AS_FAST_AS_POSSIBLE
+  };
+
+  /// \brief Equals 1000000, ie. 1 millisecond.
+  static const qint64 m_SPIN_INTERVAL_IN_NANOSECONDS;
+
+  /// \brief Constructor.
+  NiftyLinkMessagePlayer(QObject *parent = 0);
+
+  /// \brief Destructor, calls Stop().
+  virtual ~NiftyLinkMessagePlayer();
+
+  /// \brief Sets the mode, default ORIGINAL_TIMING. Must be called before Start().
+  void SetPlaybackMode(const PlaybackMode& mode);
+
+  /// \brief Returns the mode.
+  PlaybackMode GetPlaybackMode() const;
+
+  /// \brief Sets the speed factor used by SCALED_TIMING, eg. 0.5 for half speed, 4 for four times faster. Must be positive.
+  void SetSpeed(const double& speed);
+
+  /// \brief Returns the speed factor.
+  double GetSpeed() const;
+
+  /// \brief If true, each message is given the current time as its OpenIGTLink timestamp, and re-Packed. Default false.
+  void SetRestampMessages(bool restamp);
+
+  /// \brief If true, yields the CPU in a loop for the last m_SPIN_INTERVAL_IN_NANOSECONDS before each message,
+  /// rather than sleeping, default false. Must be called before Start().
+  void SetSpinWait(bool spin);
+
+  /// \brief Sets the arrival time, in nanoseconds since Unix Epoch, of the first message to play, or 0 (default)
+  /// to play from the beginning. Seeking uses the recording index, so is immediate. Must be called before Start().
+  void SetStartTime(const quint64& timeArrived);
+
+  /// \brief Sets a server to send each message to all its connected clients, or NULL for none.
+  /// The server is not owned by this class, so must outlive playback.
+  void SetServer(NiftyLinkTcpServer *server);
+
+  /// \brief Opens fileName, and starts playing from the beginning. Can be called again once playback has finished.
+  /// \throws std::logic_error if already playing, std::runtime_error if the file is not a valid recording.
+  void Start(const QString& fileName);
+
+  /// \brief Stops playing, and waits for the playback thread to finish. Safe to call repeatedly.
+  void Stop();
+
+  /// \brief Returns true from Start() until the end of the file is reached, or Stop() is called.
+  bool IsPlaying() const;
+
+  /// \brief Returns the number of messages delivered since Start().
+  quint64 GetNumberOfMessagesPlayed() const;
+
+  /// \brief Returns the statistics of how late (in nanoseconds) each message was delivered compared to its schedule.
+  NiftyLinkRunningStats GetLatenessStats() const;
+
+signals:
+
+  /// \brief Emitted from the playback thread for each message, Unpacked, just as NiftyLinkTcpClient::MessageReceived.
+  /// IMPORTANT: You must use a Qt::DirectConnection to connect to this, and not a Qt::QueuedConnection.
+  void MessagePlayed(niftk::NiftyLinkMessageContainer::Pointer message);
+
+  /// \brief Emitted from the playback thread when the end of the file is reached, or if Stop() was called.
+  void PlaybackFinished();
+
+private:
+
+  friend class NiftyLinkMessagePlayerThread;
+
+  /// \brief Called by NiftyLinkMessagePlayerThread::run().
+  void PlaybackLoop();
+
+  /// \brief Waits until clock reaches the deadline, spinning for the last bit if spin is true, returning false if Stop() was called.
+  bool WaitUntil(const QElapsedTimer& clock, const qint64& deadlineInNanoseconds, const bool& spin);
+
+  NiftyLinkRecordingReader         m_Reader;
+  NiftyLinkMessagePlayerThread    *m_Thread;
+  NiftyLinkTcpServer              *m_Server;
+  PlaybackMode                     m_PlaybackMode;
+  double                           m_Speed;
+  bool                             m_RestampMessages;
+  bool                             m_SpinWait;
+  quint64                          m_StartTime;
+
+  mutable QMutex                   m_Mutex;
+  QWaitCondition                   m_StopCondition;
+  bool                             m_IsPlaying;
+  bool                             m_StopRequested;
+  quint64                          m_NumberOfMessagesPlayed;
+  NiftyLinkRunningStats            m_LatenessStats;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkMessagePlayer_h
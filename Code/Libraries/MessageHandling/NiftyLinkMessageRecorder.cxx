@@ -0,0 +1,515 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkMessageRecorder.h"
+#include <NiftyLinkMacro.h>
+
+#include <igtl_header.h>
+#include <igtlTimeStamp.h>
+
+#include <QsLog.h>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtEndian>
+
+#include <cassert>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+namespace niftk
+{
+
+const char    NiftyLinkMessageRecorder::m_FILE_MAGIC[9] = "NIFTYREC";
+const char    NiftyLinkMessageRecorder::m_CHUNK_MAGIC[5] = "CHNK";
+const quint32 NiftyLinkMessageRecorder::m_FORMAT_VERSION(1);
+const int     NiftyLinkMessageRecorder::m_FILE_HEADER_SIZE(32);
+const int     NiftyLinkMessageRecorder::m_CHUNK_HEADER_SIZE(32);
+const int     NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE(24);
+
+// Payloads bigger than this bypass the staging buffer, and are written directly.
+static const int NIFTYLINK_RECORDER_DIRECT_WRITE_THRESHOLD = 65536;
+
+//-----------------------------------------------------------------------------
+static void AppendLittleEndian(QByteArray& buffer, const quint64& value)
+{
+  uchar bytes[8];
+  qToLittleEndian<quint64>(value, bytes);
+  buffer.append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+
+//-----------------------------------------------------------------------------
+static void AppendLittleEndian(QByteArray& buffer, const quint32& value)
+{
+  uchar bytes[4];
+  qToLittleEndian<quint32>(value, bytes);
+  buffer.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+
+//-----------------------------------------------------------------------------
+static int GetPaddingSize(const int& numberOfBytes)
+{
+  return (8 - (numberOfBytes % 8)) % 8;
+}
+
+
+/**
+* \class NiftyLinkMessageRecorderThread
+* \brief Private thread that runs NiftyLinkMessageRecorder::WriterLoop().
+*/
+class NiftyLinkMessageRecorderThread : public QThread
+{
+public:
+  NiftyLinkMessageRecorderThread(NiftyLinkMessageRecorder *recorder)
+  : m_Recorder(recorder)
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    m_Recorder->WriterLoop();
+  }
+
+private:
+  NiftyLinkMessageRecorder *m_Recorder;
+};
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageRecorder::NiftyLinkMessageRecorder(QObject *parent)
+: QObject(parent)
+, m_Thread(NULL)
+, m_ChunkSize(4 * 1024 * 1024)
+, m_FlushInterval(250)
+, m_MaximumQueuedBytes(512 * 1024 * 1024)
+, m_PreallocationSize(0)
+, m_PreallocatedUpTo(0)
+, m_QueuedBytes(0)
+, m_IsRecording(false)
+, m_StopRequested(false)
+, m_NumberOfMessagesWritten(0)
+, m_NumberOfBytesWritten(0)
+, m_NumberOfMessagesDropped(0)
+{
+  this->setObjectName("NiftyLinkMessageRecorder");
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageRecorder::~NiftyLinkMessageRecorder()
+{
+  this->Stop();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::SetChunkSize(const qint64& bytes)
+{
+  if (bytes <= 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Chunk size must be positive.");
+  }
+  QMutexLocker locker(&m_Mutex);
+  m_ChunkSize = bytes;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::SetFlushInterval(const int& msec)
+{
+  if (msec <= 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Flush interval must be positive.");
+  }
+  QMutexLocker locker(&m_Mutex);
+  m_FlushInterval = msec;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::SetMaximumQueuedBytes(const qint64& bytes)
+{
+  if (bytes <= 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Maximum queued bytes must be positive.");
+  }
+  QMutexLocker locker(&m_Mutex);
+  m_MaximumQueuedBytes = bytes;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::SetPreallocationSize(const qint64& bytes)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PreallocationSize = bytes < 0 ? 0 : bytes;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::Start(const QString& fileName)
+{
+  QMutexLocker locker(&m_Mutex);
+
+  if (m_IsRecording || m_Thread != NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::logic_error, << "Recorder is already recording to " << m_FileName.toStdString() << ".");
+  }
+
+  m_File.setFileName(fileName);
+  if (!m_File.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+  {
+    NiftyLinkStdExceptionMacro(std::runtime_error, << "Failed to open " << fileName.toStdString()
+                               << " for writing, error=" << m_File.errorString().toStdString() << ".");
+  }
+
+  m_FileName = fileName;
+  m_PreallocatedUpTo = 0;
+  m_QueuedBytes = 0;
+  m_Queue.clear();
+  m_NumberOfMessagesWritten = 0;
+  m_NumberOfBytesWritten = 0;
+  m_NumberOfMessagesDropped = 0;
+  m_Index.Clear();
+  QFile::remove(NiftyLinkRecordingIndex::GetIndexFileName(fileName));
+
+  igtl::TimeStamp::Pointer startTime = igtl::TimeStamp::New();
+  startTime->GetTime();
+
+  QByteArray header;
+  header.append(m_FILE_MAGIC, 8);
+  AppendLittleEndian(header, m_FORMAT_VERSION);
+  AppendLittleEndian(header, static_cast<quint32>(m_FILE_HEADER_SIZE));
+  AppendLittleEndian(header, static_cast<quint64>(startTime->GetTimeStampInNanoseconds()));
+  AppendLittleEndian(header, static_cast<quint64>(0));
+  assert(header.size() == m_FILE_HEADER_SIZE);
+
+  if (m_File.write(header) != header.size())
+  {
+    m_File.close();
+    NiftyLinkStdExceptionMacro(std::runtime_error, << "Failed to write header to " << fileName.toStdString() << ".");
+  }
+  m_NumberOfBytesWritten = header.size();
+
+  m_StagingBuffer.reserve(static_cast<int>(qMin(m_ChunkSize, static_cast<qint64>(NIFTYLINK_RECORDER_DIRECT_WRITE_THRESHOLD * 16))));
+  m_StopRequested = false;
+  m_IsRecording = true;
+
+  m_Thread = new NiftyLinkMessageRecorderThread(this);
+  m_Thread->start();
+
+  QLOG_INFO() << QObject::tr("%1::Start() - recording to %2.").arg(objectName()).arg(fileName);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::Stop()
+{
+  NiftyLinkMessageRecorderThread *thread = NULL;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_IsRecording = false;
+    m_StopRequested = true;
+    thread = m_Thread;
+    m_Thread = NULL;
+    m_WorkAvailable.wakeAll();
+  }
+
+  if (thread == NULL)
+  {
+    return;
+  }
+
+  // The writer drains the queue before exiting.
+  thread->wait();
+  delete thread;
+
+  const qint64 fileSize = m_File.size();
+  m_File.close();
+
+  // Only the writer thread touches the index, and it has finished. If a write failed,
+  // the index may refer to records that are not in the file, so the reader must rebuild it.
+  const QString indexFileName = NiftyLinkRecordingIndex::GetIndexFileName(m_FileName);
+
+  m_Index.Sort();
+  if (static_cast<quint64>(m_Index.GetNumberOfEntries()) != this->GetNumberOfMessagesWritten())
+  {
+    QLOG_WARN() << QObject::tr("%1::Stop() - recording %2 is incomplete, so not writing an index.").arg(objectName()).arg(m_FileName);
+  }
+  else if (!m_Index.Save(indexFileName, fileSize))
+  {
+    QLOG_WARN() << QObject::tr("%1::Stop() - failed to write index for %2, it will be rebuilt when read.").arg(objectName()).arg(m_FileName);
+  }
+  m_Index.Clear();
+
+  QLOG_INFO() << QObject::tr("%1::Stop() - wrote %2 messages, %3 bytes, dropped %4, to %5.")
+                 .arg(objectName())
+                 .arg(this->GetNumberOfMessagesWritten())
+                 .arg(this->GetNumberOfBytesWritten())
+                 .arg(this->GetNumberOfMessagesDropped())
+                 .arg(m_FileName);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessageRecorder::IsRecording() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_IsRecording;
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkMessageRecorder::GetFileName() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_FileName;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessageRecorder::Record(const quint64& timeArrived, const quint64& timeReceived,
+                                      const int& portNumber, const QByteArray& rawMessage)
+{
+  QueuedMessage message;
+  message.m_TimeArrived = timeArrived;
+  message.m_TimeReceived = timeReceived;
+  message.m_PortNumber = portNumber;
+  message.m_Bytes = rawMessage; // implicitly shared, so no copy.
+
+  QMutexLocker locker(&m_Mutex);
+
+  if (!m_IsRecording)
+  {
+    return false;
+  }
+
+  if (m_QueuedBytes + rawMessage.size() > m_MaximumQueuedBytes)
+  {
+    m_NumberOfMessagesDropped++;
+    return false;
+  }
+
+  m_Queue.push_back(message);
+  m_QueuedBytes += rawMessage.size();
+
+  if (m_QueuedBytes >= m_ChunkSize)
+  {
+    m_WorkAvailable.wakeOne();
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessageRecorder::Record(const NiftyLinkMessageContainer::Pointer& packedMessage)
+{
+  if (packedMessage.data() == NULL || packedMessage->GetMessage().IsNull())
+  {
+    return false;
+  }
+
+  igtl::MessageBase::Pointer message = packedMessage->GetMessage();
+  QByteArray rawMessage(static_cast<const char*>(message->GetPackPointer()), static_cast<int>(message->GetPackSize()));
+
+  return this->Record(packedMessage->GetTimeArrived(),
+                      packedMessage->GetTimeReceived(),
+                      packedMessage->GetSenderPortNumber(),
+                      rawMessage);
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageRecorder::GetNumberOfMessagesWritten() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_NumberOfMessagesWritten;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageRecorder::GetNumberOfBytesWritten() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_NumberOfBytesWritten;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageRecorder::GetNumberOfMessagesDropped() const
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_NumberOfMessagesDropped;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::WriterLoop()
+{
+  QVector<QueuedMessage> batch;
+  bool finished = false;
+
+  while (!finished)
+  {
+    {
+      QMutexLocker locker(&m_Mutex);
+
+      // Wait for a chunk's worth of data, or the flush interval, whichever is first.
+      if (!m_StopRequested && m_QueuedBytes < m_ChunkSize)
+      {
+        m_WorkAvailable.wait(&m_Mutex, m_FlushInterval);
+      }
+
+      finished = m_StopRequested;
+      batch.clear();
+      qSwap(batch, m_Queue);
+      m_QueuedBytes = 0;
+    }
+
+    if (batch.size() > 0 && !this->WriteChunks(batch))
+    {
+      return;
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessageRecorder::WriteChunks(const QVector<QueuedMessage>& batch)
+{
+  int chunkStart = 0;
+  while (chunkStart < batch.size())
+  {
+    // Work out how many records fit in this chunk. There is always at least one.
+    quint64 chunkPayloadSize = 0;
+    int chunkEnd = chunkStart;
+    do
+    {
+      const int messageSize = batch[chunkEnd].m_Bytes.size();
+      chunkPayloadSize += m_RECORD_HEADER_SIZE + messageSize + GetPaddingSize(messageSize);
+      chunkEnd++;
+    } while (chunkEnd < batch.size() && chunkPayloadSize < static_cast<quint64>(m_ChunkSize));
+
+    m_StagingBuffer.clear();
+    m_StagingBuffer.append(m_CHUNK_MAGIC, 4);
+    AppendLittleEndian(m_StagingBuffer, static_cast<quint32>(chunkEnd - chunkStart));
+    AppendLittleEndian(m_StagingBuffer, chunkPayloadSize);
+    AppendLittleEndian(m_StagingBuffer, batch[chunkStart].m_TimeArrived);
+    AppendLittleEndian(m_StagingBuffer, batch[chunkEnd - 1].m_TimeArrived);
+
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+    qint64 recordOffset = m_File.pos() + m_CHUNK_HEADER_SIZE;
+
+    for (int i = chunkStart; i < chunkEnd; i++)
+    {
+      const QueuedMessage& message = batch[i];
+      const int messageSize = message.m_Bytes.size();
+
+      m_Index.Append(message.m_TimeArrived, recordOffset,
+                     messageSize >= IGTL_HEADER_SIZE ? NiftyLinkRecordingIndex::GetDeviceName(message.m_Bytes.constData()) : QString());
+      recordOffset += m_RECORD_HEADER_SIZE + messageSize + GetPaddingSize(messageSize);
+
+      AppendLittleEndian(m_StagingBuffer, message.m_TimeArrived);
+      AppendLittleEndian(m_StagingBuffer, message.m_TimeReceived);
+      AppendLittleEndian(m_StagingBuffer, static_cast<quint32>(messageSize));
+      AppendLittleEndian(m_StagingBuffer, static_cast<quint32>(message.m_PortNumber));
+
+      if (messageSize > NIFTYLINK_RECORDER_DIRECT_WRITE_THRESHOLD)
+      {
+        // Large messages, eg. images, go straight from the queued buffer to disk.
+        if (!this->WriteBuffer(m_StagingBuffer.constData(), m_StagingBuffer.size())
+            || !this->WriteBuffer(message.m_Bytes.constData(), messageSize))
+        {
+          return false;
+        }
+        m_StagingBuffer.clear();
+      }
+      else
+      {
+        m_StagingBuffer.append(message.m_Bytes);
+      }
+      m_StagingBuffer.append(zeros, GetPaddingSize(messageSize));
+    }
+
+    if (m_StagingBuffer.size() > 0 && !this->WriteBuffer(m_StagingBuffer.constData(), m_StagingBuffer.size()))
+    {
+      return false;
+    }
+
+    {
+      QMutexLocker locker(&m_Mutex);
+      m_NumberOfMessagesWritten += (chunkEnd - chunkStart);
+      m_NumberOfBytesWritten += m_CHUNK_HEADER_SIZE + chunkPayloadSize;
+    }
+
+    chunkStart = chunkEnd;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkMessageRecorder::WriteBuffer(const char *data, const qint64& size)
+{
+  const qint64 position = m_File.pos();
+
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+  if (m_PreallocationSize > 0 && position + size > m_PreallocatedUpTo)
+  {
+    // Reserve space without changing the file size, so the file stays valid if we crash.
+    const qint64 length = qMax(m_PreallocationSize, size);
+    if (fallocate(m_File.handle(), FALLOC_FL_KEEP_SIZE, position, length) == 0)
+    {
+      m_PreallocatedUpTo = position + length;
+    }
+    else
+    {
+      QLOG_WARN() << QObject::tr("%1::WriteBuffer() - preallocation failed, continuing without.").arg(objectName());
+      m_PreallocationSize = 0;
+    }
+  }
+#endif
+
+  qint64 written = 0;
+  while (written < size)
+  {
+    qint64 result = m_File.write(data + written, size - written);
+    if (result <= 0)
+    {
+      this->ReportWriteFailure(QObject::tr("%1::WriteBuffer() - failed to write to %2 at offset %3, error=%4.")
+                               .arg(objectName()).arg(m_FileName).arg(position + written).arg(m_File.errorString()));
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorder::ReportWriteFailure(const QString& errorMessage)
+{
+  QLOG_ERROR() << errorMessage;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_IsRecording = false;
+    m_Queue.clear();
+    m_QueuedBytes = 0;
+  }
+  emit WriteFailed(errorMessage);
+}
+
+} // end namespace niftk
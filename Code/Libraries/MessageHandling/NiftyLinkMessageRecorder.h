@@ -0,0 +1,207 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkMessageRecorder_h
+#define NiftyLinkMessageRecorder_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+#include <NiftyLinkRecordingIndex.h>
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+namespace niftk
+{
+
+class NiftyLinkMessageRecorderThread;
+
+/**
+* \class NiftyLinkMessageRecorder
+* \brief Records raw OpenIGTLink messages, with NiftyLink's arrival and receive
+* timestamps, to an append-only binary file, for post-operative analysis and playback.
+*
+* Record() only copies a reference to the bytes onto an in-memory queue, under a short lock.
+* A background thread owned by this class drains the queue, and appends it to disk
+* in large sequential writes, so the calling thread (typically the network thread of
+* NiftyLinkTcpNetworkWorker) never blocks on disk. If the writer thread falls behind
+* by more than SetMaximumQueuedBytes(), further messages are dropped and counted,
+* rather than stalling the network.
+*
+* To record a connection, use NiftyLinkTcpClient::SetRecorder() or NiftyLinkTcpServer::SetRecorder().
+* OpenIGTLink's Unpack() converts byte order in-place, so by the time a NiftyLinkMessageContainer
+* is published, its pack no longer contains the bytes that came off the wire. The network worker
+* therefore takes its copy before unpacking.
+*
+* File format, all integers little-endian:
+* <pre>
+* File header, m_FILE_HEADER_SIZE bytes:
+*   char[8]  m_FILE_MAGIC
+*   uint32   m_FORMAT_VERSION
+*   uint32   m_FILE_HEADER_SIZE
+*   uint64   time recording started, nanoseconds since Unix Epoch
+*   uint64   reserved, zero
+*
+* Then zero or more chunks, each:
+*   char[4]  m_CHUNK_MAGIC
+*   uint32   number of records in this chunk
+*   uint64   number of bytes of records following this chunk header
+*   uint64   time arrived of first record
+*   uint64   time arrived of last record
+*   records, each:
+*     uint64   time arrived, nanoseconds since Unix Epoch
+*     uint64   time received, nanoseconds since Unix Epoch
+*     uint32   number of bytes of OpenIGTLink message, (header + body), as sent on the wire
+*     int32    sender port number
+*     bytes    the OpenIGTLink message, padded with zeros to a multiple of 8 bytes
+* </pre>
+* Small records are staged, and a chunk written in one go, but records bigger than 64 KB, (eg. images), are written
+* straight from the queue, so a chunk may take several writes. If the process dies part way through a chunk,
+* the chunk is cut short, and NiftyLinkRecordingReader stops there, so the file is readable up to the last complete chunk.
+*
+* The writer thread also keeps a NiftyLinkRecordingIndex of every record, which Stop() saves
+* to NiftyLinkRecordingIndex::GetIndexFileName(), for fast seeking by NiftyLinkRecordingReader.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessageRecorder : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /// \brief Equals "NIFTYREC", (8 bytes, no terminator in file).
+  static const char m_FILE_MAGIC[9];
+
+  /// \brief Equals "CHNK", (4 bytes, no terminator in file).
+  static const char m_CHUNK_MAGIC[5];
+
+  /// \brief Equals 1.
+  static const quint32 m_FORMAT_VERSION;
+
+  /// \brief Equals 32.
+  static const int m_FILE_HEADER_SIZE;
+
+  /// \brief Equals 32.
+  static const int m_CHUNK_HEADER_SIZE;
+
+  /// \brief Equals 24.
+  static const int m_RECORD_HEADER_SIZE;
+
+  /// \brief Constructor.
+  NiftyLinkMessageRecorder(QObject *parent = 0);
+
+  /// \brief Destructor, calls Stop().
+  virtual ~NiftyLinkMessageRecorder();
+
+  /// \brief Sets the target number of bytes per chunk, default 4MB. Must be called before Start().
+  void SetChunkSize(const qint64& bytes);
+
+  /// \brief Sets the maximum time in milliseconds that data sits in memory before being written, default 250.
+  void SetFlushInterval(const int& msec);
+
+  /// \brief Sets the maximum number of bytes waiting to be written, beyond which messages are dropped, default 512MB.
+  void SetMaximumQueuedBytes(const qint64& bytes);
+
+  /// \brief Sets the size of disk space reserved ahead of the writer, to reduce fragmentation
+  /// and file system metadata updates. Default 0, meaning off. Currently only effective on Linux.
+  void SetPreallocationSize(const qint64& bytes);
+
+  /// \brief Creates (or truncates) fileName, writes the file header and starts the writer thread.
+  /// \throws std::logic_error if already recording, std::runtime_error if the file cannot be written.
+  void Start(const QString& fileName);
+
+  /// \brief Writes everything that is queued, stops the writer thread, closes the file and writes the index. Safe to call repeatedly.
+  void Stop();
+
+  /// \brief Returns true between Start() and Stop().
+  bool IsRecording() const;
+
+  /// \brief Returns the file name passed to Start().
+  QString GetFileName() const;
+
+  /// \brief Queues a message for writing, and is safe to call from any thread.
+  /// \param rawMessage OpenIGTLink header and body exactly as sent on the wire.
+  /// \return false if not recording, or if the message was dropped because the queue is full.
+  bool Record(const quint64& timeArrived, const quint64& timeReceived,
+              const int& portNumber, const QByteArray& rawMessage);
+
+  /// \brief Convenience method to queue a message that has been Packed, but not Unpacked, such as one you are about to send.
+  /// This copies the pack, so for received messages, use NiftyLinkTcpClient::SetRecorder() instead.
+  bool Record(const NiftyLinkMessageContainer::Pointer& packedMessage);
+
+  /// \brief Returns the number of messages written to disk.
+  quint64 GetNumberOfMessagesWritten() const;
+
+  /// \brief Returns the number of bytes written to disk, including all headers.
+  quint64 GetNumberOfBytesWritten() const;
+
+  /// \brief Returns the number of messages dropped due to SetMaximumQueuedBytes().
+  quint64 GetNumberOfMessagesDropped() const;
+
+signals:
+
+  /// \brief Emitted from the writer thread if writing fails, after which recording stops accepting messages.
+  void WriteFailed(QString errorMessage);
+
+private:
+
+  friend class NiftyLinkMessageRecorderThread;
+
+  struct QueuedMessage
+  {
+    quint64    m_TimeArrived;
+    quint64    m_TimeReceived;
+    qint32     m_PortNumber;
+    QByteArray m_Bytes;
+  };
+
+  /// \brief Called by NiftyLinkMessageRecorderThread::run().
+  void WriterLoop();
+
+  /// \brief Writes a batch as one or more chunks, only called from writer thread.
+  bool WriteChunks(const QVector<QueuedMessage>& batch);
+
+  /// \brief Writes the buffer, preallocating as necessary, only called from writer thread.
+  bool WriteBuffer(const char *data, const qint64& size);
+
+  /// \brief Reports an error from the writer thread.
+  void ReportWriteFailure(const QString& errorMessage);
+
+  QString                          m_FileName;
+  QFile                            m_File;
+  NiftyLinkMessageRecorderThread  *m_Thread;
+
+  qint64                           m_ChunkSize;
+  int                              m_FlushInterval;
+  qint64                           m_MaximumQueuedBytes;
+  qint64                           m_PreallocationSize;
+  qint64                           m_PreallocatedUpTo;
+  QByteArray                       m_StagingBuffer;
+  NiftyLinkRecordingIndex          m_Index;
+
+  mutable QMutex                   m_Mutex;
+  QWaitCondition                   m_WorkAvailable;
+  QVector<QueuedMessage>           m_Queue;
+  qint64                           m_QueuedBytes;
+  bool                             m_IsRecording;
+  bool                             m_StopRequested;
+  quint64                          m_NumberOfMessagesWritten;
+  quint64                          m_NumberOfBytesWritten;
+  quint64                          m_NumberOfMessagesDropped;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkMessageRecorder_h
@@ -0,0 +1,295 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkRecordingIndex.h"
+
+#include <igtl_header.h>
+
+#include <QDataStream>
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+
+namespace niftk
+{
+
+const char    NiftyLinkRecordingIndex::m_INDEX_MAGIC[9] = "NIFTYIDX";
+const quint32 NiftyLinkRecordingIndex::m_INDEX_VERSION(1);
+
+//-----------------------------------------------------------------------------
+static bool EntryTimeLessThan(const NiftyLinkRecordingIndex::Entry& a, const NiftyLinkRecordingIndex::Entry& b)
+{
+  return a.m_TimeArrived < b.m_TimeArrived;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRecordingIndex::NiftyLinkRecordingIndex()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRecordingIndex::~NiftyLinkRecordingIndex()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkRecordingIndex::GetIndexFileName(const QString& recordingFileName)
+{
+  return recordingFileName + QString(".idx");
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkRecordingIndex::GetDeviceName(const char* rawMessage)
+{
+  // OpenIGTLink header: uint16 version, char[12] type, char[20] name, ... and name is not terminated if all 20 are used.
+  const char *name = rawMessage + 2 + IGTL_HEADER_TYPE_SIZE;
+  int length = 0;
+  while (length < IGTL_HEADER_NAME_SIZE && name[length] != '\0')
+  {
+    length++;
+  }
+  return QString::fromLatin1(name, length);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingIndex::Clear()
+{
+  m_Entries.clear();
+  m_DeviceNames.clear();
+  m_DeviceNumbers.clear();
+  m_EntriesPerDevice.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingIndex::Append(const quint64& timeArrived, const qint64& offset, const QString& deviceName)
+{
+  QHash<QString, int>::const_iterator iter = m_DeviceNumbers.find(deviceName);
+  int deviceNumber = 0;
+  if (iter == m_DeviceNumbers.end())
+  {
+    deviceNumber = m_DeviceNames.size();
+    m_DeviceNames.push_back(deviceName);
+    m_DeviceNumbers.insert(deviceName, deviceNumber);
+  }
+  else
+  {
+    deviceNumber = iter.value();
+  }
+
+  Entry entry;
+  entry.m_TimeArrived = timeArrived;
+  entry.m_Offset = offset;
+  entry.m_DeviceNumber = static_cast<quint32>(deviceNumber);
+  m_Entries.push_back(entry);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingIndex::Sort()
+{
+  // Messages from several connections can be recorded slightly out of order.
+  std::stable_sort(m_Entries.begin(), m_Entries.end(), EntryTimeLessThan);
+
+  m_EntriesPerDevice.clear();
+  m_EntriesPerDevice.resize(m_DeviceNames.size());
+  for (int i = 0; i < m_Entries.size(); i++)
+  {
+    m_EntriesPerDevice[m_Entries[i].m_DeviceNumber].push_back(i);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::GetNumberOfEntries() const
+{
+  return m_Entries.size();
+}
+
+
+//-----------------------------------------------------------------------------
+const NiftyLinkRecordingIndex::Entry& NiftyLinkRecordingIndex::GetEntry(const int& i) const
+{
+  return m_Entries[i];
+}
+
+
+//-----------------------------------------------------------------------------
+QStringList NiftyLinkRecordingIndex::GetDeviceNames() const
+{
+  return m_DeviceNames;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::GetDeviceNumber(const QString& deviceName) const
+{
+  return m_DeviceNumbers.value(deviceName, -1);
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::GetNumberOfEntries(const int& deviceNumber) const
+{
+  return m_EntriesPerDevice[deviceNumber].size();
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::GetEntryNumber(const int& deviceNumber, const int& i) const
+{
+  return m_EntriesPerDevice[deviceNumber][i];
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::LowerBound(const quint64& timeArrived) const
+{
+  Entry target;
+  target.m_TimeArrived = timeArrived;
+  return static_cast<int>(std::lower_bound(m_Entries.begin(), m_Entries.end(), target, EntryTimeLessThan) - m_Entries.begin());
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkRecordingIndex::LowerBound(const quint64& timeArrived, const int& deviceNumber) const
+{
+  // The per-device list is in time order too, so binary search it via the entries it refers to.
+  const QVector<int>& entries = m_EntriesPerDevice[deviceNumber];
+  int first = 0;
+  int count = entries.size();
+  while (count > 0)
+  {
+    int step = count / 2;
+    if (m_Entries[entries[first + step]].m_TimeArrived < timeArrived)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+  return first;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkRecordingIndex::Save(const QString& fileName, const qint64& recordingFileSize) const
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.writeRawData(m_INDEX_MAGIC, 8);
+  stream << m_INDEX_VERSION << recordingFileSize;
+
+  stream << static_cast<quint32>(m_DeviceNames.size());
+  for (int i = 0; i < m_DeviceNames.size(); i++)
+  {
+    stream << m_DeviceNames[i];
+  }
+
+  stream << static_cast<quint32>(m_Entries.size());
+  for (int i = 0; i < m_Entries.size(); i++)
+  {
+    stream << m_Entries[i].m_TimeArrived << m_Entries[i].m_Offset << m_Entries[i].m_DeviceNumber;
+  }
+
+  return stream.status() == QDataStream::Ok;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkRecordingIndex::Load(const QString& fileName, const qint64& recordingFileSize)
+{
+  this->Clear();
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setByteOrder(QDataStream::LittleEndian);
+
+  char magic[8];
+  quint32 version = 0;
+  qint64 indexedFileSize = 0;
+  if (stream.readRawData(magic, 8) != 8 || memcmp(magic, m_INDEX_MAGIC, 8) != 0)
+  {
+    return false;
+  }
+  stream >> version >> indexedFileSize;
+  if (version != m_INDEX_VERSION || indexedFileSize != recordingFileSize)
+  {
+    return false;
+  }
+
+  quint32 numberOfDevices = 0;
+  stream >> numberOfDevices;
+  for (quint32 i = 0; i < numberOfDevices && stream.status() == QDataStream::Ok; i++)
+  {
+    QString deviceName;
+    stream >> deviceName;
+    m_DeviceNumbers.insert(deviceName, m_DeviceNames.size());
+    m_DeviceNames.push_back(deviceName);
+  }
+
+  quint32 numberOfEntries = 0;
+  stream >> numberOfEntries;
+  if (stream.status() != QDataStream::Ok)
+  {
+    this->Clear();
+    return false;
+  }
+
+  // The count is checked against what is left of the file before reserving, as a corrupt count could be huge.
+  const qint64 entrySize = sizeof(quint64) + sizeof(qint64) + sizeof(quint32);
+  if (static_cast<qint64>(numberOfEntries) * entrySize != file.size() - file.pos())
+  {
+    this->Clear();
+    return false;
+  }
+
+  m_Entries.reserve(static_cast<int>(numberOfEntries));
+  for (quint32 i = 0; i < numberOfEntries; i++)
+  {
+    Entry entry;
+    stream >> entry.m_TimeArrived >> entry.m_Offset >> entry.m_DeviceNumber;
+    if (stream.status() != QDataStream::Ok
+        || entry.m_DeviceNumber >= numberOfDevices
+        || entry.m_Offset < 0
+        || entry.m_Offset >= recordingFileSize)
+    {
+      this->Clear();
+      return false;
+    }
+    m_Entries.push_back(entry);
+  }
+
+  this->Sort();
+  return true;
+}
+
+} // end namespace niftk
@@ -0,0 +1,126 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkRecordingIndex_h
+#define NiftyLinkRecordingIndex_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkRecordingIndex
+* \brief Maps arrival time and device name to the file offset of each record in a
+* file written by NiftyLinkMessageRecorder, so a reader can seek without scanning.
+*
+* NiftyLinkMessageRecorder builds the index as it writes, and saves it next to the
+* recording as a sidecar file, see GetIndexFileName(). If the sidecar is missing
+* or stale, (eg. the recording process died), NiftyLinkRecordingReader rebuilds
+* the index by walking the chunk and record headers.
+*
+* Sidecar format, written with QDataStream, little-endian:
+* <pre>
+*   char[8]  m_INDEX_MAGIC
+*   uint32   m_INDEX_VERSION
+*   int64    size of the recording file this index describes
+*   uint32   number of device names, then each as a QString
+*   uint32   number of entries, then each as uint64 time arrived, int64 offset, uint32 device number
+* </pre>
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkRecordingIndex
+{
+
+public:
+
+  /// \brief Equals "NIFTYIDX", (8 bytes, no terminator in file).
+  static const char m_INDEX_MAGIC[9];
+
+  /// \brief Equals 1.
+  static const quint32 m_INDEX_VERSION;
+
+  struct Entry
+  {
+    quint64 m_TimeArrived;
+    qint64  m_Offset;       // of the record header, from the start of the recording file.
+    quint32 m_DeviceNumber; // index into GetDeviceNames().
+  };
+
+  /// \brief Constructor.
+  NiftyLinkRecordingIndex();
+
+  /// \brief Destructor.
+  ~NiftyLinkRecordingIndex();
+
+  /// \brief Returns the sidecar file name for a recording, ie. recordingFileName + ".idx".
+  static QString GetIndexFileName(const QString& recordingFileName);
+
+  /// \brief Returns the OpenIGTLink device name from the header of a raw (wire order) message of at least IGTL_HEADER_SIZE bytes.
+  static QString GetDeviceName(const char* rawMessage);
+
+  /// \brief Removes all entries and device names.
+  void Clear();
+
+  /// \brief Adds an entry. Call Sort() once all entries are added.
+  void Append(const quint64& timeArrived, const qint64& offset, const QString& deviceName);
+
+  /// \brief Sorts entries by time arrived, (stable, so recorded order is kept for equal times), and builds the per-device lists.
+  void Sort();
+
+  /// \brief Returns the number of entries.
+  int GetNumberOfEntries() const;
+
+  /// \brief Returns the i-th entry, in time order.
+  const Entry& GetEntry(const int& i) const;
+
+  /// \brief Returns the device names, in order of first appearance.
+  QStringList GetDeviceNames() const;
+
+  /// \brief Returns the device number for deviceName, or -1 if it is not in the index.
+  int GetDeviceNumber(const QString& deviceName) const;
+
+  /// \brief Returns the number of entries for the given device.
+  int GetNumberOfEntries(const int& deviceNumber) const;
+
+  /// \brief Returns the entry number (for GetEntry()) of the i-th entry for the given device.
+  int GetEntryNumber(const int& deviceNumber, const int& i) const;
+
+  /// \brief Returns the first entry number whose time arrived is not before timeArrived, or GetNumberOfEntries(), in O(log n).
+  int LowerBound(const quint64& timeArrived) const;
+
+  /// \brief As LowerBound(timeArrived), but returns a position in the given device's list, or GetNumberOfEntries(deviceNumber).
+  int LowerBound(const quint64& timeArrived, const int& deviceNumber) const;
+
+  /// \brief Writes the index to fileName, recording recordingFileSize so a stale index can be detected.
+  /// \return false if the file cannot be written.
+  bool Save(const QString& fileName, const qint64& recordingFileSize) const;
+
+  /// \brief Reads the index from fileName.
+  /// \return false, leaving the index empty, if the file is missing, invalid or was not written for a recording of recordingFileSize bytes.
+  bool Load(const QString& fileName, const qint64& recordingFileSize);
+
+private:
+
+  QVector<Entry>         m_Entries;
+  QStringList            m_DeviceNames;
+  QHash<QString, int>    m_DeviceNumbers;
+  QVector< QVector<int> > m_EntriesPerDevice;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkRecordingIndex_h
@@ -0,0 +1,314 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkRecordingReader.h"
+#include <NiftyLinkMessageRecorder.h>
+#include <NiftyLinkMacro.h>
+
+#include <igtl_header.h>
+#include <igtlMessageHeader.h>
+#include <igtlMessageFactory.h>
+
+#include <QsLog.h>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkRecordingReader::NiftyLinkRecordingReader()
+: m_Data(NULL)
+, m_Size(0)
+, m_RecordingStartTime(0)
+, m_DeviceNumber(-1)
+, m_Position(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRecordingReader::~NiftyLinkRecordingReader()
+{
+  this->Close();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::Open(const QString& fileName)
+{
+  this->Close();
+
+  m_File.setFileName(fileName);
+  if (!m_File.open(QIODevice::ReadOnly))
+  {
+    NiftyLinkStdExceptionMacro(std::runtime_error, << "Failed to open " << fileName.toStdString()
+                               << ", error=" << m_File.errorString().toStdString() << ".");
+  }
+
+  m_Size = m_File.size();
+  if (m_Size < NiftyLinkMessageRecorder::m_FILE_HEADER_SIZE
+      || (m_Data = m_File.map(0, m_Size)) == NULL)
+  {
+    m_File.close();
+    m_Size = 0;
+    NiftyLinkStdExceptionMacro(std::runtime_error, << "Failed to map " << fileName.toStdString()
+                               << ", error=" << m_File.errorString().toStdString() << ".");
+  }
+
+  const char *header = reinterpret_cast<const char*>(m_Data);
+  if (memcmp(header, NiftyLinkMessageRecorder::m_FILE_MAGIC, 8) != 0)
+  {
+    this->Close();
+    NiftyLinkStdExceptionMacro(std::runtime_error, << fileName.toStdString() << " is not a NiftyLink recording.");
+  }
+
+  quint32 version = qFromLittleEndian<quint32>(m_Data + 8);
+  if (version != NiftyLinkMessageRecorder::m_FORMAT_VERSION)
+  {
+    this->Close();
+    NiftyLinkStdExceptionMacro(std::runtime_error, << fileName.toStdString() << " has unsupported version " << version << ".");
+  }
+
+  m_RecordingStartTime = qFromLittleEndian<quint64>(m_Data + 16);
+
+  if (!m_Index.Load(NiftyLinkRecordingIndex::GetIndexFileName(fileName), m_Size))
+  {
+    QLOG_INFO() << QObject::tr("NiftyLinkRecordingReader::Open() - no valid index for %1, rebuilding.").arg(fileName);
+    this->BuildIndex();
+  }
+
+  m_DeviceNumber = -1;
+  this->Rewind();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::Close()
+{
+  if (m_Data != NULL)
+  {
+    m_File.unmap(m_Data);
+    m_Data = NULL;
+  }
+  if (m_File.isOpen())
+  {
+    m_File.close();
+  }
+  m_Size = 0;
+  m_RecordingStartTime = 0;
+  m_Index.Clear();
+  m_DeviceNumber = -1;
+  m_Position = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkRecordingReader::IsOpen() const
+{
+  return m_Data != NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkRecordingReader::GetRecordingStartTime() const
+{
+  return m_RecordingStartTime;
+}
+
+
+//-----------------------------------------------------------------------------
+const NiftyLinkRecordingIndex& NiftyLinkRecordingReader::GetIndex() const
+{
+  return m_Index;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::SetDeviceFilter(const QString& deviceName)
+{
+  if (deviceName.isEmpty())
+  {
+    m_DeviceNumber = -1;
+  }
+  else
+  {
+    int deviceNumber = m_Index.GetDeviceNumber(deviceName);
+    if (deviceNumber < 0)
+    {
+      NiftyLinkStdExceptionMacro(std::invalid_argument, << "Recording has no messages from device " << deviceName.toStdString() << ".");
+    }
+    m_DeviceNumber = deviceNumber;
+  }
+  this->Rewind();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::Rewind()
+{
+  m_Position = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::SeekToTime(const quint64& timeArrived)
+{
+  if (m_DeviceNumber < 0)
+  {
+    m_Position = m_Index.LowerBound(timeArrived);
+  }
+  else
+  {
+    m_Position = m_Index.LowerBound(timeArrived, m_DeviceNumber);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkRecordingReader::BuildIndex()
+{
+  m_Index.Clear();
+
+  qint64 chunkOffset = NiftyLinkMessageRecorder::m_FILE_HEADER_SIZE;
+  while (chunkOffset + NiftyLinkMessageRecorder::m_CHUNK_HEADER_SIZE <= m_Size)
+  {
+    const uchar *chunk = m_Data + chunkOffset;
+    if (memcmp(chunk, NiftyLinkMessageRecorder::m_CHUNK_MAGIC, 4) != 0)
+    {
+      QLOG_WARN() << QObject::tr("NiftyLinkRecordingReader::BuildIndex() - %1 is corrupt at offset %2.")
+                     .arg(m_File.fileName()).arg(chunkOffset);
+      break;
+    }
+
+    quint32 numberOfRecords = qFromLittleEndian<quint32>(chunk + 4);
+    quint64 payloadSize = qFromLittleEndian<quint64>(chunk + 8);
+    qint64 recordOffset = chunkOffset + NiftyLinkMessageRecorder::m_CHUNK_HEADER_SIZE;
+    qint64 endOfChunk = recordOffset + static_cast<qint64>(payloadSize);
+
+    // A chunk that runs off the end of the file was not completely written.
+    if (endOfChunk > m_Size)
+    {
+      QLOG_WARN() << QObject::tr("NiftyLinkRecordingReader::BuildIndex() - %1 is truncated at offset %2.")
+                     .arg(m_File.fileName()).arg(chunkOffset);
+      break;
+    }
+
+    for (quint32 i = 0; i < numberOfRecords && recordOffset + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE <= endOfChunk; i++)
+    {
+      const uchar *record = m_Data + recordOffset;
+      quint64 timeArrived = qFromLittleEndian<quint64>(record);
+      quint32 messageSize = qFromLittleEndian<quint32>(record + 16);
+
+      // A record that runs off the end of its chunk is corrupt, and so is everything after it in the chunk.
+      if (recordOffset + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE + static_cast<qint64>(messageSize) > endOfChunk)
+      {
+        QLOG_WARN() << QObject::tr("NiftyLinkRecordingReader::BuildIndex() - %1 has a corrupt record at offset %2.")
+                       .arg(m_File.fileName()).arg(recordOffset);
+        break;
+      }
+
+      m_Index.Append(timeArrived, recordOffset,
+                     messageSize >= IGTL_HEADER_SIZE
+                     ? NiftyLinkRecordingIndex::GetDeviceName(reinterpret_cast<const char*>(record) + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE)
+                     : QString());
+
+      recordOffset += NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE + messageSize + (8 - (messageSize % 8)) % 8;
+    }
+    chunkOffset = endOfChunk;
+  }
+
+  m_Index.Sort();
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkRecordingReader::ReadNext(quint64& timeArrived, quint64& timeReceived, int& portNumber, QByteArray& rawMessage)
+{
+  if (m_Data == NULL)
+  {
+    return false;
+  }
+
+  int entryNumber = 0;
+  if (m_DeviceNumber < 0)
+  {
+    if (m_Position >= m_Index.GetNumberOfEntries())
+    {
+      return false;
+    }
+    entryNumber = m_Position;
+  }
+  else
+  {
+    if (m_Position >= m_Index.GetNumberOfEntries(m_DeviceNumber))
+    {
+      return false;
+    }
+    entryNumber = m_Index.GetEntryNumber(m_DeviceNumber, m_Position);
+  }
+
+  const qint64 offset = m_Index.GetEntry(entryNumber).m_Offset;
+  if (offset + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE > m_Size)
+  {
+    return false;
+  }
+
+  const uchar *record = m_Data + offset;
+  timeArrived = qFromLittleEndian<quint64>(record);
+  timeReceived = qFromLittleEndian<quint64>(record + 8);
+  quint32 messageSize = qFromLittleEndian<quint32>(record + 16);
+  portNumber = static_cast<qint32>(qFromLittleEndian<quint32>(record + 20));
+
+  if (offset + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE + static_cast<qint64>(messageSize) > m_Size)
+  {
+    return false;
+  }
+
+  rawMessage = QByteArray::fromRawData(reinterpret_cast<const char*>(record) + NiftyLinkMessageRecorder::m_RECORD_HEADER_SIZE,
+                                       static_cast<int>(messageSize));
+  m_Position++;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::MessageBase::Pointer NiftyLinkRecordingReader::CreateMessage(const char* rawMessage, const qint64& numberOfBytes)
+{
+  if (rawMessage == NULL || numberOfBytes < IGTL_HEADER_SIZE)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Too few bytes (" << numberOfBytes << ") for an OpenIGTLink header.");
+  }
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), rawMessage, IGTL_HEADER_SIZE);
+  header->Unpack();
+
+  qint64 bodySize = static_cast<qint64>(header->GetBodySizeToRead());
+  if (IGTL_HEADER_SIZE + bodySize != numberOfBytes)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "OpenIGTLink header says body is " << bodySize
+                               << " bytes, but " << numberOfBytes - IGTL_HEADER_SIZE << " are available.");
+  }
+
+  // The factory sets the header on the message and calls AllocatePack().
+  igtl::MessageFactory::Pointer messageFactory = igtl::MessageFactory::New();
+  igtl::MessageBase::Pointer message = messageFactory->GetMessage(header);
+
+  // Restore the header in network byte order, so the pack is exactly what was on the wire.
+  memcpy(message->GetPackPointer(), rawMessage, numberOfBytes);
+
+  return message;
+}
+
+} // end namespace niftk
@@ -0,0 +1,115 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkRecordingReader_h
+#define NiftyLinkRecordingReader_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkRecordingIndex.h>
+
+#include <igtlMessageBase.h>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkRecordingReader
+* \brief Reads files written by NiftyLinkMessageRecorder, in time order, with random
+* access by time and by device name.
+*
+* The file is memory mapped, and ReadNext() returns the message bytes without copying.
+* On Open(), the NiftyLinkRecordingIndex written by the recorder is loaded, or if it is
+* missing or stale, rebuilt by walking the chunk and record headers, which only touches
+* a few bytes per message. SeekToTime() is then a binary search, O(log n).
+*
+* Note: Error handling strategy is to throw std::exception sub-classes for a file that
+* cannot be opened, or is not a recording. A truncated file, (eg. the recording process died),
+* is not an error, and reading simply stops at the last complete chunk.
+*
+* On 32 bit systems, a recording must fit in the address space to be mapped.
+*
+* This class is not thread safe, so use one instance per thread.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkRecordingReader
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkRecordingReader();
+
+  /// \brief Destructor, closes the file.
+  ~NiftyLinkRecordingReader();
+
+  /// \brief Opens and maps fileName, checks the file header, and loads or rebuilds the index.
+  /// \throws std::runtime_error if the file cannot be read or mapped, or is not a recording.
+  void Open(const QString& fileName);
+
+  /// \brief Closes the file, after which any rawMessage returned by ReadNext() is invalid.
+  void Close();
+
+  /// \brief Returns true if Open() succeeded, and Close() has not been called.
+  bool IsOpen() const;
+
+  /// \brief Returns the time the recording was started, in nanoseconds since Unix Epoch.
+  quint64 GetRecordingStartTime() const;
+
+  /// \brief Returns the index, which is only valid while the file is open.
+  const NiftyLinkRecordingIndex& GetIndex() const;
+
+  /// \brief Restricts ReadNext() to messages with the given OpenIGTLink device name, or all messages if deviceName is empty.
+  /// Also moves back to the first message.
+  /// \throws std::invalid_argument if there are no messages from deviceName.
+  void SetDeviceFilter(const QString& deviceName);
+
+  /// \brief Moves back to the first message.
+  void Rewind();
+
+  /// \brief Moves to the first message that arrived at or after timeArrived, in nanoseconds since Unix Epoch.
+  void SeekToTime(const quint64& timeArrived);
+
+  /// \brief Reads the next message.
+  /// \param rawMessage is set to the OpenIGTLink header and body as originally sent on the wire.
+  /// This refers directly to the mapped file, (see QByteArray::fromRawData()), so is only valid until
+  /// Close(), and must not be modified. Copy it, (eg. with CreateMessage()), to keep it longer.
+  /// \return false at the end of the file, or if the rest of the file is incomplete.
+  bool ReadNext(quint64& timeArrived, quint64& timeReceived, int& portNumber, QByteArray& rawMessage);
+
+  /// \brief Creates an OpenIGTLink message from raw bytes, as returned by ReadNext().
+  ///
+  /// The message pack holds the bytes exactly as given, in network byte order, ready to send.
+  /// The header fields (device type, device name, etc) are set, but the message is not Unpacked,
+  /// so call Unpack() before reading the body, (and note that Unpack() converts the pack byte order in-place).
+  /// \throws std::invalid_argument if the bytes are not a complete OpenIGTLink message.
+  static igtl::MessageBase::Pointer CreateMessage(const char* rawMessage, const qint64& numberOfBytes);
+
+private:
+
+  /// \brief Walks the chunk and record headers to fill m_Index, stopping at the first incomplete chunk.
+  void BuildIndex();
+
+  QFile                    m_File;
+  uchar                   *m_Data;
+  qint64                   m_Size;
+  quint64                  m_RecordingStartTime;
+  NiftyLinkRecordingIndex  m_Index;
+  int                      m_DeviceNumber;
+  int                      m_Position;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkRecordingReader_h
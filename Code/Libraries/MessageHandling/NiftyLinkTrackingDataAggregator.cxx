@@ -0,0 +1,175 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkTrackingDataAggregator.h"
+#include <NiftyLinkMacro.h>
+
+#include <QsLog.h>
+
+#include <cassert>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkTrackingDataAggregator::NiftyLinkTrackingDataAggregator(const QString& deviceName,
+                                                                 const QString& hostName,
+                                                                 const int& portNumber)
+: m_DeviceName(deviceName)
+, m_HostName(hostName)
+, m_PortNumber(portNumber)
+, m_TimeWindow(1000000)
+, m_MaximumNumberOfElements(32)
+, m_Message(NULL)
+, m_FirstTime(0)
+, m_NumberOfMessagesBeforeAggregation(0)
+, m_NumberOfMessagesAfterAggregation(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTrackingDataAggregator::~NiftyLinkTrackingDataAggregator()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataAggregator::SetTimeWindow(const igtlUint64& nanoseconds)
+{
+  m_TimeWindow = nanoseconds;
+}
+
+
+//-----------------------------------------------------------------------------
+igtlUint64 NiftyLinkTrackingDataAggregator::GetTimeWindow() const
+{
+  return m_TimeWindow;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataAggregator::SetMaximumNumberOfElements(const int& numberOfElements)
+{
+  if (numberOfElements < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Maximum number of elements must be at least 1.");
+  }
+  m_MaximumNumberOfElements = numberOfElements;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkTrackingDataAggregator::GetMaximumNumberOfElements() const
+{
+  return m_MaximumNumberOfElements;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageContainer::Pointer NiftyLinkTrackingDataAggregator::AddElement(const QString& toolName,
+                                                                              const igtl::Matrix4x4& matrix,
+                                                                              const igtl::TimeStamp::Pointer& timeStamp)
+{
+  const igtlUint64 time = timeStamp->GetTimeStampInNanoseconds();
+
+  // The new element starts the next group, if it's too late, (or too early, if the clock went backwards), or a repeated tool.
+  NiftyLinkMessageContainer::Pointer result;
+  if (m_Message.IsNotNull())
+  {
+    const igtlUint64 difference = time > m_FirstTime ? time - m_FirstTime : m_FirstTime - time;
+    if (difference >= m_TimeWindow || m_ToolNames.contains(toolName))
+    {
+      result = this->Flush();
+    }
+  }
+
+  if (m_Message.IsNull())
+  {
+    m_Message = igtl::TrackingDataMessage::New();
+    m_Message->SetDeviceName(m_DeviceName.toStdString().c_str());
+    m_FirstTime = time;
+  }
+
+  igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+  element->SetMatrix(*(const_cast<igtl::Matrix4x4*>(&matrix)));
+  element->SetName(toolName.toStdString().c_str());
+  m_Message->AddTrackingDataElement(element);
+  m_ToolNames.append(toolName);
+
+  m_NumberOfMessagesBeforeAggregation++;
+
+  // A new group only reaches the maximum straight away if the maximum is 1, and then there was no previous group.
+  if (m_Message->GetNumberOfTrackingDataElements() >= m_MaximumNumberOfElements)
+  {
+    assert(result.data() == NULL);
+    result = this->Flush();
+  }
+
+  return result;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageContainer::Pointer NiftyLinkTrackingDataAggregator::Flush()
+{
+  NiftyLinkMessageContainer::Pointer m;
+  if (m_Message.IsNull())
+  {
+    return m;
+  }
+
+  igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+  timeCreated->SetTimeInNanoseconds(m_FirstTime);
+
+  m_Message->SetTimeStamp(timeCreated);
+  m_Message->Pack();
+
+  m = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+  m->SetMessage(m_Message.GetPointer());
+  m->SetOwnerName(m_DeviceName);
+  m->SetSenderHostName(m_HostName);
+  m->SetSenderPortNumber(m_PortNumber);
+  m->SetTimeArrived(timeCreated);
+  m->SetTimeReceived(timeCreated);
+
+  m_Message = NULL;
+  m_ToolNames.clear();
+  m_NumberOfMessagesAfterAggregation++;
+
+  return m;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkTrackingDataAggregator::GetNumberOfMessagesBeforeAggregation() const
+{
+  return m_NumberOfMessagesBeforeAggregation;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkTrackingDataAggregator::GetNumberOfMessagesAfterAggregation() const
+{
+  return m_NumberOfMessagesAfterAggregation;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataAggregator::OutputStats() const
+{
+  QLOG_INFO() << QObject::tr("NiftyLinkTrackingDataAggregator::OutputStats() - %1: messages before aggregation=%2, after=%3.")
+                 .arg(m_DeviceName)
+                 .arg(m_NumberOfMessagesBeforeAggregation)
+                 .arg(m_NumberOfMessagesAfterAggregation);
+}
+
+} // end namespace niftk
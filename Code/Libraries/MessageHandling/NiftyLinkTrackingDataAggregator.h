@@ -0,0 +1,108 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkTrackingDataAggregator_h
+#define NiftyLinkTrackingDataAggregator_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+
+#include <igtlTrackingDataMessage.h>
+#include <igtlTimeStamp.h>
+
+#include <QString>
+#include <QStringList>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkTrackingDataAggregator
+* \brief Sender side aggregation of tracking data, so that a tracker with many tools
+* sends one TDATA message per frame, rather than one per tool.
+*
+* Instead of calling CreateTrackingDataMessage() for each tool, call AddElement(), which collects
+* the tools, and returns a Packed TDATA message containing all of them, once the group is complete.
+* A group is complete when the next element is measured outside GetTimeWindow() of the first,
+* or is a tool already in the group, (ie. the next tracker frame), or when the group reaches
+* GetMaximumNumberOfElements(). Call Flush() to send a partial group, eg. from a QTimer, or when the
+* tracker has reported all its tools.
+*
+* OpenIGTLink TDATA has one time stamp per message, not per element, so the message is given the time
+* stamp of the first element. So, each tool's time stamp, as seen by the receiver, is within
+* GetTimeWindow() of the original, and is exact for trackers that stamp all tools in a frame with one time.
+* The receiver can use SplitTrackingDataMessage() to get one message per tool again.
+*
+* One aggregator should be used per tracker, and it is not thread safe.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkTrackingDataAggregator
+{
+
+public:
+
+  /// \brief Constructor, where the arguments are as for CreateTrackingDataMessage().
+  NiftyLinkTrackingDataAggregator(const QString& deviceName, const QString& hostName, const int& portNumber);
+
+  /// \brief Destructor.
+  ~NiftyLinkTrackingDataAggregator();
+
+  /// \brief Sets the time window, default 1ms.
+  void SetTimeWindow(const igtlUint64& nanoseconds);
+
+  /// \brief Returns the time window, in nanoseconds.
+  igtlUint64 GetTimeWindow() const;
+
+  /// \brief Sets the maximum number of elements in one message, default 32.
+  /// \throws std::invalid_argument if numberOfElements is less than 1.
+  void SetMaximumNumberOfElements(const int& numberOfElements);
+
+  /// \brief Returns the maximum number of elements in one message.
+  int GetMaximumNumberOfElements() const;
+
+  /// \brief Adds the matrix for one tool, measured at timeStamp, which is copied.
+  /// \return a Packed TDATA message ready to send, if a group was completed, or NULL.
+  NiftyLinkMessageContainer::Pointer AddElement(const QString& toolName,
+                                                const igtl::Matrix4x4& matrix,
+                                                const igtl::TimeStamp::Pointer& timeStamp);
+
+  /// \brief Returns a Packed TDATA message containing any elements added since the last message, or NULL if there are none.
+  NiftyLinkMessageContainer::Pointer Flush();
+
+  /// \brief Returns the number of elements passed to AddElement(), ie. the number
+  /// of messages there would have been without aggregation.
+  quint64 GetNumberOfMessagesBeforeAggregation() const;
+
+  /// \brief Returns the number of messages returned by AddElement() and Flush().
+  quint64 GetNumberOfMessagesAfterAggregation() const;
+
+  /// \brief Logs the above stats.
+  void OutputStats() const;
+
+private:
+
+  QString                              m_DeviceName;
+  QString                              m_HostName;
+  int                                  m_PortNumber;
+  igtlUint64                           m_TimeWindow;
+  int                                  m_MaximumNumberOfElements;
+
+  igtl::TrackingDataMessage::Pointer   m_Message;
+  QStringList                          m_ToolNames;
+  igtlUint64                           m_FirstTime;
+
+  quint64                              m_NumberOfMessagesBeforeAggregation;
+  quint64                              m_NumberOfMessagesAfterAggregation;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkTrackingDataAggregator_h
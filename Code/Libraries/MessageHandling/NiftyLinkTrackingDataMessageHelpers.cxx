@@ -14,6 +14,9 @@
 #include <NiftyLinkMacro.h>
 #include <NiftyLinkUtils.h>
 
+#include <QtEndian>
+
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -22,6 +25,12 @@
 namespace niftk
 {
 
+// Within each element of the TDATA body, the 12 floats of the transform come after the name, type and a reserved byte.
+static const int NIFTYLINK_TDATA_TRANSFORM_OFFSET = IGTL_TDATA_LEN_NAME + 2;
+
+// Element stride in the names array, including the null.
+static const int NIFTYLINK_TDATA_NAME_STRIDE = IGTL_TDATA_LEN_NAME + 1;
+
 //-----------------------------------------------------------------------------
 void InitialiseTrackingDataWithTestData(const igtl::Matrix4x4& testMatrix, igtl::TrackingDataMessage::Pointer& messageToWriteTo)
 {
@@ -232,4 +241,199 @@ NiftyLinkMessageContainer::Pointer CreateTrackingDataMessageWithRandomData(
   return m;
 }
 
+
+//-----------------------------------------------------------------------------
+QList<NiftyLinkMessageContainer::Pointer> SplitTrackingDataMessage(const NiftyLinkMessageContainer::Pointer& message)
+{
+  if (message.data() == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Message container is NULL.");
+  }
+
+  igtl::TrackingDataMessage::Pointer trackingData = dynamic_cast<igtl::TrackingDataMessage*>(message->GetMessage().GetPointer());
+  if (trackingData.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Message container does not contain a TDATA message.");
+  }
+
+  igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+  trackingData->GetTimeStamp(timeCreated);
+
+  QList<NiftyLinkMessageContainer::Pointer> result;
+  for (int i = 0; i < trackingData->GetNumberOfTrackingDataElements(); i++)
+  {
+    igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+    trackingData->GetTrackingDataElement(i, element);
+
+    igtl::TrackingDataMessage::Pointer msg = igtl::TrackingDataMessage::New();
+    msg->SetDeviceName(trackingData->GetDeviceName());
+    msg->AddTrackingDataElement(element);
+    msg->SetTimeStamp(timeCreated);
+    msg->Pack();
+
+    // The copy constructor copies the times, sender and owner, and we then replace the message.
+    NiftyLinkMessageContainer::Pointer m(new NiftyLinkMessageContainer(*message));
+    m->SetMessage(msg.GetPointer());
+    result.append(m);
+  }
+
+  return result;
+}
+
+
+//-----------------------------------------------------------------------------
+int GetTrackingDataArrays(const igtl::TrackingDataMessage::Pointer& message,
+                          const int& maximumNumberOfElements,
+                          float* positions,
+                          float* rotations,
+                          char* names)
+{
+  if (message.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Tracking data message is NULL.");
+  }
+  if (positions == NULL || rotations == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Output arrays are NULL.");
+  }
+
+  const int n = maximumNumberOfElements;
+
+  // Unpack() converts the body to host byte order in place, and fills in the elements, as does building
+  // a message before Pack(), so if there are elements, they hold the poses, and the body can't be trusted.
+  const int numberOfUnpackedElements = message->GetNumberOfTrackingDataElements();
+  if (numberOfUnpackedElements > 0)
+  {
+    const int numberToCopy = qMin(numberOfUnpackedElements, maximumNumberOfElements);
+    igtl::TrackingDataElement::Pointer element;
+    igtl::Matrix4x4 matrix;
+
+    for (int i = 0; i < numberToCopy; i++)
+    {
+      message->GetTrackingDataElement(i, element);
+      element->GetMatrix(matrix);
+
+      for (int r = 0; r < 3; r++)
+      {
+        positions[r * n + i] = matrix[r][3];
+        for (int c = 0; c < 3; c++)
+        {
+          rotations[(3 * r + c) * n + i] = matrix[r][c];
+        }
+      }
+
+      if (names != NULL)
+      {
+        char *name = names + i * NIFTYLINK_TDATA_NAME_STRIDE;
+        strncpy(name, element->GetName(), IGTL_TDATA_LEN_NAME);
+        name[IGTL_TDATA_LEN_NAME] = '\0';
+      }
+    }
+    return numberOfUnpackedElements;
+  }
+
+  // Otherwise, it is a received message not yet Unpacked, (or not Packed, so has no body).
+  const int bodySize = static_cast<int>(message->GetPackBodySize());
+  if (bodySize <= 0)
+  {
+    return 0;
+  }
+
+  const int numberOfElements = bodySize / IGTL_TDATA_ELEMENT_SIZE;
+  const int numberToDecode = qMin(numberOfElements, maximumNumberOfElements);
+  const uchar *body = static_cast<const uchar*>(message->GetPackBodyPointer());
+
+  // OpenIGTLink stores the transform in network byte order, column by column, with the position last.
+  for (int i = 0; i < numberToDecode; i++)
+  {
+    const uchar *element = body + i * IGTL_TDATA_ELEMENT_SIZE;
+    const uchar *transform = element + NIFTYLINK_TDATA_TRANSFORM_OFFSET;
+
+    for (int c = 0; c < 4; c++)
+    {
+      for (int r = 0; r < 3; r++)
+      {
+        const quint32 bits = qFromBigEndian<quint32>(transform + 4 * (3 * c + r));
+        float value;
+        memcpy(&value, &bits, sizeof(float));
+
+        if (c < 3)
+        {
+          rotations[(3 * r + c) * n + i] = value;
+        }
+        else
+        {
+          positions[r * n + i] = value;
+        }
+      }
+    }
+
+    if (names != NULL)
+    {
+      char *name = names + i * NIFTYLINK_TDATA_NAME_STRIDE;
+      memcpy(name, element, IGTL_TDATA_LEN_NAME);
+      name[IGTL_TDATA_LEN_NAME] = '\0';
+    }
+  }
+
+  return numberOfElements;
+}
+
+
+//-----------------------------------------------------------------------------
+void SetTrackingDataArrays(igtl::TrackingDataMessage::Pointer& message,
+                           const int& numberOfElements,
+                           const float* positions,
+                           const float* rotations,
+                           const char* names)
+{
+  if (message.IsNull())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Tracking data message is NULL.");
+  }
+  if (positions == NULL || rotations == NULL)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Input arrays are NULL.");
+  }
+  if (numberOfElements < 0)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Number of elements is negative.");
+  }
+
+  if (message->GetNumberOfTrackingDataElements() != numberOfElements)
+  {
+    message->ClearTrackingDataElements();
+    for (int i = 0; i < numberOfElements; i++)
+    {
+      igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+      message->AddTrackingDataElement(element);
+    }
+  }
+
+  const int n = numberOfElements;
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+
+  igtl::TrackingDataElement::Pointer element;
+  for (int i = 0; i < numberOfElements; i++)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        matrix[r][c] = rotations[(3 * r + c) * n + i];
+      }
+      matrix[r][3] = positions[r * n + i];
+    }
+
+    message->GetTrackingDataElement(i, element);
+    element->SetMatrix(matrix);
+
+    if (names != NULL)
+    {
+      element->SetName(names + i * NIFTYLINK_TDATA_NAME_STRIDE);
+    }
+  }
+}
+
 } // end namespace niftk
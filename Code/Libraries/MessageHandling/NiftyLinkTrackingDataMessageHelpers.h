@@ -16,7 +16,9 @@
 #include <NiftyLinkMessageContainer.h>
 
 #include <igtlTrackingDataMessage.h>
+#include <igtl_tdata.h>
 
+#include <QList>
 #include <QString>
 
 /**
@@ -95,6 +97,49 @@ extern "C++" NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessageContainer::Pointer Create
                                                                                                     const QString& hostName,
                                                                                                     const int& portNumber,
                                                                                                     const double* input);
+
+/// \brief Splits a TDATA message with many elements, (eg. from NiftyLinkTrackingDataAggregator), into one Packed
+/// TDATA message per element, each with the device name and time stamp of the original message, and a copy of
+/// the original container's times, sender and owner, so they can be handled as if they arrived separately.
+/// \throws std::invalid_argument if message is NULL or does not contain a TDATA message.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT QList<NiftyLinkMessageContainer::Pointer> SplitTrackingDataMessage(
+    const NiftyLinkMessageContainer::Pointer& message);
+
+/// \brief Decodes the poses of all elements of a TDATA message into caller provided arrays, with no allocation,
+/// for code that processes many poses and only needs the numbers.
+///
+/// A message built here, or received and Unpacked, (whose body OpenIGTLink has converted to host byte order),
+/// is decoded from its elements. A received message not yet Unpacked is decoded straight from its body.
+///
+/// The arrays have a structure-of-arrays layout, where n is maximumNumberOfElements:
+/// <pre>
+///   positions[i], positions[n + i], positions[2n + i]  = x, y, z of element i, (ie. matrix[0..2][3])
+///   rotations[(3r + c)n + i]                           = matrix[r][c] of element i, for r, c in 0..2
+///   names + i * (IGTL_TDATA_LEN_NAME + 1)              = null terminated name of element i
+/// </pre>
+/// \param positions array of 3 * maximumNumberOfElements floats.
+/// \param rotations array of 9 * maximumNumberOfElements floats.
+/// \param names array of maximumNumberOfElements * (IGTL_TDATA_LEN_NAME + 1) chars, or NULL if names are not needed.
+/// \return the number of elements in the message, of which at most maximumNumberOfElements are decoded.
+/// \throws std::invalid_argument if message is NULL, or positions or rotations are NULL.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT int GetTrackingDataArrays(const igtl::TrackingDataMessage::Pointer& message,
+                                                                 const int& maximumNumberOfElements,
+                                                                 float* positions,
+                                                                 float* rotations,
+                                                                 char* names);
+
+/// \brief Sets the poses of numberOfElements elements of a TDATA message from arrays laid out as for GetTrackingDataArrays(),
+/// (where n is numberOfElements), and the caller must then Pack() the message.
+///
+/// If the message already has numberOfElements elements, they are updated in place, so re-using one
+/// message for each frame from a tracker does not allocate. Otherwise the elements are replaced.
+/// \param names as for GetTrackingDataArrays(), or NULL to keep the names of existing elements.
+/// \throws std::invalid_argument if message is NULL, positions or rotations are NULL, or numberOfElements is negative.
+extern "C++" NIFTYLINKCOMMON_WINEXPORT void SetTrackingDataArrays(igtl::TrackingDataMessage::Pointer& message,
+                                                                  const int& numberOfElements,
+                                                                  const float* positions,
+                                                                  const float* rotations,
+                                                                  const char* names);
 ///@}
 
 } // end namespace
@@ -0,0 +1,303 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkTrackingHistory.h"
+#include <NiftyLinkMacro.h>
+
+#include <igtlTrackingDataMessage.h>
+#include <igtlTransformMessage.h>
+
+#include <QThread>
+
+#include <cmath>
+
+namespace niftk
+{
+
+// Above this cosine of the angle between two rotations, slerp is replaced by normalised linear interpolation.
+static const double NIFTYLINK_SLERP_THRESHOLD = 0.9995;
+
+//-----------------------------------------------------------------------------
+static void Slerp(const float* q0, const float* q1, const double& alpha, float* q)
+{
+  double dot = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    dot += static_cast<double>(q0[i]) * q1[i];
+  }
+
+  // q and -q are the same rotation, so take the shorter way round.
+  double sign = 1;
+  if (dot < 0)
+  {
+    dot = -dot;
+    sign = -1;
+  }
+
+  double w0 = 1 - alpha;
+  double w1 = alpha;
+
+  if (dot < NIFTYLINK_SLERP_THRESHOLD)
+  {
+    const double theta = acos(dot);
+    const double sinTheta = sin(theta);
+    w0 = sin((1 - alpha) * theta) / sinTheta;
+    w1 = sin(alpha * theta) / sinTheta;
+  }
+  w1 *= sign;
+
+  double norm = 0;
+  double result[4];
+  for (int i = 0; i < 4; i++)
+  {
+    result[i] = w0 * q0[i] + w1 * q1[i];
+    norm += result[i] * result[i];
+  }
+  norm = sqrt(norm);
+
+  for (int i = 0; i < 4; i++)
+  {
+    q[i] = static_cast<float>(result[i] / norm);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTrackingHistory::NiftyLinkTrackingHistory(const int& maximumNumberOfTools, const int& numberOfPosesPerTool)
+: m_MaximumNumberOfTools(maximumNumberOfTools)
+, m_NumberOfPosesPerTool(numberOfPosesPerTool)
+, m_NumberOfTools(0)
+{
+  if (maximumNumberOfTools < 1)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Maximum number of tools must be at least 1.");
+  }
+  if (numberOfPosesPerTool < 2)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Number of poses per tool must be at least 2.");
+  }
+
+  m_ToolNames.resize(maximumNumberOfTools);
+  m_Poses.resize(maximumNumberOfTools * numberOfPosesPerTool);
+  m_Newest.resize(maximumNumberOfTools, numberOfPosesPerTool - 1);
+  m_Size.resize(maximumNumberOfTools, 0);
+  m_Sequence.resize(maximumNumberOfTools, QAtomicInt(0));
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTrackingHistory::~NiftyLinkTrackingHistory()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkTrackingHistory::GetNumberOfTools() const
+{
+  return m_NumberOfTools.fetchAndAddAcquire(0);
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkTrackingHistory::FindTool(const QString& toolName) const
+{
+  // Tool names are written before the number of tools is incremented, and never change afterwards.
+  const int numberOfTools = m_NumberOfTools.fetchAndAddAcquire(0);
+  for (int i = 0; i < numberOfTools; i++)
+  {
+    if (m_ToolNames[i] == toolName)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkTrackingHistory::AddMessage(const NiftyLinkMessageContainer::Pointer& message)
+{
+  int numberAdded = 0;
+
+  if (message.data() == NULL || message->GetMessage().IsNull())
+  {
+    return numberAdded;
+  }
+
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  igtl::Matrix4x4 matrix;
+
+  igtl::TrackingDataMessage::Pointer trackingData = dynamic_cast<igtl::TrackingDataMessage*>(message->GetMessage().GetPointer());
+  if (trackingData.IsNotNull())
+  {
+    trackingData->GetTimeStamp(timeStamp);
+
+    igtl::TrackingDataElement::Pointer element;
+    for (int i = 0; i < trackingData->GetNumberOfTrackingDataElements(); i++)
+    {
+      trackingData->GetTrackingDataElement(i, element);
+      element->GetMatrix(matrix);
+
+      if (this->AddPose(QString(element->GetName()), matrix, timeStamp->GetTimeStampInNanoseconds()))
+      {
+        numberAdded++;
+      }
+    }
+    return numberAdded;
+  }
+
+  igtl::TransformMessage::Pointer transform = dynamic_cast<igtl::TransformMessage*>(message->GetMessage().GetPointer());
+  if (transform.IsNotNull())
+  {
+    transform->GetTimeStamp(timeStamp);
+    transform->GetMatrix(matrix);
+
+    if (this->AddPose(QString(transform->GetDeviceName()), matrix, timeStamp->GetTimeStampInNanoseconds()))
+    {
+      numberAdded++;
+    }
+  }
+
+  return numberAdded;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTrackingHistory::AddPose(const QString& toolName, const igtl::Matrix4x4& matrix, const igtlUint64& timeInNanoseconds)
+{
+  int tool = this->FindTool(toolName);
+  if (tool < 0)
+  {
+    tool = m_NumberOfTools.fetchAndAddAcquire(0);
+    if (tool >= m_MaximumNumberOfTools)
+    {
+      return false;
+    }
+    m_ToolNames[tool] = toolName;
+    m_NumberOfTools.fetchAndAddOrdered(1);
+  }
+
+  const int firstIndex = tool * m_NumberOfPosesPerTool;
+  if (m_Size[tool] > 0 && timeInNanoseconds < m_Poses[firstIndex + m_Newest[tool]].m_Time)
+  {
+    return false;
+  }
+
+  Pose pose;
+  pose.m_Time = timeInNanoseconds;
+  for (int i = 0; i < 3; i++)
+  {
+    pose.m_Position[i] = matrix[i][3];
+  }
+  igtl::MatrixToQuaternion(*(const_cast<igtl::Matrix4x4*>(&matrix)), pose.m_Quaternion);
+
+  // Odd while writing, so readers retry.
+  m_Sequence[tool].fetchAndAddOrdered(1);
+
+  const int newest = (m_Newest[tool] + 1) % m_NumberOfPosesPerTool;
+  m_Poses[firstIndex + newest] = pose;
+  m_Newest[tool] = newest;
+  if (m_Size[tool] < m_NumberOfPosesPerTool)
+  {
+    m_Size[tool]++;
+  }
+
+  m_Sequence[tool].fetchAndAddOrdered(1);
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTrackingHistory::GetPose(const QString& toolName, const igtlUint64& timeInNanoseconds, igtl::Matrix4x4& matrix) const
+{
+  const int tool = this->FindTool(toolName);
+  if (tool < 0)
+  {
+    return false;
+  }
+
+  const int firstIndex = tool * m_NumberOfPosesPerTool;
+  Pose before;
+  Pose after;
+  bool isFound = false;
+
+  while (true)
+  {
+    const int sequenceBefore = m_Sequence[tool].fetchAndAddAcquire(0);
+    if (sequenceBefore & 1)
+    {
+      QThread::yieldCurrentThread();
+      continue;
+    }
+
+    isFound = false;
+    const int size = m_Size[tool];
+    const int newest = m_Newest[tool];
+    const int oldest = (newest - size + 1 + m_NumberOfPosesPerTool) % m_NumberOfPosesPerTool;
+
+    if (size > 0
+        && timeInNanoseconds >= m_Poses[firstIndex + oldest].m_Time
+        && timeInNanoseconds <= m_Poses[firstIndex + newest].m_Time)
+    {
+      // Find the newest pose at or before the requested time.
+      int low = 0;
+      int high = size - 1;
+      while (low < high)
+      {
+        const int middle = (low + high + 1) / 2;
+        if (m_Poses[firstIndex + (oldest + middle) % m_NumberOfPosesPerTool].m_Time <= timeInNanoseconds)
+        {
+          low = middle;
+        }
+        else
+        {
+          high = middle - 1;
+        }
+      }
+      before = m_Poses[firstIndex + (oldest + low) % m_NumberOfPosesPerTool];
+      after = m_Poses[firstIndex + (oldest + qMin(low + 1, size - 1)) % m_NumberOfPosesPerTool];
+      isFound = true;
+    }
+
+    // Ordered, so the reads above cannot move after it.
+    const int sequenceAfter = m_Sequence[tool].fetchAndAddOrdered(0);
+    if (sequenceAfter == sequenceBefore)
+    {
+      break;
+    }
+  }
+
+  if (!isFound)
+  {
+    return false;
+  }
+
+  double alpha = 0;
+  if (after.m_Time > before.m_Time)
+  {
+    alpha = static_cast<double>(timeInNanoseconds - before.m_Time) / static_cast<double>(after.m_Time - before.m_Time);
+  }
+
+  float quaternion[4];
+  Slerp(before.m_Quaternion, after.m_Quaternion, alpha, quaternion);
+  igtl::QuaternionToMatrix(quaternion, matrix);
+
+  for (int i = 0; i < 3; i++)
+  {
+    matrix[i][3] = static_cast<float>((1 - alpha) * before.m_Position[i] + alpha * after.m_Position[i]);
+    matrix[3][i] = 0;
+  }
+  matrix[3][3] = 1;
+
+  return true;
+}
+
+} // end namespace niftk
@@ -0,0 +1,100 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkTrackingHistory_h
+#define NiftyLinkTrackingHistory_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+
+#include <igtlMath.h>
+
+#include <QAtomicInt>
+#include <QString>
+
+#include <vector>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkTrackingHistory
+* \brief Keeps the recent poses of each tool, from incoming TDATA and TRANSFORM messages,
+* so that the pose of a tool can be looked up at any time stamp, eg. the acquisition time of an image.
+*
+* Storage is allocated in the constructor, for a fixed number of tools, and a fixed number of poses
+* per tool, after which the oldest pose of a tool is overwritten. GetPose() interpolates between the two poses
+* either side of the requested time, linearly for the translation, and using slerp for the rotation.
+*
+* One thread, (eg. the thread receiving messages), may call AddMessage() and AddPose(). Any number
+* of threads may call GetPose() at the same time, without locking. Each tool has a sequence number,
+* which is odd while the tool is being written, so a reader retries if a pose changed while it was read.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkTrackingHistory
+{
+
+public:
+
+  /// \brief Constructor, which allocates all storage.
+  /// \throws std::invalid_argument if maximumNumberOfTools is less than 1, or numberOfPosesPerTool is less than 2.
+  NiftyLinkTrackingHistory(const int& maximumNumberOfTools = 16, const int& numberOfPosesPerTool = 256);
+
+  /// \brief Destructor.
+  ~NiftyLinkTrackingHistory();
+
+  /// \brief Adds the pose of each element in a TDATA message, or the matrix of a TRANSFORM message,
+  /// using the device name as the tool name, at the time stamp of the message.
+  /// \return the number of poses added, which is zero for other message types.
+  int AddMessage(const NiftyLinkMessageContainer::Pointer& message);
+
+  /// \brief Adds a pose, where only the rotation and translation of matrix are used.
+  /// \return false if the pose was not added, as it is older than the newest pose of that tool,
+  /// or the tool is new, and there is no room for more tools.
+  bool AddPose(const QString& toolName, const igtl::Matrix4x4& matrix, const igtlUint64& timeInNanoseconds);
+
+  /// \brief Returns, in matrix, the pose of the tool at the given time, and can be called from any thread.
+  /// \return false, leaving matrix unchanged, if the tool is unknown, or the time is not between the
+  /// oldest and newest pose of the tool still in the history.
+  bool GetPose(const QString& toolName, const igtlUint64& timeInNanoseconds, igtl::Matrix4x4& matrix) const;
+
+  /// \brief Returns the number of tools seen so far.
+  int GetNumberOfTools() const;
+
+private:
+
+  /// \brief One pose, with the rotation as a quaternion (x, y, z, w), as used by igtl::MatrixToQuaternion.
+  struct Pose
+  {
+    igtlUint64 m_Time;
+    float      m_Position[3];
+    float      m_Quaternion[4];
+  };
+
+  /// \brief Returns the index of the tool, or -1 if not known.
+  int FindTool(const QString& toolName) const;
+
+  int                           m_MaximumNumberOfTools;
+  int                           m_NumberOfPosesPerTool;
+  mutable QAtomicInt            m_NumberOfTools;
+  std::vector<QString>          m_ToolNames;
+
+  // For tool i, pose j is at m_Poses[i * m_NumberOfPosesPerTool + j], where
+  // m_Newest[i] is the index of the newest pose, and m_Size[i] the number of poses.
+  std::vector<Pose>             m_Poses;
+  std::vector<int>              m_Newest;
+  std::vector<int>              m_Size;
+  mutable std::vector<QAtomicInt> m_Sequence;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkTrackingHistory_h
@@ -67,6 +67,20 @@ int NiftyLinkClient::GetTimeToWaitToConnectToServer()
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkClient::SetUseKernelTimestamps(const bool& isOn)
+{
+  this->m_ClientProcess->SetUseKernelTimestamps(isOn);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkClient::SetCoalesceMessages(const bool& isOn)
+{
+  this->m_ClientProcess->SetCoalesceMessages(isOn);
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkClient::ConnectToHost(const QString& hostName, quint16 portNumber)
 {
@@ -52,7 +52,8 @@ public:
   /// \brief Starts a client, and tries to connect to the given URL.
   void ConnectToHost(const QUrl& url);
 
-  /// \brief Sends an OpenIGTLink message (blocking).
+  /// \brief Queues an OpenIGTLink message to be sent by the client's own thread, without blocking,
+  /// see NiftyLinkNetworkProcess::Send().
   void Send(igtl::MessageBase::Pointer msg);
 
   /// \brief Stops this client. This ultimately causes the thread to die, so a new client should be created after calling this.
@@ -64,6 +65,13 @@ public:
   /// \brief Returns the time to wait when trying to connect to the server.
   int GetTimeToWaitToConnectToServer();
 
+  /// \brief Turns on, or off, (the default), kernel receive time stamps, see NiftyLinkNetworkProcess::SetUseKernelTimestamps().
+  /// Must be called before ConnectToHost().
+  void SetUseKernelTimestamps(const bool& isOn);
+
+  /// \brief Turns on, or off, (the default), coalescing queued messages, see NiftyLinkNetworkProcess::SetCoalesceMessages().
+  void SetCoalesceMessages(const bool& isOn);
+
   /// \brief Used for testing, and performance analysis, writing some stats to console.
   void OutputStats();
 
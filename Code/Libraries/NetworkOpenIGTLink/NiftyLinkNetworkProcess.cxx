@@ -19,13 +19,26 @@
 #include <QTimer>
 #include <QsLog.h>
 #include <QCoreApplication>
+#include <QList>
+#include <QVector>
 
 #include <igtlMessageFactory.h>
 #include <igtlStringMessage.h>
 
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#include <Ws2tcpip.h>
+#elif defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
+#include <cstring>
 
 namespace niftk
 {
@@ -33,6 +46,13 @@ namespace niftk
 const std::string NiftyLinkNetworkProcess::m_KEEP_ALIVE_MESSAGE("POKE");
 const std::string NiftyLinkNetworkProcess::m_STATS_MESSAGE("STATS");
 
+// Enough for hundreds of TDATA/TRANSFORM messages, while image bodies are read straight into the message.
+static const int NIFTYLINK_READ_BUFFER_SIZE = 65536;
+
+// The most messages taken off the send queue in one pass of the processing loop, (as many as NiftyLinkSocket
+// sends in one system call), so a flood of messages can't hold up receiving and the timers.
+static const int NIFTYLINK_MAXIMUM_MESSAGES_PER_PASS = 64;
+
 //-----------------------------------------------------------------------------
 NiftyLinkNetworkProcess::NiftyLinkNetworkProcess(QObject *parent)
 : m_NumberOfMessagesReceived(0)
@@ -45,11 +65,75 @@ NiftyLinkNetworkProcess::NiftyLinkNetworkProcess(QObject *parent)
 , m_NoResponseTimer(NULL)
 , m_NoResponseInterval(1000)
 , m_IsRunning(false)
+, m_UseKernelTimestamps(false)
+, m_CoalesceMessages(false)
+, m_NumberOfMessagesCoalesced(0)
 , m_IsConnected(false)
 , m_LastMessageProcessedTime(NULL)
 {
   qRegisterMetaType<niftk::NiftyLinkMessageContainer::Pointer>("niftk::NiftyLinkMessageContainer::Pointer");
   m_LastMessageProcessedTime = igtl::TimeStamp::New();
+
+  m_WakeUpDescriptors[0] = -1;
+  m_WakeUpDescriptors[1] = -1;
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  // select() only waits on sockets, so a UDP socket connected to itself on loopback, sends itself the wake up.
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2,2), &wsaData) == 0)
+  {
+    SOCKET wakeUp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wakeUp != INVALID_SOCKET)
+    {
+      struct sockaddr_in address;
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = 0;
+      int addressLength = sizeof(address);
+      u_long iMode = 1; // non-blocking mode
+
+      if (bind(wakeUp, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0
+          && getsockname(wakeUp, reinterpret_cast<struct sockaddr*>(&address), &addressLength) == 0
+          && connect(wakeUp, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0
+          && ioctlsocket(wakeUp, FIONBIO, &iMode) == 0)
+      {
+        m_WakeUpDescriptors[0] = static_cast<int>(wakeUp);
+        m_WakeUpDescriptors[1] = m_WakeUpDescriptors[0];
+      }
+      else
+      {
+        closesocket(wakeUp);
+      }
+    }
+    if (m_WakeUpDescriptors[0] < 0)
+    {
+      WSACleanup();
+    }
+  }
+#elif defined(__linux__)
+  m_WakeUpDescriptors[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_WakeUpDescriptors[1] = m_WakeUpDescriptors[0];
+#else
+  if (pipe(m_WakeUpDescriptors) == 0)
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      fcntl(m_WakeUpDescriptors[i], F_SETFL, fcntl(m_WakeUpDescriptors[i], F_GETFL) | O_NONBLOCK);
+      fcntl(m_WakeUpDescriptors[i], F_SETFD, FD_CLOEXEC);
+    }
+  }
+  else
+  {
+    m_WakeUpDescriptors[0] = -1;
+    m_WakeUpDescriptors[1] = -1;
+  }
+#endif
+
+  if (m_WakeUpDescriptors[0] < 0)
+  {
+    QLOG_WARN() << QObject::tr("NiftyLinkNetworkProcess::NiftyLinkNetworkProcess() - No wake-up descriptor, so StopProcessing() and Send() may take up to the socket timeout.");
+  }
 }
 
 
@@ -57,6 +141,23 @@ NiftyLinkNetworkProcess::NiftyLinkNetworkProcess(QObject *parent)
 NiftyLinkNetworkProcess::~NiftyLinkNetworkProcess()
 {
   this->TerminateProcess();
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  if (m_WakeUpDescriptors[0] >= 0)
+  {
+    closesocket(static_cast<SOCKET>(m_WakeUpDescriptors[0]));
+    WSACleanup();
+  }
+#else
+  if (m_WakeUpDescriptors[1] >= 0 && m_WakeUpDescriptors[1] != m_WakeUpDescriptors[0])
+  {
+    close(m_WakeUpDescriptors[1]);
+  }
+  if (m_WakeUpDescriptors[0] >= 0)
+  {
+    close(m_WakeUpDescriptors[0]);
+  }
+#endif
 }
 
 
@@ -81,6 +182,34 @@ void NiftyLinkNetworkProcess::SetSocketTimeout(const int& msec)
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkNetworkProcess::SetUseKernelTimestamps(const bool& isOn)
+{
+  m_UseKernelTimestamps = isOn;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkNetworkProcess::GetUseKernelTimestamps() const
+{
+  return m_UseKernelTimestamps;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkNetworkProcess::SetCoalesceMessages(const bool& isOn)
+{
+  m_CoalesceMessages = isOn;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkNetworkProcess::GetCoalesceMessages() const
+{
+  return m_CoalesceMessages;
+}
+
+
 //-----------------------------------------------------------------------------
 int NiftyLinkNetworkProcess::GetKeepAliveInterval() const
 {
@@ -182,7 +311,8 @@ void NiftyLinkNetworkProcess::StartProcessing()
   // within the context of another thread, hence another event loop.
   connect(this, SIGNAL(InternalStartWorkingSignal()), this, SLOT(RunProcessing()));
 
-  m_ListOfLatencies.clear();
+  m_LatencyStats.Reset();
+  m_SendLatencyStats.Reset();
   m_IsRunning = true;
 
   emit InternalStartWorkingSignal();
@@ -198,6 +328,88 @@ void NiftyLinkNetworkProcess::StopProcessing()
 
   // Here we set the member variable to false, and the processing loops in subclass will realise to exit.
   m_IsRunning = false;
+
+  // And in case the processing loop is waiting for data, make sure it realises now.
+  this->WakeUp();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkNetworkProcess::WakeUp()
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  if (m_WakeUpDescriptors[1] >= 0)
+  {
+    const char one = 1;
+    send(static_cast<SOCKET>(m_WakeUpDescriptors[1]), &one, sizeof(one), 0); // If it fails, a wake up is already pending.
+  }
+#elif defined(__linux__)
+  if (m_WakeUpDescriptors[1] >= 0)
+  {
+    const uint64_t one = 1;
+    ssize_t written = write(m_WakeUpDescriptors[1], &one, sizeof(one));
+    (void)written; // If the counter is full, a wake up is already pending.
+  }
+#else
+  if (m_WakeUpDescriptors[1] >= 0)
+  {
+    const char one = 1;
+    ssize_t written = write(m_WakeUpDescriptors[1], &one, sizeof(one));
+    (void)written; // If the pipe is full, a wake up is already pending.
+  }
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkNetworkProcess::ClearWakeUp()
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  if (m_WakeUpDescriptors[0] >= 0)
+  {
+    char buffer[64];
+    while (recv(static_cast<SOCKET>(m_WakeUpDescriptors[0]), buffer, sizeof(buffer), 0) > 0)
+    {
+    }
+  }
+#elif defined(__linux__)
+  if (m_WakeUpDescriptors[0] >= 0)
+  {
+    uint64_t count = 0;
+    while (read(m_WakeUpDescriptors[0], &count, sizeof(count)) > 0)
+    {
+    }
+  }
+#else
+  if (m_WakeUpDescriptors[0] >= 0)
+  {
+    char buffer[64];
+    while (read(m_WakeUpDescriptors[0], buffer, sizeof(buffer)) > 0)
+    {
+    }
+  }
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkNetworkProcess::GetWaitTimeout() const
+{
+  int timeout = m_SocketTimeout;
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5,0,0))
+  // Don't sleep through a timer, as they are only processed between waits.
+  QTimer* timers[2] = {m_KeepAliveTimer, m_NoResponseTimer};
+  for (int i = 0; i < 2; i++)
+  {
+    if (timers[i] != NULL && timers[i]->isActive())
+    {
+      timeout = qMin(timeout, qMax(timers[i]->remainingTime(), 0));
+    }
+  }
+#endif
+
+  return timeout;
 }
 
 
@@ -242,24 +454,77 @@ void NiftyLinkNetworkProcess::ReceiveMessageLoop()
   NiftyLinkQThread *p = dynamic_cast<NiftyLinkQThread *>(QThread::currentThread());
   assert(p);
 
-  // We loop, continuously checking for arriving data.
+  // So small messages are received in as few system calls as possible.
+  m_CommsSocket->SetReadBufferSize(NIFTYLINK_READ_BUFFER_SIZE);
+
+  if (m_UseKernelTimestamps)
+  {
+    if (m_CommsSocket->SetKernelReceiveTimestamps(1) == 1)
+    {
+      QLOG_INFO() << QObject::tr("%1::ReceiveMessageLoop() - Using kernel receive time stamps.").arg(objectName());
+    }
+    else
+    {
+      QLOG_WARN() << QObject::tr("%1::ReceiveMessageLoop() - Kernel receive time stamps are not available, so using software time stamps.")
+                     .arg(objectName());
+    }
+  }
+
+  // We loop, sleeping until data arrives, a timer is due, or StopProcessing() wakes us up.
   while (this->GetIsRunning() && m_IsConnected)
   {
-    // Process data from socket.
-    int bytesPending = m_CommsSocket->CheckPendingData();
-    if (bytesPending < 0)
+    int waitResult = m_CommsSocket->WaitForData(this->GetWaitTimeout(), m_WakeUpDescriptors[0]);
+    if (waitResult < 0)
     {
-      QString errorMessage = QObject::tr("%1::ReceiveMessageLoop() - CheckPendingData returned -1. This is a system error. Check console/log file.")
+      QString errorMessage = QObject::tr("%1::ReceiveMessageLoop() - WaitForData returned -1. This is a system error. Check console/log file.")
           .arg(objectName());
 
       QLOG_ERROR() << errorMessage;
       NiftyLinkStdExceptionMacro(std::runtime_error, << errorMessage.toStdString());
     }
+    else if (waitResult == 2)
+    {
+      this->ClearWakeUp();
+    }
+    else if (waitResult == 1)
+    {
+      // Only now is it worth asking how much data there is, which also records the time it arrived.
+      int bytesPending = m_CommsSocket->CheckPendingData();
+      if (bytesPending < 0 && bytesPending != -5)
+      {
+        QString errorMessage = QObject::tr("%1::ReceiveMessageLoop() - CheckPendingData returned -1. This is a system error. Check console/log file.")
+            .arg(objectName());
+
+        QLOG_ERROR() << errorMessage;
+        NiftyLinkStdExceptionMacro(std::runtime_error, << errorMessage.toStdString());
+      }
+
+      if (bytesPending == -5)
+      {
+        // Nothing to read after all, (eg. recv() was interrupted), so just wait again.
+      }
+      else if (bytesPending == 2)
+      {
+        // Only a keepalive, (see NiftyLinkSocket::Poke()), which the socket has discarded, but the other end is alive.
+        this->StartNoResponseTimer();
+      }
+      else if (bytesPending > 0)
+      {
+        // Process the message.
+        this->ReceiveMessage();
+      }
+      else
+      {
+        // Readable with nothing to read means the other end closed the connection. Without this,
+        // we would spin here until the no response timer went off, so treat it the same way now.
+        this->OnNoResponseTimerTimedOut();
+      }
+    }
 
-    // Process the message.
-    if (bytesPending > 0)
+    // Send whatever other threads have queued, on this thread, so only this thread uses the socket.
+    if (m_IsConnected)
     {
-      this->ReceiveMessage();
+      this->SendQueuedMessages();
     }
 
     // Make sure this while loop doesn't swamp the QTimers.
@@ -300,6 +565,10 @@ bool NiftyLinkNetworkProcess::ReceiveMessage()
     return false;
   }
 
+  // Marks when the first byte of the package arrived, taken before the body is received, as with kernel
+  // time stamps on, (see SetUseKernelTimestamps()), each Receive() updates it.
+  const igtlUint64 timeArrivedInNanoseconds = m_CommsSocket->GetReceiveTimestampInNanoseconds();
+
   // Restart the timer, as we may be receiving a header only
   // message, so we wont do it in the body section below.
   this->StartNoResponseTimer();
@@ -358,16 +627,7 @@ bool NiftyLinkNetworkProcess::ReceiveMessage()
 
   // Get the receive timestamp from the socket - marks when the first byte of the package arrived
   igtl::TimeStamp::Pointer timeArrived = igtl::TimeStamp::New();
-
-  // TODO: Two socket implementations are not quite equivalent.
-  if (dynamic_cast<NiftyLinkSocket*>(m_CommsSocket.GetPointer()))
-  {
-    timeArrived->SetTimeInNanoseconds(dynamic_cast<NiftyLinkSocket*>(m_CommsSocket.GetPointer())->GetReceiveTimestampInNanoseconds());
-  }
-  else
-  {
-    timeArrived->SetTimeInNanoseconds(timeReceived->GetTimeStampInNanoseconds());
-  }
+  timeArrived->SetTimeInNanoseconds(timeArrivedInNanoseconds);
 
   // Set timestamps on NiftyLink container.
   msg->SetTimeArrived(timeArrived);
@@ -382,7 +642,7 @@ bool NiftyLinkNetworkProcess::ReceiveMessage()
   message->GetTimeStamp(timeCreated);
 
   igtlUint64 latency = niftk::GetDifferenceInNanoSeconds(timeCreated, timeReceived);
-  m_ListOfLatencies.append(latency);
+  m_LatencyStats.Add(latency);
 
   QLOG_DEBUG() << QObject::tr("%1::ReceiveMessage() - id=%2, class=%3, size=%4 bytes, device='%5', latency=%6")
                   .arg(objectName())
@@ -401,39 +661,108 @@ bool NiftyLinkNetworkProcess::ReceiveMessage()
 
 //-----------------------------------------------------------------------------
 void NiftyLinkNetworkProcess::Send(igtl::MessageBase::Pointer msg)
+{
+  if (this->GetIsRunning() && m_IsConnected)
+  {
+    igtl::TimeStamp::Pointer timeQueued = igtl::TimeStamp::New();
+    m_SendQueue.Push(msg, timeQueued->GetTimeStampInNanoseconds());
+
+    // So the processing loop sends it now, rather than when it next stops waiting for data.
+    this->WakeUp();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkNetworkProcess::SendQueuedMessages()
 {
   assert(m_CommsSocket.IsNotNull());
 
-  if (this->GetIsRunning())
+  QList<igtl::MessageBase::Pointer> messages;
+  QList<igtlUint64> timesQueued;
+
+  igtl::MessageBase::Pointer msg;
+  igtlUint64 timeQueued = 0;
+  int numberOfMessagesPopped = 0;
+
+  while (numberOfMessagesPopped < NIFTYLINK_MAXIMUM_MESSAGES_PER_PASS && m_SendQueue.Pop(msg, timeQueued))
   {
-    // In OpenIGTLink paper (Tokuda et. al. 2009), latency is
-    // defined as the time from the first byte sent to the last byte arrived.
-    // So, here we set the time, just as we send it to the socket.
-    igtl::TimeStamp::Pointer sendStarted = igtl::TimeStamp::New();
-    msg->SetTimeStamp(sendStarted);
-    msg->Pack();
+    numberOfMessagesPopped++;
 
-    int ret = m_CommsSocket->Send(msg->GetPackPointer(), msg->GetPackSize());
-    if (ret <= 0)
+    if (m_CoalesceMessages)
     {
-      QString errorMessage = QObject::tr("%1::Send() - Failed to send message, return code %2. Check console/log file.")
-          .arg(objectName()).arg(ret);
-
-      QLOG_ERROR() << errorMessage;
-      NiftyLinkStdExceptionMacro(std::logic_error, << errorMessage.toStdString());
+      // Drop any older message, still waiting, that this one supersedes.
+      for (int i = 0; i < messages.size(); i++)
+      {
+        if (std::string(messages[i]->GetDeviceType()) == msg->GetDeviceType()
+            && std::string(messages[i]->GetDeviceName()) == msg->GetDeviceName())
+        {
+          messages.removeAt(i);
+          timesQueued.removeAt(i);
+          m_NumberOfMessagesCoalesced++;
+          break;
+        }
+      }
     }
+    messages.append(msg);
+    timesQueued.append(timeQueued);
+  }
+
+  if (numberOfMessagesPopped == NIFTYLINK_MAXIMUM_MESSAGES_PER_PASS)
+  {
+    // There may be more, so come straight back for them, once any incoming data has been dealt with.
+    this->WakeUp();
+  }
 
-    // Internal message counter
-    m_NumberOfMessagesSent++;
+  if (messages.isEmpty())
+  {
+    return;
+  }
 
-    // Get the time. Note, this assumes the constructor sets a valid time.
-    igtl::TimeStamp::Pointer sendFinished = igtl::TimeStamp::New();
+  // In OpenIGTLink paper (Tokuda et. al. 2009), latency is
+  // defined as the time from the first byte sent to the last byte arrived.
+  // So, here we set the time, just as we send it to the socket.
+  igtl::TimeStamp::Pointer sendStarted = igtl::TimeStamp::New();
 
-    // Store the time where we last sent a message.
-    m_LastMessageProcessedTime->SetTimeInNanoseconds(sendFinished->GetTimeStampInNanoseconds());
+  QVector<NiftyLinkSocket::SendBuffer> buffers(messages.size());
+  for (int i = 0; i < messages.size(); i++)
+  {
+    messages[i]->SetTimeStamp(sendStarted);
+    messages[i]->Pack();
 
-    emit MessageSent(sendStarted->GetTimeStampInNanoseconds(),
-                     sendFinished->GetTimeStampInNanoseconds());
+    buffers[i].m_Data = messages[i]->GetPackPointer();
+    buffers[i].m_Length = messages[i]->GetPackSize();
+  }
+
+  // All in one go, so several small messages cost one system call.
+  int ret = m_CommsSocket->Send(buffers.data(), buffers.size());
+  if (ret <= 0)
+  {
+    QLOG_ERROR() << QObject::tr("%1::SendQueuedMessages() - Failed to send %2 message(s), return code %3: I am probably disconnected from remote host.")
+                    .arg(objectName()).arg(messages.size()).arg(ret);
+
+    this->StopNoResponseTimer();
+    this->StopKeepAliveTimer();
+    m_IsConnected = false;
+
+    emit CantReachRemote();
+    return;
+  }
+
+  // Internal message counter
+  m_NumberOfMessagesSent += messages.size();
+
+  // Get the time. Note, this assumes the constructor sets a valid time.
+  igtl::TimeStamp::Pointer sendFinished = igtl::TimeStamp::New();
+
+  // Store the time where we last sent a message.
+  m_LastMessageProcessedTime->SetTimeInNanoseconds(sendFinished->GetTimeStampInNanoseconds());
+
+  for (int i = 0; i < timesQueued.size(); i++)
+  {
+    m_SendLatencyStats.Add(sendFinished->GetTimeStampInNanoseconds() - timesQueued[i]);
+
+    emit MessageSent(timesQueued[i], sendFinished->GetTimeStampInNanoseconds());
   }
 }
 
@@ -591,15 +920,43 @@ void NiftyLinkNetworkProcess::TerminateProcess()
 //-----------------------------------------------------------------------------
 void NiftyLinkNetworkProcess::DumpStats()
 {
-  igtlUint64 number = m_ListOfLatencies.size();
-  double mean = CalculateMean(m_ListOfLatencies);
-  double stdDev = CalculateStdDev(m_ListOfLatencies);
+  igtlUint64 number = m_LatencyStats.GetCount();
+  double mean = m_LatencyStats.GetMean();
+  double stdDev = m_LatencyStats.GetStdDev();
 
-  m_ListOfLatencies.clear();
-  m_ListOfLatencies.clear();
+  m_LatencyStats.Reset();
 
   QLOG_INFO() << QObject::tr("%1::NiftyLinkNetworkProcess::DumpStats() - number=%2, mean=%3, std dev=%4, (nanoseconds).")
                  .arg(objectName()).arg(number).arg(mean).arg(stdDev);
+
+  QLOG_INFO() << QObject::tr("%1::NiftyLinkNetworkProcess::DumpStats() - send latency, from Send() to socket, number=%2, mean=%3, max=%4, (nanoseconds), coalesced=%5.")
+                 .arg(objectName()).arg(m_SendLatencyStats.GetCount()).arg(m_SendLatencyStats.GetMean())
+                 .arg(m_SendLatencyStats.GetMax()).arg(m_NumberOfMessagesCoalesced);
+
+  m_SendLatencyStats.Reset();
+
+  if (m_CommsSocket.IsNotNull())
+  {
+    igtlUint64 bytesSent = m_CommsSocket->GetNumberOfBytesSent();
+    igtlUint64 sendDuration = m_CommsSocket->GetSendDurationInNanoseconds();
+    NiftyLinkRunningStats stallStats = m_CommsSocket->GetSendStallStats();
+
+    m_CommsSocket->ResetSendStats();
+
+    // Bytes per nanosecond is GB/s, so multiply by 1000 for MB/s.
+    double throughput = sendDuration > 0 ? static_cast<double>(bytesSent) * 1000 / static_cast<double>(sendDuration) : 0;
+
+    // Both are totals since connecting. Keep-alive and stats messages cost system calls, but are not counted as received.
+    double systemCallsPerMessage = m_NumberOfMessagesReceived > 0 ?
+          static_cast<double>(m_CommsSocket->GetNumberOfReceiveSystemCalls()) / static_cast<double>(m_NumberOfMessagesReceived) : 0;
+
+    QLOG_INFO() << QObject::tr("%1::NiftyLinkNetworkProcess::DumpStats() - %2 receive system calls per message received.")
+                   .arg(objectName()).arg(systemCallsPerMessage);
+
+    QLOG_INFO() << QObject::tr("%1::NiftyLinkNetworkProcess::DumpStats() - sent %2 bytes at %3 MB/s while sending, stalled %4 times, mean stall=%5, max stall=%6, (nanoseconds).")
+                   .arg(objectName()).arg(bytesSent).arg(throughput)
+                   .arg(stallStats.GetCount()).arg(stallStats.GetMean()).arg(stallStats.GetMax());
+  }
 }
 
 
@@ -15,6 +15,8 @@
 #include <NiftyLinkCommonWin32ExportHeader.h>
 #include <NiftyLinkMessageContainer.h>
 #include <NiftyLinkSocket.h>
+#include <NiftyLinkSendQueue.h>
+#include <NiftyLinkRunningStats.h>
 
 #include <QObject>
 
@@ -46,28 +48,47 @@ public:
   /// \brief Destructor.
   virtual ~NiftyLinkNetworkProcess();
 
-  /// \brief Sets the socket timeout in milliseconds, default = 50 msec.
+  /// \brief Sets the socket timeout in milliseconds, default = 50 msec, which is the longest
+  /// the processing loop waits for data, before processing events, (eg. the timers).
   void SetSocketTimeout(const int& msec);
 
   /// \brief Returns the socket timeout in milliseconds.
   int GetSocketTimeout() const;
 
+  /// \brief Turns on, or off, (the default), using the time the kernel received each message as the time it arrived,
+  /// (see NiftyLinkMessageContainer::GetTimeArrived()), rather than the time the processing loop noticed it,
+  /// so latency statistics exclude our own scheduling delays. Only supported on Linux, and must be set
+  /// before the connection is made, otherwise software time stamps are used.
+  void SetUseKernelTimestamps(const bool& isOn);
+
+  /// \brief Returns whether kernel receive time stamps were requested.
+  bool GetUseKernelTimestamps() const;
+
   /// \brief Starts the main processing loop.
   void StartProcessing();
 
-  /// \brief Stops the main processing loop.
+  /// \brief Stops the main processing loop, and can be called from any thread.
   void StopProcessing();
 
-  /// \brief Sends the OpenIGTLink message (blocking), which should be Unpacked when passed in, as this methods Packs it.
+  /// \brief Queues the OpenIGTLink message to be sent by the processing thread, and returns straight away,
+  /// so can be called from any thread. The message is time stamped and Packed when it is sent, so
+  /// should be Unpacked when passed in, and not modified afterwards. If sending fails, CantReachRemote() is emitted.
   void Send(igtl::MessageBase::Pointer msg);
 
+  /// \brief Turns on, or off, (the default), coalescing queued messages, so if several messages with the same
+  /// device type and device name are waiting to be sent, only the newest is sent, eg. for a stream of poses.
+  void SetCoalesceMessages(const bool& isOn);
+
+  /// \brief Returns whether queued messages are coalesced.
+  bool GetCoalesceMessages() const;
+
 signals:
 
   /// \brief This signal is emitted when a new message is received from the remote peer.
   void MessageReceived(niftk::NiftyLinkMessageContainer::Pointer msg);
 
   /// \brief This signal is emmitted when a message has been successfully sent.
-  /// The start and end times indicate the time it took to process the Send() request.
+  /// The start and end times are when Send() queued the message, and when it was written to the socket.
   void MessageSent(igtlUint64 startTimeInNanoseconds, igtlUint64 endTimeInNanoseconds);
 
   /// \brief This signal is emmitted when we think the connection is dead (keep-alive failed to send).
@@ -126,12 +147,17 @@ protected:
   /// \brief Returns whether or not sub-classes should continue processing stuff.
   bool GetIsRunning() const;
 
-  /// \brief Continuously loops round receiving incoming messages.
+  /// \brief Continuously loops round receiving incoming messages, blocking
+  /// while there is no data, rather than spinning.
   void ReceiveMessageLoop();
 
   /// \brief Processes an incomming message.
   bool ReceiveMessage();
 
+  /// \brief Sends what is queued by Send(), up to a limit, in one go, and must be called from the processing thread.
+  /// Anything over the limit is left for the next pass of the processing loop.
+  void SendQueuedMessages();
+
   /// \brief Method thats triggered to extract some statistics of latencies.
   void DumpStats();
 
@@ -164,6 +190,15 @@ private:
   /// \brief Shutdown/Destroy stuff, called at the end of processing loop, as processing thread will finish, and from destructor.
   void TerminateProcess();
 
+  /// \brief Wakes up the processing loop if it is waiting for data, so it can see that m_IsRunning changed.
+  void WakeUp();
+
+  /// \brief Reads everything written by WakeUp(), so the next wait blocks again.
+  void ClearWakeUp();
+
+  /// \brief Returns how long the processing loop can wait for data, before a timer is due.
+  int GetWaitTimeout() const;
+
   /// \brief Contains the system level, standard keep-alive message.
   static const std::string m_KEEP_ALIVE_MESSAGE;
 
@@ -184,11 +219,26 @@ private:
   // Control variable to inform derived classes whether they should be processing or not.
   bool                           m_IsRunning;
 
+  // Whether to turn on kernel receive time stamps once connected.
+  bool                           m_UseKernelTimestamps;
+
+  // Messages waiting for the processing thread to send them.
+  NiftyLinkSendQueue             m_SendQueue;
+  bool                           m_CoalesceMessages;
+  igtlUint64                     m_NumberOfMessagesCoalesced;
+
+  // Time from Send() to the message being written to the socket.
+  NiftyLinkRunningStats          m_SendLatencyStats;
+
+  // Written by WakeUp(), and read by the processing loop, [0] to read and [1] to write, which are the
+  // same eventfd on Linux, or the same loopback UDP socket on Windows, or -1 if it couldn't be created.
+  int                            m_WakeUpDescriptors[2];
+
   // We track the last time we processed a real message (not a keep-alive), so we can avoid sending keep-alive if not needed.
   igtl::TimeStamp::Pointer       m_LastMessageProcessedTime;
 
   // This used for calculating stats.
-  QList<igtlUint64>              m_ListOfLatencies;
+  NiftyLinkRunningStats          m_LatencyStats;
 }; // end class
 
 } // end namespace niftk
@@ -0,0 +1,73 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkSendQueue.h"
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkSendQueue::NiftyLinkSendQueue()
+: m_Head(NULL)
+, m_Tail(NULL)
+{
+  m_Tail = new Node();
+  m_Head.fetchAndStoreOrdered(m_Tail);
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkSendQueue::~NiftyLinkSendQueue()
+{
+  igtl::MessageBase::Pointer message;
+  igtlUint64 timeQueued = 0;
+  while (this->Pop(message, timeQueued))
+  {
+  }
+  delete m_Tail;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSendQueue::Push(igtl::MessageBase::Pointer message, const igtlUint64& timeQueuedInNanoseconds)
+{
+  Node* node = new Node();
+  node->m_Message = message;
+  node->m_TimeQueued = timeQueuedInNanoseconds;
+
+  // Claim the newest position, then link the previous newest node to this one,
+  // releasing the contents of this node to the consumer.
+  Node* previous = m_Head.fetchAndStoreOrdered(node);
+  previous->m_Next.fetchAndStoreRelease(node);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkSendQueue::Pop(igtl::MessageBase::Pointer& message, igtlUint64& timeQueuedInNanoseconds)
+{
+  Node* next = m_Tail->m_Next.fetchAndAddAcquire(0);
+  if (next == NULL)
+  {
+    return false;
+  }
+
+  // The next node becomes the empty tail, once its contents are taken.
+  message = next->m_Message;
+  timeQueuedInNanoseconds = next->m_TimeQueued;
+  next->m_Message = NULL;
+
+  delete m_Tail;
+  m_Tail = next;
+
+  return true;
+}
+
+} // end namespace niftk
@@ -0,0 +1,74 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkSendQueue_h
+#define NiftyLinkSendQueue_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <igtlMessageBase.h>
+
+#include <QAtomicPointer>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkSendQueue
+* \brief Lock-free queue of messages waiting to be sent, which any number of threads may Push() onto,
+* and one thread, (the thread that owns the socket), may Pop() from.
+*
+* Each Push() allocates one node, and swaps it in as the newest with a single atomic exchange, so producers
+* never wait for each other, or for the consumer. The consumer owns the oldest node, so Pop() needs no atomic
+* read-modify-write at all. While a Push() is between its exchange and linking the node in, Pop() sees
+* the queue as ending before that node, so the consumer should be woken up after each Push(), and try again.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkSendQueue
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkSendQueue();
+
+  /// \brief Destructor, which discards anything still queued.
+  ~NiftyLinkSendQueue();
+
+  /// \brief Adds a message, and the time it was queued, and can be called from any thread.
+  void Push(igtl::MessageBase::Pointer message, const igtlUint64& timeQueuedInNanoseconds);
+
+  /// \brief Removes the oldest message, and must only be called from one thread.
+  /// \return false, leaving the arguments unchanged, if the queue is empty.
+  bool Pop(igtl::MessageBase::Pointer& message, igtlUint64& timeQueuedInNanoseconds);
+
+private:
+
+  NiftyLinkSendQueue(const NiftyLinkSendQueue&); // Purposefully not implemented.
+  void operator=(const NiftyLinkSendQueue&); // Purposefully not implemented.
+
+  struct Node
+  {
+    QAtomicPointer<Node>       m_Next;
+    igtl::MessageBase::Pointer m_Message;
+    igtlUint64                 m_TimeQueued;
+  };
+
+  // The newest node, exchanged by producers.
+  QAtomicPointer<Node>         m_Head;
+
+  // The oldest node, whose message has already been popped, (or the initial empty node), only used by the consumer.
+  Node*                        m_Tail;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkSendQueue_h
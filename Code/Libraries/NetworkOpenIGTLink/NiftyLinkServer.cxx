@@ -63,6 +63,20 @@ int NiftyLinkServer::GetTimeToWaitForClientConnections()
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkServer::SetUseKernelTimestamps(const bool& isOn)
+{
+  m_ServerProcess->SetUseKernelTimestamps(isOn);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkServer::SetCoalesceMessages(const bool& isOn)
+{
+  m_ServerProcess->SetCoalesceMessages(isOn);
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkServer::Start(const int& portNumber)
 {
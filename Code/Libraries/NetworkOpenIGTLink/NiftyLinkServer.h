@@ -49,7 +49,8 @@ public:
   /// \brief Starts the server, and binds to a specific port number.
   void Start(const int& portNumber);
 
-  /// \brief Sends an OpenIGTLink message (blocking).
+  /// \brief Queues an OpenIGTLink message to be sent by the server's own thread, without blocking,
+  /// see NiftyLinkNetworkProcess::Send().
   void Send(igtl::MessageBase::Pointer msg);
 
   /// \brief Stops this server.
@@ -62,6 +63,13 @@ public:
   /// \brief Returns the time to wait for client connections.
   int GetTimeToWaitForClientConnections();
 
+  /// \brief Turns on, or off, (the default), kernel receive time stamps, see NiftyLinkNetworkProcess::SetUseKernelTimestamps().
+  /// Must be called before Start().
+  void SetUseKernelTimestamps(const bool& isOn);
+
+  /// \brief Turns on, or off, (the default), coalescing queued messages, see NiftyLinkNetworkProcess::SetCoalesceMessages().
+  void SetCoalesceMessages(const bool& isOn);
+
 signals:
 
   /// \brief This signal is emitted when a client connects to this server.
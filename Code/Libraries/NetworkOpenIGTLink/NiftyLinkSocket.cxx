@@ -33,6 +33,9 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
 #endif
 
 #include <fcntl.h>
@@ -43,12 +46,31 @@
 namespace niftk
 {
 
+// The most buffers passed to one sendmsg/WSASend call, well below IOV_MAX on all platforms.
+static const int NIFTYLINK_MAXIMUM_BUFFERS_PER_CALL = 64;
+
+// While the send buffer is full, Send() tries again at least this often, in milliseconds. The socket is only
+// reported writable once a good part of the buffer is free, (a third, for TCP), which on a congested link can
+// take tens of milliseconds, whereas trying again uses any space as soon as it appears.
+static const int NIFTYLINK_SEND_RETRY_INTERVAL = 1;
+
 //-----------------------------------------------------------------------------
 NiftyLinkSocket::NiftyLinkSocket()
 : m_TimeoutFlag(0)
+, m_KernelTimestampsFlag(0)
 , m_SendTimeStamp(0)
 , m_ReceiveTimeStamp(0)
+, m_SendStartTimeStamp(0)
+, m_SendWaitTimeout(1000)
+, m_NumberOfBytesSent(0)
+, m_SendDurationInNanoseconds(0)
+, m_ReadBufferStart(0)
+, m_ReadBufferCount(0)
+, m_NumberOfReceiveSystemCalls(0)
 {
+  m_SendTimeStamp = igtl::TimeStamp::New();
+  m_SendStartTimeStamp = igtl::TimeStamp::New();
+  m_ReceiveTimeStamp = igtl::TimeStamp::New();
 }
 
 
@@ -104,102 +126,303 @@ int NiftyLinkSocket::GetPort()
 
 //-----------------------------------------------------------------------------
 int NiftyLinkSocket::Send(const void* data, int length)
+{
+  SendBuffer buffer;
+  buffer.m_Data   = data;
+  buffer.m_Length = length;
+
+  return this->Send(&buffer, 1);
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::Send(const SendBuffer* buffers, int numberOfBuffers)
 {
   if (!this->GetConnected())
   {
     return -1;
   }
 
-  if (length == 0)
+  if (numberOfBuffers < 0 || (numberOfBuffers > 0 && buffers == NULL))
   {
-    // nothing to send.
-    return 1;
+    return -1;
   }
 
-  int rVal     = 0;
-  u_long iMode = 1;
+  m_SendStartTimeStamp->GetTime();
+  const igtlUint64 startTime = m_SendStartTimeStamp->GetTimeStampInNanoseconds();
 
-  // Will set socket to blocking mode if working on large messages
-  //if (length > 1000)
-  //  iMode = 0;
-
-  //std::cerr <<"Preparing to send...";
-  const char* buffer = reinterpret_cast<const char*>(data);
-  int total = 0;
-  int trys  = 0;
+  int rVal     = 0;
+  int flags    = 0;
 
-  int flags;
   #if defined(_WIN32) && !defined(__CYGWIN__)
-  flags = 0; //disable signal on Win boxes.
+  u_long iMode = 1;
   rVal  = ioctlsocket(this->m_SocketDescriptor, FIONBIO, &iMode);
 
   #elif defined(__linux__)
-  flags = MSG_NOSIGNAL; //disable signal on Unix boxes.
-  rVal |= ioctl(this->m_SocketDescriptor, FIONBIO, &iMode);
+  flags = MSG_NOSIGNAL | MSG_DONTWAIT; // disable signal, and don't block, without changing the socket's mode.
 
   #elif defined(__APPLE__)
   int opt=1;
   rVal  = setsockopt(this->m_SocketDescriptor, SOL_SOCKET, SO_NOSIGPIPE, (char*) &opt, sizeof(int));
-  rVal |= ioctl(this->m_SocketDescriptor, FIONBIO, &iMode);
-  flags = SO_NOSIGPIPE; //disable signal on Mac boxes.
+  flags = MSG_DONTWAIT; // SO_NOSIGPIPE above disables the signal on Mac boxes.
+
+  #else
+  flags = MSG_DONTWAIT;
   #endif
 
-  if (rVal < 0)    // ioctl error
+  if (rVal < 0)    // ioctl/setsockopt error
   {
      igtlSocketErrorMacro(<< "ioctl");
      return -2;
   }
 
-  do
+  int        bufferIndex = 0; // first buffer not completely sent
+  int        offset      = 0; // number of bytes of that buffer already sent
+  igtlUint64 total       = 0;
+  igtlUint64 stallTime   = 0;
+  bool       hasStalled  = false;
+
+  while (bufferIndex < numberOfBuffers)
   {
-    int n = 0;
+    // Gather as many of the remaining buffers as fit in one call.
+    #if defined(_WIN32) && !defined(__CYGWIN__)
+    WSABUF vectors[NIFTYLINK_MAXIMUM_BUFFERS_PER_CALL];
+    #else
+    struct iovec vectors[NIFTYLINK_MAXIMUM_BUFFERS_PER_CALL];
+    #endif
 
-    try
+    int numberOfVectors = 0;
+    for (int i = bufferIndex; i < numberOfBuffers && numberOfVectors < NIFTYLINK_MAXIMUM_BUFFERS_PER_CALL; i++)
     {
-      n = send(this->m_SocketDescriptor, buffer+total, length-total, flags);
+      const int start = (i == bufferIndex ? offset : 0);
+      if (buffers[i].m_Length - start > 0)
+      {
+        char* data = const_cast<char*>(reinterpret_cast<const char*>(buffers[i].m_Data)) + start;
+        #if defined(_WIN32) && !defined(__CYGWIN__)
+        vectors[numberOfVectors].buf = data;
+        vectors[numberOfVectors].len = buffers[i].m_Length - start;
+        #else
+        vectors[numberOfVectors].iov_base = data;
+        vectors[numberOfVectors].iov_len  = buffers[i].m_Length - start;
+        #endif
+        numberOfVectors++;
+      }
     }
 
-    catch (std::exception& e)
+    if (numberOfVectors == 0)
     {
-      std::cerr << e.what() << std::endl;
-      return -3;
+      // Only empty buffers left.
+      break;
     }
 
-    if (n <= 0)
+    igtlUint64 n = 0;
+    bool isFull = false;
+
+    try
     {
       #if defined(_WIN32) && !defined(__CYGWIN__)
-      int error = WSAGetLastError();
-      trys++;
-
-      if (((error == WSAENOBUFS) && (trys < 1000)) || ((error == WSAEWOULDBLOCK) && (trys < 1000)))
+      DWORD bytesSent = 0;
+      if (WSASend(this->m_SocketDescriptor, vectors, numberOfVectors, &bytesSent, flags, NULL, NULL) == SOCKET_ERROR)
       {
-        igtl::Sleep(1);
-        continue;
+        int error = WSAGetLastError();
+        if (error != WSAEWOULDBLOCK && error != WSAENOBUFS)
+        {
+          igtlSocketErrorMacro(<< "sendfail");
+          return -1;
+        }
+        isFull = true;
       }
+      n = bytesSent;
       #else
-      int error = errno;
+      struct msghdr message;
+      memset(&message, 0, sizeof(message));
+      message.msg_iov    = vectors;
+      message.msg_iovlen = numberOfVectors;
 
-      if ((error == EWOULDBLOCK) && (++trys < 1000))
+      ssize_t bytesSent = sendmsg(this->m_SocketDescriptor, &message, flags);
+      if (bytesSent < 0)
       {
-        igtl::Sleep(1);
-        continue;
+        int error = errno;
+        if (error == EINTR)
+        {
+          continue;
+        }
+        if (error != EWOULDBLOCK && error != EAGAIN && error != ENOBUFS)
+        {
+          igtlSocketErrorMacro(<< "sendfail");
+          return -1;
+        }
+        isFull = true;
+      }
+      else
+      {
+        n = bytesSent;
       }
       #endif
+    }
+    catch (std::exception& e)
+    {
+      std::cerr << e.what() << std::endl;
+      return -3;
+    }
 
-      igtlSocketErrorMacro(<< "sendfail");
-      return -1;
+    if (isFull)
+    {
+      // The socket's send buffer is full, so sleep until there is room, or the deadline.
+      m_SendTimeStamp->GetTime();
+      const igtlUint64 stallStarted = m_SendTimeStamp->GetTimeStampInNanoseconds();
+      const igtlUint64 elapsed = (stallStarted - startTime) / 1000000;
+
+      int waitResult = 0;
+      if (elapsed < static_cast<igtlUint64>(m_SendWaitTimeout))
+      {
+        const int remaining = m_SendWaitTimeout - static_cast<int>(elapsed);
+        waitResult = this->WaitForWritable(remaining < NIFTYLINK_SEND_RETRY_INTERVAL ? remaining : NIFTYLINK_SEND_RETRY_INTERVAL);
+        if (waitResult == 0 && remaining > NIFTYLINK_SEND_RETRY_INTERVAL)
+        {
+          // Not the deadline yet, so just try again.
+          waitResult = 1;
+        }
+      }
+
+      m_SendTimeStamp->GetTime();
+      stallTime += m_SendTimeStamp->GetTimeStampInNanoseconds() - stallStarted;
+      hasStalled = true;
+
+      if (waitResult < 0)
+      {
+        return -1;
+      }
+      if (waitResult == 0)
+      {
+        igtlSocketErrorMacro(<< "send timed out");
+        m_SendStallStats.Add(stallTime);
+        return -4;
+      }
+      continue;
     }
 
     total += n;
 
-  } while(total < length);
+    // Move past everything sent, which may end part way through a buffer.
+    while (n > 0 && bufferIndex < numberOfBuffers)
+    {
+      const igtlUint64 remaining = buffers[bufferIndex].m_Length > offset ? buffers[bufferIndex].m_Length - offset : 0;
+      if (n >= remaining)
+      {
+        n -= remaining;
+        bufferIndex++;
+        offset = 0;
+      }
+      else
+      {
+        offset += static_cast<int>(n);
+        n = 0;
+      }
+    }
+  }
 
   // Record the software timestamp as the message left the device
-  m_SendTimeStamp = igtl::TimeStamp::New();
+  m_SendTimeStamp->GetTime();
+
+  m_NumberOfBytesSent += total;
+  m_SendDurationInNanoseconds += m_SendTimeStamp->GetTimeStampInNanoseconds() - startTime;
+  if (hasStalled)
+  {
+    m_SendStallStats.Add(stallTime);
+  }
+
   return 1;
 }
 
 
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::WaitForWritable(int timeout)
+{
+  #if defined(_WIN32) && !defined(__CYGWIN__)
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(this->m_SocketDescriptor, &writeSet);
+
+  struct timeval waitTime;
+  waitTime.tv_sec  = timeout/1000;
+  waitTime.tv_usec = (timeout%1000) * 1000;
+
+  int rVal = select(0, NULL, &writeSet, NULL, &waitTime);
+  if (rVal == SOCKET_ERROR)
+  {
+    igtlSocketErrorMacro(<< "select");
+    return -1;
+  }
+  return rVal > 0 ? 1 : 0;
+  #else
+  struct pollfd descriptor;
+  descriptor.fd      = this->m_SocketDescriptor;
+  descriptor.events  = POLLOUT;
+  descriptor.revents = 0;
+
+  int rVal = 0;
+  do
+  {
+    rVal = poll(&descriptor, 1, timeout);
+  } while (rVal < 0 && errno == EINTR);
+
+  if (rVal < 0)
+  {
+    igtlSocketErrorMacro(<< "poll");
+    return -1;
+  }
+
+  // On error or hang up, say writable, so the next send reports the error.
+  return rVal > 0 ? 1 : 0;
+  #endif
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocket::SetSendWaitTimeout(int timeout)
+{
+  m_SendWaitTimeout = timeout;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::GetSendWaitTimeout() const
+{
+  return m_SendWaitTimeout;
+}
+
+
+//-----------------------------------------------------------------------------
+igtlUint64 NiftyLinkSocket::GetNumberOfBytesSent() const
+{
+  return m_NumberOfBytesSent;
+}
+
+
+//-----------------------------------------------------------------------------
+igtlUint64 NiftyLinkSocket::GetSendDurationInNanoseconds() const
+{
+  return m_SendDurationInNanoseconds;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRunningStats NiftyLinkSocket::GetSendStallStats() const
+{
+  return m_SendStallStats;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocket::ResetSendStats()
+{
+  m_NumberOfBytesSent = 0;
+  m_SendDurationInNanoseconds = 0;
+  m_SendStallStats.Reset();
+}
+
+
 //-----------------------------------------------------------------------------
 int NiftyLinkSocket::Receive(void* data, int length, int readFully/*=1*/)
 {
@@ -211,18 +434,42 @@ int NiftyLinkSocket::Receive(void* data, int length, int readFully/*=1*/)
   char* buffer = reinterpret_cast<char*>(data);
   int total       = 0;
   //int rVal        = 0;
-  int flags       = 0;
   int trys        = 0;
 
+  // Without the read buffer, CheckPendingData() sets the socket non-blocking, but with it, nothing does,
+  // so don't block, (and stall sending, on the same thread), waiting for the rest of a large read.
+  #if defined(_WIN32) && !defined(__CYGWIN__)
+  int flags       = 0;  // The socket is set non-blocking by CheckPendingData().
+  #else
+  int flags       = MSG_DONTWAIT;
+  #endif
+
+  // Anything already buffered comes first.
+  total = this->ReadFromBuffer(buffer, length);
+  if (total == length || (total > 0 && !readFully))
+  {
+    return total;
+  }
+
   // Receive a generic message
   do
   {
     int bytesRead   = 0;
 
+    // Small reads go via the read buffer, (which is empty by now), large ones straight into the caller's memory.
+    const bool isBuffered = length - total < static_cast<int>(m_ReadBuffer.size());
+
     // Try reading from the socket
     try
     {
-      bytesRead = recv(this->m_SocketDescriptor, buffer+total, length-total, flags);
+      if (isBuffered)
+      {
+        bytesRead = this->FillReadBuffer();
+      }
+      else
+      {
+        bytesRead = this->ReceiveWithTimestamp(buffer+total, length-total, flags, total == 0);
+      }
     }
     catch (std::exception& e)
     {
@@ -259,7 +506,14 @@ int NiftyLinkSocket::Receive(void* data, int length, int readFully/*=1*/)
       return bytesRead;
     }
 
-    total += bytesRead;
+    if (isBuffered)
+    {
+      total += this->ReadFromBuffer(buffer+total, length-total);
+    }
+    else
+    {
+      total += bytesRead;
+    }
 
   } while(readFully && total < length);
 
@@ -267,6 +521,180 @@ int NiftyLinkSocket::Receive(void* data, int length, int readFully/*=1*/)
 }
 
 
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::SetReadBufferSize(int size)
+{
+  if (m_ReadBufferCount > 0)
+  {
+    return -1;
+  }
+
+  m_ReadBuffer.resize(size > 0 ? size : 0);
+  m_ReadBufferStart = 0;
+
+  return static_cast<int>(m_ReadBuffer.size());
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::GetReadBufferSize() const
+{
+  return static_cast<int>(m_ReadBuffer.size());
+}
+
+
+//-----------------------------------------------------------------------------
+igtlUint64 NiftyLinkSocket::GetNumberOfReceiveSystemCalls() const
+{
+  return m_NumberOfReceiveSystemCalls;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::ReadFromBuffer(char* data, int length)
+{
+  const int capacity = static_cast<int>(m_ReadBuffer.size());
+  const int total = length < m_ReadBufferCount ? length : m_ReadBufferCount;
+
+  int copied = 0;
+  while (copied < total)
+  {
+    // At most twice, if the data wraps round the end of the buffer.
+    int n = capacity - m_ReadBufferStart;
+    if (n > total - copied)
+    {
+      n = total - copied;
+    }
+    memcpy(data + copied, &m_ReadBuffer[m_ReadBufferStart], n);
+
+    copied += n;
+    m_ReadBufferStart = (m_ReadBufferStart + n) % capacity;
+    m_ReadBufferCount -= n;
+  }
+
+  if (m_ReadBufferCount == 0)
+  {
+    // So the next fill gets the whole buffer in one go.
+    m_ReadBufferStart = 0;
+  }
+  return copied;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::FillReadBuffer()
+{
+  const int capacity = static_cast<int>(m_ReadBuffer.size());
+  const int end = (m_ReadBufferStart + m_ReadBufferCount) % capacity;
+
+  // Only the contiguous free space, so one recv() is enough. Any space before
+  // m_ReadBufferStart, (if the free space wraps round), is used by the next fill.
+  int space = 0;
+  if (m_ReadBufferCount < capacity)
+  {
+    space = (end >= m_ReadBufferStart ? capacity : m_ReadBufferStart) - end;
+  }
+  if (space == 0)
+  {
+    return 0;
+  }
+
+  #if defined(_WIN32) && !defined(__CYGWIN__)
+  int flags = 0;  // The socket is set non-blocking by CheckPendingData().
+  #else
+  int flags = MSG_DONTWAIT;
+  #endif
+
+  int bytesRead = this->ReceiveWithTimestamp(&m_ReadBuffer[end], space, flags, true);
+  if (bytesRead > 0)
+  {
+    m_ReadBufferCount += bytesRead;
+
+    if (!this->m_KernelTimestampsFlag)
+    {
+      // The buffered data arrived no later than now, which is as close as we can tell.
+      igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+      m_ReceiveTimeStamp = ts;
+    }
+  }
+  return bytesRead;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::ReceiveWithTimestamp(char* data, int length, int flags, bool isFirst)
+{
+  #if defined(__linux__)
+  if (this->m_KernelTimestampsFlag)
+  {
+    struct iovec vector;
+    vector.iov_base = data;
+    vector.iov_len  = length;
+
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov        = &vector;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    m_NumberOfReceiveSystemCalls++;
+    int bytesRead = recvmsg(this->m_SocketDescriptor, &message, flags);
+    if (bytesRead > 0 && isFirst)
+    {
+      igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+      for (struct cmsghdr* c = CMSG_FIRSTHDR(&message); c != NULL; c = CMSG_NXTHDR(&message, c))
+      {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          struct timespec kernelTime;
+          memcpy(&kernelTime, CMSG_DATA(c), sizeof(kernelTime));
+          ts->SetTimeInNanoseconds(static_cast<igtlUint64>(kernelTime.tv_sec) * 1000000000 + kernelTime.tv_nsec);
+        }
+      }
+      // Some sockets, (eg. a socketpair), accept SO_TIMESTAMPNS but never send the time stamp,
+      // in which case this falls back to now, as if kernel time stamps were off.
+      m_ReceiveTimeStamp = ts;
+    }
+    return bytesRead;
+  }
+  #else
+  (void)isFirst;
+  #endif
+
+  m_NumberOfReceiveSystemCalls++;
+  return recv(this->m_SocketDescriptor, data, length, flags);
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::SetKernelReceiveTimestamps(int sw)
+{
+  if (!this->GetConnected())
+  {
+    return -1;
+  }
+
+  #if defined(__linux__)
+  int opt = sw ? 1 : 0;
+  if (setsockopt(this->m_SocketDescriptor, SOL_SOCKET, SO_TIMESTAMPNS, (char*) &opt, sizeof(int)) < 0)
+  {
+    igtlSocketErrorMacro(<< "setsockopt");
+    this->m_KernelTimestampsFlag = 0;
+    return -1;
+  }
+  this->m_KernelTimestampsFlag = opt;
+  #else
+  (void)sw;
+  this->m_KernelTimestampsFlag = 0;
+  #endif
+
+  return this->m_KernelTimestampsFlag;
+}
+
+
 //-----------------------------------------------------------------------------
 int NiftyLinkSocket::SetTimeout(int timeout)
 {
@@ -311,6 +739,93 @@ int NiftyLinkSocket::CheckPendingData()
   u_long iMode = 1; // non-blocking mode
   igtl::TimeStamp::Pointer ts;
 
+  if (!m_ReadBuffer.empty())
+  {
+    #if defined(_WIN32) && !defined(__CYGWIN__)
+    if (m_ReadBufferCount == 0)
+    {
+      m_NumberOfReceiveSystemCalls++;
+      if (ioctlsocket(this->m_SocketDescriptor, FIONBIO, &iMode) < 0)
+      {
+        igtlSocketErrorMacro(<< "ioctl");
+        return -3;
+      }
+    }
+    #endif
+
+    // Keepalives, (see Poke()), arrive between messages, which is where the buffered data starts,
+    // and no OpenIGTLink header starts with "??", so they are discarded here, as in the unbuffered case below.
+    const int capacity = static_cast<int>(m_ReadBuffer.size());
+    bool isKeepAlive = false;
+    bool isClosed = false;
+    for (;;)
+    {
+      const bool isFirstByteKeepAlive = m_ReadBufferCount > 0 && m_ReadBuffer[m_ReadBufferStart] == '?';
+      if (m_ReadBufferCount == 0 || (m_ReadBufferCount == 1 && isFirstByteKeepAlive))
+      {
+        // Filling the buffer costs one recv(), rather than the two ioctls below, and the data is needed anyway.
+        int bytesRead = this->FillReadBuffer();
+        if (bytesRead < 0)
+        {
+          #if defined(_WIN32) && !defined(__CYGWIN__)
+          int error = WSAGetLastError();
+          if (error != WSAEWOULDBLOCK && error != WSAENOBUFS)
+          #else
+          int error = errno;
+          if (error != EWOULDBLOCK && error != EAGAIN && error != EINTR)
+          #endif
+          {
+            igtlSocketErrorMacro(<< "recv");
+            return -3;
+          }
+        }
+        if (bytesRead <= 0)
+        {
+          isClosed = bytesRead == 0;
+          break;
+        }
+      }
+      else if (m_ReadBufferCount >= 2 && isFirstByteKeepAlive
+               && m_ReadBuffer[(m_ReadBufferStart + 1) % capacity] == '?')
+      {
+        char buf[2];
+        this->ReadFromBuffer(buf, 2);
+        isKeepAlive = true;
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    if (m_ReadBufferCount == 1 && m_ReadBuffer[m_ReadBufferStart] == '?')
+    {
+      if (!isClosed)
+      {
+        // Half a keepalive, the rest of which is on its way.
+        return 2;
+      }
+      char buf[1];
+      this->ReadFromBuffer(buf, 1);
+    }
+    if (m_ReadBufferCount == 0)
+    {
+      if (isKeepAlive && !isClosed)
+      {
+        return 2;
+      }
+      // Only an actual end of file is reported as 0, which callers take as the other end closing.
+      // Otherwise, recv() was interrupted, or found nothing after all, so the caller should wait again.
+      return isClosed ? 0 : -5;
+    }
+    if (m_ReadBufferCount == 2)
+    {
+      // 2 means a keepalive, so report the start of a message as 1 byte, which is still readable in a single call.
+      return 1;
+    }
+    return m_ReadBufferCount;
+  }
+
   #if defined(_WIN32) && !defined(__CYGWIN__)
   u_long bytesToRead = 0;
   #else
@@ -318,6 +833,7 @@ int NiftyLinkSocket::CheckPendingData()
   #endif
 
   // Take a look at the buffer to find out the number of bytes that arrived (if any)
+  m_NumberOfReceiveSystemCalls += 2;
   try
   {
     #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -354,6 +870,7 @@ int NiftyLinkSocket::CheckPendingData()
       char buf[2];
       try
       {
+        m_NumberOfReceiveSystemCalls++;
         recv(this->m_SocketDescriptor,(char*)&buf, 2, 0);
       }
       catch (std::exception& e)
@@ -370,6 +887,92 @@ int NiftyLinkSocket::CheckPendingData()
 }
 
 
+//-----------------------------------------------------------------------------
+int NiftyLinkSocket::WaitForData(int timeout, int wakeUpDescriptor)
+{
+  if (!this->GetConnected())
+  {
+    return -1;
+  }
+
+  if (m_ReadBufferCount > 0)
+  {
+    // Already readable, without asking the socket.
+    return 1;
+  }
+
+  m_NumberOfReceiveSystemCalls++;
+
+  #if defined(_WIN32) && !defined(__CYGWIN__)
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(this->m_SocketDescriptor, &readSet);
+  if (wakeUpDescriptor >= 0)
+  {
+    FD_SET(static_cast<SOCKET>(wakeUpDescriptor), &readSet);
+  }
+
+  struct timeval waitTime;
+  waitTime.tv_sec  = timeout/1000;
+  waitTime.tv_usec = (timeout%1000) * 1000;
+
+  int rVal = select(0, &readSet, NULL, NULL, &waitTime);
+  if (rVal == SOCKET_ERROR)
+  {
+    igtlSocketErrorMacro(<< "select");
+    return -1;
+  }
+  if (FD_ISSET(this->m_SocketDescriptor, &readSet))
+  {
+    return 1;
+  }
+  if (wakeUpDescriptor >= 0 && FD_ISSET(static_cast<SOCKET>(wakeUpDescriptor), &readSet))
+  {
+    return 2;
+  }
+  return 0;
+  #else
+  struct pollfd descriptors[2];
+  int numberOfDescriptors = 1;
+
+  descriptors[0].fd      = this->m_SocketDescriptor;
+  descriptors[0].events  = POLLIN;
+  descriptors[0].revents = 0;
+
+  if (wakeUpDescriptor >= 0)
+  {
+    descriptors[1].fd      = wakeUpDescriptor;
+    descriptors[1].events  = POLLIN;
+    descriptors[1].revents = 0;
+    numberOfDescriptors    = 2;
+  }
+
+  int rVal = 0;
+  do
+  {
+    rVal = poll(descriptors, numberOfDescriptors, timeout);
+  } while (rVal < 0 && errno == EINTR);
+
+  if (rVal < 0)
+  {
+    igtlSocketErrorMacro(<< "poll");
+    return -1;
+  }
+
+  // Hang up and errors are reported as readable, so the following recv() reports them.
+  if (descriptors[0].revents & (POLLIN | POLLHUP | POLLERR))
+  {
+    return 1;
+  }
+  if (numberOfDescriptors == 2 && (descriptors[1].revents & POLLIN))
+  {
+    return 2;
+  }
+  return 0;
+  #endif
+}
+
+
 //-----------------------------------------------------------------------------
 bool NiftyLinkSocket::Poke()
 {
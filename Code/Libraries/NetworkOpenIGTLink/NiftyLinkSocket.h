@@ -13,10 +13,13 @@
 #define NiftyLinkSocket_h
 
 #include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkRunningStats.h>
 
 #include <igtlAbstractSocket.h>
 #include <igtlTimeStamp.h>
 
+#include <vector>
+
 namespace niftk
 {
 
@@ -53,11 +56,43 @@ public:
 
 public:
 
+  /// Description:
+  /// One of several buffers to send in one go, see Send(const SendBuffer*, int).
+  struct SendBuffer
+  {
+    const void* m_Data;
+    int         m_Length;
+  };
+
   /// Description:
   /// These methods send data over the socket.
   /// Returns 1 on success, negative numbers on failure.
   virtual int Send(const void* data, int length);
 
+  /// Description:
+  /// Sends several buffers, (eg. a header and a body, or several messages), as if they
+  /// were one contiguous buffer, with as few system calls as possible, (sendmsg, or WSASend on Windows).
+  /// While the socket's send buffer is full, waits for it to become writable, or 1 ms, whichever
+  /// is sooner, and tries again, for at most the send wait timeout in total.
+  /// Returns 1 on success, negative numbers on failure, (-4 if the send wait timeout expired).
+  int Send(const SendBuffer* buffers, int numberOfBuffers);
+
+  /// Description:
+  /// Sets the longest time, in milliseconds, that one call to Send() waits for the socket
+  /// to become writable, default 1000.
+  void SetSendWaitTimeout(int timeout);
+  int GetSendWaitTimeout() const;
+
+  /// Description:
+  /// Send statistics since the last call to ResetSendStats(): the number of bytes sent,
+  /// the total time spent in Send(), (so throughput is bytes sent over that time),
+  /// and the time in nanoseconds that each call to Send() spent waiting for the socket to become
+  /// writable, counting only the calls that had to wait.
+  igtlUint64 GetNumberOfBytesSent() const;
+  igtlUint64 GetSendDurationInNanoseconds() const;
+  NiftyLinkRunningStats GetSendStallStats() const;
+  void ResetSendStats();
+
   /// Description:
   /// Receive data from the socket.
   /// This call blocks until some data is read from the socket.
@@ -87,12 +122,47 @@ public:
   /// Should not be called. Implemented to fullfill base class API.
   virtual int SetSendBlocking(int sw);
 
+  /// Description:
+  /// Turns on, (sw=1), or off, (sw=0), kernel receive time stamps, (SO_TIMESTAMPNS), which are then
+  /// read by Receive(), so GetReceiveTimestampInNanoseconds() returns when the kernel received the first
+  /// bytes of the last Receive() call, rather than when CheckPendingData() noticed them. Call after connecting.
+  /// If the kernel sends no time stamp, (eg. on a socketpair), the time Receive() read the data is used instead.
+  /// Returns 1 if on, 0 if off or not supported, (only Linux is), -1 on error.
+  int SetKernelReceiveTimestamps(int sw);
+
+  /// Description:
+  /// Sets the size in bytes of the read buffer, default 0, which turns it off.
+  /// When on, Receive() serves small reads, (eg. a header, or the body of a TDATA message), from a ring buffer,
+  /// which is refilled with one recv() of as much as is available, so several small messages cost one system call.
+  /// Reads at least as large as the buffer, (eg. the body of an image), bypass it once it is empty.
+  /// Returns the new size, or -1, leaving the size unchanged, if data is buffered.
+  int SetReadBufferSize(int size);
+  int GetReadBufferSize() const;
+
+  /// Description:
+  /// Returns the number of system calls made to receive data, (poll, ioctl, recv), so
+  /// dividing by the number of messages received gives the system calls per message.
+  igtlUint64 GetNumberOfReceiveSystemCalls() const;
+
   /// Description:
   /// Check socket for pending data.
   /// This call returns the amount of data that can be read in a single call,
   /// which may not be the same as the total amount of data queued on the socket.
+  /// With a read buffer, this is the amount buffered, and if none, it tries to fill the buffer first.
+  /// Either way, keepalives, (see Poke()), are discarded, and 2 is returned if that is all there was.
+  /// So with a read buffer, the first 2 bytes of a message are reported as 1, 0 only if the other end closed
+  /// the connection, and -5 if there was nothing to read after all, (eg. recv() was interrupted), so wait again.
+  /// Other negative numbers are errors.
   int CheckPendingData(void);
 
+  /// Description:
+  /// Waits up to timeout milliseconds for data to arrive, or the remote to close the connection,
+  /// without spinning. If wakeUpDescriptor is not -1, the wait also ends when it becomes readable,
+  /// so another thread can interrupt the wait by writing to it. The caller must read it to clear it.
+  /// On Windows, wakeUpDescriptor must be a socket, as select() only waits on sockets.
+  /// Returns 1 if the socket is readable, 2 if woken up, 0 on timeout, -1 on error.
+  int WaitForData(int timeout, int wakeUpDescriptor=-1);
+
   /// Description:
   /// This method is for checking if the socket is OK for writing or not.
   /// It sends a 2 byte message through, returns with false if not possible.
@@ -119,6 +189,24 @@ protected:
 
 private:
 
+  /// Description:
+  /// Waits up to timeout milliseconds for the socket to become writable.
+  /// Returns 1 if writable, 0 on timeout, -1 on error.
+  int WaitForWritable(int timeout);
+
+  /// Description:
+  /// As recv(), but if kernel receive time stamps are on, and isFirst is true, stores the time stamp, (or now, if none), in m_ReceiveTimeStamp.
+  int ReceiveWithTimestamp(char* data, int length, int flags, bool isFirst);
+
+  /// Description:
+  /// Copies up to length bytes out of the read buffer, returning the number copied.
+  int ReadFromBuffer(char* data, int length);
+
+  /// Description:
+  /// Reads, without blocking, as much as fits in the contiguous free space of the read buffer, in one recv(),
+  /// and records the receive time stamp. Returns as recv().
+  int FillReadBuffer();
+
   NiftyLinkSocket(const NiftyLinkSocket&); // Not implemented.
   void operator=(const NiftyLinkSocket&); // Not implemented.
 
@@ -130,8 +218,20 @@ private:
   struct timeval m_OrigTimeout;
 #endif
   int                      m_TimeoutFlag;
+  int                      m_KernelTimestampsFlag;
   igtl::TimeStamp::Pointer m_ReceiveTimeStamp;
   igtl::TimeStamp::Pointer m_SendTimeStamp;
+  igtl::TimeStamp::Pointer m_SendStartTimeStamp;
+  int                      m_SendWaitTimeout;
+  igtlUint64               m_NumberOfBytesSent;
+  igtlUint64               m_SendDurationInNanoseconds;
+  NiftyLinkRunningStats    m_SendStallStats;
+
+  // The read buffer holds m_ReadBufferCount bytes starting at m_ReadBufferStart, wrapping round at the end.
+  std::vector<char>        m_ReadBuffer;
+  int                      m_ReadBufferStart;
+  int                      m_ReadBufferCount;
+  igtlUint64               m_NumberOfReceiveSystemCalls;
 
 }; // NiftyLinkSocket_h
 
@@ -11,7 +11,6 @@
 =============================================================================*/
 
 #include "NiftyLinkSenderProcess.h"
-#include <NiftyLinkQThread.h>
 #include "igtlOSUtil.h"
 
 namespace niftk
@@ -24,6 +23,9 @@ NiftyLinkSenderProcess::NiftyLinkSenderProcess(QObject *parent)
   m_SendingOnSocket = false;
   m_ConnectTimeout = 5;
   m_KeepAliveTimeout = 500;
+  m_QueuePolicy = LATEST_ONLY;
+  m_MaximumQueueSize = 100;
+  m_NumberOfMessagesDropped = 0;
   m_Hostname.clear();
 }
 
@@ -147,7 +149,12 @@ void NiftyLinkSenderProcess::StartProcess(void)
 void NiftyLinkSenderProcess::StopProcess(void)
 {
   QLOG_INFO() << objectName() << ": " << "Attempting to stop sender process... (stopProcess()) \n";
+
+  // Set under the queue mutex, so the sender loop either sees it before waiting, or is woken up.
+  m_QueueMutex.lock();
   m_Running = false;  //stops the process
+  m_QueueNotEmpty.wakeAll();
+  m_QueueMutex.unlock();
 }
 
 
@@ -194,7 +201,12 @@ void NiftyLinkSenderProcess::TerminateProcess()
   }
 
   m_SendingOnSocket = false;
+
+  m_QueueMutex.lock();
+  m_NumberOfMessagesDropped += m_SendQue.size();
   m_SendQue.clear();
+  QLOG_INFO() << objectName() << ": " << "Total number of messages dropped: " << m_NumberOfMessagesDropped;
+  m_QueueMutex.unlock();
 
   disconnect(this, SIGNAL(StartWorkingSignal()), this, SLOT(DoProcessing()));
 
@@ -253,34 +265,17 @@ bool NiftyLinkSenderProcess::Activate(void)
 //-----------------------------------------------------------------------------
 void NiftyLinkSenderProcess::OnKeepAliveTimeout(void)
 {
-  int sleepInterval = m_KeepAliveTimeout / 2;
-
   QLOG_INFO() << objectName() << ": " << "KeepAliveTimeout occured: " << m_KeepAliveTimeout << ", ms";
 
   // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  // If the sendqueue is empty we're going to perform a keepalive - send 2 bytes through the socket
+  // If the sendqueue is empty we're going to perform a keepalive - send 2 bytes through the socket.
+  // The timer interval paces these, so there is no need to sleep here, which would delay queued messages.
   bool queueisempty;
   m_QueueMutex.lock();
   queueisempty = m_SendQue.isEmpty();
   m_QueueMutex.unlock();
   if (queueisempty)
   {
-    NiftyLinkQThread * p = NULL;
-    try
-    {
-      p = dynamic_cast<NiftyLinkQThread *>(QThread::currentThread());
-
-//      QLOG_DEBUG() << objectName() << "Before keep alive check: Send queue to host "
-//                   << QString::fromStdString(m_Hostname) << ", port " << m_Port << ", is empty, so sleeping for "
-//                   << sleepInterval << " ms\n";
-
-      p->SleepCallingThread(sleepInterval);
-    }
-    catch (std::exception &e)
-    {
-      qDebug() << "Type cast error. Always run this process from NiftyLinkQThread. Exception: " << e.what();
-    }
-
     bool rval;
     m_Mutex->lock();
     rval = m_ExtSocket->Poke();
@@ -303,18 +298,24 @@ void NiftyLinkSenderProcess::OnKeepAliveTimeout(void)
       //QCoreApplication::processEvents();
       return;
     }
+  }
+}
 
-    //QCoreApplication::processEvents();
 
-    if (p != NULL)
-    {
-//      QLOG_DEBUG() << objectName() <<": " <<"After keep alive check: Send queue to host "
-//                   << QString::fromStdString(m_Hostname) << ", port " << m_Port << ", is empty, so sleeping for "
-//                   << sleepInterval << " ms\n";
+//-----------------------------------------------------------------------------
+unsigned long NiftyLinkSenderProcess::GetWaitTimeout(void)
+{
+  int timeout = m_KeepAliveTimeout / 2;
 
-      p->SleepCallingThread(sleepInterval);
-    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5,0,0))
+  // Don't sleep through the keep-alive timer, as it is only processed between waits.
+  if (m_TimeOuter != NULL && m_TimeOuter->isActive())
+  {
+    timeout = qMin(timeout, qMax(m_TimeOuter->remainingTime(), 0));
   }
+#endif
+
+  return static_cast<unsigned long>(qMax(timeout, 0));
 }
 
 
@@ -374,26 +375,16 @@ void NiftyLinkSenderProcess::DoProcessing(void)
     bool queueisempty;
     m_QueueMutex.lock();
     queueisempty = m_SendQue.isEmpty();
+    if (queueisempty && m_Running)
+    {
+      // Sleep until AddMsgToSendQueue() or StopProcess() wakes us, or it is time to process events.
+      m_QueueNotEmpty.wait(&m_QueueMutex, this->GetWaitTimeout());
+    }
     m_QueueMutex.unlock();
     if (queueisempty)
     {
-      /*NiftyLinkQThread * p = NULL;
-      try
-      {
-        QLOG_DEBUG() << objectName() <<": " << "Send queue to host "
-                     << QString::fromStdString(m_Hostname) << ", port " << m_Port << ", is empty, so sleeping for "
-                     << sleepInterval << " ms\n";
-
-        p = dynamic_cast<NiftyLinkQThread *>(QThread::currentThread());
-        //p->MsleepEx(sleepInterval);
-      }
-      catch (std::exception &e)
-      {
-        qDebug() <<"Type cast error. Always run this process from NiftyLinkQThread. Exception: " <<e.what();
-      }*/
-
+      // Delivers the keep-alive timer, then go round again to pick up anything queued.
       QCoreApplication::processEvents();
-
     }
     else
     {
@@ -506,11 +497,26 @@ void NiftyLinkSenderProcess::DoProcessing(void)
 //-----------------------------------------------------------------------------
 void NiftyLinkSenderProcess::AddMsgToSendQueue(NiftyLinkMessage::Pointer msg)
 {
-  // Append message to the sendqueue
   m_QueueMutex.lock();
-  // only keep the most recent message
-  m_SendQue.clear();
+
+  if (m_QueuePolicy == LATEST_ONLY)
+  {
+    // only keep the most recent message
+    m_NumberOfMessagesDropped += m_SendQue.size();
+    m_SendQue.clear();
+  }
+  else
+  {
+    while (m_SendQue.size() >= m_MaximumQueueSize)
+    {
+      m_SendQue.removeFirst();
+      m_NumberOfMessagesDropped++;
+    }
+  }
+
+  // Append message to the sendqueue, and wake up the sender loop
   m_SendQue.append(msg);
+  m_QueueNotEmpty.wakeAll();
   m_QueueMutex.unlock();
 }
 
@@ -528,4 +534,46 @@ int NiftyLinkSenderProcess::GetConnectTimeOut(void)
   return m_ConnectTimeout;
 }
 
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSenderProcess::SetQueuePolicy(QueuePolicy policy)
+{
+  m_QueueMutex.lock();
+  m_QueuePolicy = policy;
+  m_QueueMutex.unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkSenderProcess::QueuePolicy NiftyLinkSenderProcess::GetQueuePolicy(void)
+{
+  QMutexLocker locker(&m_QueueMutex);
+  return m_QueuePolicy;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSenderProcess::SetMaximumQueueSize(int size)
+{
+  m_QueueMutex.lock();
+  m_MaximumQueueSize = qMax(size, 1);
+  m_QueueMutex.unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSenderProcess::GetMaximumQueueSize(void)
+{
+  QMutexLocker locker(&m_QueueMutex);
+  return m_MaximumQueueSize;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkSenderProcess::GetNumberOfMessagesDropped(void)
+{
+  QMutexLocker locker(&m_QueueMutex);
+  return m_NumberOfMessagesDropped;
+}
+
 } // end namespace niftk
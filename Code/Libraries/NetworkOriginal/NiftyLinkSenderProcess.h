@@ -15,6 +15,8 @@ See LICENSE.txt in the top level directory for details.
 
 #include "NiftyLinkProcessBase.h"
 
+#include <QWaitCondition>
+
 namespace niftk
 {
 
@@ -29,7 +31,15 @@ class NiftyLinkSenderProcessTester;
 * hostname and port or on a previously created socket pointer. When initilized using
 * hostname + port the Process will attempt to connect to the remote host and then enter an idle
 * loop waiting for messages. Data to be sent to the remote host are received via a QT slot
-* in the form of an NiftyLinkMessage. These messages are appended to the end of a message queue (FIFO).
+* in the form of an NiftyLinkMessage. These messages are added to a message queue, according to the queue policy:
+* <ul>
+* <li>LATEST_ONLY: the queue holds only the newest message, replacing any message not yet sent. This is the default.</li>
+* <li>FIFO: messages are appended, and sent in order, and once the queue holds SetMaximumQueueSize() messages,
+* the oldest is dropped to make room.</li>
+* </ul>
+* Messages replaced or dropped without being sent are counted by GetNumberOfMessagesDropped().
+* While the queue is empty, the sender loop waits on a condition signalled by AddMsgToSendQueue(),
+* so a new message is sent straight away, and wakes at least every half keep-alive interval to process timer events.
 */
 class NIFTYLINKCOMMON_WINEXPORT NiftyLinkSenderProcess : public NiftyLinkProcessBase
 {
@@ -37,6 +47,14 @@ class NIFTYLINKCOMMON_WINEXPORT NiftyLinkSenderProcess : public NiftyLinkProcess
 
   friend class NiftyLinkSocketObject;
 
+public:
+
+  enum QueuePolicy
+  {
+    LATEST_ONLY,
+    FIFO
+  };
+
 signals:
 
   /// \brief This signal is emitted when successfully connected to a remote host.
@@ -74,15 +92,30 @@ protected:
   /// \brief It returns the currently applied connection timeout in seconds.
   virtual int GetConnectTimeOut(void);
 
+  /// \brief Sets the queue policy, default LATEST_ONLY.
+  void SetQueuePolicy(QueuePolicy policy);
+
+  /// \brief Returns the queue policy.
+  QueuePolicy GetQueuePolicy(void);
+
+  /// \brief Sets the maximum number of messages queued with the FIFO policy, default 100, and at least 1.
+  void SetMaximumQueueSize(int size);
+
+  /// \brief Returns the maximum number of messages queued with the FIFO policy.
+  int GetMaximumQueueSize(void);
+
+  /// \brief Returns the number of messages replaced or dropped by the queue policy, or left unsent at termination.
+  quint64 GetNumberOfMessagesDropped(void);
+
 protected slots:
 
-  /// \brief This slot catches the Qt signal with the messages to be sent, appends the message to the message queue and starts the Process by calling start().
+  /// \brief This slot catches the Qt signal with the messages to be sent, adds the message to the message queue according to the queue policy, and wakes up the sender loop.
   virtual void AddMsgToSendQueue(NiftyLinkMessage::Pointer);
 
   /// \brief This slot catches the start request signal, checks if the Process was initialized, and it starts the main processing loop if it was.
   virtual void StartProcess();
 
-  /// \brief This slot catches the stop request signal, and stops the process (m_running = false)
+  /// \brief This slot catches the stop request signal, and stops the process (m_running = false), waking up the sender loop.
   virtual void StopProcess();
 
   /// \brief This function does the cleaning up after the process has stopped.
@@ -101,6 +134,9 @@ private:
   /// \brief Attempt to activate the Process: do an overall sanity check to see if all required objects / parameters are correctly initialized.
   virtual bool Activate(void);
 
+  /// \brief Returns how long, in msec, the sender loop may wait for a message before it must process timer events.
+  unsigned long GetWaitTimeout(void);
+
 private slots:
   void OnKeepAliveTimeout(void);
 
@@ -113,6 +149,10 @@ private:
 
   QList<NiftyLinkMessage::Pointer>      m_SendQue;
   QMutex                                m_QueueMutex;
+  QWaitCondition                        m_QueueNotEmpty;
+  QueuePolicy                           m_QueuePolicy;
+  int                                   m_MaximumQueueSize;
+  quint64                               m_NumberOfMessagesDropped;
 };
 
 } // end namespace niftk
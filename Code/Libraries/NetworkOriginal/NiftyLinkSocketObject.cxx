@@ -656,4 +656,38 @@ int NiftyLinkSocketObject::GetSocketTimeOut(void)
   }
 }
 
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketObject::SetSendQueuePolicy(NiftyLinkSenderProcess::QueuePolicy policy)
+{
+  if (m_Sender != NULL)
+  {
+    m_Sender->SetQueuePolicy(policy);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketObject::SetSendQueueMaximumSize(int size)
+{
+  if (m_Sender != NULL)
+  {
+    m_Sender->SetMaximumQueueSize(size);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkSocketObject::GetNumberOfMessagesDropped(void)
+{
+  if (m_Sender != NULL)
+  {
+    return m_Sender->GetNumberOfMessagesDropped();
+  }
+  else
+  {
+    return 0;
+  }
+}
+
 } // end namespace niftk
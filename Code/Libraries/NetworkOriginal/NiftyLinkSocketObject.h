@@ -139,9 +139,9 @@ public:
 public slots:
 
   /// \brief This slot catches the signal with the message to send and it pass it on to the sender thread.
-  /// BEWARE: this will queue only a single message for now, i.e. it will replace a queued message with the
+  /// BEWARE: by default this will queue only a single message, i.e. it will replace a queued message with the
   /// the one you are passing in. this is an ad-hoc congestion control in case the sender thread cannot keep
-  /// up with the queue rate (i.e. you saturated the link).
+  /// up with the queue rate (i.e. you saturated the link). See SetSendQueuePolicy() to queue more.
   void SendMessage(NiftyLinkMessage::Pointer msg);
 
   /// \brief This slot captures the signal from the listener thread with the newly arrived data
@@ -165,6 +165,15 @@ public slots:
   /// \brief Returns the currently applied timeout in msec
   int GetSocketTimeOut(void);
 
+  /// \brief Sets the queue policy of the sender thread, (see NiftyLinkSenderProcess), default LATEST_ONLY
+  void SetSendQueuePolicy(NiftyLinkSenderProcess::QueuePolicy policy);
+
+  /// \brief Sets the maximum number of messages queued by the sender thread with the FIFO policy, default 100
+  void SetSendQueueMaximumSize(int size);
+
+  /// \brief Returns the number of messages the sender thread dropped without sending, or 0 if there is no sender
+  quint64 GetNumberOfMessagesDropped(void);
+
 private:
   /// \brief Instantiates the sender and listener threads and the shared mutex, and sets up the signal - slot connections
   void InitThreads(void);
@@ -0,0 +1,117 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkLocalTransport.h"
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkLocalTransport::NiftyLinkLocalTransport(QLocalSocket *socket, QObject *parent)
+: NiftyLinkTransport(parent)
+, m_Socket(socket)
+, m_SocketDescriptor(-1)
+{
+  if (m_Socket == NULL)
+  {
+    m_Socket = new QLocalSocket();
+  }
+  m_Socket->setParent(this);
+
+  if (m_Socket->state() == QLocalSocket::ConnectedState)
+  {
+    m_SocketDescriptor = static_cast<qint64>(m_Socket->socketDescriptor());
+  }
+
+  connect(m_Socket, SIGNAL(connected()), this, SLOT(OnConnected()));
+  connect(m_Socket, SIGNAL(disconnected()), this, SIGNAL(Disconnected()));
+  connect(m_Socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(OnError(QLocalSocket::LocalSocketError)));
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkLocalTransport::~NiftyLinkLocalTransport()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+QIODevice* NiftyLinkLocalTransport::GetDevice() const
+{
+  return m_Socket;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkLocalTransport::IsLocal() const
+{
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkLocalTransport::ConnectToPeer(const QString& address, quint16 /*port*/)
+{
+  // There are no errors reported from this. Listen to the Error signal.
+  m_Socket->connectToServer(GetLocalPath(address));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkLocalTransport::DisconnectFromPeer()
+{
+  m_Socket->disconnectFromServer();
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkLocalTransport::GetPeerName() const
+{
+  return m_Socket->fullServerName();
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkLocalTransport::GetPeerPort() const
+{
+  return static_cast<int>(m_SocketDescriptor);
+}
+
+
+//-----------------------------------------------------------------------------
+qint64 NiftyLinkLocalTransport::GetSocketDescriptor() const
+{
+  return m_SocketDescriptor;
+}
+
+
+//-----------------------------------------------------------------------------
+QAbstractSocket::SocketError NiftyLinkLocalTransport::GetError() const
+{
+  return static_cast<QAbstractSocket::SocketError>(m_Socket->error());
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkLocalTransport::OnConnected()
+{
+  m_SocketDescriptor = static_cast<qint64>(m_Socket->socketDescriptor());
+  emit Connected();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkLocalTransport::OnError(QLocalSocket::LocalSocketError error)
+{
+  emit Error(static_cast<QAbstractSocket::SocketError>(error));
+}
+
+} // end namespace niftk
@@ -0,0 +1,85 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkLocalTransport_h
+#define NiftyLinkLocalTransport_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkTransport.h>
+
+#include <QLocalSocket>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkLocalTransport
+* \brief NiftyLinkTransport over a QLocalSocket, for peers on the same host, selected by addresses like "unix:/tmp/niftylink.sock".
+*
+* On Unix, QLocalSocket is an AF_UNIX stream socket, and an absolute path is used as is, so data
+* is copied between the processes by the kernel, without going through the TCP/IP stack.
+* On Windows, it is a named pipe. There is no port, so GetPeerPort() returns the socket descriptor,
+* which is unique among the open connections of a process, and is what NiftyLinkTcpServer reports clients by.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkLocalTransport : public NiftyLinkTransport
+{
+  Q_OBJECT
+
+public:
+
+  /// \brief Constructor, which takes ownership of socket, (eg. one accepted by a server), or creates a new one if socket is NULL.
+  NiftyLinkLocalTransport(QLocalSocket *socket = NULL, QObject *parent = 0);
+
+  /// \brief Destructor.
+  virtual ~NiftyLinkLocalTransport();
+
+  /// \see NiftyLinkTransport::GetDevice()
+  virtual QIODevice* GetDevice() const;
+
+  /// \see NiftyLinkTransport::IsLocal()
+  virtual bool IsLocal() const;
+
+  /// \brief Connects to the path of address, (see NiftyLinkTransport::GetLocalPath()), ignoring port.
+  virtual void ConnectToPeer(const QString& address, quint16 port);
+
+  /// \see NiftyLinkTransport::DisconnectFromPeer()
+  virtual void DisconnectFromPeer();
+
+  /// \brief Returns the full path of the server, which is empty for sockets accepted by a server.
+  virtual QString GetPeerName() const;
+
+  /// \brief Returns the socket descriptor, as there are no ports.
+  virtual int GetPeerPort() const;
+
+  /// \brief Returns the socket descriptor, which is kept after disconnecting, so the connection can still be identified.
+  virtual qint64 GetSocketDescriptor() const;
+
+  /// \see NiftyLinkTransport::GetError()
+  virtual QAbstractSocket::SocketError GetError() const;
+
+private slots:
+
+  /// \brief Stores the socket descriptor, and emits Connected().
+  void OnConnected();
+
+  /// \brief Passes the error on as Error(), as QLocalSocket::LocalSocketError values are QAbstractSocket::SocketError values.
+  void OnError(QLocalSocket::LocalSocketError error);
+
+private:
+
+  QLocalSocket *m_Socket;
+  qint64        m_SocketDescriptor;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkLocalTransport_h
@@ -0,0 +1,509 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkMessageSynchroniser.h"
+#include "NiftyLinkTcpClient.h"
+#include <NiftyLinkMacro.h>
+#include <NiftyLinkTrackingDataMessageHelpers.h>
+
+#include <igtlTrackingDataMessage.h>
+#include <igtlTransformMessage.h>
+
+#include <QsLog.h>
+
+namespace niftk
+{
+
+const int NiftyLinkMessageSynchroniser::m_MAXIMUM_NUMBER_OF_STREAMS = 16;
+
+// Number of poses kept per stream, for interpolation.
+static const int NIFTYLINK_SYNCHRONISER_POSES_PER_STREAM = 256;
+
+//-----------------------------------------------------------------------------
+static bool GetPoseFromMessage(const NiftyLinkMessageContainer::Pointer& message, igtl::Matrix4x4& matrix)
+{
+  igtl::TransformMessage::Pointer transform = dynamic_cast<igtl::TransformMessage*>(message->GetMessage().GetPointer());
+  if (transform.IsNotNull())
+  {
+    transform->GetMatrix(matrix);
+    return true;
+  }
+
+  igtl::TrackingDataMessage::Pointer trackingData = dynamic_cast<igtl::TrackingDataMessage*>(message->GetMessage().GetPointer());
+  if (trackingData.IsNotNull() && trackingData->GetNumberOfTrackingDataElements() == 1)
+  {
+    igtl::TrackingDataElement::Pointer element;
+    trackingData->GetTrackingDataElement(0, element);
+    element->GetMatrix(matrix);
+    return true;
+  }
+
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageSynchroniser::NiftyLinkMessageSynchroniser(QObject *parent)
+: QObject(parent)
+, m_Policy(NEAREST)
+, m_Tolerance(20000000)
+, m_MaximumBufferSize(32)
+, m_History(m_MAXIMUM_NUMBER_OF_STREAMS, NIFTYLINK_SYNCHRONISER_POSES_PER_STREAM)
+, m_NumberOfMessagesReceived(0)
+, m_NumberOfMessagesUnmatched(0)
+, m_NumberOfGroupsEmitted(0)
+{
+  this->setObjectName("NiftyLinkMessageSynchroniser");
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageSynchroniser::~NiftyLinkMessageSynchroniser()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::SetPolicy(const Policy& policy)
+{
+  m_Policy = policy;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageSynchroniser::Policy NiftyLinkMessageSynchroniser::GetPolicy() const
+{
+  return m_Policy;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::SetTolerance(const quint64& nanoseconds)
+{
+  m_Tolerance = nanoseconds;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageSynchroniser::GetTolerance() const
+{
+  return m_Tolerance;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::SetMaximumBufferSize(const int& size)
+{
+  if (size < 2)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Maximum buffer size must be at least 2.");
+  }
+  m_MaximumBufferSize = size;
+
+  for (int i = 0; i < m_Buffers.size(); i++)
+  {
+    if (m_Buffers[i].size() > m_MaximumBufferSize)
+    {
+      this->RemoveFromStream(i, m_Buffers[i].size() - m_MaximumBufferSize);
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageSynchroniser::GetMaximumBufferSize() const
+{
+  return m_MaximumBufferSize;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageSynchroniser::AddStream(const QString& name)
+{
+  if (name.isEmpty())
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Stream name is empty.");
+  }
+  if (m_StreamNames.contains(name))
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Stream name " << name.toStdString() << " is already used.");
+  }
+  if (m_StreamNames.size() >= m_MAXIMUM_NUMBER_OF_STREAMS)
+  {
+    NiftyLinkStdExceptionMacro(std::invalid_argument, << "Too many streams.");
+  }
+
+  m_StreamNames.append(name);
+  m_Buffers.append(QList<BufferedMessage>());
+
+  return m_StreamNames.size() - 1;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageSynchroniser::GetNumberOfStreams() const
+{
+  return m_StreamNames.size();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::Subscribe(NiftyLinkTcpClient* client)
+{
+  connect(client, SIGNAL(MessageReceived(NiftyLinkMessageContainer::Pointer)), this, SLOT(OnMessageReceived(NiftyLinkMessageContainer::Pointer)));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::Clear()
+{
+  for (int i = 0; i < m_Buffers.size(); i++)
+  {
+    this->RemoveFromStream(i, m_Buffers[i].size());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageSynchroniser::GetNumberOfMessagesReceived() const
+{
+  return m_NumberOfMessagesReceived;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageSynchroniser::GetNumberOfMessagesUnmatched() const
+{
+  return m_NumberOfMessagesUnmatched;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkMessageSynchroniser::GetNumberOfGroupsEmitted() const
+{
+  return m_NumberOfGroupsEmitted;
+}
+
+
+//-----------------------------------------------------------------------------
+double NiftyLinkMessageSynchroniser::GetUnmatchedFraction() const
+{
+  if (m_NumberOfMessagesReceived == 0)
+  {
+    return 0;
+  }
+  return static_cast<double>(m_NumberOfMessagesUnmatched) / static_cast<double>(m_NumberOfMessagesReceived);
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkRunningStats NiftyLinkMessageSynchroniser::GetPairingLatency() const
+{
+  return m_PairingLatency;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::OutputStats() const
+{
+  QLOG_INFO() << QObject::tr("%1::OutputStats() - received=%2, unmatched=%3 (%4%), groups=%5.")
+                 .arg(objectName())
+                 .arg(m_NumberOfMessagesReceived)
+                 .arg(m_NumberOfMessagesUnmatched)
+                 .arg(this->GetUnmatchedFraction() * 100)
+                 .arg(m_NumberOfGroupsEmitted);
+
+  QLOG_INFO() << QObject::tr("%1::OutputStats() - pairing latency mean=%2, stddev=%3, max=%4 (ns).")
+                 .arg(objectName())
+                 .arg(m_PairingLatency.GetMean())
+                 .arg(m_PairingLatency.GetStdDev())
+                 .arg(m_PairingLatency.GetMax());
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::OnMessageReceived(NiftyLinkMessageContainer::Pointer message)
+{
+  if (message.data() == NULL || message->GetMessage().IsNull() || m_StreamNames.isEmpty())
+  {
+    return;
+  }
+
+  const int stream = m_StreamNames.indexOf(QString(message->GetMessage()->GetDeviceName()));
+  if (stream >= 0)
+  {
+    this->AddToStream(stream, message);
+  }
+  else if (dynamic_cast<igtl::TrackingDataMessage*>(message->GetMessage().GetPointer()) != NULL)
+  {
+    QList<NiftyLinkMessageContainer::Pointer> elements = SplitTrackingDataMessage(message);
+    for (int i = 0; i < elements.size(); i++)
+    {
+      igtl::TrackingDataMessage::Pointer trackingData = dynamic_cast<igtl::TrackingDataMessage*>(elements[i]->GetMessage().GetPointer());
+      igtl::TrackingDataElement::Pointer element;
+      trackingData->GetTrackingDataElement(0, element);
+
+      const int toolStream = m_StreamNames.indexOf(QString(element->GetName()));
+      if (toolStream >= 0)
+      {
+        this->AddToStream(toolStream, elements[i]);
+      }
+    }
+  }
+  else
+  {
+    return;
+  }
+
+  if (m_Policy == LATEST_COMPLETE)
+  {
+    this->MatchLatestComplete();
+  }
+  else
+  {
+    this->MatchToReference();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::AddToStream(const int& stream, const NiftyLinkMessageContainer::Pointer& message)
+{
+  igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+  message->GetTimeCreated(timeCreated);
+
+  BufferedMessage buffered;
+  buffered.m_Message = message;
+  buffered.m_Time = timeCreated->GetTimeStampInNanoseconds();
+  buffered.m_IsEmitted = false;
+
+  m_Buffers[stream].append(buffered);
+  m_NumberOfMessagesReceived++;
+
+  // Poses are always kept, so the policy can be changed at any time.
+  igtl::Matrix4x4 matrix;
+  if (GetPoseFromMessage(message, matrix))
+  {
+    m_History.AddPose(m_StreamNames[stream], matrix, buffered.m_Time);
+  }
+
+  if (m_Buffers[stream].size() > m_MaximumBufferSize)
+  {
+    this->RemoveFromStream(stream, m_Buffers[stream].size() - m_MaximumBufferSize);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::RemoveFromStream(const int& stream, const int& numberToRemove)
+{
+  for (int i = 0; i < numberToRemove && !m_Buffers[stream].isEmpty(); i++)
+  {
+    if (!m_Buffers[stream].first().m_IsEmitted)
+    {
+      m_NumberOfMessagesUnmatched++;
+    }
+    m_Buffers[stream].removeFirst();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageSynchroniser::FindAtOrBefore(const int& stream, const igtlUint64& time) const
+{
+  const QList<BufferedMessage>& buffer = m_Buffers[stream];
+  for (int i = buffer.size() - 1; i >= 0; i--)
+  {
+    if (buffer[i].m_Time <= time)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkMessageSynchroniser::FindNearest(const int& stream, const igtlUint64& time) const
+{
+  const QList<BufferedMessage>& buffer = m_Buffers[stream];
+
+  int nearest = -1;
+  igtlUint64 nearestDifference = 0;
+
+  for (int i = 0; i < buffer.size(); i++)
+  {
+    const igtlUint64 difference = buffer[i].m_Time > time ? buffer[i].m_Time - time : time - buffer[i].m_Time;
+    if (nearest == -1 || difference < nearestDifference)
+    {
+      nearest = i;
+      nearestDifference = difference;
+    }
+  }
+  return nearest;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageContainer::Pointer NiftyLinkMessageSynchroniser::Interpolate(const int& stream, const igtlUint64& time,
+                                                                            const NiftyLinkMessageContainer::Pointer& nearest) const
+{
+  NiftyLinkMessageContainer::Pointer result;
+
+  igtl::Matrix4x4 matrix;
+  if (!GetPoseFromMessage(nearest, matrix) || !m_History.GetPose(m_StreamNames[stream], time, matrix))
+  {
+    return result;
+  }
+
+  igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+  timeCreated->SetTimeInNanoseconds(time);
+
+  igtl::TransformMessage::Pointer msg = igtl::TransformMessage::New();
+  msg->SetDeviceName(m_StreamNames[stream].toStdString().c_str());
+  msg->SetMatrix(matrix);
+  msg->SetTimeStamp(timeCreated);
+  msg->Pack();
+
+  // The copy constructor copies the times, sender and owner, and we then replace the message.
+  result = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer(*nearest)));
+  result->SetMessage(msg.GetPointer());
+
+  return result;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::MatchToReference()
+{
+  const int numberOfStreams = m_Buffers.size();
+  QVector<int> matched(numberOfStreams, -1);
+
+  while (numberOfStreams > 1 && !m_Buffers[0].isEmpty())
+  {
+    const igtlUint64 time = m_Buffers[0].first().m_Time;
+
+    // Wait until every stream has a message at least as new, so the nearest is known.
+    // If one never arrives, the reference stream's buffer limit drops old references.
+    for (int i = 1; i < numberOfStreams; i++)
+    {
+      bool isNewerAvailable = false;
+      for (int j = m_Buffers[i].size() - 1; j >= 0 && !isNewerAvailable; j--)
+      {
+        isNewerAvailable = m_Buffers[i][j].m_Time >= time;
+      }
+      if (!isNewerAvailable)
+      {
+        return;
+      }
+    }
+
+    QList<NiftyLinkMessageContainer::Pointer> messages;
+    messages.append(m_Buffers[0].first().m_Message);
+
+    bool isMatched = true;
+    for (int i = 1; i < numberOfStreams && isMatched; i++)
+    {
+      matched[i] = this->FindNearest(i, time);
+
+      const BufferedMessage& nearest = m_Buffers[i][matched[i]];
+      const igtlUint64 difference = nearest.m_Time > time ? nearest.m_Time - time : time - nearest.m_Time;
+
+      if (difference > m_Tolerance)
+      {
+        isMatched = false;
+      }
+      else
+      {
+        NiftyLinkMessageContainer::Pointer message = nearest.m_Message;
+        if (m_Policy == INTERPOLATED)
+        {
+          NiftyLinkMessageContainer::Pointer interpolated = this->Interpolate(i, time, nearest.m_Message);
+          if (interpolated.data() != NULL)
+          {
+            message = interpolated;
+          }
+        }
+        messages.append(message);
+      }
+    }
+
+    if (isMatched)
+    {
+      m_Buffers[0].first().m_IsEmitted = true;
+      for (int i = 1; i < numberOfStreams; i++)
+      {
+        m_Buffers[i][matched[i]].m_IsEmitted = true;
+      }
+      this->Emit(messages, m_Buffers[0].first().m_Message->GetTimeReceived());
+    }
+
+    this->RemoveFromStream(0, 1);
+
+    // Later references are no older, so messages before the last one at or before this time are no longer needed.
+    for (int i = 1; i < numberOfStreams; i++)
+    {
+      const int atOrBefore = this->FindAtOrBefore(i, time);
+      if (atOrBefore > 0)
+      {
+        this->RemoveFromStream(i, atOrBefore);
+      }
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::MatchLatestComplete()
+{
+  const int numberOfStreams = m_Buffers.size();
+
+  for (int i = 0; i < numberOfStreams; i++)
+  {
+    if (m_Buffers[i].isEmpty() || m_Buffers[i].last().m_IsEmitted)
+    {
+      return;
+    }
+  }
+
+  QList<NiftyLinkMessageContainer::Pointer> messages;
+  igtlUint64 timeReceived = 0;
+
+  for (int i = 0; i < numberOfStreams; i++)
+  {
+    m_Buffers[i].last().m_IsEmitted = true;
+    messages.append(m_Buffers[i].last().m_Message);
+    timeReceived = qMax(timeReceived, m_Buffers[i].last().m_Message->GetTimeReceived());
+  }
+
+  this->Emit(messages, timeReceived);
+
+  for (int i = 0; i < numberOfStreams; i++)
+  {
+    this->RemoveFromStream(i, m_Buffers[i].size());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageSynchroniser::Emit(const QList<NiftyLinkMessageContainer::Pointer>& messages, const igtlUint64& timeReceived)
+{
+  igtl::TimeStamp::Pointer now = igtl::TimeStamp::New();
+  now->GetTime();
+
+  const igtlUint64 timeNow = now->GetTimeStampInNanoseconds();
+  m_PairingLatency.Add(timeNow > timeReceived ? timeNow - timeReceived : 0);
+  m_NumberOfGroupsEmitted++;
+
+  emit MessagesSynchronised(messages);
+}
+
+} // end namespace niftk
@@ -0,0 +1,195 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkMessageSynchroniser_h
+#define NiftyLinkMessageSynchroniser_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+#include <NiftyLinkRunningStats.h>
+#include <NiftyLinkTrackingHistory.h>
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace niftk
+{
+
+class NiftyLinkTcpClient;
+
+/**
+* \class NiftyLinkMessageSynchroniser
+* \brief Pairs up messages from several streams, eg. (image, probe pose, reference pose),
+* by time stamp, and emits each matched group with MessagesSynchronised().
+*
+* Each stream is named with AddStream(). A received message goes to the stream named after its device name,
+* or, for a TDATA message where no stream has the device name, each element goes to the stream
+* named after the tool, (see SplitTrackingDataMessage()). Other messages are ignored. Messages arrive
+* through OnMessageReceived(), so call Subscribe() for each NiftyLinkTcpClient, or connect any other source.
+*
+* The first stream is the reference stream, and the policy decides how the others are matched to it:
+* <ul>
+* <li>NEAREST: each message of the reference stream is matched with the message from each other stream
+* that is nearest in time, once a message at least as new has arrived on every stream, so the nearest is known.</li>
+* <li>INTERPOLATED: as NEAREST, except that for streams of single poses, (TRANSFORM, or TDATA with one element),
+* the pose at the time of the reference message is interpolated, (see NiftyLinkTrackingHistory), and
+* returned in a new TRANSFORM message, with the reference time stamp.</li>
+* <li>LATEST_COMPLETE: as soon as every stream has a message not already emitted, the newest message of each is emitted,
+* regardless of time stamps. This has the lowest latency, but no guarantee about time differences.</li>
+* </ul>
+* For NEAREST and INTERPOLATED, if a message used from another stream is more than SetTolerance() from the
+* reference message, the reference message is unmatched, and dropped.
+*
+* Each stream keeps at most SetMaximumBufferSize() messages, after which the oldest is dropped. Any message
+* dropped without having been emitted counts as unmatched. Pairing latency is the time from when the
+* reference message was received to when it was emitted, (or for LATEST_COMPLETE, from when the last message
+* needed was received).
+*
+* This class is not thread safe, so should be used from one thread, normally the GUI thread, via queued connections.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkMessageSynchroniser : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  enum Policy
+  {
+    NEAREST,
+    INTERPOLATED,
+    LATEST_COMPLETE
+  };
+
+  /// \brief Equals 16.
+  static const int m_MAXIMUM_NUMBER_OF_STREAMS;
+
+  /// \brief Constructor.
+  NiftyLinkMessageSynchroniser(QObject *parent = 0);
+
+  /// \brief Destructor.
+  virtual ~NiftyLinkMessageSynchroniser();
+
+  /// \brief Sets the matching policy, default NEAREST.
+  void SetPolicy(const Policy& policy);
+
+  /// \brief Returns the matching policy.
+  Policy GetPolicy() const;
+
+  /// \brief Sets the maximum time difference between the reference message, and a message matched to it, default 20ms.
+  void SetTolerance(const quint64& nanoseconds);
+
+  /// \brief Returns the tolerance in nanoseconds.
+  quint64 GetTolerance() const;
+
+  /// \brief Sets the maximum number of messages kept for each stream, default 32.
+  /// \throws std::invalid_argument if size is less than 2.
+  void SetMaximumBufferSize(const int& size);
+
+  /// \brief Returns the maximum number of messages kept for each stream.
+  int GetMaximumBufferSize() const;
+
+  /// \brief Adds a stream, where the first stream added is the reference stream.
+  /// \return the index of this stream in the list emitted by MessagesSynchronised().
+  /// \throws std::invalid_argument if the name is empty or already used, or there are already m_MAXIMUM_NUMBER_OF_STREAMS.
+  int AddStream(const QString& name);
+
+  /// \brief Returns the number of streams.
+  int GetNumberOfStreams() const;
+
+  /// \brief Connects the client's MessageReceived() signal to OnMessageReceived().
+  void Subscribe(NiftyLinkTcpClient* client);
+
+  /// \brief Drops all buffered messages, (counting them as unmatched if not emitted).
+  void Clear();
+
+  /// \brief Returns the number of messages received on any stream.
+  quint64 GetNumberOfMessagesReceived() const;
+
+  /// \brief Returns the number of messages dropped without being emitted.
+  quint64 GetNumberOfMessagesUnmatched() const;
+
+  /// \brief Returns the number of groups emitted.
+  quint64 GetNumberOfGroupsEmitted() const;
+
+  /// \brief Returns the fraction of received messages that were dropped without being emitted.
+  double GetUnmatchedFraction() const;
+
+  /// \brief Returns the pairing latency, in nanoseconds.
+  NiftyLinkRunningStats GetPairingLatency() const;
+
+  /// \brief Logs the above stats.
+  void OutputStats() const;
+
+public slots:
+
+  /// \brief Adds a message to the streams it belongs to, and emits any groups that are now complete.
+  void OnMessageReceived(NiftyLinkMessageContainer::Pointer message);
+
+signals:
+
+  /// \brief Emitted with one message per stream, in the order the streams were added.
+  void MessagesSynchronised(QList<niftk::NiftyLinkMessageContainer::Pointer> messages);
+
+private:
+
+  struct BufferedMessage
+  {
+    NiftyLinkMessageContainer::Pointer m_Message;
+    igtlUint64                         m_Time;
+    bool                               m_IsEmitted;
+  };
+
+  /// \brief Adds a message to one stream.
+  void AddToStream(const int& stream, const NiftyLinkMessageContainer::Pointer& message);
+
+  /// \brief Removes the first numberToRemove messages of a stream, counting those not emitted as unmatched.
+  void RemoveFromStream(const int& stream, const int& numberToRemove);
+
+  /// \brief Emits as many groups as possible with NEAREST or INTERPOLATED.
+  void MatchToReference();
+
+  /// \brief Emits a group if possible with LATEST_COMPLETE.
+  void MatchLatestComplete();
+
+  /// \brief Returns the index, in the buffer of stream, of the newest message at or before time, or -1.
+  int FindAtOrBefore(const int& stream, const igtlUint64& time) const;
+
+  /// \brief Returns the index, in the buffer of stream, of the message nearest to time, or -1 if the buffer is empty.
+  int FindNearest(const int& stream, const igtlUint64& time) const;
+
+  /// \brief Creates a TRANSFORM message with the interpolated pose of stream at time, copying the
+  /// sender and times from nearest, or returns NULL if stream is not a stream of poses.
+  NiftyLinkMessageContainer::Pointer Interpolate(const int& stream, const igtlUint64& time,
+                                                 const NiftyLinkMessageContainer::Pointer& nearest) const;
+
+  /// \brief Emits the group, and records the latency.
+  void Emit(const QList<NiftyLinkMessageContainer::Pointer>& messages, const igtlUint64& timeReceived);
+
+  Policy                                   m_Policy;
+  quint64                                  m_Tolerance;
+  int                                      m_MaximumBufferSize;
+  QStringList                              m_StreamNames;
+  QVector< QList<BufferedMessage> >        m_Buffers;
+  NiftyLinkTrackingHistory                 m_History;
+
+  quint64                                  m_NumberOfMessagesReceived;
+  quint64                                  m_NumberOfMessagesUnmatched;
+  quint64                                  m_NumberOfGroupsEmitted;
+  NiftyLinkRunningStats                    m_PairingLatency;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkMessageSynchroniser_h
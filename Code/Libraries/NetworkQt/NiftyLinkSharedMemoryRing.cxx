@@ -0,0 +1,294 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkSharedMemoryRing.h"
+
+#include <QCoreApplication>
+#include <QsLog.h>
+
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace niftk
+{
+
+// Identifies a segment created by NiftyLinkSharedMemoryRing, ie. "NLSM".
+static const int NIFTYLINK_SHARED_MEMORY_MAGIC = 0x4E4C534D;
+
+// Magic number, slot size, number of slots, and one spare, all ints.
+static const int NIFTYLINK_SHARED_MEMORY_HEADER_SIZE = 4 * sizeof(int);
+
+// Slot states.
+static const int NIFTYLINK_SHARED_MEMORY_SLOT_FREE = 0;
+static const int NIFTYLINK_SHARED_MEMORY_SLOT_WRITTEN = 1;
+
+// Incremented for each key, see CreateUniqueKey().
+static QAtomicInt s_NextKey(0);
+
+//-----------------------------------------------------------------------------
+static qint64 GetSlotsOffset(const int& numberOfSlots)
+{
+  // States and lengths, rounded up so the slots start on a 64 byte boundary.
+  qint64 offset = NIFTYLINK_SHARED_MEMORY_HEADER_SIZE + static_cast<qint64>(numberOfSlots) * (sizeof(QAtomicInt) + sizeof(int));
+  return (offset + 63) & ~static_cast<qint64>(63);
+}
+
+
+//-----------------------------------------------------------------------------
+static qint64 GetSegmentSize(const int& slotSize, const int& numberOfSlots)
+{
+  // In 64 bits, as both may come from another process, and QSharedMemory sizes are ints.
+  return GetSlotsOffset(numberOfSlots) + static_cast<qint64>(slotSize) * numberOfSlots;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkSharedMemoryRing::NiftyLinkSharedMemoryRing()
+: m_SlotSize(0)
+, m_NumberOfSlots(0)
+, m_NextSlot(0)
+, m_States(NULL)
+, m_Lengths(NULL)
+, m_Slots(NULL)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkSharedMemoryRing::~NiftyLinkSharedMemoryRing()
+{
+  this->Detach();
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkSharedMemoryRing::CreateUniqueKey()
+{
+  return QObject::tr("NiftyLink-%1-%2").arg(QCoreApplication::applicationPid()).arg(s_NextKey.fetchAndAddOrdered(1));
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkSharedMemoryRing::Create(const QString& key, const int& slotSize, const int& numberOfSlots)
+{
+  this->Detach();
+
+  if (slotSize < 1 || numberOfSlots < 1 || GetSegmentSize(slotSize, numberOfSlots) > std::numeric_limits<int>::max())
+  {
+    QLOG_ERROR() << QObject::tr("NiftyLinkSharedMemoryRing::Create() - invalid slot size %1, or number of slots %2.")
+                    .arg(slotSize).arg(numberOfSlots);
+    return false;
+  }
+
+  m_SharedMemory.setKey(key);
+  if (!m_SharedMemory.create(static_cast<int>(GetSegmentSize(slotSize, numberOfSlots))))
+  {
+    QLOG_ERROR() << QObject::tr("NiftyLinkSharedMemoryRing::Create() - failed to create '%1', error was %2.")
+                    .arg(key).arg(m_SharedMemory.errorString());
+    return false;
+  }
+
+  int *header = static_cast<int*>(m_SharedMemory.data());
+  header[1] = slotSize;
+  header[2] = numberOfSlots;
+  header[3] = 0;
+
+  this->SetPointers(slotSize, numberOfSlots);
+  for (int i = 0; i < m_NumberOfSlots; i++)
+  {
+    new (m_States + i) QAtomicInt(NIFTYLINK_SHARED_MEMORY_SLOT_FREE);
+    m_Lengths[i] = 0;
+  }
+
+  // Written last, so a consumer that attaches early can tell the segment isn't ready.
+  QAtomicInt *magic = reinterpret_cast<QAtomicInt*>(header);
+  magic->fetchAndStoreRelease(NIFTYLINK_SHARED_MEMORY_MAGIC);
+
+  QLOG_INFO() << QObject::tr("NiftyLinkSharedMemoryRing::Create() - created '%1', with %2 slots of %3 bytes.")
+                 .arg(key).arg(m_NumberOfSlots).arg(m_SlotSize);
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkSharedMemoryRing::Attach(const QString& key)
+{
+  this->Detach();
+
+  m_SharedMemory.setKey(key);
+  if (!m_SharedMemory.attach(QSharedMemory::ReadWrite))
+  {
+    QLOG_ERROR() << QObject::tr("NiftyLinkSharedMemoryRing::Attach() - failed to attach to '%1', error was %2.")
+                    .arg(key).arg(m_SharedMemory.errorString());
+    return false;
+  }
+
+  const int *header = static_cast<const int*>(m_SharedMemory.constData());
+  QAtomicInt *magic = reinterpret_cast<QAtomicInt*>(m_SharedMemory.data());
+
+  if (m_SharedMemory.size() < NIFTYLINK_SHARED_MEMORY_HEADER_SIZE
+      || magic->fetchAndAddAcquire(0) != NIFTYLINK_SHARED_MEMORY_MAGIC)
+  {
+    QLOG_ERROR() << QObject::tr("NiftyLinkSharedMemoryRing::Attach() - '%1' is not a NiftyLinkSharedMemoryRing.").arg(key);
+    m_SharedMemory.detach();
+    return false;
+  }
+
+  // Read once, as the other process could change them, and only trusted once checked against the size of the segment.
+  const int slotSize = header[1];
+  const int numberOfSlots = header[2];
+
+  if (slotSize < 1
+      || numberOfSlots < 1
+      || GetSegmentSize(slotSize, numberOfSlots) > m_SharedMemory.size())
+  {
+    QLOG_ERROR() << QObject::tr("NiftyLinkSharedMemoryRing::Attach() - '%1' has an invalid slot size %2, or number of slots %3.")
+                    .arg(key).arg(slotSize).arg(numberOfSlots);
+    m_SharedMemory.detach();
+    return false;
+  }
+
+  this->SetPointers(slotSize, numberOfSlots);
+  m_NextSlot = 0;
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSharedMemoryRing::Detach()
+{
+  if (m_SharedMemory.isAttached())
+  {
+    m_SharedMemory.detach();
+  }
+  m_SlotSize = 0;
+  m_NumberOfSlots = 0;
+  m_NextSlot = 0;
+  m_States = NULL;
+  m_Lengths = NULL;
+  m_Slots = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSharedMemoryRing::SetPointers(const int& slotSize, const int& numberOfSlots)
+{
+  char *data = static_cast<char*>(m_SharedMemory.data());
+
+  m_SlotSize = slotSize;
+  m_NumberOfSlots = numberOfSlots;
+  m_States = reinterpret_cast<QAtomicInt*>(data + NIFTYLINK_SHARED_MEMORY_HEADER_SIZE);
+  m_Lengths = reinterpret_cast<int*>(data + NIFTYLINK_SHARED_MEMORY_HEADER_SIZE + m_NumberOfSlots * sizeof(QAtomicInt));
+  m_Slots = data + GetSlotsOffset(m_NumberOfSlots);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkSharedMemoryRing::IsAttached() const
+{
+  return m_Slots != NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkSharedMemoryRing::GetKey() const
+{
+  return m_SharedMemory.key();
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSharedMemoryRing::GetSlotSize() const
+{
+  return m_SlotSize;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSharedMemoryRing::GetNumberOfSlots() const
+{
+  return m_NumberOfSlots;
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkSharedMemoryRing::Write(const void* data, const int& length)
+{
+  if (!this->IsAttached() || length < 0 || length > m_SlotSize)
+  {
+    return -1;
+  }
+
+  // Slots are handed back in the order they were written, so if the next one isn't free, none are.
+  const int slot = m_NextSlot;
+  if (m_States[slot].fetchAndAddAcquire(0) != NIFTYLINK_SHARED_MEMORY_SLOT_FREE)
+  {
+    return -1;
+  }
+
+  memcpy(m_Slots + static_cast<qint64>(slot) * m_SlotSize, data, length);
+  m_Lengths[slot] = length;
+
+  // Release, so the consumer sees the data and length once it sees the state.
+  m_States[slot].fetchAndStoreRelease(NIFTYLINK_SHARED_MEMORY_SLOT_WRITTEN);
+
+  m_NextSlot = (m_NextSlot + 1) % m_NumberOfSlots;
+  return slot;
+}
+
+
+//-----------------------------------------------------------------------------
+const char* NiftyLinkSharedMemoryRing::GetSlot(const int& slot, int& length) const
+{
+  if (!this->IsAttached() || slot < 0 || slot >= m_NumberOfSlots
+      || m_States[slot].fetchAndAddAcquire(0) != NIFTYLINK_SHARED_MEMORY_SLOT_WRITTEN)
+  {
+    return NULL;
+  }
+
+  // Read once, and checked, as it was written by the other process.
+  const int slotLength = m_Lengths[slot];
+  if (slotLength < 0 || slotLength > m_SlotSize)
+  {
+    return NULL;
+  }
+
+  length = slotLength;
+  return m_Slots + static_cast<qint64>(slot) * m_SlotSize;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkSharedMemoryRing::IsAnySlotWritten() const
+{
+  for (int i = 0; i < m_NumberOfSlots; i++)
+  {
+    if (m_States[i].fetchAndAddAcquire(0) == NIFTYLINK_SHARED_MEMORY_SLOT_WRITTEN)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSharedMemoryRing::Release(const int& slot)
+{
+  if (this->IsAttached() && slot >= 0 && slot < m_NumberOfSlots)
+  {
+    m_States[slot].fetchAndStoreRelease(NIFTYLINK_SHARED_MEMORY_SLOT_FREE);
+  }
+}
+
+} // end namespace niftk
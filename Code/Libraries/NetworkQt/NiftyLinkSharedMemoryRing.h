@@ -0,0 +1,111 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkSharedMemoryRing_h
+#define NiftyLinkSharedMemoryRing_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <QAtomicInt>
+#include <QSharedMemory>
+#include <QString>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkSharedMemoryRing
+* \brief A ring of fixed size slots in a QSharedMemory segment, written by one process and read by
+* another on the same host, so large messages, (ie. images), need not be copied through a socket.
+*
+* The segment starts with a small header, (a magic number, the slot size and the number of slots),
+* followed by the state and length of each slot, then the slots themselves. A slot is either free,
+* or written. The producer, (see Create()), copies a message into a free slot with Write(), and tells
+* the consumer the slot number some other way, (NiftyLinkTcpNetworkWorker sends it over the socket).
+* The consumer, (see Attach()), reads the slot with GetSlot(), and hands it back with Release().
+* The slot states are atomic integers in the segment itself, so no lock is shared between the processes.
+*
+* There must be one producer and one consumer, and each must only use the ring from one thread.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkSharedMemoryRing
+{
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkSharedMemoryRing();
+
+  /// \brief Destructor, which detaches.
+  ~NiftyLinkSharedMemoryRing();
+
+  /// \brief Returns a key that is unique to this process, for Create().
+  static QString CreateUniqueKey();
+
+  /// \brief Creates a new segment called key, with numberOfSlots of slotSize bytes, all free, as the producer.
+  /// \return false if the segment could not be created, (eg. the key is in use, or it would be 2GB or more), which is logged.
+  bool Create(const QString& key, const int& slotSize, const int& numberOfSlots);
+
+  /// \brief Attaches to an existing segment called key, as the consumer.
+  /// \return false if there is no such segment, or it is not a NiftyLinkSharedMemoryRing, or the slot size
+  /// and number of slots in its header don't fit in it, which is logged.
+  bool Attach(const QString& key);
+
+  /// \brief Detaches from the segment. The segment is destroyed once both ends have detached.
+  void Detach();
+
+  /// \brief Returns true if Create() or Attach() succeeded, and Detach() has not been called since.
+  bool IsAttached() const;
+
+  /// \brief Returns the key passed to Create() or Attach().
+  QString GetKey() const;
+
+  /// \brief Returns the size of each slot in bytes, or 0 if not attached.
+  int GetSlotSize() const;
+
+  /// \brief Returns the number of slots, or 0 if not attached.
+  int GetNumberOfSlots() const;
+
+  /// \brief Producer only, copies length bytes of data into the next free slot, and marks it written.
+  /// \return the slot number, or -1 if length is bigger than a slot, or no slot is free, ie. the consumer isn't keeping up.
+  int Write(const void* data, const int& length);
+
+  /// \brief Consumer only, returns the data in a written slot, which stays valid until Release(slot).
+  /// \param length output, the number of bytes written to the slot.
+  /// \return NULL if slot is out of range, or not written, or its length is bigger than a slot.
+  const char* GetSlot(const int& slot, int& length) const;
+
+  /// \brief Producer only, returns true if any slot is written, and not yet released by the consumer.
+  bool IsAnySlotWritten() const;
+
+  /// \brief Consumer only, marks a slot returned by GetSlot() as free, so the producer can use it again.
+  void Release(const int& slot);
+
+private:
+
+  NiftyLinkSharedMemoryRing(const NiftyLinkSharedMemoryRing&); // Purposefully not implemented.
+  NiftyLinkSharedMemoryRing& operator=(const NiftyLinkSharedMemoryRing&); // Purposefully not implemented.
+
+  /// \brief Sets m_SlotSize, m_NumberOfSlots, m_States, m_Lengths and m_Slots for the attached segment.
+  void SetPointers(const int& slotSize, const int& numberOfSlots);
+
+  QSharedMemory  m_SharedMemory;
+  int            m_SlotSize;
+  int            m_NumberOfSlots;
+  int            m_NextSlot;
+  QAtomicInt    *m_States;
+  int           *m_Lengths;
+  char          *m_Slots;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkSharedMemoryRing_h
@@ -11,6 +11,7 @@
 =============================================================================*/
 #include "NiftyLinkTcpClient.h"
 #include "NiftyLinkTcpNetworkWorker.h"
+#include <NiftyLinkTcpTransport.h>
 #include <NiftyLinkQThread.h>
 #include <NiftyLinkUtils.h>
 
@@ -26,7 +27,7 @@ NiftyLinkTcpClient::NiftyLinkTcpClient(QObject *parent)
 : QObject(parent)
 , m_Mutex(QMutex::Recursive)
 , m_State(UNCONNECTED)
-, m_Socket(NULL)
+, m_Transport(NULL)
 , m_Worker(NULL)
 , m_Thread(NULL)
 , m_RequestedName("")
@@ -40,7 +41,7 @@ NiftyLinkTcpClient::NiftyLinkTcpClient(QObject *parent)
 NiftyLinkTcpClient::NiftyLinkTcpClient(const QString& hostName, quint16 portNumber, QObject *parent)
 : QObject(parent)
 , m_State(UNCONNECTED)
-, m_Socket(NULL)
+, m_Transport(NULL)
 , m_Worker(NULL)
 , m_Thread(NULL)
 , m_RequestedName(hostName)
@@ -59,6 +60,7 @@ void NiftyLinkTcpClient::Initialise()
   qRegisterMetaType<QAbstractSocket::SocketError>("QAbstractSocket::SocketError");
   qRegisterMetaType<niftk::NiftyLinkMessageContainer::Pointer>("niftk::NiftyLinkMessageContainer::Pointer");
   qRegisterMetaType<niftk::NiftyLinkMessageStatsContainer>("niftk::NiftyLinkMessageStatsContainer");
+  qRegisterMetaType<quint64>("quint64");
 
   // This is to make sure we have the best possible system timer.
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -74,10 +76,29 @@ void NiftyLinkTcpClient::Initialise()
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpClient::InitialiseSocket()
 {
-  m_Socket = new QTcpSocket();
-  connect(m_Socket, SIGNAL(connected()), this, SLOT(OnConnected()));
-  connect(m_Socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnError()));
-  m_Worker = new NiftyLinkTcpNetworkWorker("NiftyLinkTcpClientWorker", &m_InboundMessages, &m_OutboundMessages, m_Socket);
+  // TCP, unless ConnectToHost() is given a local address, see InitialiseTransport().
+  // OnConnected() is queued, as a local socket may connect before ConnectToHost() returns,
+  // and OnConnected() moves the socket to another thread.
+  m_Transport = new NiftyLinkTcpTransport();
+  connect(m_Transport, SIGNAL(Connected()), this, SLOT(OnConnected()), Qt::QueuedConnection);
+  connect(m_Transport, SIGNAL(Error(QAbstractSocket::SocketError)), this, SLOT(OnError()));
+  m_Worker = new NiftyLinkTcpNetworkWorker("NiftyLinkTcpClientWorker", &m_InboundMessages, &m_OutboundMessages, m_Transport);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::InitialiseTransport(const QString& hostName)
+{
+  if (m_Transport->IsLocal() == NiftyLinkTransport::IsLocalAddress(hostName))
+  {
+    return;
+  }
+
+  // The worker keeps its settings, and deletes the old transport.
+  m_Transport = NiftyLinkTransport::New(hostName);
+  connect(m_Transport, SIGNAL(Connected()), this, SLOT(OnConnected()), Qt::QueuedConnection);
+  connect(m_Transport, SIGNAL(Error(QAbstractSocket::SocketError)), this, SLOT(OnError()));
+  m_Worker->SetTransport(m_Transport);
 }
 
 
@@ -164,6 +185,20 @@ void NiftyLinkTcpClient::SetCheckForNoIncomingData(bool isOn)
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::SetRecorder(NiftyLinkMessageRecorder* recorder)
+{
+  m_Worker->SetRecorder(recorder);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::SetDecodeInParallel(bool isOn)
+{
+  m_Worker->SetDecodeInParallel(isOn);
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpClient::OutputStats()
 {
@@ -178,6 +213,34 @@ void NiftyLinkTcpClient::RequestStats()
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::RequestCompression(bool isOn)
+{
+  m_Worker->RequestCompression(isOn);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::RequestDownsampling(int factor)
+{
+  m_Worker->RequestDownsampling(factor);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::RequestRegionOfInterest(const QRect& regionOfInterest)
+{
+  m_Worker->RequestRegionOfInterest(regionOfInterest);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpClient::RequestSharedMemory(bool isOn)
+{
+  m_Worker->RequestSharedMemory(isOn);
+}
+
+
 //-----------------------------------------------------------------------------
 bool NiftyLinkTcpClient::Send(NiftyLinkMessageContainer::Pointer message)
 {
@@ -218,8 +281,8 @@ void NiftyLinkTcpClient::OnMessageReceived(int portNumber)
 void NiftyLinkTcpClient::OnError()
 {
   // Remember, this method is called when the socket is registered with this class, and being processing in this event loop.
-  QLOG_ERROR() << QObject::tr("%1::OnError() - code=%2, string=%3").arg(objectName()).arg(m_Socket->error()).arg(m_Socket->errorString());
-  emit SocketError(this->m_RequestedName, this->m_RequestedPort, m_Socket->error(), m_Socket->errorString());
+  QLOG_ERROR() << QObject::tr("%1::OnError() - code=%2, string=%3").arg(objectName()).arg(m_Transport->GetError()).arg(m_Transport->GetErrorString());
+  emit SocketError(this->m_RequestedName, this->m_RequestedPort, m_Transport->GetError(), m_Transport->GetErrorString());
 }
 
 
@@ -250,8 +313,10 @@ void NiftyLinkTcpClient::ConnectToHost(const QString& hostName, quint16 portNumb
     m_RequestedPort = portNumber;
   }
 
+  this->InitialiseTransport(m_RequestedName);
+
   // There are no errors reported from this. Listen to the error signal, see OnError().
-  m_Socket->connectToHost(m_RequestedName, m_RequestedPort);
+  m_Transport->ConnectToPeer(m_RequestedName, m_RequestedPort);
 }
 
 
@@ -263,25 +328,25 @@ void NiftyLinkTcpClient::ConnectToHost()
     m_State = CONNECTING;
   }
 
+  this->InitialiseTransport(m_RequestedName);
+
   // There are no errors reported from this. Listen to the error signal, see OnError().
-  m_Socket->connectToHost(m_RequestedName, m_RequestedPort);
+  m_Transport->ConnectToPeer(m_RequestedName, m_RequestedPort);
 }
 
 
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpClient::OnConnected()
 {
-  this->setObjectName(QObject::tr("NiftyLinkTcpClient(%1:%2)").arg(m_Socket->peerName()).arg(m_Socket->peerPort()));
+  this->setObjectName(QObject::tr("NiftyLinkTcpClient(%1:%2)").arg(m_Transport->GetPeerName()).arg(m_Transport->GetPeerPort()));
   m_Worker->UpdateObjectName();
 
-  m_Socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
-
   m_Thread = new NiftyLinkQThread();
   connect(m_Thread, SIGNAL(finished()), m_Thread, SLOT(deleteLater())); // i.e. the event loop of thread deletes it when control returns to this event loop.
   connect(m_Thread, SIGNAL(finished()), this, SLOT(OnThreadFinished()), Qt::BlockingQueuedConnection);
 
   m_Worker->moveToThread(m_Thread);
-  m_Socket->moveToThread(m_Thread);
+  m_Transport->moveToThread(m_Thread); // and its socket, as a child.
 
   connect(m_Worker, SIGNAL(SocketError(int,QAbstractSocket::SocketError,QString)), this, SLOT(OnWorkerSocketError(int,QAbstractSocket::SocketError,QString)));
   connect(m_Worker, SIGNAL(NoIncomingData()), this, SIGNAL(NoIncomingData()));
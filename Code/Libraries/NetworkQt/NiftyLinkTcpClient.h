@@ -17,9 +17,10 @@
 #include <NiftyLinkMessageManager.h>
 #include <NiftyLinkQThread.h>
 
+#include <QAbstractSocket>
 #include <QObject>
-#include <QTcpSocket>
 #include <QMutex>
+#include <QRect>
 
 #include <igtlMessageBase.h>
 
@@ -27,12 +28,18 @@ namespace niftk
 {
 
 class NiftyLinkTcpNetworkWorker;
+class NiftyLinkMessageRecorder;
+class NiftyLinkTransport;
 
 /**
 * \class NiftyLinkTcpClient
 * \brief TCP client that runs a QTcpSocket via a NiftyLinkTcpNetworkWorker
 * in another NiftyLinkQThread, sending and receiving OpenIGTLink messages.
 *
+* A host name of the form "unix:<path>", (eg. "unix:/run/niftylink/us.sock"), connects to a NiftyLinkTcpServer
+* on the same host, which is listening on that path, (see NiftyLinkTcpServer::Listen()), using a
+* NiftyLinkLocalTransport instead of TCP. The port is then ignored, and everything else works the same.
+*
 * Like a QThread, this object should be used once, once you have
 * gone through the states UNCONNECTED ... SHUTDOWN, it cannot be restarted.
 */
@@ -75,7 +82,15 @@ public:
   /// eg. One end sends keep alive messages, the other end expects to receive data regularly.
   void SetCheckForNoIncomingData(bool isOn);
 
-  /// \brief Connects to a host.
+  /// \brief Records every received message to recorder, which must already be started. Set to NULL to stop.
+  /// The recorder is not owned by this class, so must outlive it, or be unset first. See NiftyLinkMessageRecorder.
+  void SetRecorder(NiftyLinkMessageRecorder* recorder);
+
+  /// \brief Turns on, or off, decoding incoming IMAGE messages off the socket thread, default off.
+  /// See NiftyLinkTcpNetworkWorker::SetDecodeInParallel().
+  void SetDecodeInParallel(bool isOn);
+
+  /// \brief Connects to a host, or a local server if hostName is "unix:<path>".
   ///
   /// You should register and listen to SocketError signal before calling this.
   void ConnectToHost(const QString& hostName, quint16 portNumber);
@@ -108,6 +123,24 @@ public slots:
   /// Defined as a slot, so we can trigger it via QTimer for instance.
   void RequestStats();
 
+  /// \brief Sends message to other end to ask it to send IMAGE messages compressed (isOn = true) or not (isOn = false).
+  /// Other ends that don't support compression ignore this, and carry on sending normal IMAGE messages.
+  /// See NiftyLinkTcpNetworkWorker::RequestCompression().
+  void RequestCompression(bool isOn);
+
+  /// \brief Sends message to other end to ask it to downsample IMAGE messages by factor, or 1 to stop.
+  /// See NiftyLinkTcpNetworkWorker::RequestDownsampling().
+  void RequestDownsampling(int factor);
+
+  /// \brief Sends message to other end to ask it to crop IMAGE messages to regionOfInterest, in pixels, or a null QRect to stop.
+  /// See NiftyLinkTcpNetworkWorker::RequestRegionOfInterest().
+  void RequestRegionOfInterest(const QRect& regionOfInterest);
+
+  /// \brief Sends message to other end to ask it to send IMAGE messages through shared memory (isOn = true) or not (isOn = false).
+  /// Only sent when connected to a "unix:" address, as the other end must be on the same host.
+  /// See NiftyLinkTcpNetworkWorker::RequestSharedMemory().
+  void RequestSharedMemory(bool isOn);
+
 signals:
 
   /// \brief Emmitted when we have successfully connected.
@@ -165,11 +198,12 @@ private:
 
   void Initialise();
   void InitialiseSocket();
+  void InitialiseTransport(const QString& hostName);
   void RaiseInternalError(const QString& errorMessage);
 
   mutable QMutex             m_Mutex;
   ClientState                m_State;
-  QTcpSocket                *m_Socket;
+  NiftyLinkTransport        *m_Transport;
   NiftyLinkTcpNetworkWorker *m_Worker;
   NiftyLinkQThread          *m_Thread;
   QString                    m_RequestedName;
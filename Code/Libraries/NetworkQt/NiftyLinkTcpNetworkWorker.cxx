@@ -11,6 +11,9 @@
 =============================================================================*/
 #include "NiftyLinkTcpNetworkWorker.h"
 #include <NiftyLinkMacro.h>
+#include <NiftyLinkImageCompression.h>
+#include <NiftyLinkImageMessageHelpers.h>
+#include <NiftyLinkMessageRecorder.h>
 #include <NiftyLinkQThread.h>
 #include <NiftyLinkUtils.h>
 #include <NiftyLinkStringMessageHelpers.h>
@@ -20,24 +23,130 @@
 #include <igtlMessageFactory.h>
 #include <igtlStatusMessage.h>
 
-#include <QTcpSocket>
+#include <QRunnable>
 #include <QsLog.h>
 #include <QTimer>
 
 #include <cassert>
+#include <cstring>
 
 namespace niftk
 {
 
+// Number of threads decoding the messages from one connection, see SetDecodeInParallel().
+static const int NIFTYLINK_DECODE_THREADS = 2;
+
+// Once this many messages are read but not yet delivered, the socket thread decodes the rest itself,
+// which slows down reading, rather than buffering more and more messages in memory.
+static const quint64 NIFTYLINK_MAX_UNPUBLISHED_MESSAGES = 8;
+
+// Number of images that can be in shared memory, waiting for the other end, see RequestSharedMemory().
+static const int NIFTYLINK_SHARED_MEMORY_SLOTS = 4;
+
+//-----------------------------------------------------------------------------
+static QByteArray CopyRawMessage(const QByteArray& rawHeader, const igtl::MessageBase::Pointer& message)
+{
+  const int bodySize = static_cast<int>(message->GetPackBodySize());
+
+  QByteArray rawMessage;
+  rawMessage.resize(IGTL_HEADER_SIZE + bodySize);
+  memcpy(rawMessage.data(), rawHeader.constData(), IGTL_HEADER_SIZE);
+  if (bodySize > 0)
+  {
+    memcpy(rawMessage.data() + IGTL_HEADER_SIZE, message->GetPackBodyPointer(), bodySize);
+  }
+  return rawMessage;
+}
+
+
+/**
+* \class NiftyLinkDecodeTask
+* \brief Private task to decompress, if necessary, and Unpack one incoming message on NiftyLinkTcpNetworkWorker::m_DecodePool.
+*/
+class NiftyLinkDecodeTask : public QRunnable
+{
+public:
+  NiftyLinkDecodeTask(NiftyLinkTcpNetworkWorker *worker,
+                      const quint64& sequenceNumber,
+                      NiftyLinkMessageContainer::Pointer msg,
+                      const QByteArray& rawHeader,
+                      const bool& isRecording)
+  : m_Worker(worker)
+  , m_SequenceNumber(sequenceNumber)
+  , m_Container(msg)
+  , m_RawHeader(rawHeader)
+  , m_IsRecording(isRecording)
+  {
+    this->setAutoDelete(true);
+  }
+
+  virtual void run()
+  {
+    igtl::MessageBase::Pointer message = m_Container->GetMessage();
+    QByteArray rawMessage;
+
+    if (niftk::IsCompressedImage(message))
+    {
+      // The pack header was converted in place, so restore it as it came off the wire.
+      memcpy(message->GetPackPointer(), m_RawHeader.constData(), IGTL_HEADER_SIZE);
+
+      igtl::TimeStamp::Pointer startTime = igtl::TimeStamp::New();
+      igtl::TimeStamp::Pointer endTime = igtl::TimeStamp::New();
+      igtl::ImageMessage::Pointer image;
+      try
+      {
+        startTime->GetTime();
+        image = niftk::DecompressImageMessage(message);
+        endTime->GetTime();
+      }
+      catch (const std::exception& e)
+      {
+        QLOG_ERROR() << QObject::tr("%1::NiftyLinkDecodeTask() - Failed to decompress image, error was %2. Discarding it.")
+                        .arg(m_Worker->objectName()).arg(QString::fromStdString(e.what()));
+
+        m_Worker->InsertDecodedMessage(m_SequenceNumber, NiftyLinkMessageContainer::Pointer(), rawMessage);
+        emit m_Worker->InternalDecodedSignal();
+        return;
+      }
+
+      emit m_Worker->InternalCodecSignal(image->GetPackSize(), message->GetPackSize(),
+                                         niftk::GetDifferenceInNanoSeconds(endTime, startTime));
+
+      // From here on, it's as if the original IMAGE message came off the wire.
+      memcpy(m_RawHeader.data(), image->GetPackPointer(), IGTL_HEADER_SIZE);
+      message = image.GetPointer();
+      m_Container->SetMessage(message);
+    }
+
+    if (m_IsRecording)
+    {
+      rawMessage = CopyRawMessage(m_RawHeader, message);
+    }
+
+    message->Unpack();
+
+    m_Worker->InsertDecodedMessage(m_SequenceNumber, m_Container, rawMessage);
+    emit m_Worker->InternalDecodedSignal();
+  }
+
+private:
+  NiftyLinkTcpNetworkWorker          *m_Worker;
+  quint64                             m_SequenceNumber;
+  NiftyLinkMessageContainer::Pointer  m_Container;
+  QByteArray                          m_RawHeader;
+  bool                                m_IsRecording;
+};
+
+
 //-----------------------------------------------------------------------------
 NiftyLinkTcpNetworkWorker::NiftyLinkTcpNetworkWorker(
     const QString& namePrefix,
     NiftyLinkMessageManager* inboundMessages,
     NiftyLinkMessageManager *outboundMessages,
-    QTcpSocket *socket,
+    NiftyLinkTransport *transport,
     QObject *parent)
 : QObject(parent)
-, m_Socket(socket)
+, m_Transport(transport)
 , m_NamePrefix(namePrefix)
 , m_MessagePrefix("")
 , m_InboundMessages(inboundMessages)
@@ -57,8 +166,20 @@ NiftyLinkTcpNetworkWorker::NiftyLinkTcpNetworkWorker(
 , m_NoIncomingDataInterval(1000)
 , m_LastMessageReceivedTime(NULL)
 , m_Disconnecting(false)
+, m_Recorder(NULL)
+, m_SendCompressedImages(false)
+, m_CodecStartTimeStamp(NULL)
+, m_CodecEndTimeStamp(NULL)
+, m_BytesToWrite(0)
+, m_RoundTripTime(0)
+, m_DecodeInParallel(false)
+, m_NextSequenceNumber(0)
+, m_NextSequenceNumberToPublish(0)
+, m_HasRequestedSharedMemory(false)
+, m_SendImagesBySharedMemory(false)
+, m_SharedMemoryWriterIndex(0)
 {
-  assert(m_Socket);
+  assert(m_Transport);
   assert(m_InboundMessages);
   assert(m_OutboundMessages);
   
@@ -69,6 +190,10 @@ NiftyLinkTcpNetworkWorker::NiftyLinkTcpNetworkWorker(
   m_LastMessageSentTime = igtl::TimeStamp::New();
   m_NoIncomingDataTimeStamp = igtl::TimeStamp::New();
   m_LastMessageReceivedTime = igtl::TimeStamp::New();
+  m_CodecStartTimeStamp = igtl::TimeStamp::New();
+  m_CodecEndTimeStamp = igtl::TimeStamp::New();
+  m_IncomingRawHeader.resize(IGTL_HEADER_SIZE);
+  m_DecodePool.setMaxThreadCount(NIFTYLINK_DECODE_THREADS);
 
   // Timers for internal monitoring.
   m_KeepAliveTimer = new QTimer(this);
@@ -85,12 +210,11 @@ NiftyLinkTcpNetworkWorker::NiftyLinkTcpNetworkWorker(
   connect(this, SIGNAL(InternalDisconnectedSocketSignal()), this, SLOT(OnRequestSocketDisconnected()));
   connect(this, SIGNAL(InternalSetKeepAliveSignal(bool)), this, SLOT(OnSetKeepAliveOn(bool)));
   connect(this, SIGNAL(InternalSetCheckForNoIncomingDataSignal(bool)), this, SLOT(OnSetCheckForNoIncomingData(bool)));
+  connect(this, SIGNAL(InternalCodecSignal(quint64, quint64, quint64)), this, SLOT(OnCodecStats(quint64, quint64, quint64)));
+  connect(this, SIGNAL(InternalDecodedSignal()), this, SLOT(OnPublishDecodedMessages()));
   connect(m_NoIncomingDataTimer, SIGNAL(timeout()), this, SLOT(OnCheckForIncomingData()));
   connect(m_KeepAliveTimer, SIGNAL(timeout()), this, SLOT(OnSendInternalPing()));
-  connect(m_Socket, SIGNAL(disconnected()), this, SLOT(OnSocketDisconnected()));
-  connect(m_Socket, SIGNAL(bytesWritten(qint64)), this, SLOT(OnBytesSent(qint64)));
-  connect(m_Socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnSocketError(QAbstractSocket::SocketError)));
-  connect(m_Socket, SIGNAL(readyRead()), this, SLOT(OnSocketReadyRead()));
+  this->ConnectTransport();
 
   QLOG_INFO() << QObject::tr("%1::NiftyLinkTcpNetworkWorker() - created.").arg(m_MessagePrefix);
 }
@@ -108,6 +232,9 @@ NiftyLinkTcpNetworkWorker::~NiftyLinkTcpNetworkWorker()
   m_NoIncomingDataTimer->stop();
   m_NoIncomingDataTimer->disconnect();
 
+  // Decode tasks call back into this object, so must all finish first.
+  m_DecodePool.waitForDone();
+
   QLOG_INFO() << QObject::tr("%1::~NiftyLinkTcpNetworkWorker() - destroyed.").arg(name);
 }
 
@@ -115,16 +242,16 @@ NiftyLinkTcpNetworkWorker::~NiftyLinkTcpNetworkWorker()
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpNetworkWorker::UpdateObjectName()
 {
-  assert(m_Socket);
+  assert(m_Transport);
 
-  QString host = m_Socket->peerName();
+  QString host = m_Transport->GetPeerName();
   if (host.size() == 0)
   {
     host = "localhost";
   }
 
   m_MessagePrefix = QObject::tr("%1(d=%2, h=%3, p=%4)")
-      .arg(m_NamePrefix).arg(m_Socket->socketDescriptor()).arg(host).arg(m_Socket->peerPort());
+      .arg(m_NamePrefix).arg(m_Transport->GetSocketDescriptor()).arg(host).arg(m_Transport->GetPeerPort());
 
   this->setObjectName(m_MessagePrefix);
   m_ReceivedCounter.setObjectName(m_MessagePrefix);
@@ -132,16 +259,44 @@ void NiftyLinkTcpNetworkWorker::UpdateObjectName()
 
 
 //-----------------------------------------------------------------------------
-QTcpSocket* NiftyLinkTcpNetworkWorker::GetSocket() const
+NiftyLinkTransport* NiftyLinkTcpNetworkWorker::GetTransport() const
 {
-  return m_Socket;
+  return m_Transport;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::SetTransport(NiftyLinkTransport *transport)
+{
+  assert(transport);
+
+  if (m_Transport != NULL)
+  {
+    m_Transport->GetDevice()->disconnect(this);
+    m_Transport->disconnect(this);
+    m_Transport->deleteLater();
+  }
+
+  m_Transport = transport;
+  this->ConnectTransport();
+  this->UpdateObjectName();
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::ConnectTransport()
+{
+  connect(m_Transport, SIGNAL(Disconnected()), this, SLOT(OnSocketDisconnected()));
+  connect(m_Transport, SIGNAL(Error(QAbstractSocket::SocketError)), this, SLOT(OnSocketError(QAbstractSocket::SocketError)));
+  connect(m_Transport->GetDevice(), SIGNAL(bytesWritten(qint64)), this, SLOT(OnBytesSent(qint64)));
+  connect(m_Transport->GetDevice(), SIGNAL(readyRead()), this, SLOT(OnSocketReadyRead()));
 }
 
 
 //-----------------------------------------------------------------------------
 bool NiftyLinkTcpNetworkWorker::IsSocketConnected() const
 {
-  return !m_Disconnecting && m_Socket != NULL && m_Socket->isOpen();
+  return !m_Disconnecting && m_Transport != NULL && m_Transport->GetDevice()->isOpen();
 }
 
 
@@ -207,6 +362,487 @@ void NiftyLinkTcpNetworkWorker::OnSetCheckForNoIncomingData(bool isOn)
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::SetRecorder(NiftyLinkMessageRecorder* recorder)
+{
+  QMutexLocker locker(&m_RecorderMutex);
+  m_Recorder = recorder;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::SetDecodeInParallel(bool isOn)
+{
+  QMutexLocker locker(&m_DecodeMutex);
+  m_DecodeInParallel = isOn;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::IsDecodingInParallel() const
+{
+  QMutexLocker locker(&m_DecodeMutex);
+  return m_DecodeInParallel;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::StartDecode(NiftyLinkMessageContainer::Pointer msg, bool isRecording)
+{
+  // m_IncomingRawHeader is implicitly shared, and is detached when the next header is copied into it.
+  m_DecodePool.start(new NiftyLinkDecodeTask(this, m_NextSequenceNumber, msg, m_IncomingRawHeader, isRecording));
+  m_NextSequenceNumber++;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::InsertDecodedMessage(const quint64& sequenceNumber,
+                                                     NiftyLinkMessageContainer::Pointer msg,
+                                                     const QByteArray& rawMessage)
+{
+  QMutexLocker locker(&m_DecodeMutex);
+  m_DecodedMessages.insert(sequenceNumber, qMakePair(msg, rawMessage));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::OnPublishDecodedMessages()
+{
+  // This doubly double checks we are running in our own thread.
+  NiftyLinkQThread *p = dynamic_cast<NiftyLinkQThread*>(QThread::currentThread());
+  assert(p != NULL);
+
+  while (true)
+  {
+    QPair<NiftyLinkMessageContainer::Pointer, QByteArray> decoded;
+    {
+      QMutexLocker locker(&m_DecodeMutex);
+      QMap<quint64, QPair<NiftyLinkMessageContainer::Pointer, QByteArray> >::iterator iter
+          = m_DecodedMessages.find(m_NextSequenceNumberToPublish);
+      if (iter == m_DecodedMessages.end())
+      {
+        return;
+      }
+      decoded = iter.value();
+      m_DecodedMessages.erase(iter);
+      m_NextSequenceNumberToPublish++;
+    }
+
+    // NULL if it was a corrupt image, which has already been logged.
+    if (decoded.first.data() != NULL)
+    {
+      this->PublishIncomingMessage(decoded.first, decoded.second);
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::PublishIncomingMessage(NiftyLinkMessageContainer::Pointer msg, const QByteArray& rawMessage)
+{
+  // For stats.
+  m_ReceivedCounter.OnMessageReceived(msg);
+
+  // Queued for the recorder's own thread to write out, so we don't block here.
+  // Record() only queues, so holding the lock is cheap, and stops SetRecorder(NULL) returning while it runs.
+  if (!rawMessage.isEmpty())
+  {
+    QMutexLocker locker(&m_RecorderMutex);
+    if (m_Recorder != NULL)
+    {
+      m_Recorder->Record(msg->GetTimeArrived(), msg->GetTimeReceived(), m_Transport->GetPeerPort(), rawMessage);
+    }
+  }
+
+  // For monitoring.
+  m_LastMessageReceivedTime->GetTime();
+
+  // Store the message in the map, and signal that we have done so.
+  m_InboundMessages->InsertContainer(m_Transport->GetPeerPort(), msg);
+  emit MessageReceived(m_Transport->GetPeerPort());
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::IsRecording() const
+{
+  QMutexLocker locker(&m_RecorderMutex);
+  return m_Recorder != NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+QByteArray NiftyLinkTcpNetworkWorker::CopyRawIncomingMessage() const
+{
+  return CopyRawMessage(m_IncomingRawHeader, m_IncomingMessage);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::DecompressIncomingImage()
+{
+  // The pack header may have been converted in place, so restore it as it came off the wire.
+  memcpy(m_IncomingMessage->GetPackPointer(), m_IncomingRawHeader.constData(), IGTL_HEADER_SIZE);
+
+  igtl::ImageMessage::Pointer image;
+  try
+  {
+    m_CodecStartTimeStamp->GetTime();
+    image = niftk::DecompressImageMessage(m_IncomingMessage);
+    m_CodecEndTimeStamp->GetTime();
+  }
+  catch (const std::exception& e)
+  {
+    QLOG_ERROR() << QObject::tr("%1::DecompressIncomingImage() - Failed to decompress image, error was %2. Discarding it.")
+                    .arg(m_MessagePrefix).arg(QString::fromStdString(e.what()));
+    return false;
+  }
+
+  m_ReceivedCounter.OnMessageCodec(image->GetPackSize(), m_IncomingMessage->GetPackSize(),
+                                   niftk::GetDifferenceInNanoSeconds(m_CodecEndTimeStamp, m_CodecStartTimeStamp));
+
+  // From here on, it's as if the original IMAGE message came off the wire.
+  memcpy(m_IncomingRawHeader.data(), image->GetPackPointer(), IGTL_HEADER_SIZE);
+  m_IncomingMessage = image.GetPointer();
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::RequestCompression(bool isOn)
+{
+  NiftyLinkMessageContainer::Pointer msg = niftk::CreateStringMessage(
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(),
+      isOn ? "COMPRESS:zlib" : "COMPRESS:none", m_LastMessageSentTime);
+
+  return this->Send(msg);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::IsSendingCompressedImages() const
+{
+  QMutexLocker locker(&m_CompressionMutex);
+  return m_SendCompressedImages;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageContainer::Pointer NiftyLinkTcpNetworkWorker::CompressImage(NiftyLinkMessageContainer::Pointer message)
+{
+  if (!this->IsSendingCompressedImages() || !niftk::IsUncompressedImage(message->GetMessage()))
+  {
+    return message;
+  }
+
+  // Called from an external thread, so this can't use our own time stamps,
+  // and the stats are passed to the thread owning this object.
+  igtl::TimeStamp::Pointer startTime = igtl::TimeStamp::New();
+  igtl::TimeStamp::Pointer endTime = igtl::TimeStamp::New();
+
+  startTime->GetTime();
+  igtl::MessageBase::Pointer compressed = niftk::CompressImageMessage(message->GetMessage());
+  endTime->GetTime();
+
+  emit InternalCodecSignal(message->GetMessage()->GetPackSize(), compressed->GetPackSize(),
+                           niftk::GetDifferenceInNanoSeconds(endTime, startTime));
+
+  NiftyLinkMessageContainer::Pointer result(new NiftyLinkMessageContainer(*message));
+  result->SetMessage(compressed);
+  return result;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::SetAdaptiveDecimation(bool isOn)
+{
+  QMutexLocker locker(&m_DecimationMutex);
+  m_Decimator.SetAdaptive(isOn);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::IsDecimatingImages() const
+{
+  QMutexLocker locker(&m_DecimationMutex);
+  return m_Decimator.IsDecimating();
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::RequestDownsampling(int factor)
+{
+  NiftyLinkMessageContainer::Pointer msg = niftk::CreateStringMessage(
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(),
+      QObject::tr("DOWNSAMPLE:%1").arg(factor), m_LastMessageSentTime);
+
+  return this->Send(msg);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::RequestRegionOfInterest(const QRect& regionOfInterest)
+{
+  QString request("ROI:none");
+  if (!regionOfInterest.isNull())
+  {
+    request = QObject::tr("ROI:%1,%2,%3,%4")
+        .arg(regionOfInterest.x()).arg(regionOfInterest.y()).arg(regionOfInterest.width()).arg(regionOfInterest.height());
+  }
+
+  NiftyLinkMessageContainer::Pointer msg = niftk::CreateStringMessage(
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(), request, m_LastMessageSentTime);
+
+  return this->Send(msg);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::RequestSharedMemory(bool isOn)
+{
+  if (isOn && !m_Transport->IsLocal())
+  {
+    QLOG_WARN() << QObject::tr("%1::RequestSharedMemory() - not a local transport, so the other end may be on another host. Not asking.")
+                   .arg(m_MessagePrefix);
+    return false;
+  }
+
+  // Set before sending, as the first notice can arrive as soon as the request is sent. Never cleared,
+  // so notices already on their way when we turn it off are still read, and their slots handed back.
+  if (isOn)
+  {
+    QMutexLocker locker(&m_SharedMemoryRequestMutex);
+    m_HasRequestedSharedMemory = true;
+  }
+
+  NiftyLinkMessageContainer::Pointer msg = niftk::CreateStringMessage(
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(),
+      isOn ? "SHM:on" : "SHM:none", m_LastMessageSentTime);
+
+  return this->Send(msg);
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::MessageBase::Pointer NiftyLinkTcpNetworkWorker::WriteSharedMemoryImage(igtl::MessageBase::Pointer image)
+{
+  const int size = static_cast<int>(image->GetPackSize());
+
+  NiftyLinkSharedMemoryRing *writer = &m_SharedMemoryWriters[m_SharedMemoryWriterIndex];
+  NiftyLinkSharedMemoryRing *previousWriter = &m_SharedMemoryWriters[1 - m_SharedMemoryWriterIndex];
+
+  // Once the other end has handed back every slot of the previous ring, it has read all the notices for it.
+  if (previousWriter->IsAttached() && !previousWriter->IsAnySlotWritten())
+  {
+    previousWriter->Detach();
+  }
+
+  // The other end attaches to a new ring when the first notice for it arrives, and the one it replaces
+  // stays until the other end has read the notices already sent for it, as detaching would destroy it.
+  if (!writer->IsAttached() || size > writer->GetSlotSize())
+  {
+    if (previousWriter->IsAttached())
+    {
+      QLOG_DEBUG() << QObject::tr("%1::WriteSharedMemoryImage() - other end still reading the ring before last, so sending through the socket.")
+                      .arg(m_MessagePrefix);
+      return igtl::MessageBase::Pointer();
+    }
+
+    if (!previousWriter->Create(NiftyLinkSharedMemoryRing::CreateUniqueKey(), size, NIFTYLINK_SHARED_MEMORY_SLOTS))
+    {
+      QLOG_WARN() << QObject::tr("%1::WriteSharedMemoryImage() - failed to create shared memory, so sending images through the socket.")
+                     .arg(m_MessagePrefix);
+      m_SendImagesBySharedMemory = false;
+      return igtl::MessageBase::Pointer();
+    }
+
+    m_SharedMemoryWriterIndex = 1 - m_SharedMemoryWriterIndex;
+    writer = &m_SharedMemoryWriters[m_SharedMemoryWriterIndex];
+    previousWriter = &m_SharedMemoryWriters[1 - m_SharedMemoryWriterIndex];
+
+    if (!previousWriter->IsAnySlotWritten())
+    {
+      previousWriter->Detach();
+    }
+  }
+
+  const int slot = writer->Write(image->GetPackPointer(), size);
+  if (slot < 0)
+  {
+    QLOG_DEBUG() << QObject::tr("%1::WriteSharedMemoryImage() - no free slot, as the other end isn't keeping up, so sending through the socket.")
+                    .arg(m_MessagePrefix);
+    return igtl::MessageBase::Pointer();
+  }
+
+  NiftyLinkMessageContainer::Pointer notice = niftk::CreateStringMessage(
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(),
+      QObject::tr("SHMIMAGE:%1,%2").arg(writer->GetKey()).arg(slot), m_LastMessageSentTime);
+
+  return notice->GetMessage();
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpNetworkWorker::ReadSharedMemoryImage(const QString& key, const int& slot)
+{
+  if (!m_SharedMemoryReader.IsAttached() || m_SharedMemoryReader.GetKey() != key)
+  {
+    if (!m_SharedMemoryReader.Attach(key))
+    {
+      QLOG_ERROR() << QObject::tr("%1::ReadSharedMemoryImage() - Failed to attach to shared memory '%2'. Discarding image.")
+                      .arg(m_MessagePrefix).arg(key);
+      return false;
+    }
+  }
+
+  int length = 0;
+  const char *data = m_SharedMemoryReader.GetSlot(slot, length);
+  if (data == NULL || length < IGTL_HEADER_SIZE)
+  {
+    QLOG_ERROR() << QObject::tr("%1::ReadSharedMemoryImage() - Slot %2 of shared memory '%3' is not valid. Discarding image.")
+                    .arg(m_MessagePrefix).arg(slot).arg(key);
+    m_SharedMemoryReader.Release(slot);
+    return false;
+  }
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), data, IGTL_HEADER_SIZE);
+  header->Unpack();
+
+  igtl::MessageBase::Pointer image;
+  try
+  {
+    igtl::MessageFactory::Pointer messageFactory = igtl::MessageFactory::New();
+    image = messageFactory->GetMessage(header);
+  }
+  catch (const std::exception& e)
+  {
+    QLOG_ERROR() << QObject::tr("%1::ReadSharedMemoryImage() - Failed to create message type %2, error was %3. Discarding image.")
+                    .arg(m_MessagePrefix).arg(QString::fromStdString(header->GetDeviceType())).arg(QString::fromStdString(e.what()));
+    m_SharedMemoryReader.Release(slot);
+    return false;
+  }
+
+  if (image.IsNull() || static_cast<int>(image->GetPackSize()) != length)
+  {
+    QLOG_ERROR() << QObject::tr("%1::ReadSharedMemoryImage() - Slot %2 of shared memory '%3' has the wrong size. Discarding image.")
+                    .arg(m_MessagePrefix).arg(slot).arg(key);
+    m_SharedMemoryReader.Release(slot);
+    return false;
+  }
+
+  // The one copy out of shared memory, after which the slot is handed straight back.
+  memcpy(image->GetPackBodyPointer(), data + IGTL_HEADER_SIZE, length - IGTL_HEADER_SIZE);
+  memcpy(m_IncomingRawHeader.data(), data, IGTL_HEADER_SIZE);
+  m_SharedMemoryReader.Release(slot);
+
+  // From here on, it's as if the IMAGE message came off the wire.
+  m_IncomingHeader = header;
+  m_IncomingMessage = image;
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::UpdateCongestion()
+{
+  const qint64 bytesToWrite = m_Transport->GetDevice()->bytesToWrite();
+  const quint64 roundTripTime = m_Transport->GetRoundTripTimeInNanoseconds();
+
+  QMutexLocker locker(&m_DecimationMutex);
+  m_BytesToWrite = bytesToWrite;
+  m_RoundTripTime = roundTripTime;
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkMessageContainer::Pointer NiftyLinkTcpNetworkWorker::DecimateImage(NiftyLinkMessageContainer::Pointer message)
+{
+  igtl::ImageMessage::Pointer image = dynamic_cast<igtl::ImageMessage*>(message->GetMessage().GetPointer());
+  if (image.IsNull())
+  {
+    return message;
+  }
+
+  int dimensions[3];
+  int subVolumeDimensions[3];
+  int subVolumeOffset[3];
+  image->GetDimensions(dimensions);
+  image->GetSubVolume(subVolumeDimensions, subVolumeOffset);
+  if (dimensions[2] != 1)
+  {
+    return message;
+  }
+
+  QMutexLocker locker(&m_DecimationMutex);
+
+  // Sub-volumes, (eg. from NiftyLinkImageDeltaEncoder), can't be dropped or resized, as later images depend on them,
+  // and nor can the key frames of the same device, as the sub-volumes must match their size.
+  if (subVolumeDimensions[0] != dimensions[0] || subVolumeDimensions[1] != dimensions[1])
+  {
+    m_DeltaEncodedDeviceNames.insert(QString(image->GetDeviceName()));
+    return message;
+  }
+
+  if (!m_Decimator.IsDecimating()
+      || m_DeltaEncodedDeviceNames.contains(QString(image->GetDeviceName())))
+  {
+    return message;
+  }
+
+  const int previousLevel = m_Decimator.GetLevel();
+  const bool isSent = m_Decimator.Update(m_BytesToWrite, m_RoundTripTime);
+  const int level = m_Decimator.GetLevel();
+  const int factor = m_Decimator.GetDownsampleFactor();
+  const QRect regionOfInterest = m_Decimator.GetRegionOfInterest();
+
+  locker.unlock();
+
+  if (level != previousLevel)
+  {
+    QLOG_INFO() << QObject::tr("%1::DecimateImage() - decimation level changed from %2 to %3.")
+                   .arg(m_MessagePrefix).arg(previousLevel).arg(level);
+  }
+
+  if (!isSent)
+  {
+    return NiftyLinkMessageContainer::Pointer();
+  }
+
+  if (factor == 1 && regionOfInterest.isNull())
+  {
+    return message;
+  }
+
+  igtl::ImageMessage::Pointer decimated = igtl::ImageMessage::New();
+  try
+  {
+    niftk::DecimateImage(image, factor, regionOfInterest, decimated);
+  }
+  catch (const std::exception& e)
+  {
+    QLOG_WARN() << QObject::tr("%1::DecimateImage() - Failed to decimate image, error was %2. Sending it whole.")
+                   .arg(m_MessagePrefix).arg(QString::fromStdString(e.what()));
+    return message;
+  }
+  decimated->Pack();
+
+  NiftyLinkMessageContainer::Pointer result(new NiftyLinkMessageContainer(*message));
+  result->SetMessage(decimated.GetPointer());
+  return result;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpNetworkWorker::OnCodecStats(quint64 uncompressedBytes, quint64 compressedBytes, quint64 codecTimeInNanoseconds)
+{
+  m_ReceivedCounter.OnMessageCodec(uncompressedBytes, compressedBytes, codecTimeInNanoseconds);
+}
+
+
 //-----------------------------------------------------------------------------
 bool NiftyLinkTcpNetworkWorker::Send(NiftyLinkMessageContainer::Pointer message)
 {
@@ -215,9 +851,18 @@ bool NiftyLinkTcpNetworkWorker::Send(NiftyLinkMessageContainer::Pointer message)
     return false;
   }
 
+  // Dropped, deliberately, as the other end isn't keeping up.
+  message = this->DecimateImage(message);
+  if (message.data() == NULL)
+  {
+    return true;
+  }
+
+  message = this->CompressImage(message);
+
   // This is done, as this can be called from an external thread (eg. GUI thread),
   // but the sending of the messages is done from the thread that this object is bound to (NiftyLinkQThread).
-  m_OutboundMessages->InsertContainer(m_Socket->peerPort(), message);
+  m_OutboundMessages->InsertContainer(m_Transport->GetPeerPort(), message);
   emit this->InternalSendSignal();
 
   return true;
@@ -232,7 +877,7 @@ bool NiftyLinkTcpNetworkWorker::RequestStats()
   // this method calls the Send method above.
 
   NiftyLinkMessageContainer::Pointer msg = niftk::CreateStringMessage(
-      "NiftyLinkTcpNetworkWorker", m_Socket->peerName(), m_Socket->peerPort(), "STATS", m_LastMessageSentTime);
+      "NiftyLinkTcpNetworkWorker", m_Transport->GetPeerName(), m_Transport->GetPeerPort(), "STATS", m_LastMessageSentTime);
 
   return this->Send(msg);
 }
@@ -253,7 +898,7 @@ void NiftyLinkTcpNetworkWorker::OnRequestSocketDisconnected()
   if (this->IsSocketConnected())
   {
     QLOG_WARN() << QObject::tr("%1::OnRequestSocketDisconnected() - asking socket.").arg(objectName());
-    m_Socket->disconnectFromHost();
+    m_Transport->DisconnectFromPeer();
     QLOG_WARN() << QObject::tr("%1::OnRequestSocketDisconnected() - asked socket.").arg(objectName());
   }
   else
@@ -274,8 +919,9 @@ void NiftyLinkTcpNetworkWorker::OnSocketDisconnected()
 
   m_Disconnecting = true;
 
-  m_Socket->disconnect(); // i.e. disconnect Qt signals/slots, not TCP socket disconnect.
-  m_Socket->deleteLater();
+  m_Transport->GetDevice()->disconnect(); // i.e. disconnect Qt signals/slots, not TCP socket disconnect.
+  m_Transport->disconnect();
+  m_Transport->deleteLater();              // which deletes the socket too.
 
   this->disconnect();     // i.e. disconnect Qt signals/slots.
   this->deleteLater();
@@ -289,9 +935,9 @@ void NiftyLinkTcpNetworkWorker::OnSocketDisconnected()
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpNetworkWorker::OnSocketError(QAbstractSocket::SocketError error)
 {
-  QString errorString = m_Socket->errorString();
+  QString errorString = m_Transport->GetErrorString();
   QLOG_ERROR() << QObject::tr("%1::OnSocketError(code=%2, string=%3).").arg(objectName()).arg(error).arg(errorString);
-  emit SocketError(m_Socket->peerPort(), error, errorString);
+  emit SocketError(m_Transport->GetPeerPort(), error, errorString);
 }
 
 
@@ -319,6 +965,7 @@ void NiftyLinkTcpNetworkWorker::OnCheckForIncomingData()
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpNetworkWorker::OnBytesSent(qint64 bytes)
 {
+  this->UpdateCongestion();
   emit BytesSent(bytes);
 }
 
@@ -345,11 +992,11 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
   }
 
   // Create stream outside of loop ... maybe more efficient.
-  QDataStream in(m_Socket);
+  QDataStream in(m_Transport->GetDevice());
   in.setVersion(QDataStream::Qt_4_0);
   
   // Storing this locally, incase the socket gets updated.
-  quint64 bytesAvailable = m_Socket->bytesAvailable();
+  quint64 bytesAvailable = m_Transport->GetDevice()->bytesAvailable();
   quint64 bytesReceived = 0;
 
   QLOG_DEBUG() << QObject::tr("%1::OnSocketReadyRead() - Starting to read data, bytes available=%2.")
@@ -359,6 +1006,10 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
   // Also need to cater for reading partial messages, as TCP may fragment them.
   do
   {
+    // If recording, this is the message as it came off the wire, before Unpack() converts byte order.
+    const bool isRecording = this->IsRecording();
+    QByteArray rawMessage;
+
     if (!m_HeaderInProgress)
     {
       // If there are not enough bytes even for a header, we can wait until the rest of the message appears.
@@ -384,13 +1035,16 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
             .arg(m_MessagePrefix);
 
         QLOG_ERROR() << errorMessage;
-        emit SocketError(m_Socket->peerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
+        emit SocketError(m_Transport->GetPeerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
         return;
       }
 
       // This should not occur, as we specifically checked for at least the right number of bytes for a header.
       assert(bytesReceived == m_IncomingHeader->GetPackSize());
 
+      // Unpack() converts byte order in-place, so keep the original, (it's only 58 bytes).
+      memcpy(m_IncomingRawHeader.data(), m_IncomingHeader->GetPackPointer(), IGTL_HEADER_SIZE);
+
       // Deserialize the header
       m_IncomingHeader->Unpack();
       m_HeaderInProgress = true;
@@ -406,9 +1060,19 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
     {
       try
       {
-        // Allocate correct message type. The factory sets the header on the message and calls AllocatePack().
-        igtl::MessageFactory::Pointer messageFactory = igtl::MessageFactory::New();
-        m_IncomingMessage = messageFactory->GetMessage(m_IncomingHeader);
+        if (niftk::IsCompressedImage(m_IncomingHeader.GetPointer()))
+        {
+          // The factory doesn't know our compressed images, so just allocate space for the body.
+          m_IncomingMessage = igtl::MessageBase::New();
+          m_IncomingMessage->SetMessageHeader(m_IncomingHeader);
+          m_IncomingMessage->AllocatePack();
+        }
+        else
+        {
+          // Allocate correct message type. The factory sets the header on the message and calls AllocatePack().
+          igtl::MessageFactory::Pointer messageFactory = igtl::MessageFactory::New();
+          m_IncomingMessage = messageFactory->GetMessage(m_IncomingHeader);
+        }
         m_IncomingMessageBytesReceived = 0;
         m_MessageInProgress = true;
       }
@@ -420,7 +1084,7 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
             .arg(m_MessagePrefix).arg(QString::fromStdString(m_IncomingHeader->GetDeviceType())).arg(QString::fromStdString(e.what()));
 
         QLOG_ERROR() << errorMessage;
-        emit SocketError(m_Socket->peerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
+        emit SocketError(m_Transport->GetPeerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
         return;
       }
     }
@@ -450,7 +1114,7 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
               .arg(m_MessagePrefix).arg(bytesAvailable).arg(bytesReceived);
 
           QLOG_ERROR() << errorMessage;
-          emit SocketError(m_Socket->peerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
+          emit SocketError(m_Transport->GetPeerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
           return;
         }
         m_IncomingMessageBytesReceived += bytesReceived;
@@ -473,15 +1137,82 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
               .arg(bytesReceived);
 
           QLOG_ERROR() << errorMessage;
-          emit SocketError(m_Socket->peerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
+          emit SocketError(m_Transport->GetPeerPort(), QAbstractSocket::UnknownSocketError, errorMessage);
           return;
         }
         m_IncomingMessageBytesReceived += bytesReceived;
         bytesAvailable -= bytesReceived;
       }
 
+      // In pipeline mode, images are decoded on m_DecodePool, while we carry on reading.
+      if ((niftk::IsUncompressedImage(m_IncomingMessage) || niftk::IsCompressedImage(m_IncomingMessage))
+          && this->IsDecodingInParallel()
+          && m_NextSequenceNumber - m_NextSequenceNumberToPublish < NIFTYLINK_MAX_UNPUBLISHED_MESSAGES)
+      {
+        m_TimeFullyReceivedTimeStamp->GetTime();
+
+        NiftyLinkMessageContainer::Pointer msg = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+        msg->SetTimeArrived(m_IncomingHeaderTimeStamp);
+        msg->SetTimeReceived(m_TimeFullyReceivedTimeStamp);
+        msg->SetMessage(m_IncomingMessage);
+
+        this->StartDecode(msg, isRecording);
+
+        m_LastMessageReceivedTime->GetTime();
+
+        // The message now belongs to the decode task.
+        m_HeaderInProgress = false;
+        m_MessageInProgress = false;
+        m_IncomingHeader = NULL;
+        m_IncomingMessage = NULL;
+        m_IncomingMessageBytesReceived = 0;
+        continue;
+      }
+
+      // Compressed images are decompressed here, so are delivered and recorded as the original IMAGE message.
+      bool isCorruptImage = false;
+      if (niftk::IsCompressedImage(m_IncomingMessage))
+      {
+        isCorruptImage = !this->DecompressIncomingImage();
+      }
+
+      if (isRecording && !isCorruptImage)
+      {
+        rawMessage = this->CopyRawIncomingMessage();
+      }
+
       // Don't forget to Unpack!
-      m_IncomingMessage->Unpack();
+      if (!isCorruptImage)
+      {
+        m_IncomingMessage->Unpack();
+      }
+
+      // Images through shared memory arrive as a notice, which is replaced by the IMAGE message itself.
+      // Notices are only read if we asked for them, over a local transport, so a peer can't make us attach
+      // to any shared memory on this host. Otherwise, a notice is just delivered as a normal STRING message.
+      bool isSharedMemoryImageExpected = false;
+      if (m_Transport->IsLocal())
+      {
+        QMutexLocker locker(&m_SharedMemoryRequestMutex);
+        isSharedMemoryImageExpected = m_HasRequestedSharedMemory;
+      }
+
+      QString sharedMemoryKey;
+      int sharedMemorySlot = -1;
+      if (!isCorruptImage
+          && isSharedMemoryImageExpected
+          && niftk::IsSharedMemoryImage(m_IncomingMessage, sharedMemoryKey, sharedMemorySlot))
+      {
+        isCorruptImage = !this->ReadSharedMemoryImage(sharedMemoryKey, sharedMemorySlot);
+        if (!isCorruptImage)
+        {
+          if (isRecording)
+          {
+            rawMessage = this->CopyRawIncomingMessage();
+          }
+          m_IncomingMessage->Unpack();
+        }
+      }
 
       bool isKeepAlive = niftk::IsKeepAlive(m_IncomingMessage);
       if (isKeepAlive)
@@ -496,8 +1227,61 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
         this->OnOutputStats();
       }
 
+      bool isCompressionOn = false;
+      bool isCompressionRequest = niftk::IsCompressionRequest(m_IncomingMessage, isCompressionOn);
+      if (isCompressionRequest)
+      {
+        QLOG_INFO() << QObject::tr("%1::IsCompressionRequest() - other end asked for compressed images=%2.")
+                       .arg(m_MessagePrefix).arg(isCompressionOn);
+
+        QMutexLocker locker(&m_CompressionMutex);
+        m_SendCompressedImages = isCompressionOn;
+      }
+
+      int downsampleFactor = 1;
+      bool isDownsamplingRequest = niftk::IsDownsamplingRequest(m_IncomingMessage, downsampleFactor);
+      if (isDownsamplingRequest)
+      {
+        QLOG_INFO() << QObject::tr("%1::IsDownsamplingRequest() - other end asked for images downsampled by %2.")
+                       .arg(m_MessagePrefix).arg(downsampleFactor);
+
+        QMutexLocker locker(&m_DecimationMutex);
+        m_Decimator.SetDownsampleFactor(downsampleFactor);
+      }
+
+      QRect regionOfInterest;
+      bool isRegionOfInterestRequest = niftk::IsRegionOfInterestRequest(m_IncomingMessage, regionOfInterest);
+      if (isRegionOfInterestRequest)
+      {
+        QLOG_INFO() << QObject::tr("%1::IsRegionOfInterestRequest() - other end asked for region (%2, %3, %4, %5).")
+                       .arg(m_MessagePrefix).arg(regionOfInterest.x()).arg(regionOfInterest.y())
+                       .arg(regionOfInterest.width()).arg(regionOfInterest.height());
+
+        QMutexLocker locker(&m_DecimationMutex);
+        m_Decimator.SetRegionOfInterest(regionOfInterest);
+      }
+
+      bool isSharedMemoryOn = false;
+      bool isSharedMemoryRequest = niftk::IsSharedMemoryRequest(m_IncomingMessage, isSharedMemoryOn);
+      if (isSharedMemoryRequest)
+      {
+        if (isSharedMemoryOn && !m_Transport->IsLocal())
+        {
+          QLOG_WARN() << QObject::tr("%1::IsSharedMemoryRequest() - other end asked for images through shared memory, "
+                                     "but is not on a local transport, so ignoring it.").arg(m_MessagePrefix);
+        }
+        else
+        {
+          QLOG_INFO() << QObject::tr("%1::IsSharedMemoryRequest() - other end asked for images through shared memory=%2.")
+                         .arg(m_MessagePrefix).arg(isSharedMemoryOn);
+
+          m_SendImagesBySharedMemory = isSharedMemoryOn;
+        }
+      }
+
       // Check for special case messages. They are squashed here, and not delivered to client.
-      if (isKeepAlive || isStatsRequest)
+      if (isKeepAlive || isStatsRequest || isCompressionRequest || isDownsamplingRequest || isRegionOfInterestRequest
+          || isSharedMemoryRequest || isCorruptImage)
       {
         
         m_LastMessageReceivedTime->GetTime();
@@ -512,6 +1296,11 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
       }
     } // end if we have a body.
 
+    if (isRecording && rawMessage.isEmpty())
+    {
+      rawMessage = this->CopyRawIncomingMessage();
+    }
+
     m_TimeFullyReceivedTimeStamp->GetTime();
 
     // This is the container we eventually publish.
@@ -537,15 +1326,19 @@ void NiftyLinkTcpNetworkWorker::OnSocketReadyRead()
     m_MessageInProgress = false;
     m_IncomingMessageBytesReceived = 0;
 
-    // For stats.
-    m_ReceivedCounter.OnMessageReceived(msg);
-
-    // For monitoring.
-    m_LastMessageReceivedTime->GetTime();
-
-    // Store the message in the map, and signal that we have done so.
-    m_InboundMessages->InsertContainer(m_Socket->peerPort(), msg);
-    emit MessageReceived(m_Socket->peerPort());
+    // If images are still being decoded, this message must wait its turn, so messages are delivered in order.
+    if (m_NextSequenceNumber == m_NextSequenceNumberToPublish)
+    {
+      m_NextSequenceNumber++;
+      m_NextSequenceNumberToPublish++;
+      this->PublishIncomingMessage(msg, rawMessage);
+    }
+    else
+    {
+      this->InsertDecodedMessage(m_NextSequenceNumber, msg, rawMessage);
+      m_NextSequenceNumber++;
+      this->OnPublishDecodedMessages();
+    }
 
   } while (bytesAvailable > 0);
 
@@ -560,8 +1353,19 @@ void NiftyLinkTcpNetworkWorker::OnSendMessage()
   NiftyLinkQThread *p = dynamic_cast<NiftyLinkQThread*>(QThread::currentThread());
   assert(p != NULL);
 
-  NiftyLinkMessageContainer::Pointer message = m_OutboundMessages->GetContainer(m_Socket->peerPort());
+  NiftyLinkMessageContainer::Pointer message = m_OutboundMessages->GetContainer(m_Transport->GetPeerPort());
   igtl::MessageBase::Pointer msg = message->GetMessage();
+
+  // The other end asked to read images from shared memory, so it's just sent a notice of the slot.
+  if (m_SendImagesBySharedMemory && niftk::IsUncompressedImage(msg))
+  {
+    igtl::MessageBase::Pointer notice = this->WriteSharedMemoryImage(msg);
+    if (notice.IsNotNull())
+    {
+      msg = notice;
+    }
+  }
+
   this->InternalSendMessage(msg);
 
   QLOG_DEBUG() << QObject::tr("%1::OnSendMessage() - sent.").arg(m_MessagePrefix);
@@ -609,7 +1413,7 @@ void NiftyLinkTcpNetworkWorker::InternalSendMessage(igtl::MessageBase::Pointer m
     return;
   }
 
-  int bytesWritten = m_Socket->write(static_cast<const char*>(msg->GetPackPointer()), msg->GetPackSize());
+  int bytesWritten = m_Transport->GetDevice()->write(static_cast<const char*>(msg->GetPackPointer()), msg->GetPackSize());
   if (bytesWritten != msg->GetPackSize())
   {
     QLOG_ERROR() << QObject::tr("%1::SendMessage() - only written %2 bytes instead of %3").arg(m_MessagePrefix).arg(bytesWritten).arg(msg->GetPackSize());
@@ -618,6 +1422,8 @@ void NiftyLinkTcpNetworkWorker::InternalSendMessage(igtl::MessageBase::Pointer m
   // Store the time where we last sent a message.
   m_LastMessageSentTime->GetTime();
 
+  this->UpdateCongestion();
+
   QLOG_DEBUG() << QObject::tr("%1::SendMessage() - written %2 bytes.").arg(m_MessagePrefix).arg(bytesWritten);
 }
 
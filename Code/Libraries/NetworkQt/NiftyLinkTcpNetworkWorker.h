@@ -16,16 +16,28 @@
 #include <NiftyLinkMessageContainer.h>
 #include <NiftyLinkMessageManager.h>
 #include <NiftyLinkMessageCounter.h>
+#include <NiftyLinkImageDecimator.h>
+#include <NiftyLinkSharedMemoryRing.h>
+#include <NiftyLinkTransport.h>
 #include <igtlMessageBase.h>
 #include <igtlTimeStamp.h>
 
 #include <QThread>
-#include <QTcpSocket>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QByteArray>
+#include <QRect>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+#include <QThreadPool>
 
 namespace niftk
 {
+
+class NiftyLinkMessageRecorder;
+class NiftyLinkDecodeTask;
+
 /**
 * \class NiftyLinkTcpNetworkWorker
 * \brief Worker object, to be run in a separate NiftyLinkQThread by NiftyLinkTcpServer or NiftyLinkTcpClient.
@@ -34,6 +46,19 @@ namespace niftk
 *
 * Once this worker is running in its own event loop, you should consider the socket
 * and worker as being owned by NiftyLinkQThread, and events are fired from the event loop of the new NiftyLinkQThread.
+*
+* The socket is wrapped in a NiftyLinkTransport, so the same OpenIGTLink framing, stats and signals
+* are used over TCP, (NiftyLinkTcpTransport), or a same-host local socket, (NiftyLinkLocalTransport).
+*
+* By default, each message is decoded (decompressed and Unpacked) on the NiftyLinkQThread, as soon as it is
+* read, so while a large image is being decoded, nothing more is read from the socket. With SetDecodeInParallel(),
+* the NiftyLinkQThread just reads the raw bytes of IMAGE messages, and hands them to a small pool of threads to
+* decode, while it carries on reading. Messages are still delivered in the order they arrived.
+*
+* Over a local transport, the receiving end can ask, with RequestSharedMemory(), for IMAGE messages to be
+* passed through a NiftyLinkSharedMemoryRing, rather than the socket. Each image is then copied once into
+* shared memory, and once out of it, and only a small STRING notice of the slot goes through the socket,
+* which keeps images in order with all the other messages.
 */
 class NiftyLinkTcpNetworkWorker : public QObject
 {
@@ -45,7 +70,7 @@ public:
   NiftyLinkTcpNetworkWorker(const QString& namePrefix,
                             NiftyLinkMessageManager* inboundMessages,
                             NiftyLinkMessageManager* outboundMessages,
-                            QTcpSocket *socket,
+                            NiftyLinkTransport *transport,
                             QObject *parent = 0);
 
   /// \brief Destructor.
@@ -54,8 +79,12 @@ public:
   /// \brief For Logging purposes.
   void UpdateObjectName();
 
-  /// \brief Returns the contained socket, but breaks encapsulation - use carefully.
-  QTcpSocket* GetSocket() const;
+  /// \brief Returns the contained transport, but breaks encapsulation - use carefully.
+  NiftyLinkTransport* GetTransport() const;
+
+  /// \brief Replaces the transport, which is then owned by this worker, deleting the previous one.
+  /// Must only be called before the transport connects, and before this worker is moved to its NiftyLinkQThread.
+  void SetTransport(NiftyLinkTransport *transport);
 
   /// \brief Returns true if the socket exists, and the socket says its open, and false otherwise.
   bool IsSocketConnected() const;
@@ -78,6 +107,18 @@ public:
   /// eg. One end sends keep alive messages, the other end expects to receive data regularly.
   void SetCheckForNoIncomingData(bool isOn);
 
+  /// \brief Sets a recorder, which is given the raw bytes of every delivered message. Set to NULL to stop.
+  /// The recorder is not owned by this class, so must outlive it, or be unset first. Once this returns,
+  /// the recorder is no longer in use, so can be deleted.
+  void SetRecorder(NiftyLinkMessageRecorder* recorder);
+
+  /// \brief Turns on, or off, decoding incoming IMAGE messages on a pool of threads, rather than the
+  /// thread reading the socket, default off. Messages are delivered in order either way.
+  void SetDecodeInParallel(bool isOn);
+
+  /// \brief Returns true if incoming IMAGE messages are decoded on a pool of threads.
+  bool IsDecodingInParallel() const;
+
   /// \brief Sends an OpenIGTLink message.
   /// The OpenIGTLink message within NiftyLinkMessageContainer should be already Packed.
   /// \return false if socket closed or unwritable, true otherwise.
@@ -91,6 +132,54 @@ public:
   /// \return false if socket closed or unwritable, true otherwise.
   bool RequestStats();
 
+  /// \brief Sends a message via the socket to ask the other end to send us IMAGE messages
+  /// compressed, (isOn = true), or not, (isOn = false), see NiftyLinkImageCompression.h.
+  ///
+  /// A peer that doesn't understand the request just receives it as a normal STRING message,
+  /// and carries on sending uncompressed IMAGE messages, so this is safe to send to any peer.
+  /// \return false if socket closed or unwritable, true otherwise.
+  bool RequestCompression(bool isOn);
+
+  /// \brief Returns true if the other end has asked for compressed IMAGE messages, via RequestCompression().
+  bool IsSendingCompressedImages() const;
+
+  /// \brief If the other end asked for compressed IMAGE messages, and message contains a Packed IMAGE message,
+  /// returns a new container with the compressed message, and otherwise returns message itself.
+  ///
+  /// This is called by Send(), so client code need not call it, but NiftyLinkTcpServer calls it so that
+  /// an image is only compressed once, for all the clients that asked. Compression runs on the calling
+  /// thread and a private thread pool, (see NiftyLinkImageCompression.h), so it doesn't stall the socket thread.
+  NiftyLinkMessageContainer::Pointer CompressImage(NiftyLinkMessageContainer::Pointer message);
+
+  /// \brief Turns on, or off, automatically sending fewer, smaller, images when the other end can't keep up,
+  /// judged by the bytes still queued on the socket, and the TCP round trip time, (see NiftyLinkImageDecimator).
+  void SetAdaptiveDecimation(bool isOn);
+
+  /// \brief Returns true if images sent by Send() may be dropped or changed,
+  /// ie. adaptive decimation is on, or the other end asked for downsampling, or a region of interest.
+  /// Delta encoded images are never dropped or changed, see DecimateImage().
+  bool IsDecimatingImages() const;
+
+  /// \brief Sends a message via the socket to ask the other end to downsample IMAGE messages by factor, (1 to turn it off).
+  /// A peer that doesn't understand the request just receives it as a normal STRING message.
+  /// \return false if socket closed or unwritable, true otherwise.
+  bool RequestDownsampling(int factor);
+
+  /// \brief Sends a message via the socket to ask the other end to send only a region of interest
+  /// of IMAGE messages, in pixels, or a null QRect to turn it off.
+  /// A peer that doesn't understand the request just receives it as a normal STRING message.
+  /// \return false if socket closed or unwritable, true otherwise.
+  bool RequestRegionOfInterest(const QRect& regionOfInterest);
+
+  /// \brief Sends a message via the socket to ask the other end to send us uncompressed IMAGE messages
+  /// through shared memory, (isOn = true), or through the socket, (isOn = false), see NiftyLinkSharedMemoryRing.
+  ///
+  /// Only asks if the transport is local, (see NiftyLinkTransport::IsLocal()), so the other end is on the same host.
+  /// Until this has asked, notices of images in shared memory are delivered as normal STRING messages, and not read.
+  /// A peer that doesn't understand the request just receives it as a normal STRING message.
+  /// \return false if the transport isn't local, or the socket is closed or unwritable, true otherwise.
+  bool RequestSharedMemory(bool isOn);
+
 signals:
 
   /// \brief The socket has disconnected, which means everything will start shutting down.
@@ -126,6 +215,12 @@ signals:
   /// \brief Internal use only.
   void InternalSetCheckForNoIncomingDataSignal(bool);
 
+  /// \brief Internal use only.
+  void InternalCodecSignal(quint64 uncompressedBytes, quint64 compressedBytes, quint64 codecTimeInNanoseconds);
+
+  /// \brief Internal use only.
+  void InternalDecodedSignal();
+
 private slots:
 
   /// \brief Internal slot that actually tells the socket to disconnect.
@@ -168,15 +263,70 @@ private slots:
   /// Due to multi-threaded nature, should only be called by the main thread owning this class.
   void OnSetCheckForNoIncomingData(bool isOn);
 
+  /// \brief Adds to the compression stats, so that they are only updated from the thread owning this class.
+  void OnCodecStats(quint64 uncompressedBytes, quint64 compressedBytes, quint64 codecTimeInNanoseconds);
+
+  /// \brief Delivers decoded messages, in the order they were read, stopping at the first one still being decoded.
+  /// Due to multi-threaded nature, should only be called by the main thread owning this class.
+  void OnPublishDecodedMessages();
+
 private:
 
+  friend class NiftyLinkDecodeTask;
+
   /// \brief Actually sends a message out the socket, so don't expose this publically.
   void InternalSendMessage(igtl::MessageBase::Pointer);
 
   /// \brief Asks the containing thread to quit.
   void ShutdownThread();
 
-  QTcpSocket                   *m_Socket;
+  /// \brief Connects the signals of m_Transport, and its socket, to this.
+  void ConnectTransport();
+
+  /// \brief Returns true if there is a recorder. Don't use the recorder outside m_RecorderMutex, see SetRecorder().
+  bool IsRecording() const;
+
+  /// \brief Copies the header and body of the incoming message, before Unpack() changes the byte order.
+  QByteArray CopyRawIncomingMessage() const;
+
+  /// \brief Hands the incoming message, whose bytes have all been read, to m_DecodePool.
+  /// Due to multi-threaded nature, should only be called by the main thread owning this class.
+  void StartDecode(NiftyLinkMessageContainer::Pointer msg, bool isRecording);
+
+  /// \brief Stores a decoded message, or NULL if it couldn't be decoded, until OnPublishDecodedMessages().
+  void InsertDecodedMessage(const quint64& sequenceNumber, NiftyLinkMessageContainer::Pointer msg, const QByteArray& rawMessage);
+
+  /// \brief Updates stats, passes the raw message to the recorder, if any, and delivers msg.
+  /// Due to multi-threaded nature, should only be called by the main thread owning this class.
+  void PublishIncomingMessage(NiftyLinkMessageContainer::Pointer msg, const QByteArray& rawMessage);
+
+  /// \brief Replaces the incoming compressed image, (see NiftyLinkImageCompression.h), with the decompressed IMAGE message.
+  /// \return false if the compressed image was corrupt.
+  bool DecompressIncomingImage();
+
+  /// \brief Returns NULL if the image in message should be dropped, or a new container with a smaller
+  /// image, or message itself, (see NiftyLinkImageDecimator).
+  ///
+  /// Images from a device that has sent a sub-volume, (eg. from NiftyLinkImageDeltaEncoder), are never decimated,
+  /// as the receiver must decode its sub-volumes against its key frames. A key frame decimated before that device's
+  /// first sub-volume means the receiver can't decode until the next key frame.
+  NiftyLinkMessageContainer::Pointer DecimateImage(NiftyLinkMessageContainer::Pointer message);
+
+  /// \brief Stores the bytes still to write, and the round trip time, for DecimateImage().
+  /// Due to multi-threaded nature, should only be called by the main thread owning this class.
+  void UpdateCongestion();
+
+  /// \brief Copies the packed image into a shared memory ring, creating a bigger one if need be,
+  /// and returns a packed notice of the slot to send instead, or NULL if the image must go through the socket.
+  /// Due to multi-threaded nature, should only be called by the main thread owning this class.
+  igtl::MessageBase::Pointer WriteSharedMemoryImage(igtl::MessageBase::Pointer image);
+
+  /// \brief Replaces the incoming notice with the IMAGE message in slot of the ring called key, (not yet Unpacked),
+  /// and hands the slot back.
+  /// \return false if the image could not be read, which is logged.
+  bool ReadSharedMemoryImage(const QString& key, const int& slot);
+
+  NiftyLinkTransport           *m_Transport;
   QString                       m_NamePrefix;
   QString                       m_MessagePrefix;
 
@@ -212,6 +362,45 @@ private:
   // Disconnecting in progress.
   bool                           m_Disconnecting;
 
+  // For recording, the header bytes are kept as they came off the wire.
+  mutable QMutex                 m_RecorderMutex;
+  NiftyLinkMessageRecorder      *m_Recorder;
+  QByteArray                     m_IncomingRawHeader;
+
+  // For compression, which the other end must have asked for.
+  mutable QMutex                 m_CompressionMutex;
+  bool                           m_SendCompressedImages;
+  igtl::TimeStamp::Pointer       m_CodecStartTimeStamp;
+  igtl::TimeStamp::Pointer       m_CodecEndTimeStamp;
+
+  // For decimating images, when the other end asked, or can't keep up.
+  mutable QMutex                 m_DecimationMutex;
+  NiftyLinkImageDecimator        m_Decimator;
+  QSet<QString>                  m_DeltaEncodedDeviceNames;
+  qint64                         m_BytesToWrite;
+  quint64                        m_RoundTripTime;
+
+  // For decoding off the socket thread. Sequence numbers are given to messages as they are read,
+  // and messages are published in sequence number order, see OnPublishDecodedMessages().
+  QThreadPool                    m_DecodePool;
+  mutable QMutex                 m_DecodeMutex;
+  bool                           m_DecodeInParallel;
+  quint64                        m_NextSequenceNumber;
+  quint64                        m_NextSequenceNumberToPublish;
+  QMap<quint64, QPair<NiftyLinkMessageContainer::Pointer, QByteArray> > m_DecodedMessages;
+
+  // Set once we have asked the other end for images through shared memory, by any thread, so its notices are read.
+  mutable QMutex                 m_SharedMemoryRequestMutex;
+  bool                           m_HasRequestedSharedMemory;
+
+  // For images through shared memory, which the other end must have asked for. Only used by the thread owning this class.
+  // Images are written to m_SharedMemoryWriters[m_SharedMemoryWriterIndex], and the other ring, if attached, is the one
+  // it replaced, (for bigger images), kept until the other end has read everything in it.
+  bool                           m_SendImagesBySharedMemory;
+  NiftyLinkSharedMemoryRing      m_SharedMemoryWriters[2];
+  int                            m_SharedMemoryWriterIndex;
+  NiftyLinkSharedMemoryRing      m_SharedMemoryReader;
+
 }; // end class
 
 } // end namespace niftk
@@ -13,9 +13,13 @@
 #include <NiftyLinkUtils.h>
 #include <NiftyLinkQThread.h>
 #include <NiftyLinkMacro.h>
+#include <NiftyLinkLocalTransport.h>
+#include <NiftyLinkTcpTransport.h>
 
 #include <QsLog.h>
 #include <QMutexLocker>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QTcpSocket>
 
 #include <igtlMessageFactory.h>
@@ -24,6 +28,8 @@
 #include <iostream>
 #include <cassert>
 
+static const int NIFTYLINK_LOCAL_SERVER_PROBE_TIMEOUT_MSECS = 500;
+
 namespace niftk
 {
 
@@ -32,6 +38,10 @@ NiftyLinkTcpServer::NiftyLinkTcpServer(QObject *parent)
 : QTcpServer(parent)
 , m_SendKeepAlive(false)
 , m_CheckNoIncoming(false)
+, m_Recorder(NULL)
+, m_AdaptiveDecimation(false)
+, m_DecodeInParallel(false)
+, m_LocalServer(NULL)
 {
   this->Initialise();
 }
@@ -42,6 +52,10 @@ NiftyLinkTcpServer::NiftyLinkTcpServer(const QHostAddress &address, quint16 port
 : QTcpServer(parent)
 , m_SendKeepAlive(false)
 , m_CheckNoIncoming(false)
+, m_Recorder(NULL)
+, m_AdaptiveDecimation(false)
+, m_DecodeInParallel(false)
+, m_LocalServer(NULL)
 {
   this->Initialise();
 
@@ -62,6 +76,7 @@ void NiftyLinkTcpServer::Initialise()
   qRegisterMetaType<QAbstractSocket::SocketError>("QAbstractSocket::SocketError");
   qRegisterMetaType<niftk::NiftyLinkMessageContainer::Pointer>("niftk::NiftyLinkMessageContainer::Pointer");
   qRegisterMetaType<niftk::NiftyLinkMessageStatsContainer>("niftk::NiftyLinkMessageStatsContainer");
+  qRegisterMetaType<quint64>("quint64");
 
   // This is to make sure we have the best possible system timer.
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -91,6 +106,44 @@ NiftyLinkTcpServer::~NiftyLinkTcpServer()
 }
 
 
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpServer::Listen(const QString& address, quint16 port)
+{
+  if (!NiftyLinkTransport::IsLocalAddress(address))
+  {
+    return this->listen(QHostAddress(address), port);
+  }
+
+  if (m_LocalServer == NULL)
+  {
+    m_LocalServer = new QLocalServer(this);
+    connect(m_LocalServer, SIGNAL(newConnection()), this, SLOT(OnNewLocalConnection()));
+  }
+
+  QString path = NiftyLinkTransport::GetLocalPath(address);
+
+  // Only a socket file that nobody answers on is stale. If another server is still listening, leave it alone.
+  QLocalSocket probe;
+  probe.connectToServer(path);
+  if (probe.waitForConnected(NIFTYLINK_LOCAL_SERVER_PROBE_TIMEOUT_MSECS))
+  {
+    probe.abort();
+    QLOG_ERROR() << QObject::tr("%1::Listen(%2) - failed, another server is already listening.").arg(objectName()).arg(address);
+    return false;
+  }
+  QLocalServer::removeServer(path);
+
+  if (!m_LocalServer->listen(path))
+  {
+    QLOG_ERROR() << QObject::tr("%1::Listen(%2) - failed, error=%3.").arg(objectName()).arg(address).arg(m_LocalServer->errorString());
+    return false;
+  }
+
+  QLOG_INFO() << QObject::tr("%1::Listen(%2) - listening.").arg(objectName()).arg(address);
+  return true;
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpServer::SetNumberMessageReceivedThreshold(qint64 threshold)
 {
@@ -124,6 +177,42 @@ void NiftyLinkTcpServer::SetCheckForNoIncomingData(bool isOn)
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpServer::SetRecorder(NiftyLinkMessageRecorder* recorder)
+{
+  QMutexLocker locker(&m_Mutex);
+  foreach (NiftyLinkTcpNetworkWorker* worker, m_Workers)
+  {
+    worker->SetRecorder(recorder);
+  }
+  m_Recorder = recorder;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpServer::SetAdaptiveDecimation(bool isOn)
+{
+  QMutexLocker locker(&m_Mutex);
+  foreach (NiftyLinkTcpNetworkWorker* worker, m_Workers)
+  {
+    worker->SetAdaptiveDecimation(isOn);
+  }
+  m_AdaptiveDecimation = isOn;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpServer::SetDecodeInParallel(bool isOn)
+{
+  QMutexLocker locker(&m_Mutex);
+  foreach (NiftyLinkTcpNetworkWorker* worker, m_Workers)
+  {
+    worker->SetDecodeInParallel(isOn);
+  }
+  m_DecodeInParallel = isOn;
+}
+
+
 //-----------------------------------------------------------------------------
 int NiftyLinkTcpServer::GetNumberOfClientsConnected()
 {
@@ -136,11 +225,27 @@ int NiftyLinkTcpServer::GetNumberOfClientsConnected()
 int NiftyLinkTcpServer::Send(NiftyLinkMessageContainer::Pointer message)
 {
   int numberSentTo = 0;
+
+  // Images are compressed at most once, and shared by all clients that asked for compression,
+  // except those that are being sent decimated images, which must be decimated before compression.
+  NiftyLinkMessageContainer::Pointer compressedMessage;
+
   foreach (NiftyLinkTcpNetworkWorker* worker, m_Workers)
   {
     if (worker->IsSocketConnected())
     {
-      worker->Send(message);
+      if (worker->IsSendingCompressedImages() && !worker->IsDecimatingImages())
+      {
+        if (compressedMessage.data() == NULL)
+        {
+          compressedMessage = worker->CompressImage(message);
+        }
+        worker->Send(compressedMessage);
+      }
+      else
+      {
+        worker->Send(message);
+      }
       numberSentTo++;
     }
     else
@@ -175,32 +280,7 @@ void NiftyLinkTcpServer::incomingConnection(qintptr socketDescriptor)
   QTcpSocket *socket = new QTcpSocket();
   if (socket->setSocketDescriptor(socketDescriptor))
   {
-    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
-
-    NiftyLinkTcpNetworkWorker *worker = new NiftyLinkTcpNetworkWorker("NiftyLinkTcpServerWorker", &m_InboundMessages, &m_OutboundMessages, socket);
-    worker->SetNumberMessageReceivedThreshold(m_ReceivedCounter.GetNumberMessageReceivedThreshold());
-    worker->SetKeepAliveOn(m_SendKeepAlive);
-    worker->SetCheckForNoIncomingData(m_CheckNoIncoming);
-
-    connect(worker, SIGNAL(NoIncomingData()), this, SIGNAL(NoIncomingData()));
-    connect(worker, SIGNAL(SentKeepAlive()), this, SIGNAL(SentKeepAlive()));
-    connect(worker, SIGNAL(BytesSent(qint64)), this, SIGNAL(BytesSent(qint64)));
-    connect(worker, SIGNAL(SocketError(int,QAbstractSocket::SocketError,QString)), this, SIGNAL(SocketError(int,QAbstractSocket::SocketError,QString)));
-    connect(worker, SIGNAL(MessageReceived(int)), this, SLOT(OnMessageReceived(int)));
-    connect(worker, SIGNAL(SocketDisconnected()), this, SLOT(OnClientDisconnected()), Qt::QueuedConnection);
-
-    QMutexLocker locker(&m_Mutex);
-    m_Workers.insert(worker);
-
-    NiftyLinkQThread *thread = new NiftyLinkQThread();
-    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater())); // i.e. the event loop of thread deletes it when control returns to this event loop.
-
-    worker->moveToThread(thread);
-    socket->moveToThread(thread);
-
-    thread->start();
-
-    emit ClientConnected(socketDescriptor);
+    this->StartWorker(new NiftyLinkTcpTransport(socket));
   }
   else
   {
@@ -219,6 +299,62 @@ void NiftyLinkTcpServer::incomingConnection(qintptr socketDescriptor)
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpServer::OnNewLocalConnection()
+{
+  while (m_LocalServer->hasPendingConnections())
+  {
+    QLocalSocket *socket = m_LocalServer->nextPendingConnection();
+
+    QLOG_INFO() << QObject::tr("%1::OnNewLocalConnection(%2) - creating socket.").arg(objectName()).arg(socket->socketDescriptor());
+
+    // The transport takes the socket from the local server, so the server won't delete it.
+    this->StartWorker(new NiftyLinkLocalTransport(socket));
+
+    this->setObjectName(QObject::tr("NiftyLinkTcpServer(%1)").arg(m_LocalServer->fullServerName()));
+    m_ReceivedCounter.setObjectName(QObject::tr("NiftyLinkTcpServer(%1)").arg(m_LocalServer->fullServerName()));
+
+    QLOG_INFO() << QObject::tr("%1::OnNewLocalConnection() - created socket.").arg(objectName());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpServer::StartWorker(NiftyLinkTransport *transport)
+{
+  // Read before the transport moves to its thread.
+  const int socketDescriptor = static_cast<int>(transport->GetSocketDescriptor());
+
+  NiftyLinkTcpNetworkWorker *worker = new NiftyLinkTcpNetworkWorker("NiftyLinkTcpServerWorker", &m_InboundMessages, &m_OutboundMessages, transport);
+  worker->SetNumberMessageReceivedThreshold(m_ReceivedCounter.GetNumberMessageReceivedThreshold());
+  worker->SetKeepAliveOn(m_SendKeepAlive);
+  worker->SetCheckForNoIncomingData(m_CheckNoIncoming);
+  worker->SetRecorder(m_Recorder);
+  worker->SetAdaptiveDecimation(m_AdaptiveDecimation);
+  worker->SetDecodeInParallel(m_DecodeInParallel);
+
+  connect(worker, SIGNAL(NoIncomingData()), this, SIGNAL(NoIncomingData()));
+  connect(worker, SIGNAL(SentKeepAlive()), this, SIGNAL(SentKeepAlive()));
+  connect(worker, SIGNAL(BytesSent(qint64)), this, SIGNAL(BytesSent(qint64)));
+  connect(worker, SIGNAL(SocketError(int,QAbstractSocket::SocketError,QString)), this, SIGNAL(SocketError(int,QAbstractSocket::SocketError,QString)));
+  connect(worker, SIGNAL(MessageReceived(int)), this, SLOT(OnMessageReceived(int)));
+  connect(worker, SIGNAL(SocketDisconnected()), this, SLOT(OnClientDisconnected()), Qt::QueuedConnection);
+
+  QMutexLocker locker(&m_Mutex);
+  m_Workers.insert(worker);
+
+  NiftyLinkQThread *thread = new NiftyLinkQThread();
+  connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater())); // i.e. the event loop of thread deletes it when control returns to this event loop.
+
+  worker->moveToThread(thread);
+  transport->moveToThread(thread); // and its socket, as a child.
+
+  thread->start();
+
+  emit ClientConnected(socketDescriptor);
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkTcpServer::OnClientDisconnected()
 {
@@ -238,7 +374,7 @@ void NiftyLinkTcpServer::OnClientDisconnected()
     assert(false);
   }
 
-  int portNumber = sender->GetSocket()->peerPort();
+  int portNumber = sender->GetTransport()->GetPeerPort();
 
   QLOG_INFO() << QObject::tr("%1::OnClientDisconnected() - client on port %2 removed, leaving %3 clients.")
                  .arg(objectName()).arg(portNumber).arg(m_Workers.size());
@@ -266,7 +402,7 @@ void NiftyLinkTcpServer::Shutdown()
   QList<NiftyLinkTcpNetworkWorker*> copyOfSet = m_Workers.toList();
   foreach (NiftyLinkTcpNetworkWorker* worker, copyOfSet)
   {
-    int port = worker->GetSocket()->peerPort();
+    int port = worker->GetTransport()->GetPeerPort();
 
     QLOG_INFO() << QObject::tr("%1::Shutdown() - asking (%2) to disconnect.").arg(objectName()).arg(port);
     worker->RequestDisconnectSocket();
@@ -22,8 +22,14 @@
 #include <QMutex>
 #include <QTcpServer>
 
+class QLocalServer;
+
 namespace niftk
 {
+
+class NiftyLinkMessageRecorder;
+class NiftyLinkTransport;
+
 /**
 * \class NiftyLinkTcpServer
 * \brief TCP server that processes multiple clients bound to a single port,
@@ -31,6 +37,10 @@ namespace niftk
 * sending and receiving OpenIGTLink messages.
 *
 * Lots of functionality is provided by the QTcpServer base class.
+*
+* With Listen(), the server can instead, or as well, accept clients on the same host on a local socket,
+* using NiftyLinkLocalTransport, which skips the TCP/IP stack. Local clients are reported by their
+* socket descriptor, where TCP clients are reported by port number.
 */
 class NIFTYLINKCOMMON_WINEXPORT NiftyLinkTcpServer : public QTcpServer
 {
@@ -48,6 +58,14 @@ public:
   /// If there are clients connected, this method will call Shutdown() first.
   virtual ~NiftyLinkTcpServer();
 
+  /// \brief Listens on a local socket if address is "unix:<path>", (see NiftyLinkTransport), ignoring port,
+  /// or else on TCP, on the given host address and port, as QTcpServer::listen().
+  ///
+  /// A stale local socket file, left by a server that crashed, is removed first. If another
+  /// server still answers on the path, the file is left alone and Listen() fails.
+  /// \return true if successful.
+  bool Listen(const QString& address, quint16 port = 0);
+
   /// \brief Call this to shut down.
   ///
   /// Will ask each connected client to disconnect, and will wait until
@@ -70,6 +88,19 @@ public:
   /// eg. One end sends keep alive messages, the other end expects to receive data regularly.
   void SetCheckForNoIncomingData(bool isOn);
 
+  /// \brief Records every message received from any client to recorder, which must already be started. Set to NULL to stop.
+  /// The recorder is not owned by this class, so must outlive it, or be unset first. See NiftyLinkMessageRecorder.
+  void SetRecorder(NiftyLinkMessageRecorder* recorder);
+
+  /// \brief Turns adaptive decimation on or off for all clients, current and future, default off.
+  /// When on, images to a client that can't keep up are dropped and downsampled, without affecting other clients.
+  /// See NiftyLinkTcpNetworkWorker::SetAdaptiveDecimation().
+  void SetAdaptiveDecimation(bool isOn);
+
+  /// \brief Turns on, or off, decoding incoming IMAGE messages off the socket threads, for all clients,
+  /// current and future, default off. See NiftyLinkTcpNetworkWorker::SetDecodeInParallel().
+  void SetDecodeInParallel(bool isOn);
+
   /// \brief Returns the number of connected clients.
   int GetNumberOfClientsConnected();
 
@@ -135,11 +166,15 @@ private slots:
 
   void OnClientDisconnected();
   void OnMessageReceived(int portNumber);
+  void OnNewLocalConnection();
 
 private:
 
   void Initialise();
 
+  /// \brief Creates a worker for a newly connected client, and starts it in its own NiftyLinkQThread.
+  void StartWorker(NiftyLinkTransport *transport);
+
   QSet<NiftyLinkTcpNetworkWorker*> m_Workers;
   QMutex                           m_Mutex;
   NiftyLinkMessageManager          m_InboundMessages;
@@ -147,6 +182,10 @@ private:
   NiftyLinkMessageCounter          m_ReceivedCounter;
   bool                             m_SendKeepAlive;
   bool                             m_CheckNoIncoming;
+  NiftyLinkMessageRecorder        *m_Recorder;
+  bool                             m_AdaptiveDecimation;
+  bool                             m_DecodeInParallel;
+  QLocalServer                    *m_LocalServer;
 };
 
 } // end namespace niftk
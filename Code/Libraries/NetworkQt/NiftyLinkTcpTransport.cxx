@@ -0,0 +1,134 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkTcpTransport.h"
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+NiftyLinkTcpTransport::NiftyLinkTcpTransport(QTcpSocket *socket, QObject *parent)
+: NiftyLinkTransport(parent)
+, m_Socket(socket)
+{
+  if (m_Socket == NULL)
+  {
+    m_Socket = new QTcpSocket();
+  }
+  m_Socket->setParent(this);
+
+  if (m_Socket->state() == QAbstractSocket::ConnectedState)
+  {
+    m_Socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  }
+
+  connect(m_Socket, SIGNAL(connected()), this, SLOT(OnConnected()));
+  connect(m_Socket, SIGNAL(disconnected()), this, SIGNAL(Disconnected()));
+  connect(m_Socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SIGNAL(Error(QAbstractSocket::SocketError)));
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTcpTransport::~NiftyLinkTcpTransport()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+QIODevice* NiftyLinkTcpTransport::GetDevice() const
+{
+  return m_Socket;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTcpTransport::IsLocal() const
+{
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpTransport::ConnectToPeer(const QString& address, quint16 port)
+{
+  // There are no errors reported from this. Listen to the Error signal.
+  m_Socket->connectToHost(address, port);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpTransport::DisconnectFromPeer()
+{
+  m_Socket->disconnectFromHost();
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkTcpTransport::GetPeerName() const
+{
+  return m_Socket->peerName();
+}
+
+
+//-----------------------------------------------------------------------------
+int NiftyLinkTcpTransport::GetPeerPort() const
+{
+  return m_Socket->peerPort();
+}
+
+
+//-----------------------------------------------------------------------------
+qint64 NiftyLinkTcpTransport::GetSocketDescriptor() const
+{
+  return static_cast<qint64>(m_Socket->socketDescriptor());
+}
+
+
+//-----------------------------------------------------------------------------
+QAbstractSocket::SocketError NiftyLinkTcpTransport::GetError() const
+{
+  return m_Socket->error();
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkTcpTransport::GetRoundTripTimeInNanoseconds() const
+{
+  quint64 roundTripTime = 0;
+
+#if defined(__linux__)
+  // The kernel's smoothed estimate, in microseconds, so this costs nothing on the network.
+  struct tcp_info info;
+  socklen_t length = sizeof(info);
+  if (getsockopt(static_cast<int>(m_Socket->socketDescriptor()), IPPROTO_TCP, TCP_INFO, &info, &length) == 0)
+  {
+    roundTripTime = static_cast<quint64>(info.tcpi_rtt) * 1000;
+  }
+#endif
+
+  return roundTripTime;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTcpTransport::OnConnected()
+{
+  m_Socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  emit Connected();
+}
+
+} // end namespace niftk
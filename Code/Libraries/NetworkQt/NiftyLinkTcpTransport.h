@@ -0,0 +1,79 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkTcpTransport_h
+#define NiftyLinkTcpTransport_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkTransport.h>
+
+#include <QTcpSocket>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkTcpTransport
+* \brief NiftyLinkTransport over a QTcpSocket, with Nagle's algorithm turned off once connected.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkTcpTransport : public NiftyLinkTransport
+{
+  Q_OBJECT
+
+public:
+
+  /// \brief Constructor, which takes ownership of socket, (eg. one accepted by a server), or creates a new one if socket is NULL.
+  NiftyLinkTcpTransport(QTcpSocket *socket = NULL, QObject *parent = 0);
+
+  /// \brief Destructor.
+  virtual ~NiftyLinkTcpTransport();
+
+  /// \see NiftyLinkTransport::GetDevice()
+  virtual QIODevice* GetDevice() const;
+
+  /// \see NiftyLinkTransport::IsLocal()
+  virtual bool IsLocal() const;
+
+  /// \see NiftyLinkTransport::ConnectToPeer()
+  virtual void ConnectToPeer(const QString& address, quint16 port);
+
+  /// \see NiftyLinkTransport::DisconnectFromPeer()
+  virtual void DisconnectFromPeer();
+
+  /// \see NiftyLinkTransport::GetPeerName()
+  virtual QString GetPeerName() const;
+
+  /// \see NiftyLinkTransport::GetPeerPort()
+  virtual int GetPeerPort() const;
+
+  /// \see NiftyLinkTransport::GetSocketDescriptor()
+  virtual qint64 GetSocketDescriptor() const;
+
+  /// \see NiftyLinkTransport::GetError()
+  virtual QAbstractSocket::SocketError GetError() const;
+
+  /// \brief Returns the kernel's smoothed round trip time, on Linux, or 0 elsewhere.
+  virtual quint64 GetRoundTripTimeInNanoseconds() const;
+
+private slots:
+
+  /// \brief Turns on QAbstractSocket::LowDelayOption, and emits Connected().
+  void OnConnected();
+
+private:
+
+  QTcpSocket *m_Socket;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkTcpTransport_h
@@ -0,0 +1,77 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkTransport.h"
+#include "NiftyLinkLocalTransport.h"
+#include "NiftyLinkTcpTransport.h"
+
+namespace niftk
+{
+
+// Prefix of addresses that select NiftyLinkLocalTransport.
+static const char* NIFTYLINK_LOCAL_SCHEME = "unix:";
+
+//-----------------------------------------------------------------------------
+NiftyLinkTransport* NiftyLinkTransport::New(const QString& address, QObject *parent)
+{
+  if (IsLocalAddress(address))
+  {
+    return new NiftyLinkLocalTransport(NULL, parent);
+  }
+  return new NiftyLinkTcpTransport(NULL, parent);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkTransport::IsLocalAddress(const QString& address)
+{
+  return address.startsWith(QLatin1String(NIFTYLINK_LOCAL_SCHEME));
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkTransport::GetLocalPath(const QString& address)
+{
+  if (!IsLocalAddress(address))
+  {
+    return address;
+  }
+  return address.mid(QString(QLatin1String(NIFTYLINK_LOCAL_SCHEME)).size());
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTransport::NiftyLinkTransport(QObject *parent)
+: QObject(parent)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkTransport::~NiftyLinkTransport()
+{
+}
+
+
+//-----------------------------------------------------------------------------
+QString NiftyLinkTransport::GetErrorString() const
+{
+  return this->GetDevice()->errorString();
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkTransport::GetRoundTripTimeInNanoseconds() const
+{
+  return 0;
+}
+
+} // end namespace niftk
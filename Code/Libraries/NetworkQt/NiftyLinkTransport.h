@@ -0,0 +1,111 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkTransport_h
+#define NiftyLinkTransport_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+
+#include <QAbstractSocket>
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkTransport
+* \brief Base class for the byte stream that NiftyLinkTcpNetworkWorker reads and writes OpenIGTLink messages on,
+* so that the same framing, stats and signals work over any kind of socket.
+*
+* The transport owns its socket, as a child QObject, so moving the transport to another thread moves the socket too.
+* Reading and writing go through GetDevice(), and the socket's readyRead() and bytesWritten() signals are
+* used directly, while connection and error signals, which differ between socket classes, are passed on
+* as Connected(), Disconnected() and Error().
+*
+* An address of the form "unix:<path>", (eg. "unix:/run/niftylink/us.sock"), selects NiftyLinkLocalTransport,
+* for peers on the same host, and anything else selects NiftyLinkTcpTransport, see New().
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkTransport : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /// \brief Creates a NiftyLinkLocalTransport if IsLocalAddress(address), and a NiftyLinkTcpTransport otherwise.
+  static NiftyLinkTransport* New(const QString& address, QObject *parent = 0);
+
+  /// \brief Returns true if address starts with "unix:".
+  static bool IsLocalAddress(const QString& address);
+
+  /// \brief Returns the path of a local address, ie. without "unix:", or address itself if it is not local.
+  static QString GetLocalPath(const QString& address);
+
+  /// \brief Destructor.
+  virtual ~NiftyLinkTransport();
+
+  /// \brief Returns the socket, for reading and writing.
+  virtual QIODevice* GetDevice() const = 0;
+
+  /// \brief Returns true if this is a same-host transport.
+  virtual bool IsLocal() const = 0;
+
+  /// \brief Starts connecting, reporting the result with Connected() or Error().
+  /// The port is ignored by local transports.
+  virtual void ConnectToPeer(const QString& address, quint16 port) = 0;
+
+  /// \brief Starts disconnecting, reporting the result with Disconnected().
+  virtual void DisconnectFromPeer() = 0;
+
+  /// \brief Returns the name of the peer, which may be empty.
+  virtual QString GetPeerName() const = 0;
+
+  /// \brief Returns the port of the peer, or for local transports the socket descriptor, which identifies the connection.
+  virtual int GetPeerPort() const = 0;
+
+  /// \brief Returns the socket descriptor, or -1.
+  virtual qint64 GetSocketDescriptor() const = 0;
+
+  /// \brief Returns the last error.
+  virtual QAbstractSocket::SocketError GetError() const = 0;
+
+  /// \brief Returns a description of the last error.
+  QString GetErrorString() const;
+
+  /// \brief Returns the kernel's estimate of the round trip time, or 0 if not known.
+  virtual quint64 GetRoundTripTimeInNanoseconds() const;
+
+signals:
+
+  /// \brief Emitted when ConnectToPeer() has succeeded.
+  void Connected();
+
+  /// \brief Emitted when the socket has disconnected.
+  void Disconnected();
+
+  /// \brief Emitted when the socket reports an error.
+  void Error(QAbstractSocket::SocketError errorCode);
+
+protected:
+
+  NiftyLinkTransport(QObject *parent = 0);
+
+private:
+
+  NiftyLinkTransport(const NiftyLinkTransport&); // Purposefully not implemented.
+  void operator=(const NiftyLinkTransport&); // Purposefully not implemented.
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkTransport_h
@@ -0,0 +1,339 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkUdpClient.h"
+
+#include <igtl_header.h>
+#include <igtlMessageFactory.h>
+
+#include <QByteArray>
+#include <QHostInfo>
+#include <QsLog.h>
+#include <QtEndian>
+#include <QUdpSocket>
+
+#include <cstring>
+#include <string>
+
+namespace niftk
+{
+
+// Identifies a NiftyLinkUdpClient datagram, ie. "NLUD".
+static const quint32 NIFTYLINK_UDP_MAGIC = 0x4E4C5544;
+
+// Magic number, then sequence number.
+static const int NIFTYLINK_UDP_HEADER_SIZE = 12;
+
+// The largest UDP payload over IPv4.
+static const int NIFTYLINK_UDP_MAX_DATAGRAM_SIZE = 65507;
+
+//-----------------------------------------------------------------------------
+NiftyLinkUdpClient::NiftyLinkUdpClient(QObject *parent)
+: QObject(parent)
+, m_Socket(NULL)
+, m_DestinationPort(0)
+, m_NextSequenceNumber(1)
+, m_NumberOfMessagesReceived(0)
+, m_NumberOfMessagesLost(0)
+, m_NumberOfMessagesReordered(0)
+, m_NumberOfMessagesDuplicated(0)
+{
+  this->setObjectName("NiftyLinkUdpClient");
+
+  m_TimeArrived = igtl::TimeStamp::New();
+
+  m_Socket = new QUdpSocket(this);
+  connect(m_Socket, SIGNAL(readyRead()), this, SLOT(OnReadyRead()));
+  connect(m_Socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnError(QAbstractSocket::SocketError)));
+}
+
+
+//-----------------------------------------------------------------------------
+NiftyLinkUdpClient::~NiftyLinkUdpClient()
+{
+  QLOG_INFO() << QObject::tr("%1::~NiftyLinkUdpClient() - received=%2, lost=%3, reordered=%4, duplicated=%5.")
+                 .arg(objectName()).arg(m_NumberOfMessagesReceived).arg(m_NumberOfMessagesLost)
+                 .arg(m_NumberOfMessagesReordered).arg(m_NumberOfMessagesDuplicated);
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkUdpClient::IsSupportedMessage(const igtl::MessageBase::Pointer& message)
+{
+  if (message.IsNull())
+  {
+    return false;
+  }
+
+  const std::string type = message->GetDeviceType();
+  return type == "TDATA" || type == "TRANSFORM" || type == "POSITION";
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkUdpClient::Bind(quint16 portNumber)
+{
+  if (!m_Socket->bind(portNumber))
+  {
+    QLOG_ERROR() << QObject::tr("%1::Bind() - failed to bind port %2.").arg(objectName()).arg(portNumber);
+    return false;
+  }
+
+  QLOG_INFO() << QObject::tr("%1::Bind() - receiving on port %2.").arg(objectName()).arg(m_Socket->localPort());
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+quint16 NiftyLinkUdpClient::GetLocalPort() const
+{
+  return m_Socket->localPort();
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkUdpClient::SetDestination(const QString& hostName, quint16 portNumber)
+{
+  QHostAddress address;
+  if (!address.setAddress(hostName))
+  {
+    QHostInfo info = QHostInfo::fromName(hostName);
+    if (info.addresses().isEmpty())
+    {
+      QString errorString = QObject::tr("%1::SetDestination() - failed to find host %2.").arg(objectName()).arg(hostName);
+      QLOG_ERROR() << errorString;
+      emit ClientError(hostName, portNumber, errorString);
+      return false;
+    }
+    address = info.addresses().first();
+  }
+
+  m_DestinationName = hostName;
+  m_DestinationAddress = address;
+  m_DestinationPort = portNumber;
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkUdpClient::Send(NiftyLinkMessageContainer::Pointer message)
+{
+  if (m_DestinationAddress.isNull())
+  {
+    QString errorString = QObject::tr("%1::Send() - no destination, see SetDestination().").arg(objectName());
+    QLOG_ERROR() << errorString;
+    emit ClientError(m_DestinationName, m_DestinationPort, errorString);
+    return false;
+  }
+
+  igtl::MessageBase::Pointer msg = message->GetMessage();
+  if (!IsSupportedMessage(msg))
+  {
+    QString errorString = QObject::tr("%1::Send() - only TDATA, TRANSFORM and POSITION can be sent.").arg(objectName());
+    QLOG_ERROR() << errorString;
+    emit ClientError(m_DestinationName, m_DestinationPort, errorString);
+    return false;
+  }
+
+  const int size = NIFTYLINK_UDP_HEADER_SIZE + static_cast<int>(msg->GetPackSize());
+  if (size > NIFTYLINK_UDP_MAX_DATAGRAM_SIZE)
+  {
+    QString errorString = QObject::tr("%1::Send() - message of %2 bytes is too big for a datagram.")
+        .arg(objectName()).arg(msg->GetPackSize());
+    QLOG_ERROR() << errorString;
+    emit ClientError(m_DestinationName, m_DestinationPort, errorString);
+    return false;
+  }
+
+  QByteArray datagram;
+  datagram.resize(size);
+  qToBigEndian<quint32>(NIFTYLINK_UDP_MAGIC, reinterpret_cast<uchar*>(datagram.data()));
+  qToBigEndian<quint64>(m_NextSequenceNumber, reinterpret_cast<uchar*>(datagram.data() + 4));
+  memcpy(datagram.data() + NIFTYLINK_UDP_HEADER_SIZE, msg->GetPackPointer(), msg->GetPackSize());
+
+  qint64 bytesWritten = m_Socket->writeDatagram(datagram, m_DestinationAddress, m_DestinationPort);
+  if (bytesWritten != size)
+  {
+    QLOG_ERROR() << QObject::tr("%1::Send() - only written %2 bytes instead of %3.").arg(objectName()).arg(bytesWritten).arg(size);
+    return false;
+  }
+
+  m_NextSequenceNumber++;
+  emit BytesSent(bytesWritten);
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkUdpClient::GetNumberOfMessagesReceived() const
+{
+  return m_NumberOfMessagesReceived;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkUdpClient::GetNumberOfMessagesLost() const
+{
+  return m_NumberOfMessagesLost;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkUdpClient::GetNumberOfMessagesReordered() const
+{
+  return m_NumberOfMessagesReordered;
+}
+
+
+//-----------------------------------------------------------------------------
+quint64 NiftyLinkUdpClient::GetNumberOfMessagesDuplicated() const
+{
+  return m_NumberOfMessagesDuplicated;
+}
+
+
+//-----------------------------------------------------------------------------
+bool NiftyLinkUdpClient::IsInSequence(const QString& sender, const quint64& sequenceNumber)
+{
+  QMap<QString, quint64>::iterator iter = m_LastSequenceNumbers.find(sender);
+  if (iter == m_LastSequenceNumbers.end() || sequenceNumber == 1)
+  {
+    m_LastSequenceNumbers.insert(sender, sequenceNumber);
+    return true;
+  }
+
+  const quint64 lastSequenceNumber = iter.value();
+  if (sequenceNumber == lastSequenceNumber)
+  {
+    m_NumberOfMessagesDuplicated++;
+    return false;
+  }
+  if (sequenceNumber < lastSequenceNumber)
+  {
+    m_NumberOfMessagesReordered++;
+    return false;
+  }
+
+  m_NumberOfMessagesLost += sequenceNumber - lastSequenceNumber - 1;
+  iter.value() = sequenceNumber;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+igtl::MessageBase::Pointer NiftyLinkUdpClient::UnpackMessage(const char* data, const int& size) const
+{
+  if (size < IGTL_HEADER_SIZE)
+  {
+    return igtl::MessageBase::Pointer();
+  }
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), data, IGTL_HEADER_SIZE);
+  header->Unpack();
+
+  igtl::MessageBase::Pointer message;
+  try
+  {
+    igtl::MessageFactory::Pointer messageFactory = igtl::MessageFactory::New();
+    message = messageFactory->GetMessage(header);
+  }
+  catch (const std::exception& e)
+  {
+    QLOG_ERROR() << QObject::tr("%1::UnpackMessage() - Failed to create message type %2. Error was %3.")
+                    .arg(objectName()).arg(QString::fromStdString(header->GetDeviceType())).arg(QString::fromStdString(e.what()));
+    return igtl::MessageBase::Pointer();
+  }
+
+  if (message.IsNull() || static_cast<int>(message->GetPackSize()) != size)
+  {
+    return igtl::MessageBase::Pointer();
+  }
+
+  memcpy(message->GetPackBodyPointer(), data + IGTL_HEADER_SIZE, size - IGTL_HEADER_SIZE);
+  message->Unpack();
+
+  return message;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClient::OnReadyRead()
+{
+  QByteArray datagram;
+  QHostAddress senderAddress;
+  quint16 senderPort = 0;
+
+  while (m_Socket->hasPendingDatagrams())
+  {
+    const qint64 pendingSize = m_Socket->pendingDatagramSize();
+    if (pendingSize < 0)
+    {
+      break;
+    }
+
+    datagram.resize(static_cast<int>(pendingSize));
+    const qint64 size = m_Socket->readDatagram(datagram.data(), datagram.size(), &senderAddress, &senderPort);
+    m_TimeArrived->GetTime();
+
+    if (size < NIFTYLINK_UDP_HEADER_SIZE
+        || qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(datagram.constData())) != NIFTYLINK_UDP_MAGIC)
+    {
+      QLOG_WARN() << QObject::tr("%1::OnReadyRead() - ignoring a datagram of %2 bytes, from %3:%4, that is not from NiftyLinkUdpClient.")
+                     .arg(objectName()).arg(size).arg(senderAddress.toString()).arg(senderPort);
+      continue;
+    }
+
+    const quint64 sequenceNumber = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(datagram.constData() + 4));
+    const QString sender = QObject::tr("%1:%2").arg(senderAddress.toString()).arg(senderPort);
+
+    // Checked before unpacking, so stale messages cost as little as possible.
+    if (!this->IsInSequence(sender, sequenceNumber))
+    {
+      QLOG_DEBUG() << QObject::tr("%1::OnReadyRead() - dropped message %2 from %3, as it is out of sequence.")
+                      .arg(objectName()).arg(sequenceNumber).arg(sender);
+      continue;
+    }
+
+    igtl::MessageBase::Pointer message = this->UnpackMessage(datagram.constData() + NIFTYLINK_UDP_HEADER_SIZE,
+                                                             static_cast<int>(size) - NIFTYLINK_UDP_HEADER_SIZE);
+    if (message.IsNull())
+    {
+      QLOG_WARN() << QObject::tr("%1::OnReadyRead() - ignoring message %2 from %3, as it is not a valid OpenIGTLink message.")
+                     .arg(objectName()).arg(sequenceNumber).arg(sender);
+      continue;
+    }
+
+    NiftyLinkMessageContainer::Pointer msg = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+    msg->SetTimeArrived(m_TimeArrived);
+    msg->SetTimeReceived(m_TimeArrived);
+    msg->SetSenderHostName(senderAddress.toString());
+    msg->SetSenderPortNumber(senderPort);
+    msg->SetMessage(message);
+
+    m_NumberOfMessagesReceived++;
+    emit MessageReceived(msg);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClient::OnError(QAbstractSocket::SocketError error)
+{
+  QString errorString = m_Socket->errorString();
+  QLOG_ERROR() << QObject::tr("%1::OnError(code=%2, string=%3).").arg(objectName()).arg(error).arg(errorString);
+  emit SocketError(m_DestinationName, m_DestinationPort, error, errorString);
+}
+
+} // end namespace niftk
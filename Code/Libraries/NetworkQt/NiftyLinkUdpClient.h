@@ -0,0 +1,141 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkUdpClient_h
+#define NiftyLinkUdpClient_h
+
+#include <NiftyLinkCommonWin32ExportHeader.h>
+#include <NiftyLinkMessageContainer.h>
+
+#include <igtlMessageBase.h>
+#include <igtlTimeStamp.h>
+
+#include <QAbstractSocket>
+#include <QHostAddress>
+#include <QMap>
+#include <QObject>
+
+class QUdpSocket;
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkUdpClient
+* \brief Sends and receives small, time critical, OpenIGTLink messages, (TDATA, TRANSFORM and POSITION),
+* one per UDP datagram, for tracking data, where a late pose is no use, so TCP retransmission just adds latency.
+*
+* Each datagram is a 4 byte magic number, ("NLUD"), an 8 byte sequence number, in network byte order,
+* counting up from 1 for each NiftyLinkUdpClient that sends, and then the Packed OpenIGTLink message.
+*
+* On receipt, the sequence number is compared with the last one accepted from the same sender address and port.
+* Duplicates, and datagrams older than the last one accepted, are dropped, so messages are always delivered in
+* order, and gaps are counted as lost. A sequence number of 1 means the sender restarted, so is always accepted.
+*
+* Unlike NiftyLinkTcpClient, this does not run in its own thread, as reading a datagram is cheap.
+* So, it must only be used from the thread that owns it, and MessageReceived() is emitted from that thread.
+*/
+class NIFTYLINKCOMMON_WINEXPORT NiftyLinkUdpClient : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /// \brief Constructor.
+  NiftyLinkUdpClient(QObject *parent = 0);
+
+  /// \brief Destructor.
+  virtual ~NiftyLinkUdpClient();
+
+  /// \brief Returns true for the message types this class sends, ie. TDATA, TRANSFORM and POSITION.
+  static bool IsSupportedMessage(const igtl::MessageBase::Pointer& message);
+
+  /// \brief Starts receiving datagrams sent to portNumber, on any interface. A portNumber of 0 picks a free port.
+  /// \return false if the port could not be bound, which is logged.
+  bool Bind(quint16 portNumber);
+
+  /// \brief Returns the port bound by Bind(), or 0 if not bound.
+  quint16 GetLocalPort() const;
+
+  /// \brief Sets the host and port that Send() sends to, looking up hostName if it isn't an IP address.
+  /// \return false if hostName could not be found, which is also reported via ClientError().
+  bool SetDestination(const QString& hostName, quint16 portNumber);
+
+  /// \brief Sends an OpenIGTLink message, which should be Packed, as a single datagram.
+  /// There is no acknowledgement, so a message may be lost, without any error.
+  /// \return false if there is no destination, the message isn't supported, (see IsSupportedMessage()),
+  /// or is too big for a datagram, or the datagram could not be written, true otherwise.
+  bool Send(NiftyLinkMessageContainer::Pointer message);
+
+  /// \brief Returns the number of messages delivered via MessageReceived().
+  quint64 GetNumberOfMessagesReceived() const;
+
+  /// \brief Returns the number of messages missing from gaps in the sequence numbers.
+  /// A message that arrives after a later one was delivered has been counted here, as it is dropped.
+  quint64 GetNumberOfMessagesLost() const;
+
+  /// \brief Returns the number of messages dropped, as a later one had already been delivered.
+  quint64 GetNumberOfMessagesReordered() const;
+
+  /// \brief Returns the number of messages dropped, as the same one had already been delivered.
+  quint64 GetNumberOfMessagesDuplicated() const;
+
+signals:
+
+  /// \brief Emitted when the underlying socket reports an error.
+  void SocketError(QString hostName, int portNumber, QAbstractSocket::SocketError errorCode, QString errorString);
+
+  /// \brief Emitted by this class when an error has occured (eg. usage error).
+  void ClientError(QString hostName, int portNumber, QString errorString);
+
+  /// \brief Emitted when this client receives an OpenIGTLink message, messages come out UnPacked.
+  void MessageReceived(NiftyLinkMessageContainer::Pointer message);
+
+  /// \brief Emitted when a datagram has been written.
+  void BytesSent(qint64 bytes);
+
+private slots:
+
+  /// \brief Reads all pending datagrams, delivering those that are in sequence.
+  void OnReadyRead();
+
+  /// \brief Passes socket errors on as SocketError().
+  void OnError(QAbstractSocket::SocketError error);
+
+private:
+
+  NiftyLinkUdpClient(const NiftyLinkUdpClient&); // Purposefully not implemented.
+  NiftyLinkUdpClient& operator=(const NiftyLinkUdpClient&); // Purposefully not implemented.
+
+  /// \brief Returns true if sequenceNumber is the newest from sender, updating the counters either way.
+  bool IsInSequence(const QString& sender, const quint64& sequenceNumber);
+
+  /// \brief Returns the message packed in data, Unpacked, or NULL if data is not a valid OpenIGTLink message.
+  igtl::MessageBase::Pointer UnpackMessage(const char* data, const int& size) const;
+
+  QUdpSocket               *m_Socket;
+  QString                   m_DestinationName;
+  QHostAddress              m_DestinationAddress;
+  quint16                   m_DestinationPort;
+  quint64                   m_NextSequenceNumber;
+
+  QMap<QString, quint64>    m_LastSequenceNumbers;
+  quint64                   m_NumberOfMessagesReceived;
+  quint64                   m_NumberOfMessagesLost;
+  quint64                   m_NumberOfMessagesReordered;
+  quint64                   m_NumberOfMessagesDuplicated;
+  igtl::TimeStamp::Pointer  m_TimeArrived;
+
+}; // end class
+
+} // end namespace niftk
+
+#endif // NiftyLinkUdpClient_h
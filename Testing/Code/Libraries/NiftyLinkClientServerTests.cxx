@@ -12,6 +12,7 @@
 #include "NiftyLinkClientServerTests.h"
 #include <NiftyLinkTcpClient.h>
 #include <NiftyLinkTcpServer.h>
+#include <NiftyLinkMessageSynchroniser.h>
 #include <NiftyLinkUtils.h>
 #include <NiftyLinkImageMessageHelpers.h>
 #include <NiftyLinkTrackingDataMessageHelpers.h>
@@ -20,6 +21,7 @@
 #include <igtlTrackingDataMessage.h>
 #include <igtlTransformMessage.h>
 #include <igtlImageMessage.h>
+#include <igtlStringMessage.h>
 
 #include <cassert>
 
@@ -89,6 +91,8 @@ void NiftyLinkClientServerTests::OnReceiveMessage(int /*portNumber*/, niftk::Nif
 
   assert(message.data() != NULL);
 
+  m_ReceivedTypes.append(QString::fromStdString(message->GetMessage()->GetDeviceType()));
+
   if (dynamic_cast<igtl::ImageMessage*>(message.data()->GetMessage().GetPointer()) != NULL)
   {
     QLOG_INFO() << "Received IMAGE";
@@ -206,6 +210,176 @@ void NiftyLinkClientServerTests::TestSendReceiveIMAGE()
 }
 
 
+
+//-----------------------------------------------------------------------------
+void NiftyLinkClientServerTests::TestSendReceiveInOrderWithParallelDecode()
+{
+  m_Server->SetDecodeInParallel(true);
+  m_ReceivedTypes.clear();
+
+  QImage i1(":/NiftyLink/UCL_LOGO.tif");
+  i1 = i1.convertToFormat(QImage::Format_ARGB32);
+
+  QStringList sentTypes;
+  for (int i = 0; i < 10; i++)
+  {
+    m_Client->Send(CreateImageMessage("TestingDevice", "TestingHost", 1234, i1));
+    m_Client->Send(CreateTrackingDataMessageWithRandomData());
+    m_Client->Send(CreateImageMessage("TestingDevice", "TestingHost", 1234, i1));
+    m_Client->Send(CreateTransformMessageWithRandomData());
+    sentTypes << "IMAGE" << "TDATA" << "IMAGE" << "TRANSFORM";
+  }
+
+  QTest::qWait(2000);
+
+  m_Server->SetDecodeInParallel(false);
+
+  QVERIFY(m_ReceivedTypes == sentTypes);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkClientServerTests::OnMessagesSynchronised(QList<niftk::NiftyLinkMessageContainer::Pointer> messages)
+{
+  m_SynchronisedMessages.append(messages);
+}
+
+
+//-----------------------------------------------------------------------------
+static igtl::TimeStamp::Pointer NiftyLinkSynchroniserTestTime(const int& milliseconds)
+{
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  timeStamp->SetTimeInNanoseconds(static_cast<igtlUint64>(1000000000000ULL) + static_cast<igtlUint64>(milliseconds) * 1000000);
+  return timeStamp;
+}
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkMessageContainer::Pointer NiftyLinkSynchroniserTestContainer(igtl::MessageBase* msg,
+                                                                            const igtl::TimeStamp::Pointer& timeStamp)
+{
+  msg->SetTimeStamp(timeStamp);
+  msg->Pack();
+
+  NiftyLinkMessageContainer::Pointer m(new NiftyLinkMessageContainer());
+  m->SetMessage(msg);
+  m->SetTimeArrived(timeStamp);
+  m->SetTimeReceived(timeStamp);
+  return m;
+}
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkMessageContainer::Pointer NiftyLinkSynchroniserTestImage(const int& milliseconds)
+{
+  igtl::StringMessage::Pointer msg = igtl::StringMessage::New();
+  msg->SetDeviceName("US");
+  msg->SetString("Image");
+  return NiftyLinkSynchroniserTestContainer(msg.GetPointer(), NiftyLinkSynchroniserTestTime(milliseconds));
+}
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkMessageContainer::Pointer NiftyLinkSynchroniserTestTracker(const int& milliseconds)
+{
+  // Probe moves +1 per millisecond along x, and Reference -1.
+  igtl::TrackingDataMessage::Pointer msg = igtl::TrackingDataMessage::New();
+  msg->SetDeviceName("Tracker");
+
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+
+  matrix[0][3] = milliseconds;
+  igtl::TrackingDataElement::Pointer probe = igtl::TrackingDataElement::New();
+  probe->SetName("Probe");
+  probe->SetMatrix(matrix);
+  msg->AddTrackingDataElement(probe);
+
+  matrix[0][3] = -milliseconds;
+  igtl::TrackingDataElement::Pointer reference = igtl::TrackingDataElement::New();
+  reference->SetName("Reference");
+  reference->SetMatrix(matrix);
+  msg->AddTrackingDataElement(reference);
+
+  return NiftyLinkSynchroniserTestContainer(msg.GetPointer(), NiftyLinkSynchroniserTestTime(milliseconds));
+}
+
+
+//-----------------------------------------------------------------------------
+static float NiftyLinkSynchroniserTestX(const NiftyLinkMessageContainer::Pointer& message)
+{
+  igtl::Matrix4x4 matrix;
+
+  igtl::TransformMessage::Pointer transform = dynamic_cast<igtl::TransformMessage*>(message->GetMessage().GetPointer());
+  if (transform.IsNotNull())
+  {
+    transform->GetMatrix(matrix);
+    return matrix[0][3];
+  }
+
+  igtl::TrackingDataMessage::Pointer trackingData = dynamic_cast<igtl::TrackingDataMessage*>(message->GetMessage().GetPointer());
+  igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+  trackingData->GetTrackingDataElement(0, element);
+  element->GetMatrix(matrix);
+  return matrix[0][3];
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkClientServerTests::TestSynchroniser()
+{
+  NiftyLinkMessageSynchroniser synchroniser;
+  synchroniser.AddStream("US");
+  synchroniser.AddStream("Probe");
+  synchroniser.AddStream("Reference");
+  synchroniser.SetTolerance(5000000);
+
+  connect(&synchroniser, SIGNAL(MessagesSynchronised(QList<niftk::NiftyLinkMessageContainer::Pointer>)),
+          this, SLOT(OnMessagesSynchronised(QList<niftk::NiftyLinkMessageContainer::Pointer>)));
+
+  m_SynchronisedMessages.clear();
+
+  for (int i = 0; i < 4; i++)
+  {
+    synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestTracker(i * 10));
+  }
+  QVERIFY(m_SynchronisedMessages.size() == 0);
+
+  // Nearest.
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestImage(12));
+  QVERIFY(m_SynchronisedMessages.size() == 1);
+  QVERIFY(m_SynchronisedMessages[0].size() == 3);
+  QVERIFY(NiftyLinkSynchroniserTestX(m_SynchronisedMessages[0][1]) == 10);
+  QVERIFY(NiftyLinkSynchroniserTestX(m_SynchronisedMessages[0][2]) == -10);
+
+  // Interpolated.
+  synchroniser.SetPolicy(NiftyLinkMessageSynchroniser::INTERPOLATED);
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestImage(25));
+  QVERIFY(m_SynchronisedMessages.size() == 2);
+  QVERIFY(IsCloseEnoughTo(NiftyLinkSynchroniserTestX(m_SynchronisedMessages[1][1]), 25, 0.001));
+  QVERIFY(IsCloseEnoughTo(NiftyLinkSynchroniserTestX(m_SynchronisedMessages[1][2]), -25, 0.001));
+
+  // Waits for a newer pose, which is then too far away.
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestImage(100));
+  QVERIFY(m_SynchronisedMessages.size() == 2);
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestTracker(140));
+  QVERIFY(m_SynchronisedMessages.size() == 2);
+
+  // Latest complete.
+  synchroniser.Clear();
+  synchroniser.SetPolicy(NiftyLinkMessageSynchroniser::LATEST_COMPLETE);
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestTracker(200));
+  QVERIFY(m_SynchronisedMessages.size() == 2);
+  synchroniser.OnMessageReceived(NiftyLinkSynchroniserTestImage(205));
+  QVERIFY(m_SynchronisedMessages.size() == 3);
+  QVERIFY(NiftyLinkSynchroniserTestX(m_SynchronisedMessages[2][1]) == 200);
+
+  QVERIFY(synchroniser.GetNumberOfMessagesReceived() == 16);
+  QVERIFY(synchroniser.GetNumberOfMessagesUnmatched() == 7);
+  QVERIFY(synchroniser.GetNumberOfGroupsEmitted() == 3);
+  QVERIFY(synchroniser.GetPairingLatency().GetCount() == 3);
+}
+
 } // end namespace
 
 NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkClientServerTests )
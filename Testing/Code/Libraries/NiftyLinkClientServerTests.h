@@ -15,6 +15,9 @@
 #include <NiftyLinkTestingMacros.h>
 #include <NiftyLinkMessageContainer.h>
 
+#include <QList>
+#include <QStringList>
+
 namespace niftk
 {
 
@@ -88,9 +91,35 @@ private slots:
    */
   void TestSendReceiveIMAGE();
 
+  /**
+   * \brief Send a mix of IMAGE, TDATA and TRANSFORM, with the server decoding in parallel.
+   *
+   * Spec:
+   *   - Turn on NiftyLinkTcpServer::SetDecodeInParallel()
+   *   - Send IMAGE, TDATA, IMAGE, TRANSFORM, repeatedly
+   *   - Wait 2sec
+   *   - Check all messages were received, in the order they were sent.
+   */
+  void TestSendReceiveInOrderWithParallelDecode();
+
+  /**
+   * \brief Feed NiftyLinkMessageSynchroniser with a reference stream, and a tracker with two tools.
+   *
+   * Spec:
+   *   - NEAREST: a reference message is matched with the nearest pose of each tool, once a newer pose has arrived
+   *   - INTERPOLATED: the poses are interpolated to the time of the reference message
+   *   - A reference message with no pose within the tolerance is unmatched
+   *   - LATEST_COMPLETE: a group is emitted as soon as every stream has a new message
+   *   - Check the number of messages received, unmatched, and groups emitted
+   */
+  void TestSynchroniser();
+
   /// \brief To parse/receive incoming messages.
   void OnReceiveMessage(int, niftk::NiftyLinkMessageContainer::Pointer);
 
+  /// \brief To receive synchronised messages.
+  void OnMessagesSynchronised(QList<niftk::NiftyLinkMessageContainer::Pointer>);
+
 private:
 
   NiftyLinkTcpServer *m_Server;
@@ -100,6 +129,8 @@ private:
   NiftyLinkMessageContainer::Pointer m_TransformMessage;
   NiftyLinkMessageContainer::Pointer m_TdataMessage;
   NiftyLinkMessageContainer::Pointer m_ImageMessage;
+  QStringList                        m_ReceivedTypes;
+  QList< QList<NiftyLinkMessageContainer::Pointer> > m_SynchronisedMessages;
 
 };
 
@@ -13,10 +13,17 @@
 #include "NiftyLinkImageMessageHelpersTests.h"
 #include <NiftyLinkUtils.h>
 #include <NiftyLinkImageMessageHelpers.h>
+#include <NiftyLinkImageDeltaEncoder.h>
+#include <NiftyLinkImageDeltaDecoder.h>
+#include <NiftyLinkImageCompression.h>
+#include <NiftyLinkImageDecimator.h>
+#include <NiftyLinkRecordingReader.h>
 #include <igtl_image.h>
 #include <igtlMath.h>
 #include <math.h>
 #include <exception>
+#include <stdexcept>
+#include <cstring>
 
 namespace niftk
 {
@@ -114,6 +121,304 @@ void NiftyLinkImageMessageHelpersTests::ReadWriteImageTest()
   QVERIFY(i1 == i2);
 }
 
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::GetQImageViewTest()
+{
+  QImage i1(":/NiftyLink/UCL_LOGO.tif");
+  i1 = i1.convertToFormat(QImage::Format_ARGB32);
+
+  igtl::ImageMessage::Pointer msg = igtl::ImageMessage::New();
+  niftk::SetQImage(i1, msg);
+
+  const bool isAligned = reinterpret_cast<quintptr>(msg->GetScalarPointer()) % 4 == 0;
+
+  QImage view;
+  QVERIFY(niftk::GetQImageView(msg, view) == isAligned);
+  QVERIFY((view.constBits() == static_cast<const uchar*>(msg->GetScalarPointer())) == isAligned);
+  QVERIFY(i1 == view);
+
+  igtl::ImageMessage::Pointer msg2 = igtl::ImageMessage::New();
+  QImage view2;
+  const bool isView = niftk::AllocateQImage(64, 32, QImage::Format_ARGB32, msg2, view2);
+  view2.fill(qRgba(1, 2, 3, 4));
+  if (!isView)
+  {
+    niftk::SetQImage(view2, msg2);
+  }
+  QVERIFY(*static_cast<const QRgb*>(msg2->GetScalarPointer()) == qRgba(1, 2, 3, 4));
+  QVERIFY(msg2->GetScalarSize() * 64 * 32 == msg2->GetImageSize());
+
+  QImage i3(101, 7, QImage::Format_RGB888);
+  i3.fill(QColor(10, 20, 30));
+  i3.setPixel(100, 6, qRgb(40, 50, 60));
+
+  QImage i4;
+  igtl::ImageMessage::Pointer msg3 = igtl::ImageMessage::New();
+  niftk::SetQImage(i3, msg3);
+  niftk::GetQImage(msg3, i4);
+  QVERIFY(i3.convertToFormat(QImage::Format_ARGB32) == i4);
+
+  // Lines of 101 RGB888 pixels are not a multiple of 4 bytes, so the view must be a copy.
+  QImage view3;
+  QVERIFY(!niftk::GetQImageView(msg3, view3));
+  QVERIFY(view3.constBits() != static_cast<const uchar*>(msg3->GetScalarPointer()));
+  QVERIFY(i4 == view3);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::DeltaEncodeDecodeTest()
+{
+  QImage i1(":/NiftyLink/UCL_LOGO.tif");
+  i1 = i1.convertToFormat(QImage::Format_ARGB32);
+
+  igtl::ImageMessage::Pointer frame = igtl::ImageMessage::New();
+  frame->SetDeviceName("Ultrasound");
+  niftk::SetQImage(i1, frame);
+  const int frameSize = frame->GetImageSize();
+
+  niftk::NiftyLinkImageDeltaEncoder encoder;
+  encoder.SetTileSize(32);
+  encoder.SetKeyFrameInterval(3);
+  niftk::NiftyLinkImageDeltaDecoder decoder;
+
+  igtl::ImageMessage::Pointer encoded = encoder.Encode(frame);
+  QVERIFY(encoded.IsNotNull());
+  QVERIFY(encoded->GetSubVolumeImageSize() == frameSize);
+  QVERIFY(decoder.Decode(encoded).IsNotNull());
+
+  QVERIFY(encoder.Encode(frame).IsNull());
+
+  // Change one pixel, which should only send one tile.
+  QImage i2(i1);
+  i2.setPixel(100, 50, qRgba(1, 2, 3, 4));
+  niftk::SetQImage(i2, frame);
+
+  encoded = encoder.Encode(frame);
+  QVERIFY(encoded.IsNotNull());
+  QVERIFY(encoded->GetSubVolumeImageSize() == 32 * 32 * 4);
+
+  // Send it through Pack/Unpack, as it would be on the network.
+  encoded->Pack();
+  igtl::MessageBase::Pointer received = niftk::NiftyLinkRecordingReader::CreateMessage(
+        static_cast<const char*>(encoded->GetPackPointer()), encoded->GetPackSize());
+  received->Unpack();
+  igtl::ImageMessage::Pointer receivedImage = dynamic_cast<igtl::ImageMessage*>(received.GetPointer());
+  QVERIFY(receivedImage.IsNotNull());
+
+  igtl::ImageMessage::Pointer decoded = decoder.Decode(receivedImage);
+  QVERIFY(decoded.IsNotNull());
+  QVERIFY(memcmp(decoded->GetScalarPointer(), frame->GetScalarPointer(), frameSize) == 0);
+
+  // Third frame since the key frame, so whole again.
+  encoded = encoder.Encode(frame);
+  QVERIFY(encoded.IsNotNull());
+  QVERIFY(encoded->GetSubVolumeImageSize() == frameSize);
+
+  QVERIFY(encoder.GetNumberOfFrames() == 4);
+  QVERIFY(encoder.GetNumberOfKeyFrames() == 2);
+  QVERIFY(encoder.GetBandwidthSaving() > 0.45);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::CompressDecompressTest()
+{
+  QImage i1(1920, 1080, QImage::Format_ARGB32);
+  i1.fill(QColor(10, 20, 30));
+  for (int y = 0; y < i1.height(); y += 7)
+  {
+    for (int x = 0; x < i1.width(); x += 5)
+    {
+      i1.setPixel(x, y, qRgba(x % 256, y % 256, (x + y) % 256, 255));
+    }
+  }
+
+  igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+  image->SetDeviceName("Endoscope");
+  niftk::SetQImage(i1, image);
+  image->Pack();
+
+  igtl::MessageBase::Pointer compressed = niftk::CompressImageMessage(image.GetPointer());
+  QVERIFY(niftk::IsCompressedImage(compressed));
+  QVERIFY(!niftk::IsUncompressedImage(compressed));
+  QVERIFY(compressed->GetPackSize() < image->GetPackSize() / 2);
+  QVERIFY(std::string(compressed->GetDeviceName()) == "Endoscope");
+
+  igtl::ImageMessage::Pointer decompressed = niftk::DecompressImageMessage(compressed);
+  QVERIFY(decompressed->GetPackSize() == image->GetPackSize());
+  QVERIFY(memcmp(decompressed->GetPackPointer(), image->GetPackPointer(), image->GetPackSize()) == 0);
+
+  decompressed->Unpack();
+  QVERIFY(std::string(decompressed->GetDeviceName()) == "Endoscope");
+
+  QImage i2;
+  niftk::GetQImage(decompressed, i2);
+  QVERIFY(i1 == i2);
+
+  // Corrupt the size of the first block.
+  static_cast<uchar*>(compressed->GetPackBodyPointer())[20] ^= 0xFF;
+  try
+  {
+    niftk::DecompressImageMessage(compressed);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (const std::invalid_argument&)
+  {
+  }
+}
+
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::DecimateImageTest()
+{
+  QImage i1(100, 80, QImage::Format_ARGB32);
+  for (int y = 0; y < i1.height(); y++)
+  {
+    for (int x = 0; x < i1.width(); x++)
+    {
+      i1.setPixel(x, y, qRgba(x, y, x + y, 255));
+    }
+  }
+
+  igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+  niftk::SetQImage(i1, image);
+
+  float spacing[3];
+  image->GetSpacing(spacing);
+
+  igtl::ImageMessage::Pointer decimated = igtl::ImageMessage::New();
+  niftk::DecimateImage(image, 2, QRect(), decimated);
+
+  int dimensions[3];
+  decimated->GetDimensions(dimensions);
+  QVERIFY(dimensions[0] == 50);
+  QVERIFY(dimensions[1] == 40);
+  QVERIFY(dimensions[2] == 1);
+
+  float decimatedSpacing[3];
+  decimated->GetSpacing(decimatedSpacing);
+  QVERIFY(decimatedSpacing[0] == spacing[0] * 2);
+  QVERIFY(decimatedSpacing[1] == spacing[1] * 2);
+  QVERIFY(decimatedSpacing[2] == spacing[2]);
+
+  QImage i2;
+  niftk::GetQImage(decimated, i2);
+  QVERIFY(i2.width() == 50);
+  QVERIFY(i2.height() == 40);
+  QVERIFY(i2.pixel(0, 0) == i1.pixel(0, 0));
+  QVERIFY(i2.pixel(7, 3) == i1.pixel(14, 6));
+  QVERIFY(i2.pixel(49, 39) == i1.pixel(98, 78));
+
+  // Region of interest, partly outside the image.
+  igtl::ImageMessage::Pointer cropped = igtl::ImageMessage::New();
+  niftk::DecimateImage(image, 1, QRect(90, 70, 20, 20), cropped);
+  cropped->GetDimensions(dimensions);
+  QVERIFY(dimensions[0] == 10);
+  QVERIFY(dimensions[1] == 10);
+
+  QImage i3;
+  niftk::GetQImage(cropped, i3);
+  QVERIFY(i3.pixel(0, 0) == i1.pixel(90, 70));
+  QVERIFY(i3.pixel(9, 9) == i1.pixel(99, 79));
+
+  try
+  {
+    niftk::DecimateImage(image, 0, QRect(), decimated);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (const std::invalid_argument&)
+  {
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::AdaptiveDecimationTest()
+{
+  const qint64 fullQueue = 8 * 1024 * 1024;
+
+  niftk::NiftyLinkImageDecimator decimator;
+  QVERIFY(!decimator.IsDecimating());
+  QVERIFY(decimator.Update(fullQueue, 0));
+  QVERIFY(decimator.GetLevel() == 0);
+  QVERIFY(decimator.GetDownsampleFactor() == 1);
+
+  decimator.SetAdaptive(true);
+  QVERIFY(decimator.IsDecimating());
+
+  int numberSent = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    if (decimator.Update(fullQueue, 0))
+    {
+      numberSent++;
+    }
+  }
+  QVERIFY(decimator.GetLevel() == 5);
+  QVERIFY(decimator.GetFrameInterval() == 8);
+  QVERIFY(decimator.GetDownsampleFactor() == 4);
+  QVERIFY(numberSent < 50);
+  QVERIFY(decimator.GetNumberOfImagesDropped() == static_cast<quint64>(100 - numberSent));
+
+  for (int i = 0; i < 200; i++)
+  {
+    decimator.Update(0, 0);
+  }
+  QVERIFY(decimator.GetLevel() == 0);
+  QVERIFY(decimator.GetDownsampleFactor() == 1);
+
+  // A requested factor is kept, whatever the level.
+  decimator.SetDownsampleFactor(3);
+  QVERIFY(decimator.GetDownsampleFactor() == 3);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkImageMessageHelpersTests::ConvertImageEndianTest()
+{
+  const int nativeEndian = niftk::GetNativeEndian();
+  const int otherEndian = nativeEndian == igtl::ImageMessage::ENDIAN_LITTLE ? igtl::ImageMessage::ENDIAN_BIG
+                                                                            : igtl::ImageMessage::ENDIAN_LITTLE;
+
+  QImage i1(8, 8, QImage::Format_ARGB32);
+  i1.fill(QColor(10, 20, 30));
+  igtl::ImageMessage::Pointer argb = igtl::ImageMessage::New();
+  niftk::SetQImage(i1, argb);
+  QVERIFY(argb->GetEndian() == nativeEndian);
+
+  igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+  image->SetDimensions(5, 3, 1);
+  image->SetScalarType(igtl::ImageMessage::TYPE_UINT16);
+  image->SetNumComponents(1);
+  image->SetEndian(nativeEndian);
+  image->AllocateScalars();
+
+  quint16 *scalars = static_cast<quint16*>(image->GetScalarPointer());
+  for (int i = 0; i < 15; i++)
+  {
+    scalars[i] = static_cast<quint16>(0x0102 * (i + 1));
+  }
+
+  niftk::ConvertImageEndian(image, nativeEndian);
+  QVERIFY(image->GetEndian() == nativeEndian);
+  QVERIFY(scalars[0] == 0x0102);
+
+  niftk::ConvertImageEndian(image, otherEndian);
+  QVERIFY(image->GetEndian() == otherEndian);
+  for (int i = 0; i < 15; i++)
+  {
+    const quint16 expected = static_cast<quint16>(0x0102 * (i + 1));
+    QVERIFY(scalars[i] == static_cast<quint16>((expected >> 8) | (expected << 8)));
+  }
+
+  niftk::ConvertImageEndian(image, nativeEndian);
+  QVERIFY(scalars[14] == static_cast<quint16>(0x0102 * 15));
+}
+
 } // end namespace
 
 NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkImageMessageHelpersTests )
@@ -78,6 +78,70 @@ private slots:
    */
   void ReadWriteImageTest();
 
+  /**
+   * \brief Tests NiftyLinkImageMessageHelpers::GetQImageView and AllocateQImage.
+   *
+   * Spec:
+   *   - Set a 4 channel image into an image message.
+   *   - The view should equal the original image, and refer to the message's scalars only if they are 32 bit aligned.
+   *   - Painting into an allocated view, (then SetQImage() if it is a copy), should change the message's scalars.
+   *   - An odd width RGB888 image, (padded lines in QImage), should survive SetQImage/GetQImage.
+   *   - Its view should be a copy, as its lines are not a multiple of 4 bytes.
+   */
+  void GetQImageViewTest();
+
+  /**
+   * \brief Tests NiftyLinkImageDeltaEncoder and NiftyLinkImageDeltaDecoder.
+   *
+   * Spec:
+   *   - First frame is sent whole.
+   *   - An unchanged frame is not sent.
+   *   - A frame with a small change sends a small sub-volume, which survives Pack/Unpack, and decodes to the full frame.
+   *   - Key frames are sent at the requested interval.
+   */
+  void DeltaEncodeDecodeTest();
+
+  /**
+   * \brief Tests NiftyLinkImageCompression, CompressImageMessage() and DecompressImageMessage().
+   *
+   * Spec:
+   *   - A 1080p image, (so more than one block), compresses to a smaller ZIMAGE message.
+   *   - Decompressing gives exactly the same pack as the original IMAGE message, which Unpacks.
+   *   - A corrupt ZIMAGE message throws.
+   */
+  void CompressDecompressTest();
+
+  /**
+   * \brief Tests DecimateImage().
+   *
+   * Spec:
+   *   - Downsampling by 2 halves the dimensions, doubles the spacing, and keeps every other pixel.
+   *   - A region of interest partly outside the image is clipped to the image.
+   *   - A factor less than 1 throws.
+   */
+  void DecimateImageTest();
+
+  /**
+   * \brief Tests NiftyLinkImageDecimator.
+   *
+   * Spec:
+   *   - With nothing requested, and adaptive off, nothing is decimated.
+   *   - With adaptive on, a full queue raises the level, so images are dropped and downsampled.
+   *   - An empty queue then lowers the level back to 0.
+   *   - An unknown (zero) round trip time is ignored.
+   */
+  void AdaptiveDecimationTest();
+
+  /**
+   * \brief Tests GetNativeEndian() and ConvertImageEndian().
+   *
+   * Spec:
+   *   - SetQImage() labels the image with the native endian.
+   *   - Converting a 16 bit image to the other endian swaps the bytes of each scalar, and sets the endian flag.
+   *   - Converting to the endian it already is changes nothing.
+   */
+  void ConvertImageEndianTest();
+
 };
 
 } // end namespace
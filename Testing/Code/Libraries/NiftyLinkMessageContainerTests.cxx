@@ -24,7 +24,7 @@ void NiftyLinkMessageContainerTests::SetGetTest()
 {
   NiftyLinkMessageContainer::Pointer m = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
   QVERIFY(m->GetOwnerName().size() == 0);
-  QVERIFY(m->GetNiftyLinkMessageId() == 0);
+  QVERIFY(m->GetNiftyLinkMessageId() != 0);
   QVERIFY(m->GetLatency() == 0);
   QVERIFY(m->GetMessage().IsNull());
   QVERIFY(m->GetSenderHostName().size() == 0);
@@ -48,6 +48,15 @@ void NiftyLinkMessageContainerTests::SetGetTest()
   QVERIFY(m->GetSenderPortNumber() == 1234);
   QVERIFY(m->GetTimeArrived() == ts->GetTimeStampInNanoseconds());
   QVERIFY(m->GetTimeReceived() == ts->GetTimeStampInNanoseconds());
+
+  NiftyLinkMessageContainer::Pointer m2 = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+  QVERIFY(m2->GetNiftyLinkMessageId() > m->GetNiftyLinkMessageId());
+  QVERIFY(m2->GetOwnerName().size() == 0);
+
+  m2->SetOwnerName("TestOwner");
+  m2->SetSenderHostName("");
+  QVERIFY(m2->GetOwnerName() == "TestOwner");
+  QVERIFY(m2->GetSenderHostName().size() == 0);
 }
 
 
@@ -67,6 +76,7 @@ void NiftyLinkMessageContainerTests::CopyAssignTest()
   NiftyLinkMessageContainer::Pointer m2 = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
   *m2 = *m;
 
+  QVERIFY(m2->GetNiftyLinkMessageId() == m->GetNiftyLinkMessageId());
   QVERIFY(m2->GetLatency() == 0);
   QVERIFY(m2->GetMessage().IsNull());
   QVERIFY(m2->GetOwnerName() == "TestOwner");
@@ -76,6 +86,7 @@ void NiftyLinkMessageContainerTests::CopyAssignTest()
   QVERIFY(m2->GetTimeReceived() == ts->GetTimeStampInNanoseconds());
 
   NiftyLinkMessageContainer::Pointer m3= (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer(*m2)));
+  QVERIFY(m3->GetNiftyLinkMessageId() == m->GetNiftyLinkMessageId());
   QVERIFY(m3->GetLatency() == 0);
   QVERIFY(m3->GetMessage().IsNull());
   QVERIFY(m3->GetOwnerName() == "TestOwner");
@@ -85,6 +96,41 @@ void NiftyLinkMessageContainerTests::CopyAssignTest()
   QVERIFY(m3->GetTimeReceived() == ts->GetTimeStampInNanoseconds());
 }
 
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageContainerTests::PoolTest()
+{
+  const int numberOfMessages = 1000;
+
+  // The first round may need to go to the heap, to fill this thread's pool.
+  QList<NiftyLinkMessageContainer::Pointer> messages;
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    messages.append(NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+  }
+  messages.clear();
+
+  const int heapAllocationsBefore = NiftyLinkMessageContainer::GetNumberOfHeapAllocations();
+
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    NiftyLinkMessageContainer::Pointer m = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+    m->SetOwnerName("TestOwner");
+    m->SetSenderHostName("TestHost");
+    messages.append(m);
+  }
+  messages.clear();
+
+  // How many are reused depends on how the freed containers were split between this thread and the
+  // shared batches, and on any other thread taking them, so just check that most were reused.
+  const int heapAllocations = NiftyLinkMessageContainer::GetNumberOfHeapAllocations() - heapAllocationsBefore;
+  QVERIFY(heapAllocations <= numberOfMessages / 10);
+
+  QLOG_INFO() << QObject::tr("PoolTest() - sizeof(NiftyLinkMessageContainer) is %1 bytes, and %2 messages needed %3 heap allocations.")
+                 .arg(sizeof(NiftyLinkMessageContainer)).arg(numberOfMessages).arg(heapAllocations);
+}
+
 } // end namespace niftk
 
 NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkMessageContainerTests )
@@ -40,6 +40,14 @@ private slots:
 
   void CopyAssignTest();
 
+  /**
+   * \brief Tests that containers are reused.
+   *
+   * Spec:
+   *   - Once a thread has created and destroyed N containers, creating another N needs at most N/10 heap allocations.
+   */
+  void PoolTest();
+
 };
 
 } // end namespace niftk
@@ -0,0 +1,245 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+
+#include "NiftyLinkMessageRecorderTests.h"
+#include <NiftyLinkMessageRecorder.h>
+#include <NiftyLinkRecordingIndex.h>
+#include <NiftyLinkRecordingReader.h>
+#include <NiftyLinkMessagePlayer.h>
+#include <NiftyLinkTrackingDataMessageHelpers.h>
+#include <NiftyLinkUtils.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorderTests::OnMessagePlayed(niftk::NiftyLinkMessageContainer::Pointer message)
+{
+  m_PlayedMessages.push_back(message);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorderTests::WriteTestRecording(const QString& fileName, const int& numberOfMessages, const quint64& intervalInNanoseconds)
+{
+  NiftyLinkMessageRecorder recorder;
+  recorder.SetChunkSize(1024); // small, so we get several chunks.
+  recorder.Start(fileName);
+  QVERIFY(recorder.IsRecording());
+
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    NiftyLinkMessageContainer::Pointer msg = CreateTrackingDataMessage(QString("Tracker%1").arg(i % 3), "Tool", "localhost", 1234, matrix);
+    igtl::MessageBase::Pointer message = msg->GetMessage();
+    QByteArray rawMessage(static_cast<const char*>(message->GetPackPointer()), static_cast<int>(message->GetPackSize()));
+
+    QVERIFY(recorder.Record(1000000000 + i * intervalInNanoseconds, 1000000001 + i * intervalInNanoseconds, 1000 + i, rawMessage));
+  }
+  recorder.Stop();
+
+  QVERIFY(!recorder.IsRecording());
+  QVERIFY(recorder.GetNumberOfMessagesWritten() == static_cast<quint64>(numberOfMessages));
+  QVERIFY(recorder.GetNumberOfMessagesDropped() == 0);
+  QVERIFY(static_cast<qint64>(recorder.GetNumberOfBytesWritten()) == QFileInfo(fileName).size());
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorderTests::RecordAndReadTest()
+{
+  QString fileName = niftk::AppendPathSeparator(niftk::GetTempDirectoryPath()) + QString("RecordAndReadTest.nlr");
+  this->WriteTestRecording(fileName, 50, 1000);
+
+  NiftyLinkRecordingReader reader;
+  reader.Open(fileName);
+  QVERIFY(reader.IsOpen());
+  QVERIFY(reader.GetRecordingStartTime() > 0);
+
+  quint64 timeArrived = 0;
+  quint64 timeReceived = 0;
+  int portNumber = 0;
+  QByteArray rawMessage;
+
+  int numberRead = 0;
+  while (reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage))
+  {
+    QVERIFY(timeArrived == static_cast<quint64>(1000000000 + numberRead * 1000));
+    QVERIFY(timeReceived == timeArrived + 1);
+    QVERIFY(portNumber == 1000 + numberRead);
+
+    igtl::MessageBase::Pointer message = NiftyLinkRecordingReader::CreateMessage(rawMessage.constData(), rawMessage.size());
+    QVERIFY(message->GetPackSize() == static_cast<igtlUint64>(rawMessage.size()));
+    QVERIFY(memcmp(message->GetPackPointer(), rawMessage.constData(), rawMessage.size()) == 0);
+
+    message->Unpack();
+    QVERIFY(QString(message->GetDeviceName()) == QString("Tracker%1").arg(numberRead % 3));
+    QVERIFY(QString(message->GetDeviceType()) == QString("TDATA"));
+
+    numberRead++;
+  }
+  QVERIFY(numberRead == 50);
+
+  reader.Rewind();
+  QVERIFY(reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage));
+  QVERIFY(timeArrived == 1000000000);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorderTests::IndexTest()
+{
+  QString fileName = niftk::AppendPathSeparator(niftk::GetTempDirectoryPath()) + QString("IndexTest.nlr");
+  QString indexFileName = NiftyLinkRecordingIndex::GetIndexFileName(fileName);
+  this->WriteTestRecording(fileName, 60, 1000);
+  QVERIFY(QFile::exists(indexFileName));
+
+  NiftyLinkRecordingReader reader;
+  reader.Open(fileName);
+  QVERIFY(reader.GetIndex().GetNumberOfEntries() == 60);
+  QVERIFY(reader.GetIndex().GetDeviceNames().size() == 3);
+  QVERIFY(reader.GetIndex().GetDeviceNumber("Tracker1") == 1);
+  QVERIFY(reader.GetIndex().GetDeviceNumber("Nonsense") == -1);
+
+  quint64 timeArrived = 0;
+  quint64 timeReceived = 0;
+  int portNumber = 0;
+  QByteArray rawMessage;
+
+  reader.SeekToTime(1000000000 + 30 * 1000);
+  QVERIFY(reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage));
+  QVERIFY(portNumber == 1030);
+
+  reader.SeekToTime(1000000000 + 30 * 1000 + 500);
+  QVERIFY(reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage));
+  QVERIFY(portNumber == 1031);
+
+  reader.SeekToTime(2000000000);
+  QVERIFY(!reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage));
+
+  reader.SetDeviceFilter("Tracker1");
+  int numberRead = 0;
+  while (reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage))
+  {
+    QVERIFY(NiftyLinkRecordingIndex::GetDeviceName(rawMessage.constData()) == QString("Tracker1"));
+    numberRead++;
+  }
+  QVERIFY(numberRead == 20);
+
+  // The next Tracker1 message at or after message 30 is message 31.
+  reader.SeekToTime(1000000000 + 30 * 1000);
+  QVERIFY(reader.ReadNext(timeArrived, timeReceived, portNumber, rawMessage));
+  QVERIFY(portNumber == 1031);
+
+  QVector<qint64> offsets;
+  for (int i = 0; i < reader.GetIndex().GetNumberOfEntries(); i++)
+  {
+    offsets.push_back(reader.GetIndex().GetEntry(i).m_Offset);
+  }
+  reader.Close();
+
+  // A corrupt number of entries, (stored just before the 60 entries of 20 bytes), must be rejected, not reserved.
+  QFile indexFile(indexFileName);
+  QVERIFY(indexFile.open(QIODevice::ReadWrite));
+  QVERIFY(indexFile.seek(indexFile.size() - 60 * 20 - 4));
+  const char hugeNumberOfEntries[4] = {'\xff', '\xff', '\xff', '\x7f'};
+  QVERIFY(indexFile.write(hugeNumberOfEntries, 4) == 4);
+  indexFile.close();
+
+  NiftyLinkRecordingIndex corruptIndex;
+  QVERIFY(!corruptIndex.Load(indexFileName, QFileInfo(fileName).size()));
+  QVERIFY(corruptIndex.GetNumberOfEntries() == 0);
+
+  // Without the index, the reader must rebuild an identical one.
+  QVERIFY(QFile::remove(indexFileName));
+  reader.Open(fileName);
+  QVERIFY(reader.GetIndex().GetNumberOfEntries() == 60);
+  for (int i = 0; i < reader.GetIndex().GetNumberOfEntries(); i++)
+  {
+    QVERIFY(reader.GetIndex().GetEntry(i).m_Offset == offsets[i]);
+  }
+  reader.Close();
+
+  // A record whose message runs off the end of its chunk stops indexing that chunk, rather than reading past it.
+  QFile recordingFile(fileName);
+  QVERIFY(recordingFile.open(QIODevice::ReadWrite));
+  QVERIFY(recordingFile.seek(NiftyLinkMessageRecorder::m_FILE_HEADER_SIZE + NiftyLinkMessageRecorder::m_CHUNK_HEADER_SIZE + 16));
+  const char hugeMessageSize[4] = {'\xff', '\xff', '\xff', '\x7f'};
+  QVERIFY(recordingFile.write(hugeMessageSize, 4) == 4);
+  recordingFile.close();
+
+  QVERIFY(QFile::remove(indexFileName));
+  reader.Open(fileName);
+  QVERIFY(reader.GetIndex().GetNumberOfEntries() < 60);
+  for (int i = 0; i < reader.GetIndex().GetNumberOfEntries(); i++)
+  {
+    QVERIFY(reader.GetIndex().GetEntry(i).m_Offset != offsets[0]);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkMessageRecorderTests::PlaybackTest()
+{
+  QString fileName = niftk::AppendPathSeparator(niftk::GetTempDirectoryPath()) + QString("PlaybackTest.nlr");
+
+  // 20 messages, 10 milliseconds apart, so 190 milliseconds from first to last.
+  this->WriteTestRecording(fileName, 20, 10000000);
+
+  NiftyLinkMessagePlayer player;
+  connect(&player, SIGNAL(MessagePlayed(niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnMessagePlayed(niftk::NiftyLinkMessageContainer::Pointer)), Qt::DirectConnection);
+
+  m_PlayedMessages.clear();
+  player.SetPlaybackMode(NiftyLinkMessagePlayer::AS_FAST_AS_POSSIBLE);
+  player.Start(fileName);
+  for (int i = 0; i < 500 && player.IsPlaying(); i++)
+  {
+    QTest::qWait(10);
+  }
+  player.Stop();
+
+  QVERIFY(m_PlayedMessages.size() == 20);
+  QVERIFY(player.GetNumberOfMessagesPlayed() == 20);
+  QVERIFY(QString(m_PlayedMessages[0]->GetMessage()->GetDeviceName()) == QString("Tracker0"));
+  QVERIFY(m_PlayedMessages[19]->GetSenderPortNumber() == 1019);
+
+  // At 4 times speed, the last message is due after 47.5 milliseconds, and must not be early.
+  m_PlayedMessages.clear();
+  player.SetPlaybackMode(NiftyLinkMessagePlayer::SCALED_TIMING);
+  player.SetSpeed(4);
+
+  QElapsedTimer timer;
+  timer.start();
+  player.Start(fileName);
+  for (int i = 0; i < 500 && player.IsPlaying(); i++)
+  {
+    QTest::qWait(5);
+  }
+  qint64 elapsed = timer.elapsed();
+  player.Stop();
+
+  QVERIFY(m_PlayedMessages.size() == 20);
+  QVERIFY(elapsed >= 47);
+}
+
+} // end namespace niftk
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkMessageRecorderTests )
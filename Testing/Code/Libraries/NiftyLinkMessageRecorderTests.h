@@ -0,0 +1,67 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkMessageRecorderTests_h
+#define NiftyLinkMessageRecorderTests_h
+
+#include <NiftyLinkTestingMacros.h>
+#include <NiftyLinkMessageContainer.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkMessageRecorderTests
+* \brief Tests for NiftyLinkMessageRecorder, NiftyLinkRecordingReader and NiftyLinkMessagePlayer.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkMessageRecorderTests: public QObject
+{
+  Q_OBJECT
+
+public slots:
+
+  /// \brief Counts messages from NiftyLinkMessagePlayer, (public, so QTestLib doesn't run it as a test).
+  void OnMessagePlayed(niftk::NiftyLinkMessageContainer::Pointer message);
+
+private slots:
+
+  /**
+   * \brief Records messages, and checks that NiftyLinkRecordingReader returns identical bytes and timestamps.
+   */
+  void RecordAndReadTest();
+
+  /**
+   * \brief Checks the index written by the recorder, seeking by time, filtering by device, rejecting a corrupt index, rebuilding a missing one, and skipping a corrupt record.
+   */
+  void IndexTest();
+
+  /**
+   * \brief Plays a recording as fast as possible, and with scaled timing, checking all messages are delivered, and not early.
+   */
+  void PlaybackTest();
+
+private:
+
+  /// \brief Writes numberOfMessages tracking messages, intervalInNanoseconds apart, to fileName.
+  void WriteTestRecording(const QString& fileName, const int& numberOfMessages, const quint64& intervalInNanoseconds);
+
+  QList<NiftyLinkMessageContainer::Pointer> m_PlayedMessages;
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkMessageRecorderTests_h
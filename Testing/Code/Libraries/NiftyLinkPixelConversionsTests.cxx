@@ -0,0 +1,227 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+
+#include "NiftyLinkPixelConversionsTests.h"
+#include <NiftyLinkPixelConversions.h>
+
+#include <QImage>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <stdexcept>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkPixelConversionsTestTask
+* \brief Waits until numberOfTasks are running, so the pool is saturated, then converts a frame large enough to be split into bands.
+*/
+class NiftyLinkPixelConversionsTestTask : public QRunnable
+{
+public:
+  NiftyLinkPixelConversionsTestTask(QSemaphore *started, const int& numberOfTasks, QAtomicInt *numberCorrect)
+  : m_Started(started)
+  , m_NumberOfTasks(numberOfTasks)
+  , m_NumberCorrect(numberCorrect)
+  {
+    this->setAutoDelete(true);
+  }
+
+  virtual void run()
+  {
+    m_Started->release();
+    while (m_Started->available() < m_NumberOfTasks)
+    {
+      QThread::yieldCurrentThread();
+    }
+
+    const int width = 1024;
+    const int height = 512;
+    QVector<uchar> input(width * height * 4, 1);
+    QVector<uchar> output(input.size(), 0);
+    niftk::ConvertBGRAToRGBA(input.constData(), width * 4, output.data(), width * 4, width, height);
+
+    if (output == input)
+    {
+      m_NumberCorrect->ref();
+    }
+  }
+
+private:
+  QSemaphore *m_Started;
+  int         m_NumberOfTasks;
+  QAtomicInt *m_NumberCorrect;
+};
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::RGB888ToARGB32Test()
+{
+  // Odd width, so QImage pads each line.
+  QImage input(1921, 1080, QImage::Format_RGB888);
+  for (int y = 0; y < input.height(); y++)
+  {
+    uchar *line = input.scanLine(y);
+    for (int x = 0; x < input.width() * 3; x++)
+    {
+      line[x] = static_cast<uchar>((x * 7 + y * 13) % 256);
+    }
+  }
+
+  QImage expected = input.convertToFormat(QImage::Format_ARGB32);
+  QImage actual(input.width(), input.height(), QImage::Format_ARGB32);
+
+  niftk::ConvertRGB888ToARGB32(input.constBits(), input.bytesPerLine(),
+                               actual.bits(), actual.bytesPerLine(),
+                               input.width(), input.height());
+
+  QVERIFY(actual == expected);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::BGRAToRGBATest()
+{
+  const int width = 5;
+  const int height = 3;
+  QVector<uchar> input(width * height * 4);
+  for (int i = 0; i < input.size(); i++)
+  {
+    input[i] = static_cast<uchar>(i);
+  }
+
+  QVector<uchar> output(input.size());
+  QVector<uchar> roundTrip(input.size());
+
+  niftk::ConvertBGRAToRGBA(input.constData(), width * 4, output.data(), width * 4, width, height);
+  niftk::ConvertBGRAToRGBA(output.constData(), width * 4, roundTrip.data(), width * 4, width, height);
+
+  for (int i = 0; i < width * height; i++)
+  {
+    QVERIFY(output[4 * i]     == input[4 * i + 2]);
+    QVERIFY(output[4 * i + 1] == input[4 * i + 1]);
+    QVERIFY(output[4 * i + 2] == input[4 * i]);
+    QVERIFY(output[4 * i + 3] == input[4 * i + 3]);
+  }
+  QVERIFY(roundTrip == input);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::YUVToARGB32Test()
+{
+  // Y = 16 is black, Y = 235 is white, and U = V = 128 is no colour.
+  const uchar yuv422[8] = {16, 128, 235, 128, 126, 128, 126, 128};
+  QImage actual(4, 1, QImage::Format_ARGB32);
+
+  niftk::ConvertYUV422ToARGB32(yuv422, 8, actual.bits(), actual.bytesPerLine(), 4, 1);
+  QVERIFY(actual.pixel(0, 0) == qRgb(0, 0, 0));
+  QVERIFY(actual.pixel(1, 0) == qRgb(255, 255, 255));
+  QVERIFY(actual.pixel(2, 0) == qRgb(128, 128, 128));
+
+  const uchar yPlane[8] = {16, 235, 126, 126,
+                           16, 235, 126, 126};
+  const uchar uvPlane[4] = {128, 128, 128, 128};
+  QImage actualNV12(4, 2, QImage::Format_ARGB32);
+
+  niftk::ConvertNV12ToARGB32(yPlane, 4, uvPlane, 4, actualNV12.bits(), actualNV12.bytesPerLine(), 4, 2);
+  QVERIFY(actualNV12.pixel(0, 1) == qRgb(0, 0, 0));
+  QVERIFY(actualNV12.pixel(1, 1) == qRgb(255, 255, 255));
+  QVERIFY(actualNV12.pixel(3, 1) == qRgb(128, 128, 128));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::Grey16ToGrey8Test()
+{
+  const int width = 4;
+  const quint16 input[width] = {999, 1000, 1500, 2001};
+  uchar output[width];
+
+  niftk::ConvertGrey16ToGrey8(reinterpret_cast<const uchar*>(input), width * 2, output, width, width, 1, 1000, 1500);
+
+  QVERIFY(output[0] == 0);
+  QVERIFY(output[1] == 0);
+  QVERIFY(output[2] == 128);
+  QVERIFY(output[3] == 255);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::SwapByteOrderTest()
+{
+  const int numberOfElements = 10007;
+  const int bytesPerElement[3] = {2, 4, 8};
+
+  for (int k = 0; k < 3; k++)
+  {
+    const int size = bytesPerElement[k];
+
+    QVector<uchar> input(numberOfElements * size);
+    for (int i = 0; i < input.size(); i++)
+    {
+      input[i] = static_cast<uchar>(i * 31 + 7);
+    }
+
+    QVector<uchar> output(input.size());
+    niftk::SwapByteOrder(input.constData(), output.data(), size, numberOfElements);
+
+    for (int i = 0; i < numberOfElements; i++)
+    {
+      for (int j = 0; j < size; j++)
+      {
+        QVERIFY(output[i * size + j] == input[i * size + size - 1 - j]);
+      }
+    }
+
+    // Swapping twice, in place, gets back to the input.
+    niftk::SwapByteOrder(output.constData(), output.data(), size, numberOfElements);
+    QVERIFY(output == input);
+  }
+
+  try
+  {
+    uchar buffer[3];
+    niftk::SwapByteOrder(buffer, buffer, 3, 1);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (const std::invalid_argument&)
+  {
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkPixelConversionsTests::SaturatedGlobalPoolTest()
+{
+  QThreadPool *pool = QThreadPool::globalInstance();
+  const int numberOfTasks = pool->maxThreadCount();
+
+  QSemaphore started;
+  QAtomicInt numberCorrect(0);
+  for (int i = 0; i < numberOfTasks; i++)
+  {
+    pool->start(new NiftyLinkPixelConversionsTestTask(&started, numberOfTasks, &numberCorrect));
+  }
+
+  // If the bands were queued behind these tasks on the global pool, this would time out.
+  QVERIFY(pool->waitForDone(10000));
+  QVERIFY(numberCorrect.fetchAndAddOrdered(0) == numberOfTasks);
+}
+
+} // end namespace
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkPixelConversionsTests )
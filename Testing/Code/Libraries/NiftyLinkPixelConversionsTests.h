@@ -0,0 +1,69 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkPixelConversionsTests_h
+#define NiftyLinkPixelConversionsTests_h
+
+#include <NiftyLinkTestingMacros.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkPixelConversionsTests
+* \brief Tests for functions in NiftyLinkPixelConversions.h
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkPixelConversionsTests: public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  /**
+   * \brief Converts a 1080p RGB888 frame, (so, in parallel), and compares with QImage::convertToFormat().
+   */
+  void RGB888ToARGB32Test();
+
+  /**
+   * \brief Checks BGRA to RGBA swaps the first and third byte, and that doing it twice gets back to the start.
+   */
+  void BGRAToRGBATest();
+
+  /**
+   * \brief Checks YUV 4:2:2 and NV12 give black, white and grey at the video range limits.
+   */
+  void YUVToARGB32Test();
+
+  /**
+   * \brief Checks window and level of 16 bit grey, including clamping either side of the window.
+   */
+  void Grey16ToGrey8Test();
+
+  /**
+   * \brief Checks byte order swapping of 2, 4 and 8 byte elements, in place and not, for a length that isn't a multiple of the vector width.
+   */
+  void SwapByteOrderTest();
+
+  /**
+   * \brief Converts large frames, (so, in parallel), from tasks that occupy every thread of QThreadPool::globalInstance(), checking this doesn't deadlock.
+   */
+  void SaturatedGlobalPoolTest();
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkPixelConversionsTests_h
@@ -0,0 +1,143 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+
+#include "NiftyLinkSendQueueTests.h"
+#include <NiftyLinkSendQueue.h>
+
+#include <igtlStringMessage.h>
+
+#include <QThread>
+#include <QVector>
+
+namespace niftk
+{
+
+static const int NUMBER_OF_PRODUCERS = 4;
+static const int NUMBER_OF_MESSAGES_PER_PRODUCER = 10000;
+
+/// Pushes NUMBER_OF_MESSAGES_PER_PRODUCER messages, named after the producer, where the time is the index.
+class SendQueueProducer : public QThread
+{
+public:
+  SendQueueProducer(NiftyLinkSendQueue* queue, const int& producer)
+  : m_Queue(queue)
+  , m_Producer(producer)
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    for (int i = 0; i < NUMBER_OF_MESSAGES_PER_PRODUCER; i++)
+    {
+      igtl::StringMessage::Pointer message = igtl::StringMessage::New();
+      message->SetDeviceName(QString::number(m_Producer).toStdString().c_str());
+      m_Queue->Push(message.GetPointer(), i);
+    }
+  }
+
+private:
+  NiftyLinkSendQueue* m_Queue;
+  int                 m_Producer;
+};
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSendQueueTests::PushPopTest()
+{
+  NiftyLinkSendQueue* queue = new NiftyLinkSendQueue();
+
+  igtl::MessageBase::Pointer message;
+  igtlUint64 timeQueued = 0;
+  QVERIFY(!queue->Pop(message, timeQueued));
+  QVERIFY(message.IsNull());
+
+  for (int i = 0; i < 3; i++)
+  {
+    igtl::StringMessage::Pointer m = igtl::StringMessage::New();
+    m->SetDeviceName(QString::number(i).toStdString().c_str());
+    queue->Push(m.GetPointer(), 100 + i);
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    QVERIFY(queue->Pop(message, timeQueued));
+    QVERIFY(message.IsNotNull());
+    QVERIFY(std::string(message->GetDeviceName()) == QString::number(i).toStdString());
+    QVERIFY(timeQueued == static_cast<igtlUint64>(100 + i));
+  }
+  QVERIFY(!queue->Pop(message, timeQueued));
+
+  // Left in the queue, so the destructor has to release it.
+  igtl::StringMessage::Pointer leftOver = igtl::StringMessage::New();
+  queue->Push(leftOver.GetPointer(), 200);
+  QVERIFY(leftOver->GetReferenceCount() == 2);
+
+  delete queue;
+  QVERIFY(leftOver->GetReferenceCount() == 1);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSendQueueTests::MultipleProducersTest()
+{
+  NiftyLinkSendQueue queue;
+
+  QVector<SendQueueProducer*> producers;
+  for (int i = 0; i < NUMBER_OF_PRODUCERS; i++)
+  {
+    producers.append(new SendQueueProducer(&queue, i));
+  }
+  for (int i = 0; i < NUMBER_OF_PRODUCERS; i++)
+  {
+    producers[i]->start();
+  }
+
+  QVector<int> numberPopped(NUMBER_OF_PRODUCERS, 0);
+  int total = 0;
+  int numberOutOfOrder = 0;
+
+  igtl::MessageBase::Pointer message;
+  igtlUint64 timeQueued = 0;
+
+  // Don't QVERIFY in here, as returning would destroy the producers while running.
+  while (total < NUMBER_OF_PRODUCERS * NUMBER_OF_MESSAGES_PER_PRODUCER)
+  {
+    if (queue.Pop(message, timeQueued))
+    {
+      int producer = QString(message->GetDeviceName()).toInt();
+      if (timeQueued != static_cast<igtlUint64>(numberPopped[producer]))
+      {
+        numberOutOfOrder++;
+      }
+      numberPopped[producer]++;
+      total++;
+    }
+  }
+
+  for (int i = 0; i < NUMBER_OF_PRODUCERS; i++)
+  {
+    producers[i]->wait();
+    delete producers[i];
+  }
+
+  QVERIFY(numberOutOfOrder == 0);
+  for (int i = 0; i < NUMBER_OF_PRODUCERS; i++)
+  {
+    QVERIFY(numberPopped[i] == NUMBER_OF_MESSAGES_PER_PRODUCER);
+  }
+  QVERIFY(!queue.Pop(message, timeQueued));
+}
+
+} // end namespace niftk
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkSendQueueTests )
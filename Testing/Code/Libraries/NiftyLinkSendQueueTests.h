@@ -0,0 +1,59 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkSendQueueTests_h
+#define NiftyLinkSendQueueTests_h
+
+#include <NiftyLinkTestingMacros.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkSendQueueTests
+* \brief Tests for NiftyLinkSendQueue.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkSendQueueTests: public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  /**
+   * \brief Tests a single thread pushing and popping.
+   *
+   * Spec:
+   *   - Pop() on an empty queue returns false.
+   *   - Messages, and their times, come out in the order they went in.
+   *   - Messages left in the queue are released by the destructor.
+   */
+  void PushPopTest();
+
+  /**
+   * \brief Tests several threads pushing, while this thread pops.
+   *
+   * Spec:
+   *   - Every message pushed is popped exactly once.
+   *   - Messages from each thread come out in the order that thread pushed them.
+   */
+  void MultipleProducersTest();
+
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkSendQueueTests_h
@@ -0,0 +1,111 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+
+#include "NiftyLinkSenderProcessTests.h"
+#include <NiftyLinkSenderProcess.h>
+#include <NiftyLinkStringMessage.h>
+
+#include <QMutex>
+
+namespace niftk
+{
+
+/// Makes the queue methods of NiftyLinkSenderProcess, (normally only used by NiftyLinkSocketObject), public.
+class NiftyLinkSenderProcessTestsSender : public NiftyLinkSenderProcess
+{
+public:
+  NiftyLinkSenderProcessTestsSender()
+  {
+    this->SetMutex(&m_TestMutex);
+  }
+
+  using NiftyLinkSenderProcess::SetQueuePolicy;
+  using NiftyLinkSenderProcess::GetQueuePolicy;
+  using NiftyLinkSenderProcess::SetMaximumQueueSize;
+  using NiftyLinkSenderProcess::GetMaximumQueueSize;
+  using NiftyLinkSenderProcess::GetNumberOfMessagesDropped;
+  using NiftyLinkSenderProcess::AddMsgToSendQueue;
+  using NiftyLinkSenderProcess::TerminateProcess;
+
+private:
+  QMutex m_TestMutex;
+};
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkMessage::Pointer CreateMessage(const int& i)
+{
+  NiftyLinkStringMessage::Pointer msg(new NiftyLinkStringMessage());
+  msg->SetString(QString::number(i));
+  return NiftyLinkMessage::Pointer(msg.data());
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSenderProcessTests::LatestOnlyTest()
+{
+  NiftyLinkSenderProcessTestsSender sender;
+  QVERIFY(sender.GetQueuePolicy() == NiftyLinkSenderProcess::LATEST_ONLY);
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 0);
+
+  sender.AddMsgToSendQueue(CreateMessage(0));
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 0);
+
+  for (int i = 1; i < 10; i++)
+  {
+    sender.AddMsgToSendQueue(CreateMessage(i));
+    QVERIFY(sender.GetNumberOfMessagesDropped() == static_cast<quint64>(i));
+  }
+
+  sender.TerminateProcess();
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 10);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSenderProcessTests::FifoTest()
+{
+  NiftyLinkSenderProcessTestsSender sender;
+  sender.SetQueuePolicy(NiftyLinkSenderProcess::FIFO);
+  QVERIFY(sender.GetQueuePolicy() == NiftyLinkSenderProcess::FIFO);
+  QVERIFY(sender.GetMaximumQueueSize() == 100);
+
+  sender.SetMaximumQueueSize(0);
+  QVERIFY(sender.GetMaximumQueueSize() == 1);
+
+  sender.SetMaximumQueueSize(5);
+  QVERIFY(sender.GetMaximumQueueSize() == 5);
+
+  for (int i = 0; i < 5; i++)
+  {
+    sender.AddMsgToSendQueue(CreateMessage(i));
+  }
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 0);
+
+  for (int i = 5; i < 12; i++)
+  {
+    sender.AddMsgToSendQueue(CreateMessage(i));
+    QVERIFY(sender.GetNumberOfMessagesDropped() == static_cast<quint64>(i - 4));
+  }
+
+  // Shrinking the queue drops the oldest when the next message arrives.
+  sender.SetMaximumQueueSize(2);
+  sender.AddMsgToSendQueue(CreateMessage(12));
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 7 + 4);
+
+  sender.TerminateProcess();
+  QVERIFY(sender.GetNumberOfMessagesDropped() == 11 + 2);
+}
+
+} // end namespace niftk
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkSenderProcessTests )
@@ -0,0 +1,61 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkSenderProcessTests_h
+#define NiftyLinkSenderProcessTests_h
+
+#include <NiftyLinkTestingMacros.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkSenderProcessTests
+* \brief Tests for the queue policy of NiftyLinkSenderProcess, (from the first version of NiftyLink), without connecting.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkSenderProcessTests: public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  /**
+   * \brief Tests the LATEST_ONLY queue policy.
+   *
+   * Spec:
+   *   - Is the default.
+   *   - Each message replaces the one queued before it, which counts as dropped.
+   *   - The message left unsent at termination counts as dropped.
+   */
+  void LatestOnlyTest();
+
+  /**
+   * \brief Tests the FIFO queue policy.
+   *
+   * Spec:
+   *   - Nothing is dropped until the queue holds the maximum number of messages.
+   *   - After that, each message drops the oldest.
+   *   - The maximum queue size is at least 1.
+   *   - Messages left unsent at termination count as dropped.
+   */
+  void FifoTest();
+
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkSenderProcessTests_h
@@ -0,0 +1,441 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+
+#include "NiftyLinkSocketTests.h"
+#include <NiftyLinkSocket.h>
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+
+#include <igtlTimeStamp.h>
+
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace niftk
+{
+
+/// A NiftyLinkSocket that takes over an existing descriptor, here one end of a socketpair, which it closes when destroyed.
+class NiftyLinkSocketTestsSocket : public NiftyLinkSocket
+{
+public:
+  typedef NiftyLinkSocketTestsSocket     Self;
+  typedef igtl::SmartPointer<Self>       Pointer;
+
+  igtlNewMacro(NiftyLinkSocketTestsSocket);
+
+  void SetSocketDescriptor(const int& descriptor)
+  {
+    this->m_SocketDescriptor = descriptor;
+  }
+
+protected:
+  NiftyLinkSocketTestsSocket() {}
+  ~NiftyLinkSocketTestsSocket() {}
+};
+
+
+/// Reads numberOfBytes from a descriptor, in small pieces, with a pause between each, so the writer keeps finding the socket full.
+class NiftyLinkSocketTestsSlowReader : public QThread
+{
+public:
+  NiftyLinkSocketTestsSlowReader(const int& descriptor, const int& numberOfBytes)
+  : m_Descriptor(descriptor)
+  , m_Data(numberOfBytes, 0)
+  , m_NumberOfBytesRead(0)
+  {
+  }
+
+  const QVector<char>& GetData() const { return m_Data; }
+  int GetNumberOfBytesRead() const { return m_NumberOfBytesRead; }
+
+protected:
+  virtual void run()
+  {
+    while (m_NumberOfBytesRead < m_Data.size())
+    {
+      // An odd size, so reads rarely line up with the writer's buffers.
+      int length = m_Data.size() - m_NumberOfBytesRead;
+      if (length > 1000)
+      {
+        length = 1000;
+      }
+      ssize_t bytesRead = read(m_Descriptor, m_Data.data() + m_NumberOfBytesRead, length);
+      if (bytesRead <= 0)
+      {
+        return;
+      }
+      m_NumberOfBytesRead += static_cast<int>(bytesRead);
+      QThread::msleep(1);
+    }
+  }
+
+private:
+  int           m_Descriptor;
+  QVector<char> m_Data;
+  int           m_NumberOfBytesRead;
+};
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkSocketTestsSocket::Pointer CreateSocketPair(int& otherEnd, const int& sendBufferSize = 0)
+{
+  int descriptors[2] = {-1, -1};
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, descriptors) != 0)
+  {
+    otherEnd = -1;
+    return NiftyLinkSocketTestsSocket::Pointer();
+  }
+
+  if (sendBufferSize > 0)
+  {
+    setsockopt(descriptors[0], SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+  }
+
+  NiftyLinkSocketTestsSocket::Pointer socket = NiftyLinkSocketTestsSocket::New();
+  socket->SetSocketDescriptor(descriptors[0]);
+  otherEnd = descriptors[1];
+  return socket;
+}
+
+
+//-----------------------------------------------------------------------------
+static NiftyLinkSocketTestsSocket::Pointer CreateTcpPair(int& otherEnd)
+{
+  otherEnd = -1;
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+  {
+    return NiftyLinkSocketTestsSocket::Pointer();
+  }
+
+  // Any free port on the loopback interface.
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t addressLength = sizeof(address);
+
+  int client = -1;
+  int server = -1;
+  if (bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0
+      && getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &addressLength) == 0
+      && listen(listener, 1) == 0)
+  {
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    if (client >= 0 && connect(client, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+    {
+      server = accept(listener, NULL, NULL);
+    }
+  }
+  close(listener);
+
+  if (server < 0)
+  {
+    if (client >= 0)
+    {
+      close(client);
+    }
+    return NiftyLinkSocketTestsSocket::Pointer();
+  }
+
+  NiftyLinkSocketTestsSocket::Pointer socket = NiftyLinkSocketTestsSocket::New();
+  socket->SetSocketDescriptor(server);
+  otherEnd = client;
+  return socket;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::WaitForDataTest()
+{
+  int otherEnd = -1;
+  NiftyLinkSocketTestsSocket::Pointer socket = CreateSocketPair(otherEnd);
+  QVERIFY(socket.IsNotNull());
+
+  int wakeUp[2] = {-1, -1};
+  QVERIFY(pipe(wakeUp) == 0);
+
+  // Nothing to read.
+  QElapsedTimer clock;
+  clock.start();
+  QVERIFY(socket->WaitForData(100, wakeUp[0]) == 0);
+  QVERIFY(clock.elapsed() >= 90);
+
+  // Woken up, so the caller must clear the wake-up descriptor.
+  char byte = 1;
+  QVERIFY(write(wakeUp[1], &byte, 1) == 1);
+  QVERIFY(socket->WaitForData(1000, wakeUp[0]) == 2);
+  QVERIFY(read(wakeUp[0], &byte, 1) == 1);
+  QVERIFY(socket->WaitForData(0, wakeUp[0]) == 0);
+
+  // Data arriving, and then the other end closing.
+  QVERIFY(write(otherEnd, "abcd", 4) == 4);
+  QVERIFY(socket->WaitForData(1000, wakeUp[0]) == 1);
+  QVERIFY(socket->CheckPendingData() == 4);
+
+  char data[4];
+  QVERIFY(socket->Receive(data, 4) == 4);
+  QVERIFY(socket->WaitForData(0) == 0);
+
+  close(otherEnd);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 0);
+
+  close(wakeUp[0]);
+  close(wakeUp[1]);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::SendBuffersTest()
+{
+  int otherEnd = -1;
+  NiftyLinkSocketTestsSocket::Pointer socket = CreateSocketPair(otherEnd, 4096);
+  QVERIFY(socket.IsNotNull());
+
+  // 300 buffers, of up to 999 bytes, some empty, with the byte values following on from one buffer to the next.
+  const int numberOfBuffers = 300;
+  QVector<int> lengths(numberOfBuffers);
+  int total = 0;
+  for (int i = 0; i < numberOfBuffers; i++)
+  {
+    lengths[i] = (i % 10 == 0) ? 0 : (i * 37) % 1000;
+    total += lengths[i];
+  }
+
+  QVector<char> expected(total);
+  for (int i = 0; i < total; i++)
+  {
+    expected[i] = static_cast<char>(i % 251);
+  }
+
+  QVector<NiftyLinkSocket::SendBuffer> buffers(numberOfBuffers);
+  int offset = 0;
+  for (int i = 0; i < numberOfBuffers; i++)
+  {
+    buffers[i].m_Data = expected.data() + offset;
+    buffers[i].m_Length = lengths[i];
+    offset += lengths[i];
+  }
+
+  NiftyLinkSocketTestsSlowReader reader(otherEnd, total);
+  reader.start();
+
+  QVERIFY(socket->Send(buffers.data(), numberOfBuffers) == 1);
+
+  reader.wait();
+  QVERIFY(reader.GetNumberOfBytesRead() == total);
+  QVERIFY(reader.GetData() == expected);
+
+  QVERIFY(socket->GetNumberOfBytesSent() == static_cast<igtlUint64>(total));
+  QVERIFY(socket->GetSendStallStats().GetCount() == 1);
+  QVERIFY(socket->GetSendStallStats().GetMax() > 0);
+
+  close(otherEnd);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::SendTimeoutTest()
+{
+  int otherEnd = -1;
+  NiftyLinkSocketTestsSocket::Pointer socket = CreateSocketPair(otherEnd, 4096);
+  QVERIFY(socket.IsNotNull());
+
+  QVector<char> data(1000000, 'x');
+  socket->SetSendWaitTimeout(100);
+
+  QElapsedTimer clock;
+  clock.start();
+  QVERIFY(socket->Send(data.data(), data.size()) == -4);
+  QVERIFY(clock.elapsed() >= 90);
+  QVERIFY(clock.elapsed() < 1000);
+
+  close(otherEnd);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::KernelTimestampTest()
+{
+  for (int i = 0; i < 2; i++)
+  {
+    int otherEnd = -1;
+    NiftyLinkSocketTestsSocket::Pointer socket = (i == 0) ? CreateSocketPair(otherEnd) : CreateTcpPair(otherEnd);
+    QVERIFY(socket.IsNotNull());
+
+    // Nothing received yet, but there is still a time stamp to ask for.
+    socket->GetReceiveTimestampInNanoseconds();
+
+#if defined(__linux__)
+    QVERIFY(socket->SetKernelReceiveTimestamps(1) == 1);
+#else
+    QVERIFY(socket->SetKernelReceiveTimestamps(1) == 0);
+#endif
+
+    igtl::TimeStamp::Pointer beforeSend = igtl::TimeStamp::New();
+    QVERIFY(write(otherEnd, "abcd", 4) == 4);
+    QVERIFY(socket->WaitForData(1000) == 1);
+
+    char data[4];
+    QVERIFY(socket->Receive(data, 4) == 4);
+    igtl::TimeStamp::Pointer afterReceive = igtl::TimeStamp::New();
+
+    QVERIFY(socket->GetReceiveTimestampInNanoseconds() >= beforeSend->GetTimeStampInNanoseconds());
+    // Plus a microsecond, as the software clock may be that coarse.
+    QVERIFY(socket->GetReceiveTimestampInNanoseconds() <= afterReceive->GetTimeStampInNanoseconds() + 1000);
+
+    close(otherEnd);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::ReadBufferTest()
+{
+  int otherEnd = -1;
+  NiftyLinkSocketTestsSocket::Pointer socket = CreateSocketPair(otherEnd);
+  QVERIFY(socket.IsNotNull());
+  QVERIFY(socket->SetReadBufferSize(64) == 64);
+
+  QVector<char> expected(20000);
+  for (int i = 0; i < expected.size(); i++)
+  {
+    expected[i] = static_cast<char>(i % 251);
+  }
+
+  // Reads of assorted sizes, either side of the buffer size.
+  QVERIFY(write(otherEnd, expected.data(), 1000) == 1000);
+
+  const int sizes[] = {1, 7, 13, 30, 63, 64, 65, 100, 2};
+  const int numberOfSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  QVector<char> data(expected.size());
+  int total = 0;
+  int numberOfReads = 0;
+  const igtlUint64 systemCallsBefore = socket->GetNumberOfReceiveSystemCalls();
+  while (total < 1000)
+  {
+    int length = sizes[numberOfReads % numberOfSizes];
+    if (length > 1000 - total)
+    {
+      length = 1000 - total;
+    }
+    QVERIFY(socket->Receive(data.data() + total, length) == length);
+    total += length;
+    numberOfReads++;
+  }
+  QVERIFY(memcmp(data.data(), expected.data(), 1000) == 0);
+  QVERIFY(socket->GetNumberOfReceiveSystemCalls() - systemCallsBefore < static_cast<igtlUint64>(numberOfReads));
+
+  // A large read, which goes straight into the caller's memory.
+  QVERIFY(write(otherEnd, expected.data() + 1000, 10000) == 10000);
+  QVERIFY(socket->Receive(data.data() + 1000, 10000) == 10000);
+  QVERIFY(memcmp(data.data() + 1000, expected.data() + 1000, 10000) == 0);
+
+  // Not resizable while holding data.
+  QVERIFY(write(otherEnd, expected.data() + 11000, 10) == 10);
+  QVERIFY(socket->Receive(data.data() + 11000, 5) == 5);
+  QVERIFY(socket->SetReadBufferSize(128) == -1);
+  QVERIFY(socket->Receive(data.data() + 11005, 5) == 5);
+  QVERIFY(memcmp(data.data() + 11000, expected.data() + 11000, 10) == 0);
+  QVERIFY(socket->SetReadBufferSize(128) == 128);
+
+  // Nothing to read, (as after poll() says readable, but recv() is interrupted), is not the other end closing.
+  QVERIFY(socket->CheckPendingData() == -5);
+
+  // A read too big for the buffer, the rest of which never arrives, gives up rather than blocking.
+  QVERIFY(write(otherEnd, expected.data(), 10) == 10);
+  QElapsedTimer clock;
+  clock.start();
+  QVERIFY(socket->Receive(data.data(), 1000) < 0);
+  QVERIFY(clock.elapsed() < 5000);
+
+  // The other end closing, with data still to read.
+  QVERIFY(write(otherEnd, expected.data() + 11010, 3) == 3);
+  close(otherEnd);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 3);
+  QVERIFY(socket->Receive(data.data() + 11010, 3) == 3);
+  QVERIFY(memcmp(data.data() + 11010, expected.data() + 11010, 3) == 0);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 0);
+  QVERIFY(socket->Receive(data.data(), 1) == 0);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkSocketTests::KeepAliveTest()
+{
+  int otherEnd = -1;
+  NiftyLinkSocketTestsSocket::Pointer socket = CreateSocketPair(otherEnd);
+  QVERIFY(socket.IsNotNull());
+
+  // Without a read buffer.
+  QVERIFY(write(otherEnd, "??", 2) == 2);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 2);
+  QVERIFY(socket->WaitForData(0) == 0);
+
+  QVERIFY(socket->SetReadBufferSize(64) == 64);
+
+  // Only keepalives.
+  QVERIFY(write(otherEnd, "????", 4) == 4);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 2);
+  QVERIFY(socket->WaitForData(0) == 0);
+
+  // Keepalives before a message.
+  char data[64];
+  QVERIFY(write(otherEnd, "????abcdef", 10) == 10);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 6);
+  QVERIFY(socket->Receive(data, 6) == 6);
+  QVERIFY(memcmp(data, "abcdef", 6) == 0);
+
+  // A keepalive split across the end of the read buffer, and across two writes.
+  QVector<char> message(64, 'x');
+  message[63] = '?';
+  QVERIFY(write(otherEnd, message.data(), 64) == 64);
+  QVERIFY(socket->Receive(data, 63) == 63);
+  QVERIFY(socket->CheckPendingData() == 2);
+  QVERIFY(write(otherEnd, "?hello world!", 13) == 13);
+  QVERIFY(socket->CheckPendingData() == 12);
+  QVERIFY(socket->Receive(data, 12) == 12);
+  QVERIFY(memcmp(data, "hello world!", 12) == 0);
+
+  // The first 2 bytes of a message.
+  QVERIFY(write(otherEnd, "ab", 2) == 2);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 1);
+  QVERIFY(socket->Receive(data, 2) == 2);
+  QVERIFY(memcmp(data, "ab", 2) == 0);
+
+  // Half a keepalive, then the other end closing.
+  QVERIFY(write(otherEnd, "?", 1) == 1);
+  close(otherEnd);
+  QVERIFY(socket->WaitForData(1000) == 1);
+  QVERIFY(socket->CheckPendingData() == 0);
+}
+
+} // end namespace niftk
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkSocketTests )
@@ -0,0 +1,102 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkSocketTests_h
+#define NiftyLinkSocketTests_h
+
+#include <NiftyLinkTestingMacros.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkSocketTests
+* \brief Tests for NiftyLinkSocket, using one end of a socketpair, so POSIX only.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkSocketTests: public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  /**
+   * \brief Tests WaitForData().
+   *
+   * Spec:
+   *   - Returns 0 when nothing arrives before the timeout, without returning early.
+   *   - Returns 2 when the wake-up descriptor is readable, and the socket isn't.
+   *   - Returns 1 when the socket is readable, or the other end has closed.
+   */
+  void WaitForDataTest();
+
+  /**
+   * \brief Tests Send() of many buffers to a slow reader, through a small send buffer.
+   *
+   * Spec:
+   *   - More than 64 buffers, of any size including 0, arrive in order, as if they were one contiguous buffer.
+   *   - Partial writes, which end part way through a buffer, carry on from the right byte.
+   *   - The number of bytes sent is counted, and the time spent waiting for the reader is recorded as a stall.
+   */
+  void SendBuffersTest();
+
+  /**
+   * \brief Tests Send() when nothing reads.
+   *
+   * Spec:
+   *   - Returns -4 once the send wait timeout has expired, and not long after.
+   */
+  void SendTimeoutTest();
+
+  /**
+   * \brief Tests kernel receive time stamps.
+   *
+   * Spec:
+   *   - The receive time stamp is valid before anything has been received.
+   *   - With kernel time stamps on, the receive time stamp is between sending and receiving, on TCP (Linux only),
+   *     and also on a socketpair, which accepts SO_TIMESTAMPNS but never sends one, so the time of the read is used.
+   */
+  void KernelTimestampTest();
+
+  /**
+   * \brief Tests Receive() with a read buffer.
+   *
+   * Spec:
+   *   - Reads of any size, smaller or larger than the buffer, return the bytes in order.
+   *   - Small reads are served from the buffer, so take fewer system calls than reads.
+   *   - Large reads bypass the buffer once it is empty.
+   *   - The buffer can't be resized while it holds data.
+   *   - With nothing to read, CheckPendingData() returns -5, and a large read whose rest never arrives doesn't block.
+   *   - Once the other end closes, buffered data can still be read, then CheckPendingData() returns 0.
+   */
+  void ReadBufferTest();
+
+  /**
+   * \brief Tests that keepalives, (see NiftyLinkSocket::Poke()), are discarded by CheckPendingData().
+   *
+   * Spec:
+   *   - With or without a read buffer, returns 2 when there were only keepalives, and then has nothing to read.
+   *   - Keepalives before a message are discarded, including one split across the end of the read buffer.
+   *   - The first 2 bytes of a message are reported as 1, not mistaken for a keepalive.
+   *   - Half a keepalive followed by the other end closing returns 0.
+   */
+  void KeepAliveTest();
+
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkSocketTests_h
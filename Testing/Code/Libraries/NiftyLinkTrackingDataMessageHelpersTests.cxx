@@ -12,8 +12,18 @@
 
 #include "NiftyLinkTrackingDataMessageHelpersTests.h"
 #include <NiftyLinkTrackingDataMessageHelpers.h>
+#include <NiftyLinkTrackingDataAggregator.h>
+#include <NiftyLinkTrackingHistory.h>
+#include <NiftyLinkTransformMessageHelpers.h>
 #include <NiftyLinkUtils.h>
 
+#include <igtlMessageHeader.h>
+#include <igtlStringMessage.h>
+#include <igtl_header.h>
+
+#include <cmath>
+#include <cstring>
+
 namespace niftk
 {
 
@@ -56,6 +66,340 @@ void NiftyLinkTrackingDataMessageHelpersTests::SetGetTrackingDataTest()
 
 }
 
+
+//-----------------------------------------------------------------------------
+static void NiftyLinkTrackingDataAggregatorTestMatrix(const int& tool, igtl::Matrix4x4& matrix)
+{
+  igtl::IdentityMatrix(matrix);
+  matrix[0][3] = tool;
+  matrix[1][3] = tool * 2;
+  matrix[2][3] = tool * 3;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataMessageHelpersTests::AggregatorTest()
+{
+  NiftyLinkTrackingDataAggregator aggregator("Tracker", "localhost", 1234);
+  aggregator.SetTimeWindow(1000000);
+  aggregator.SetMaximumNumberOfElements(16);
+
+  QVERIFY(aggregator.Flush().data() == NULL);
+
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  igtl::Matrix4x4 matrix;
+
+  // 10 tools within 1ms of each other.
+  for (int i = 0; i < 10; i++)
+  {
+    timeStamp->SetTimeInNanoseconds(1000000000 + i * 10000);
+    NiftyLinkTrackingDataAggregatorTestMatrix(i, matrix);
+    NiftyLinkMessageContainer::Pointer m = aggregator.AddElement(QString("Tool%1").arg(i), matrix, timeStamp);
+    QVERIFY(m.data() == NULL);
+  }
+
+  // Repeated tool finishes the first group.
+  timeStamp->SetTimeInNanoseconds(1000200000);
+  NiftyLinkMessageContainer::Pointer m = aggregator.AddElement("Tool0", matrix, timeStamp);
+  QVERIFY(m.data() != NULL);
+
+  igtl::TrackingDataMessage::Pointer msg = dynamic_cast<igtl::TrackingDataMessage*>(m->GetMessage().GetPointer());
+  QVERIFY(msg.IsNotNull());
+  QVERIFY(msg->GetNumberOfTrackingDataElements() == 10);
+  igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+  m->GetTimeCreated(timeCreated);
+  QVERIFY(timeCreated->GetTimeStampInNanoseconds() == 1000000000);
+  QVERIFY(m->GetSenderHostName() == "localhost");
+  QVERIFY(m->GetSenderPortNumber() == 1234);
+
+  // Element outside the time window finishes the second group.
+  timeStamp->SetTimeInNanoseconds(1002000000);
+  m = aggregator.AddElement("Tool1", matrix, timeStamp);
+  QVERIFY(m.data() != NULL);
+  msg = dynamic_cast<igtl::TrackingDataMessage*>(m->GetMessage().GetPointer());
+  QVERIFY(msg->GetNumberOfTrackingDataElements() == 1);
+
+  // Flush the third group.
+  m = aggregator.Flush();
+  QVERIFY(m.data() != NULL);
+  QVERIFY(aggregator.Flush().data() == NULL);
+
+  // Maximum number of elements.
+  aggregator.SetMaximumNumberOfElements(3);
+  for (int i = 0; i < 3; i++)
+  {
+    timeStamp->SetTimeInNanoseconds(1003000000 + i);
+    m = aggregator.AddElement(QString("Tool%1").arg(i), matrix, timeStamp);
+    QVERIFY((i < 2 && m.data() == NULL) || (i == 2 && m.data() != NULL));
+  }
+
+  QVERIFY(aggregator.GetNumberOfMessagesBeforeAggregation() == 15);
+  QVERIFY(aggregator.GetNumberOfMessagesAfterAggregation() == 4);
+
+  try
+  {
+    aggregator.SetMaximumNumberOfElements(0);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataMessageHelpersTests::SplitTrackingDataMessageTest()
+{
+  NiftyLinkMessageContainer::Pointer m;
+  try
+  {
+    SplitTrackingDataMessage(m);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+
+  m = (NiftyLinkMessageContainer::Pointer(new NiftyLinkMessageContainer()));
+  m->SetMessage(igtl::StringMessage::New().GetPointer());
+  try
+  {
+    SplitTrackingDataMessage(m);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+
+  NiftyLinkTrackingDataAggregator aggregator("Tracker", "localhost", 1234);
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  igtl::Matrix4x4 matrix;
+
+  for (int i = 0; i < 5; i++)
+  {
+    timeStamp->SetTimeInNanoseconds(2000000000 + i);
+    NiftyLinkTrackingDataAggregatorTestMatrix(i, matrix);
+    aggregator.AddElement(QString("Tool%1").arg(i), matrix, timeStamp);
+  }
+
+  QList<NiftyLinkMessageContainer::Pointer> split = SplitTrackingDataMessage(aggregator.Flush());
+  QVERIFY(split.size() == 5);
+
+  for (int i = 0; i < split.size(); i++)
+  {
+    igtl::TrackingDataMessage::Pointer msg = dynamic_cast<igtl::TrackingDataMessage*>(split[i]->GetMessage().GetPointer());
+    QVERIFY(msg.IsNotNull());
+    QVERIFY(msg->GetNumberOfTrackingDataElements() == 1);
+    igtl::TimeStamp::Pointer timeCreated = igtl::TimeStamp::New();
+    split[i]->GetTimeCreated(timeCreated);
+    QVERIFY(timeCreated->GetTimeStampInNanoseconds() == 2000000000);
+    QVERIFY(split[i]->GetSenderPortNumber() == 1234);
+
+    igtl::TrackingDataElement::Pointer elem = igtl::TrackingDataElement::New();
+    msg->GetTrackingDataElement(0, elem);
+    QVERIFY(QString(elem->GetName()) == QString("Tool%1").arg(i));
+
+    igtl::Matrix4x4 actual;
+    elem->GetMatrix(actual);
+    NiftyLinkTrackingDataAggregatorTestMatrix(i, matrix);
+    for (int r = 0; r < 4; r++)
+    {
+      for (int c = 0; c < 4; c++)
+      {
+        QVERIFY(matrix[r][c] == actual[r][c]);
+      }
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataMessageHelpersTests::TrackingDataArraysTest()
+{
+  const int n = 4;
+  float positions[3 * n];
+  float rotations[9 * n];
+  char names[n * (IGTL_TDATA_LEN_NAME + 1)];
+
+  igtl::TrackingDataMessage::Pointer msg;
+  try
+  {
+    GetTrackingDataArrays(msg, n, positions, rotations, names);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+
+  msg = igtl::TrackingDataMessage::New();
+  try
+  {
+    SetTrackingDataArrays(msg, n, NULL, rotations, names);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+
+  for (int i = 0; i < 3 * n; i++)
+  {
+    positions[i] = i * 1.5f;
+  }
+  for (int i = 0; i < 9 * n; i++)
+  {
+    rotations[i] = i * 0.25f - 3;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    qsnprintf(names + i * (IGTL_TDATA_LEN_NAME + 1), IGTL_TDATA_LEN_NAME + 1, "Tool%d", i);
+  }
+
+  SetTrackingDataArrays(msg, n, positions, rotations, names);
+  msg->Pack();
+  QVERIFY(msg->GetNumberOfTrackingDataElements() == n);
+
+  // Re-using the message should keep the same elements.
+  igtl::TrackingDataElement::Pointer first;
+  msg->GetTrackingDataElement(0, first);
+  SetTrackingDataArrays(msg, n, positions, rotations, NULL);
+  msg->Pack();
+  igtl::TrackingDataElement::Pointer firstAgain;
+  msg->GetTrackingDataElement(0, firstAgain);
+  QVERIFY(first.GetPointer() == firstAgain.GetPointer());
+
+  float decodedPositions[3 * n];
+  float decodedRotations[9 * n];
+  char decodedNames[n * (IGTL_TDATA_LEN_NAME + 1)];
+
+  QVERIFY(GetTrackingDataArrays(msg, n, decodedPositions, decodedRotations, decodedNames) == n);
+  QVERIFY(memcmp(positions, decodedPositions, sizeof(positions)) == 0);
+  QVERIFY(memcmp(rotations, decodedRotations, sizeof(rotations)) == 0);
+
+  for (int i = 0; i < n; i++)
+  {
+    QVERIFY(QString(decodedNames + i * (IGTL_TDATA_LEN_NAME + 1)) == QString("Tool%1").arg(i));
+
+    igtl::TrackingDataElement::Pointer elem = igtl::TrackingDataElement::New();
+    msg->GetTrackingDataElement(i, elem);
+
+    igtl::Matrix4x4 matrix;
+    elem->GetMatrix(matrix);
+
+    for (int r = 0; r < 3; r++)
+    {
+      QVERIFY(matrix[r][3] == decodedPositions[r * n + i]);
+      for (int c = 0; c < 3; c++)
+      {
+        QVERIFY(matrix[r][c] == decodedRotations[(3 * r + c) * n + i]);
+      }
+    }
+  }
+
+  // Fewer elements requested than in the message.
+  QVERIFY(GetTrackingDataArrays(msg, 2, decodedPositions, decodedRotations, NULL) == n);
+  QVERIFY(decodedPositions[0] == positions[0]);
+  QVERIFY(decodedPositions[2] == positions[n]);
+
+  // As received, ie. the header and body bytes copied into a new message, before and after Unpack().
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), msg->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+
+  igtl::TrackingDataMessage::Pointer received = igtl::TrackingDataMessage::New();
+  received->SetMessageHeader(header);
+  received->AllocatePack();
+  QVERIFY(received->GetPackBodySize() == msg->GetPackBodySize());
+  memcpy(received->GetPackBodyPointer(), msg->GetPackBodyPointer(), received->GetPackBodySize());
+
+  memset(decodedPositions, 0, sizeof(decodedPositions));
+  memset(decodedRotations, 0, sizeof(decodedRotations));
+  QVERIFY(GetTrackingDataArrays(received, n, decodedPositions, decodedRotations, NULL) == n);
+  QVERIFY(memcmp(positions, decodedPositions, sizeof(positions)) == 0);
+  QVERIFY(memcmp(rotations, decodedRotations, sizeof(rotations)) == 0);
+
+  received->Unpack();
+
+  memset(decodedPositions, 0, sizeof(decodedPositions));
+  memset(decodedRotations, 0, sizeof(decodedRotations));
+  memset(decodedNames, 0, sizeof(decodedNames));
+  QVERIFY(GetTrackingDataArrays(received, n, decodedPositions, decodedRotations, decodedNames) == n);
+  QVERIFY(memcmp(positions, decodedPositions, sizeof(positions)) == 0);
+  QVERIFY(memcmp(rotations, decodedRotations, sizeof(rotations)) == 0);
+  for (int i = 0; i < n; i++)
+  {
+    QVERIFY(QString(decodedNames + i * (IGTL_TDATA_LEN_NAME + 1)) == QString("Tool%1").arg(i));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+static void NiftyLinkTrackingHistoryTestMatrix(const double& angle, const float& x, igtl::Matrix4x4& matrix)
+{
+  igtl::IdentityMatrix(matrix);
+  matrix[0][0] = static_cast<float>(cos(angle));
+  matrix[0][1] = static_cast<float>(-sin(angle));
+  matrix[1][0] = static_cast<float>(sin(angle));
+  matrix[1][1] = static_cast<float>(cos(angle));
+  matrix[0][3] = x;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTrackingDataMessageHelpersTests::TrackingHistoryTest()
+{
+  try
+  {
+    NiftyLinkTrackingHistory history(1, 1);
+    QFAIL("Should have thrown std::invalid_argument.");
+  }
+  catch (std::invalid_argument& e)
+  {
+    // Expected.
+  }
+
+  NiftyLinkTrackingHistory history(2, 8);
+  igtl::Matrix4x4 matrix;
+  igtl::Matrix4x4 result;
+
+  // 20 poses, rotating 0.1 radians about z, and moving 1 along x, every 100ns, so only the last 8 are kept.
+  for (int i = 0; i < 20; i++)
+  {
+    NiftyLinkTrackingHistoryTestMatrix(i * 0.1, i, matrix);
+    QVERIFY(history.AddPose("Probe", matrix, 1000 + i * 100));
+  }
+  QVERIFY(!history.AddPose("Probe", matrix, 10));
+
+  QVERIFY(!history.GetPose("Probe", 2100, result));
+  QVERIFY(!history.GetPose("Probe", 2901, result));
+  QVERIFY(!history.GetPose("Pointer", 2500, result));
+
+  QVERIFY(history.GetPose("Probe", 2250, result));
+  QVERIFY(fabs(result[0][3] - 12.5) < 0.0001);
+  QVERIFY(fabs(atan2(result[1][0], result[0][0]) - 1.25) < 0.0001);
+
+  QVERIFY(history.GetPose("Probe", 2900, result));
+  QVERIFY(fabs(result[0][3] - 19) < 0.0001);
+
+  // From messages, with only room for one more tool.
+  igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+  NiftyLinkTrackingHistoryTestMatrix(0.5, 3, matrix);
+
+  NiftyLinkMessageContainer::Pointer transform = CreateTransformMessage("Pointer", "localhost", 1234, matrix, timeStamp);
+  QVERIFY(history.AddMessage(transform) == 1);
+  QVERIFY(history.GetPose("Pointer", timeStamp->GetTimeStampInNanoseconds(), result));
+  QVERIFY(fabs(result[0][3] - 3) < 0.0001);
+
+  NiftyLinkMessageContainer::Pointer trackingData = CreateTrackingDataMessage("Tracker", "Reference", "localhost", 1234, matrix, timeStamp);
+  QVERIFY(history.AddMessage(trackingData) == 0);
+  QVERIFY(history.GetNumberOfTools() == 2);
+}
+
 } // end namespace
 
 NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkTrackingDataMessageHelpersTests )
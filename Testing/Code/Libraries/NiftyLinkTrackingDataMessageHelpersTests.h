@@ -44,6 +44,50 @@ private slots:
    */
   void SetGetTrackingDataTest();
 
+  /**
+   * \brief Tests NiftyLinkTrackingDataAggregator.
+   *
+   * Spec:
+   *   - 10 tools within the time window give one message, with all 10 elements
+   *   - A repeated tool, or an element outside the time window, starts a new message
+   *   - Reaching the maximum number of elements returns a message straight away
+   *   - Flush() returns NULL when there is nothing to send
+   *   - Stats count the messages before and after aggregation
+   */
+  void AggregatorTest();
+
+  /**
+   * \brief Tests SplitTrackingDataMessage.
+   *
+   * Spec:
+   *   - Should throw std::invalid_argument if the message is NULL, or not TDATA
+   *   - Should return one message per element, with the same name, matrix and time stamp
+   */
+  void SplitTrackingDataMessageTest();
+
+  /**
+   * \brief Tests SetTrackingDataArrays and GetTrackingDataArrays.
+   *
+   * Spec:
+   *   - Should throw std::invalid_argument if the message or arrays are NULL
+   *   - Arrays set into a message, then Packed, should decode to the same numbers and names
+   *   - Decoded matrices should match those from GetTrackingDataElement
+   *   - Should decode at most maximumNumberOfElements, and return the number in the message
+   *   - The same message as received, both before and after Unpack(), should decode to the same numbers
+   */
+  void TrackingDataArraysTest();
+
+  /**
+   * \brief Tests NiftyLinkTrackingHistory.
+   *
+   * Spec:
+   *   - Poses added from TDATA and TRANSFORM messages can be looked up by tool name
+   *   - A pose between two stored poses is interpolated, linearly for translation, and by slerp for rotation
+   *   - Times outside the stored history, unknown tools, and out of order poses are rejected
+   *   - The oldest poses are overwritten once the history is full
+   */
+  void TrackingHistoryTest();
+
 };
 
 } // end namespace
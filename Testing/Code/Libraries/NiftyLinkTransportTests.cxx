@@ -0,0 +1,502 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkTransportTests.h"
+#include <NiftyLinkTcpClient.h>
+#include <NiftyLinkTcpServer.h>
+#include <NiftyLinkTransport.h>
+#include <NiftyLinkSharedMemoryRing.h>
+#include <NiftyLinkImageDeltaDecoder.h>
+#include <NiftyLinkImageDeltaEncoder.h>
+#include <NiftyLinkUtils.h>
+#include <NiftyLinkImageMessageHelpers.h>
+#include <NiftyLinkStringMessageHelpers.h>
+#include <NiftyLinkTrackingDataMessageHelpers.h>
+
+#include <igtlImageMessage.h>
+#include <igtlStringMessage.h>
+#include <igtlTrackingDataMessage.h>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSharedMemory>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+static QString NiftyLinkTransportTestAddress()
+{
+  return QString("unix:") + QDir::temp().absoluteFilePath("NiftyLinkTransportTests.sock");
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::OnReceiveMessage(int /*portNumber*/, niftk::NiftyLinkMessageContainer::Pointer message)
+{
+  m_NumberOfMessagesReceived++;
+  m_LastMessage = message;
+  m_Messages.append(message);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::OnClientReceiveMessage(niftk::NiftyLinkMessageContainer::Pointer message)
+{
+  this->OnReceiveMessage(0, message);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestAddresses()
+{
+  QVERIFY(NiftyLinkTransport::IsLocalAddress("unix:/tmp/x.sock"));
+  QVERIFY(NiftyLinkTransport::GetLocalPath("unix:/tmp/x.sock") == "/tmp/x.sock");
+
+  NiftyLinkTransport *transport = NiftyLinkTransport::New("unix:/tmp/x.sock");
+  QVERIFY(transport->IsLocal());
+  delete transport;
+
+  QVERIFY(!NiftyLinkTransport::IsLocalAddress("127.0.0.1"));
+  QVERIFY(NiftyLinkTransport::GetLocalPath("127.0.0.1") == "127.0.0.1");
+
+  transport = NiftyLinkTransport::New("127.0.0.1");
+  QVERIFY(!transport->IsLocal());
+  delete transport;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestSendReceiveLocal()
+{
+  m_NumberOfMessagesReceived = 0;
+  m_LastMessage.clear();
+
+  NiftyLinkTcpServer *server = new NiftyLinkTcpServer();
+  QVERIFY(server->Listen(NiftyLinkTransportTestAddress()));
+
+  connect(server, SIGNAL(MessageReceived(int,niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnReceiveMessage(int,niftk::NiftyLinkMessageContainer::Pointer)));
+
+  NiftyLinkTcpClient *client = new NiftyLinkTcpClient();
+  client->ConnectToHost(NiftyLinkTransportTestAddress(), 0);
+
+  QTest::qWait(1000);
+
+  QVERIFY(client->IsConnected());
+  QVERIFY(server->GetNumberOfClientsConnected() == 1);
+
+  NiftyLinkMessageContainer::Pointer msg = CreateTrackingDataMessageWithRandomData();
+  client->Send(msg);
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_NumberOfMessagesReceived == 1);
+  QVERIFY(m_LastMessage.data() != NULL);
+
+  igtl::TrackingDataMessage::Pointer expectedMessage = dynamic_cast<igtl::TrackingDataMessage*>(msg->GetMessage().GetPointer());
+  igtl::TrackingDataMessage::Pointer actualMessage = dynamic_cast<igtl::TrackingDataMessage*>(m_LastMessage->GetMessage().GetPointer());
+  QVERIFY(actualMessage.IsNotNull());
+  QVERIFY(actualMessage->GetNumberOfTrackingDataElements() == 1);
+
+  igtl::TrackingDataElement::Pointer expectedElem = igtl::TrackingDataElement::New();
+  igtl::TrackingDataElement::Pointer actualElem = igtl::TrackingDataElement::New();
+  expectedMessage->GetTrackingDataElement(0, expectedElem);
+  actualMessage->GetTrackingDataElement(0, actualElem);
+
+  igtl::Matrix4x4 expectedMatrix;
+  expectedElem->GetMatrix(expectedMatrix);
+
+  igtl::Matrix4x4 actualMatrix;
+  actualElem->GetMatrix(actualMatrix);
+
+  QVERIFY(IsCloseEnoughTo(expectedMatrix, actualMatrix, 0.00000001));
+
+  delete client;
+
+  QTest::qWait(1000);
+
+  QVERIFY(server->GetNumberOfClientsConnected() == 0);
+
+  // A second server must not take the path from one that is still listening.
+  NiftyLinkTcpServer *secondServer = new NiftyLinkTcpServer();
+  QVERIFY(!secondServer->Listen(NiftyLinkTransportTestAddress()));
+  delete secondServer;
+
+  client = new NiftyLinkTcpClient();
+  client->ConnectToHost(NiftyLinkTransportTestAddress(), 0);
+
+  QTest::qWait(1000);
+
+  QVERIFY(client->IsConnected());
+
+  delete client;
+  delete server;
+}
+
+
+//-----------------------------------------------------------------------------
+qint64 NiftyLinkTransportTests::TimeMessages(const QString& address, quint16 port, int numberOfMessages)
+{
+  m_NumberOfMessagesReceived = 0;
+
+  NiftyLinkTcpServer server;
+  if (!server.Listen(address, port))
+  {
+    return -1;
+  }
+
+  connect(&server, SIGNAL(MessageReceived(int,niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnReceiveMessage(int,niftk::NiftyLinkMessageContainer::Pointer)));
+
+  NiftyLinkTcpClient client;
+  client.ConnectToHost(address, port);
+
+  QTest::qWait(1000);
+
+  if (!client.IsConnected())
+  {
+    return -1;
+  }
+
+  // Created up front, so only sending and receiving is timed.
+  QList<NiftyLinkMessageContainer::Pointer> messages;
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    messages.append(CreateTrackingDataMessageWithRandomData());
+  }
+
+  QElapsedTimer clock;
+  clock.start();
+
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    client.Send(messages[i]);
+  }
+
+  while (m_NumberOfMessagesReceived < numberOfMessages && clock.elapsed() < 10000)
+  {
+    QCoreApplication::processEvents();
+  }
+
+  qint64 elapsed = clock.elapsed();
+  if (m_NumberOfMessagesReceived < numberOfMessages)
+  {
+    elapsed = -1;
+  }
+
+  client.DisconnectFromHost();
+  return elapsed;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestLocalVersusLoopbackTcp()
+{
+  const int numberOfMessages = 2000;
+
+  qint64 localTime = this->TimeMessages(NiftyLinkTransportTestAddress(), 0, numberOfMessages);
+  QVERIFY(localTime >= 0);
+
+  qint64 tcpTime = this->TimeMessages("127.0.0.1", 18946, numberOfMessages);
+  QVERIFY(tcpTime >= 0);
+
+  QLOG_INFO() << QObject::tr("TestLocalVersusLoopbackTcp() - %1 TDATA messages took %2 ms over a local socket, and %3 ms over loopback TCP.")
+                 .arg(numberOfMessages).arg(localTime).arg(tcpTime);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestSharedMemoryRing()
+{
+  const QString key = NiftyLinkSharedMemoryRing::CreateUniqueKey();
+
+  NiftyLinkSharedMemoryRing producer;
+  QVERIFY(producer.Create(key, 16, 2));
+  QVERIFY(producer.IsAttached());
+  QVERIFY(producer.GetSlotSize() == 16);
+  QVERIFY(producer.GetNumberOfSlots() == 2);
+
+  NiftyLinkSharedMemoryRing consumer;
+  QVERIFY(consumer.Attach(key));
+  QVERIFY(consumer.GetKey() == key);
+  QVERIFY(consumer.GetSlotSize() == 16);
+  QVERIFY(consumer.GetNumberOfSlots() == 2);
+
+  char tooBig[17];
+  memset(tooBig, 1, sizeof(tooBig));
+  QVERIFY(producer.Write(tooBig, sizeof(tooBig)) == -1);
+
+  const char first[] = "first";
+  const char second[] = "second";
+  QVERIFY(producer.Write(first, sizeof(first)) == 0);
+  QVERIFY(producer.Write(second, sizeof(second)) == 1);
+  QVERIFY(producer.Write(first, sizeof(first)) == -1);
+
+  int length = 0;
+  const char *data = consumer.GetSlot(0, length);
+  QVERIFY(data != NULL);
+  QVERIFY(length == sizeof(first));
+  QVERIFY(memcmp(data, first, length) == 0);
+  consumer.Release(0);
+  QVERIFY(consumer.GetSlot(0, length) == NULL);
+
+  QVERIFY(producer.Write(first, sizeof(first)) == 0);
+
+  data = consumer.GetSlot(1, length);
+  QVERIFY(data != NULL);
+  QVERIFY(length == sizeof(second));
+  QVERIFY(memcmp(data, second, length) == 0);
+  consumer.Release(1);
+
+  QVERIFY(consumer.GetSlot(2, length) == NULL);
+
+  // Slot 0 is still written, until the consumer hands it back.
+  QVERIFY(producer.IsAnySlotWritten());
+
+  // A length bigger than a slot, as if the other process had written it, is not trusted.
+  QSharedMemory segment(key);
+  QVERIFY(segment.attach());
+  int *lengths = reinterpret_cast<int*>(static_cast<char*>(segment.data()) + 4 * sizeof(int) + 2 * sizeof(QAtomicInt));
+  lengths[0] = 17;
+  QVERIFY(consumer.GetSlot(0, length) == NULL);
+  consumer.Release(0);
+  QVERIFY(!producer.IsAnySlotWritten());
+  segment.detach();
+
+  consumer.Detach();
+  QVERIFY(!consumer.IsAttached());
+
+  // Too big for a QSharedMemory segment, rather than overflowing.
+  NiftyLinkSharedMemoryRing tooBigRing;
+  QVERIFY(!tooBigRing.Create(NiftyLinkSharedMemoryRing::CreateUniqueKey(), 0x40000000, 4));
+
+  // A header whose slots don't fit in the segment, (here by overflowing an int), is not attached to.
+  const QString badKey = NiftyLinkSharedMemoryRing::CreateUniqueKey();
+  QSharedMemory badSegment(badKey);
+  QVERIFY(badSegment.create(1024));
+  int *header = static_cast<int*>(badSegment.data());
+  header[0] = 0x4E4C534D;
+  header[1] = 0x40000000;
+  header[2] = 4;
+  QVERIFY(!consumer.Attach(badKey));
+  QVERIFY(!consumer.IsAttached());
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestSendReceiveImageThroughSharedMemory()
+{
+  m_NumberOfMessagesReceived = 0;
+  m_LastMessage.clear();
+
+  NiftyLinkTcpServer *server = new NiftyLinkTcpServer();
+  QVERIFY(server->Listen(NiftyLinkTransportTestAddress()));
+
+  NiftyLinkTcpClient *client = new NiftyLinkTcpClient();
+  connect(client, SIGNAL(MessageReceived(niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnClientReceiveMessage(niftk::NiftyLinkMessageContainer::Pointer)));
+
+  client->ConnectToHost(NiftyLinkTransportTestAddress(), 0);
+
+  QTest::qWait(1000);
+
+  QVERIFY(client->IsConnected());
+  client->RequestSharedMemory(true);
+
+  QTest::qWait(1000);
+
+  QImage i1(":/NiftyLink/UCL_LOGO.tif");
+  i1 = i1.convertToFormat(QImage::Format_ARGB32);
+
+  NiftyLinkMessageContainer::Pointer msg = CreateImageMessage("TestingDevice", "TestingHost", 1234, i1);
+  server->Send(msg);
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_NumberOfMessagesReceived == 1);
+  QVERIFY(m_LastMessage.data() != NULL);
+
+  igtl::ImageMessage::Pointer actualMessage = dynamic_cast<igtl::ImageMessage*>(m_LastMessage->GetMessage().GetPointer());
+  QVERIFY(actualMessage.IsNotNull());
+
+  QImage i2;
+  GetQImage(actualMessage, i2);
+  QVERIFY(i1 == i2);
+
+  // A smaller image, which fits in the ring, straight away followed by a bigger one, which needs
+  // a new ring, while the notice for the smaller one may still be on its way.
+  QImage smaller = i1.scaled(i1.width() / 2, i1.height() / 2);
+  QImage bigger = i1.scaled(i1.width() * 2, i1.height() * 2);
+  server->Send(CreateImageMessage("TestingDevice", "TestingHost", 1234, smaller));
+  server->Send(CreateImageMessage("TestingDevice", "TestingHost", 1234, bigger));
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_NumberOfMessagesReceived == 3);
+  actualMessage = dynamic_cast<igtl::ImageMessage*>(m_LastMessage->GetMessage().GetPointer());
+  QVERIFY(actualMessage.IsNotNull());
+
+  QImage i3;
+  GetQImage(actualMessage, i3);
+  QVERIFY(bigger == i3);
+
+  delete client;
+
+  QTest::qWait(1000);
+
+  delete server;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestSharedMemoryNoticeNotAskedFor()
+{
+  // A real ring, with an image in slot 0, so reading the notice would hand the slot back.
+  const QString key = NiftyLinkSharedMemoryRing::CreateUniqueKey();
+  NiftyLinkSharedMemoryRing ring;
+  QVERIFY(ring.Create(key, 1024, 2));
+  char data[1024];
+  std::memset(data, 0, sizeof(data));
+  QVERIFY(ring.Write(data, sizeof(data)) == 0);
+
+  const QString notice = QString("SHMIMAGE:%1,0").arg(key);
+
+  // Over TCP, the client asks, which is refused, and over a local socket, it doesn't ask.
+  QStringList addresses;
+  addresses << "127.0.0.1" << NiftyLinkTransportTestAddress();
+  quint16 ports[2] = {18947, 0};
+
+  for (int i = 0; i < addresses.size(); i++)
+  {
+    m_NumberOfMessagesReceived = 0;
+    m_LastMessage.clear();
+
+    NiftyLinkTcpServer *server = new NiftyLinkTcpServer();
+    QVERIFY(server->Listen(addresses[i], ports[i]));
+
+    NiftyLinkTcpClient *client = new NiftyLinkTcpClient();
+    connect(client, SIGNAL(MessageReceived(niftk::NiftyLinkMessageContainer::Pointer)),
+            this, SLOT(OnClientReceiveMessage(niftk::NiftyLinkMessageContainer::Pointer)));
+
+    client->ConnectToHost(addresses[i], ports[i]);
+
+    QTest::qWait(1000);
+
+    QVERIFY(client->IsConnected());
+
+    if (i == 0)
+    {
+      client->RequestSharedMemory(true);
+    }
+    server->Send(CreateStringMessage("TestingDevice", "TestingHost", 1234, notice));
+
+    QTest::qWait(1000);
+
+    QVERIFY(m_NumberOfMessagesReceived == 1);
+    QVERIFY(m_LastMessage.data() != NULL);
+
+    igtl::StringMessage::Pointer actualMessage = dynamic_cast<igtl::StringMessage*>(m_LastMessage->GetMessage().GetPointer());
+    QVERIFY(actualMessage.IsNotNull());
+    QVERIFY(QString(actualMessage->GetString()) == notice);
+    QVERIFY(ring.IsAnySlotWritten());
+
+    delete client;
+
+    QTest::qWait(1000);
+
+    delete server;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkTransportTests::TestDecimationOfDeltaEncodedImages()
+{
+  m_NumberOfMessagesReceived = 0;
+  m_Messages.clear();
+
+  NiftyLinkTcpServer *server = new NiftyLinkTcpServer();
+  QVERIFY(server->Listen(NiftyLinkTransportTestAddress()));
+
+  NiftyLinkTcpClient *client = new NiftyLinkTcpClient();
+  connect(client, SIGNAL(MessageReceived(niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnClientReceiveMessage(niftk::NiftyLinkMessageContainer::Pointer)));
+
+  client->ConnectToHost(NiftyLinkTransportTestAddress(), 0);
+
+  QTest::qWait(1000);
+
+  QVERIFY(client->IsConnected());
+  client->RequestDownsampling(2);
+
+  QTest::qWait(1000);
+
+  // Key frames are frames 0 and 3, and the rest are sub-volumes.
+  NiftyLinkImageDeltaEncoder encoder;
+  encoder.SetTileSize(32);
+  encoder.SetKeyFrameInterval(3);
+
+  const int numberOfFrames = 5;
+  QImage image(256, 256, QImage::Format_ARGB32);
+  image.fill(QColor(10, 20, 30));
+
+  igtl::ImageMessage::Pointer frame = igtl::ImageMessage::New();
+  frame->SetDeviceName("Ultrasound");
+
+  for (int i = 0; i < numberOfFrames; i++)
+  {
+    image.setPixel(10 + 40 * i, 10, qRgba(i, 2, 3, 255));
+    niftk::SetQImage(image, frame);
+
+    igtl::ImageMessage::Pointer encoded = encoder.Encode(frame);
+    QVERIFY(encoded.IsNotNull());
+    encoded->Pack();
+
+    NiftyLinkMessageContainer::Pointer msg(new NiftyLinkMessageContainer());
+    msg->SetMessage(encoded.GetPointer());
+    server->Send(msg);
+  }
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_NumberOfMessagesReceived == numberOfFrames);
+
+  // The first key frame is downsampled, as the server doesn't yet know the device sends sub-volumes.
+  NiftyLinkImageDeltaDecoder decoder;
+  igtl::ImageMessage::Pointer decoded;
+  for (int i = 0; i < numberOfFrames; i++)
+  {
+    igtl::ImageMessage::Pointer received = dynamic_cast<igtl::ImageMessage*>(m_Messages[i]->GetMessage().GetPointer());
+    QVERIFY(received.IsNotNull());
+
+    int dimensions[3];
+    received->GetDimensions(dimensions);
+    QVERIFY(dimensions[0] == (i == 0 ? 128 : 256));
+
+    decoded = decoder.Decode(received);
+  }
+
+  QVERIFY(decoded.IsNotNull());
+  QVERIFY(memcmp(decoded->GetScalarPointer(), frame->GetScalarPointer(), frame->GetImageSize()) == 0);
+
+  delete client;
+
+  QTest::qWait(1000);
+
+  delete server;
+}
+
+} // end namespace
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkTransportTests )
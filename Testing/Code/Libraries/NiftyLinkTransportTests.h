@@ -0,0 +1,137 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkTransportTests_h
+#define NiftyLinkTransportTests_h
+
+#include <NiftyLinkTestingMacros.h>
+#include <NiftyLinkMessageContainer.h>
+
+namespace niftk
+{
+
+class NiftyLinkTcpServer;
+class NiftyLinkTcpClient;
+
+/**
+* \class NiftyLinkTransportTests
+* \brief Tests for NiftyLinkTransport, NiftyLinkSharedMemoryRing, and NiftyLinkTcpClient/NiftyLinkTcpServer over a local socket.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkTransportTests: public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  /**
+   * \brief Tests parsing addresses.
+   *
+   * Spec:
+   *   - "unix:/tmp/x.sock" is local, with path "/tmp/x.sock", and New() creates a local transport.
+   *   - "127.0.0.1" is not local, its path is unchanged, and New() creates a TCP transport.
+   */
+  void TestAddresses();
+
+  /**
+   * \brief Generate random TDATA, test Sending and Receive over a local socket produces identical TDATA.
+   *
+   * Spec:
+   *   - Server listens on "unix:<temp dir>/NiftyLinkTransportTests.sock", and client connects to it.
+   *   - Send TDATA, wait 1sec.
+   *   - Check received matrix is close enough to sent matrix, tolerance=0.00000001.
+   *   - Disconnect, and check the server has no clients.
+   *   - Check a second server can't Listen() on the same path, and the first still accepts a client.
+   */
+  void TestSendReceiveLocal();
+
+  /**
+   * \brief Sends the same number of TDATA messages over a local socket, and over loopback TCP, logging the time taken.
+   *
+   * Spec:
+   *   - Check every message is received on both.
+   *   - Only the times are logged, as they depend on the machine.
+   */
+  void TestLocalVersusLoopbackTcp();
+
+  /**
+   * \brief Tests writing to and reading from a NiftyLinkSharedMemoryRing, in one process.
+   *
+   * Spec:
+   *   - Create a ring of 2 slots of 16 bytes, and attach a second ring to it.
+   *   - Data bigger than a slot is not written.
+   *   - Two writes fill both slots, and a third fails until the first slot is released.
+   *   - Each slot read holds the bytes written.
+   *   - A slot whose length is bigger than a slot is not read.
+   *   - A ring too big for a segment isn't created, and a header whose slots don't fit in the segment isn't attached to.
+   */
+  void TestSharedMemoryRing();
+
+  /**
+   * \brief Tests a client asking for images through shared memory receives identical images.
+   *
+   * Spec:
+   *   - Client connects over a local socket, and calls RequestSharedMemory(true), wait 1sec.
+   *   - Server sends an IMAGE, wait 1sec.
+   *   - Check the client received one IMAGE, identical to the one sent.
+   *   - Server sends a smaller IMAGE, then straight away a bigger one, which needs a new ring, wait 1sec.
+   *   - Check the client received both, and the last is identical to the bigger one.
+   */
+  void TestSendReceiveImageThroughSharedMemory();
+
+  /**
+   * \brief Tests a notice of an image in shared memory, from a peer that wasn't asked, is just a STRING message.
+   *
+   * Spec:
+   *   - Create a ring, and write to slot 0.
+   *   - Over loopback TCP, the client calls RequestSharedMemory(true), which is refused, and the server sends "SHMIMAGE:<key>,0".
+   *   - Over a local socket, the client doesn't ask, and the server sends the same.
+   *   - Each time, check the client received it as a STRING message, and slot 0 is still written.
+   */
+  void TestSharedMemoryNoticeNotAskedFor();
+
+  /**
+   * \brief Tests a delta encoded stream, (see NiftyLinkImageDeltaEncoder), to a client that asked for downsampling.
+   *
+   * Spec:
+   *   - Client connects over a local socket, and calls RequestDownsampling(2), wait 1sec.
+   *   - Server sends 5 delta encoded frames, with a key frame interval of 3, wait 1sec.
+   *   - Check only the first key frame, sent before any sub-volume, is downsampled.
+   *   - Check the last frame decodes to the last frame sent.
+   */
+  void TestDecimationOfDeltaEncodedImages();
+
+  /// \brief To count incoming messages.
+  void OnReceiveMessage(int, niftk::NiftyLinkMessageContainer::Pointer);
+
+  /// \brief To count messages coming in to a client.
+  void OnClientReceiveMessage(niftk::NiftyLinkMessageContainer::Pointer);
+
+private:
+
+  /// \brief Starts a server on address, connects a client, sends numberOfMessages TDATA, and returns
+  /// the milliseconds until all were received, or -1 if they were not.
+  qint64 TimeMessages(const QString& address, quint16 port, int numberOfMessages);
+
+  int                                m_NumberOfMessagesReceived;
+  NiftyLinkMessageContainer::Pointer m_LastMessage;
+  QList<NiftyLinkMessageContainer::Pointer> m_Messages;
+
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkTransportTests_h
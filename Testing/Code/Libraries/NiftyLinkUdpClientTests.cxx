@@ -0,0 +1,140 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#include "NiftyLinkUdpClientTests.h"
+#include <NiftyLinkUdpClient.h>
+#include <NiftyLinkStringMessageHelpers.h>
+#include <NiftyLinkTrackingDataMessageHelpers.h>
+#include <NiftyLinkUtils.h>
+
+#include <igtlTrackingDataMessage.h>
+
+#include <QHostAddress>
+#include <QtEndian>
+#include <QUdpSocket>
+
+#include <cstring>
+
+namespace niftk
+{
+
+//-----------------------------------------------------------------------------
+static QByteArray NiftyLinkUdpTestDatagram(const quint64& sequenceNumber, NiftyLinkMessageContainer::Pointer message)
+{
+  // As written by NiftyLinkUdpClient::Send().
+  igtl::MessageBase::Pointer msg = message->GetMessage();
+  QByteArray datagram;
+  datagram.resize(12 + msg->GetPackSize());
+  qToBigEndian<quint32>(0x4E4C5544, reinterpret_cast<uchar*>(datagram.data()));
+  qToBigEndian<quint64>(sequenceNumber, reinterpret_cast<uchar*>(datagram.data() + 4));
+  memcpy(datagram.data() + 12, msg->GetPackPointer(), msg->GetPackSize());
+  return datagram;
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClientTests::OnMessageReceived(niftk::NiftyLinkMessageContainer::Pointer message)
+{
+  m_ReceivedMessages.push_back(message);
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClientTests::TestSendReceive()
+{
+  m_ReceivedMessages.clear();
+
+  NiftyLinkUdpClient receiver;
+  QVERIFY(receiver.Bind(0));
+  QVERIFY(receiver.GetLocalPort() != 0);
+
+  connect(&receiver, SIGNAL(MessageReceived(niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnMessageReceived(niftk::NiftyLinkMessageContainer::Pointer)));
+
+  NiftyLinkUdpClient sender;
+  QVERIFY(sender.SetDestination("127.0.0.1", receiver.GetLocalPort()));
+
+  NiftyLinkMessageContainer::Pointer msg = CreateTrackingDataMessageWithRandomData();
+  QVERIFY(sender.Send(msg));
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_ReceivedMessages.size() == 1);
+  QVERIFY(receiver.GetNumberOfMessagesReceived() == 1);
+  QVERIFY(receiver.GetNumberOfMessagesLost() == 0);
+  QVERIFY(receiver.GetNumberOfMessagesReordered() == 0);
+  QVERIFY(receiver.GetNumberOfMessagesDuplicated() == 0);
+
+  igtl::TrackingDataMessage::Pointer expectedMessage = dynamic_cast<igtl::TrackingDataMessage*>(msg->GetMessage().GetPointer());
+  igtl::TrackingDataMessage::Pointer actualMessage = dynamic_cast<igtl::TrackingDataMessage*>(m_ReceivedMessages[0]->GetMessage().GetPointer());
+  QVERIFY(actualMessage.IsNotNull());
+  QVERIFY(actualMessage->GetNumberOfTrackingDataElements() == 1);
+
+  igtl::TrackingDataElement::Pointer expectedElem = igtl::TrackingDataElement::New();
+  igtl::TrackingDataElement::Pointer actualElem = igtl::TrackingDataElement::New();
+  expectedMessage->GetTrackingDataElement(0, expectedElem);
+  actualMessage->GetTrackingDataElement(0, actualElem);
+
+  igtl::Matrix4x4 expectedMatrix;
+  expectedElem->GetMatrix(expectedMatrix);
+
+  igtl::Matrix4x4 actualMatrix;
+  actualElem->GetMatrix(actualMatrix);
+
+  QVERIFY(IsCloseEnoughTo(expectedMatrix, actualMatrix, 0.00000001));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClientTests::TestUnsupportedMessages()
+{
+  NiftyLinkUdpClient sender;
+  QVERIFY(!sender.Send(CreateTrackingDataMessageWithRandomData()));
+
+  QVERIFY(sender.SetDestination("127.0.0.1", 18947));
+  QVERIFY(!sender.Send(CreateStringMessage("TestingDevice", "TestingHost", 1234, "Hello")));
+  QVERIFY(sender.Send(CreateTrackingDataMessageWithRandomData()));
+}
+
+
+//-----------------------------------------------------------------------------
+void NiftyLinkUdpClientTests::TestOutOfSequence()
+{
+  m_ReceivedMessages.clear();
+
+  NiftyLinkUdpClient receiver;
+  QVERIFY(receiver.Bind(0));
+
+  connect(&receiver, SIGNAL(MessageReceived(niftk::NiftyLinkMessageContainer::Pointer)),
+          this, SLOT(OnMessageReceived(niftk::NiftyLinkMessageContainer::Pointer)));
+
+  NiftyLinkMessageContainer::Pointer msg = CreateTrackingDataMessageWithRandomData();
+
+  QUdpSocket socket;
+  const quint64 sequenceNumbers[5] = {1, 3, 3, 2, 5};
+  for (int i = 0; i < 5; i++)
+  {
+    socket.writeDatagram(NiftyLinkUdpTestDatagram(sequenceNumbers[i], msg), QHostAddress::LocalHost, receiver.GetLocalPort());
+  }
+  socket.writeDatagram(QByteArray("junk"), QHostAddress::LocalHost, receiver.GetLocalPort());
+
+  QTest::qWait(1000);
+
+  QVERIFY(m_ReceivedMessages.size() == 3);
+  QVERIFY(receiver.GetNumberOfMessagesReceived() == 3);
+  QVERIFY(receiver.GetNumberOfMessagesLost() == 2);
+  QVERIFY(receiver.GetNumberOfMessagesDuplicated() == 1);
+  QVERIFY(receiver.GetNumberOfMessagesReordered() == 1);
+}
+
+} // end namespace
+
+NIFTYLINK_QTEST_MAIN( niftk::NiftyLinkUdpClientTests )
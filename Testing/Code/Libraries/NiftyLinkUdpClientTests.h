@@ -0,0 +1,77 @@
+/*=============================================================================
+  NiftyLink:  A software library to facilitate communication over OpenIGTLink.
+
+  Copyright (c) University College London (UCL). All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+  See LICENSE.txt in the top level directory for details.
+=============================================================================*/
+#ifndef NiftyLinkUdpClientTests_h
+#define NiftyLinkUdpClientTests_h
+
+#include <NiftyLinkTestingMacros.h>
+#include <NiftyLinkMessageContainer.h>
+
+namespace niftk
+{
+
+/**
+* \class NiftyLinkUdpClientTests
+* \brief Tests for NiftyLinkUdpClient, over loopback.
+*
+* This test harness uses the <a href="http://qt-project.org/doc/qt-4.8/qtestlib-manual.html">QTestLib</a> framework.
+*
+* This class is for developers to read. Comments in this header file should be brief. If you want to
+* describe the functionality of the method you are testing, put the description in the header file
+* of the real class, not in this test harness. Developers are expected to be able to read the .cxx file.
+*/
+class NiftyLinkUdpClientTests: public QObject
+{
+  Q_OBJECT
+
+public slots:
+
+  /// \brief Stores incoming messages, (public, so QTestLib doesn't run it as a test).
+  void OnMessageReceived(niftk::NiftyLinkMessageContainer::Pointer message);
+
+private slots:
+
+  /**
+   * \brief Generate random TDATA, test Sending and Receive over loopback produces identical TDATA.
+   *
+   * Spec:
+   *   - Receiver binds any free port, and sender sends TDATA to it on 127.0.0.1, wait 1sec.
+   *   - Check received matrix is close enough to sent matrix, tolerance=0.00000001.
+   *   - Check nothing was counted as lost, reordered or duplicated.
+   */
+  void TestSendReceive();
+
+  /**
+   * \brief Checks only TDATA, TRANSFORM and POSITION can be sent.
+   *
+   * Spec:
+   *   - Sending a STRING returns false.
+   *   - Sending without a destination returns false.
+   */
+  void TestUnsupportedMessages();
+
+  /**
+   * \brief Sends hand made datagrams, to check out of sequence messages are dropped and counted.
+   *
+   * Spec:
+   *   - Send sequence numbers 1, 3, 3, 2, 5, and a datagram that isn't from NiftyLinkUdpClient, wait 1sec.
+   *   - Check 1, 3 and 5 are delivered, 2 are counted lost, 1 duplicated, and 1 reordered.
+   */
+  void TestOutOfSequence();
+
+private:
+
+  QList<NiftyLinkMessageContainer::Pointer> m_ReceivedMessages;
+};
+
+} // end namespace niftk
+
+#endif // NiftyLinkUdpClientTests_h
@@ -143,6 +143,63 @@ void NiftyLinkUtilsTests::CalculateMaxTest()
 }
 
 
+//-----------------------------------------------------------------------------
+void NiftyLinkUtilsTests::CalculateStatsTest()
+{
+  QList<igtlUint64> list;
+  NiftyLinkRunningStats stats = CalculateStats(list);
+  QVERIFY(stats.GetCount() == 0);
+  QVERIFY(stats.GetMean() == 0);
+  QVERIFY(stats.GetStdDev() == 0);
+  QVERIFY(stats.GetMin() == 0);
+  QVERIFY(stats.GetMax() == 0);
+
+  list.push_back(1);
+  list.push_back(2);
+  list.push_back(3);
+  list.push_back(4);
+  stats = CalculateStats(list);
+  QVERIFY(stats.GetCount() == 4);
+  QVERIFY(IsCloseEnoughTo(stats.GetMean(), 2.5));
+  QVERIFY(IsCloseEnoughTo(stats.GetStdDev(), 1.290994449));
+  QVERIFY(stats.GetMin() == 1);
+  QVERIFY(stats.GetMax() == 4);
+
+  // Large values with small spread, and not a multiple of the block or lane size,
+  // must give the same answer via the array kernel, the O(1) update, and a merge.
+  list.clear();
+  NiftyLinkRunningStats incremental;
+  NiftyLinkRunningStats firstHalf;
+  NiftyLinkRunningStats secondHalf;
+  const int numberOfValues = 5003;
+  for (int i = 0; i < numberOfValues; i++)
+  {
+    igtlUint64 value = static_cast<igtlUint64>(50000000ULL) + static_cast<igtlUint64>((i * 7919) % 1000);
+    list.push_back(value);
+    incremental.Add(value);
+    if (i < numberOfValues / 2)
+    {
+      firstHalf.Add(value);
+    }
+    else
+    {
+      secondHalf.Add(value);
+    }
+  }
+  firstHalf.Merge(secondHalf);
+  stats = CalculateStats(list);
+
+  QVERIFY(stats.GetCount() == static_cast<quint64>(numberOfValues));
+  QVERIFY(stats.GetMin() == incremental.GetMin());
+  QVERIFY(stats.GetMax() == incremental.GetMax());
+  QVERIFY(stats.GetMin() == firstHalf.GetMin());
+  QVERIFY(stats.GetMax() == firstHalf.GetMax());
+  QVERIFY(IsCloseEnoughTo(stats.GetStdDev(), incremental.GetStdDev(), 0.01));
+  QVERIFY(IsCloseEnoughTo(stats.GetStdDev(), firstHalf.GetStdDev(), 0.01));
+  QVERIFY(IsCloseEnoughTo(stats.GetMean(), incremental.GetMean(), 0.001));
+}
+
+
 //-----------------------------------------------------------------------------
 void NiftyLinkUtilsTests::CalculateCloseEnoughToTest()
 {
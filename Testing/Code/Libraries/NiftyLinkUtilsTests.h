@@ -77,6 +77,11 @@ private slots:
    */
   void CalculateMaxTest();
 
+  /**
+   * \brief Tests NiftyLinkUtils::CalculateStats() and NiftyLinkRunningStats, checking the single pass, incremental and merged results agree.
+   */
+  void CalculateStatsTest();
+
   /**
    * \brief Tests NiftyLinkUtils::IsCloseEnoughTo() and NiftyLinkUtils::IsCloseEnoughToZero()
    */